@@ -256,6 +256,12 @@ int DoActionMove(CUnit &unit)
 				unit.Moving = 0;
 				return d;
 			case PF_WAIT: // No path, wait
+				//Wyrmgus start
+				if (unit.pathFinderData->RequestState == PathRequestPending) { // the path will be available by the next cycle
+					unit.Moving = 0;
+					return PF_MOVE;
+				}
+				//Wyrmgus end
 				unit.Wait = 10;
 
 				unit.Moving = 0;
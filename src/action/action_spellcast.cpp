@@ -448,7 +448,10 @@ bool COrder_SpellCast::SpellMoveToTarget(CUnit &unit)
 //										unit.Type->Name.c_str(), spell.Name.c_str());
 										unit.GetMessageName().c_str(), spell.Name.c_str());
 										//Wyrmgus end
-				} else if (unit.SpellCoolDownTimers[spell.Slot]) {
+				//Wyrmgus start
+//				} else if (unit.SpellCoolDownTimers[spell.Slot]) {
+				} else if (unit.GetSpellCoolDownTimer(spell.Slot)) {
+				//Wyrmgus end
 					unit.Player->Notify(NotifyYellow, unit.tilePos,
 										//Wyrmgus start
 										unit.MapLayer,
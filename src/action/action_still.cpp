@@ -72,6 +72,10 @@ enum {
 	SUB_STILL_ATTACK
 };
 
+//Wyrmgus start
+#define UNIT_SLEEP_MAX_CYCLES (CYCLES_PER_SECOND / 2) /// maximum cycles for which an idle unit which can react to others sleeps
+//Wyrmgus end
+
 /* static */ COrder *COrder::NewActionStandGround()
 {
 	return new COrder_Still(true);
@@ -536,6 +540,111 @@ bool AutoAttack(CUnit &unit)
 }
 
 
+//Wyrmgus start
+/**
+**  Get the range around an idle unit in which others moving can give it something to do
+**
+**  @return  the range, or 0 if nothing around the unit can make it act
+*/
+int COrder_Still::GetSleepWatchRange(const CUnit &unit) const
+{
+	int range = 0;
+	
+	if (unit.IsAgressive()) {
+		range = std::max(unit.GetReactionRange(), unit.GetModifiedVariable(ATTACKRANGE_INDEX));
+	}
+	
+	if (unit.AutoRepair) {
+		range = std::max(range, unit.Variable[AUTOREPAIRRANGE_INDEX].Value);
+	}
+	
+	if (unit.Type->BoolFlag[ORGANIC_INDEX].value && unit.Player->AiEnabled) {
+		range = std::max(range, unit.GetReactionRange());
+	}
+	
+	return range;
+}
+
+/**
+**  Check whether an idle unit has done nothing but stand still this cycle, and can be put to sleep
+**
+**  Units which move randomly or auto cast spells never sleep, as they use the synchronized random number generator when looking for something to do.
+*/
+bool COrder_Still::CanSleep(const CUnit &unit) const
+{
+	if (
+		unit.Orders.size() != 1
+		|| unit.CurrentOrder() != this
+		|| !this->Finished
+		|| this->State != SUB_STILL_STANDBY
+		|| unit.Removed
+		|| unit.CriticalOrder != NULL
+		|| unit.Anim.Unbreakable
+		|| unit.Variable[STUN_INDEX].Value > 0
+		|| unit.Type->RandomMovementProbability
+	) {
+		return false;
+	}
+	
+	if (unit.AutoCastSpell) {
+		for (size_t i = 0; i < SpellTypeTable.size(); ++i) {
+			if (unit.AutoCastSpell[i]) {
+				return false;
+			}
+		}
+	}
+	
+	return true;
+}
+
+/**
+**  Check whether a sleeping unit should stay asleep
+**
+**  A unit wakes up if its order changes, if it is attacked or if diplomacy changes (see WakeUpSleepingUnits). If it can react to other units, it also wakes up when the buckets around it change, i.e. when a unit enters or leaves them, a tile in them is revealed or fogged, or a unit in them is damaged or changes owner; and periodically to account for any remaining changes.
+*/
+bool COrder_Still::IsAsleep(const CUnit &unit) const
+{
+	if (!unit.SleepCycle || !this->CanSleep(unit) || unit.Attacked >= unit.SleepCycle) {
+		return false;
+	}
+	
+	const int watch_range = this->GetSleepWatchRange(unit);
+	if (watch_range == 0) {
+		return true;
+	}
+	
+	if (GameCycle - unit.SleepCycle >= UNIT_SLEEP_MAX_CYCLES) {
+		return false;
+	}
+	
+	const Vec2i offset(watch_range, watch_range);
+	const Vec2i end_pos(unit.tilePos.x + unit.Type->TileWidth - 1, unit.tilePos.y + unit.Type->TileHeight - 1);
+	return !Map.HasUnitBucketChangedSince(unit.tilePos - offset, end_pos + offset, unit.MapLayer, unit.SleepCycle);
+}
+
+/**
+**  Execute the order of a sleeping unit
+**
+**  Only the idle animation and sound are handled, in the same way as in Execute, so that the synchronized state is the same as if the unit had been awake.
+*/
+void COrder_Still::ExecuteAsleep(CUnit &unit)
+{
+	this->Finished = false;
+	
+	UnitShowAnimation(unit, unit.GetAnimations()->Still);
+	if (SyncRand(10000) == 0) {
+		PlayUnitSound(unit, VoiceIdle);
+	}
+	unit.StepCount = 0;
+	
+	if (unit.Anim.Unbreakable) { // animation can't be aborted here
+		return;
+	}
+	
+	this->Finished = true;
+}
+//Wyrmgus end
+
 /* virtual */ void COrder_Still::Execute(CUnit &unit)
 {
 	// If unit is not bunkered and removed, wait
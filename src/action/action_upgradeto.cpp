@@ -311,9 +311,15 @@ int TransformUnitIntoType(CUnit &unit, const CUnitType &newtype)
 	if (!unit.AutoCastSpell) { //to avoid crashes with spell items for units who cannot ordinarily cast spells
 	//Wyrmgus end
 		unit.AutoCastSpell = new char[SpellTypeTable.size()];
-		unit.SpellCoolDownTimers = new int[SpellTypeTable.size()];
+		//Wyrmgus start
+//		unit.SpellCoolDownTimers = new int[SpellTypeTable.size()];
+		unit.SpellCoolDownTimers = new unsigned long[SpellTypeTable.size()];
+		//Wyrmgus end
 		memset(unit.AutoCastSpell, 0, SpellTypeTable.size() * sizeof(char));
-		memset(unit.SpellCoolDownTimers, 0, SpellTypeTable.size() * sizeof(int));
+		//Wyrmgus start
+//		memset(unit.SpellCoolDownTimers, 0, SpellTypeTable.size() * sizeof(int));
+		memset(unit.SpellCoolDownTimers, 0, SpellTypeTable.size() * sizeof(unsigned long));
+		//Wyrmgus end
 	}
 
 	if (!unit.Constructed) {
@@ -64,6 +64,9 @@
 #include "action/action_use.h"
 
 #include "animation/animation_die.h"
+//Wyrmgus start
+#include "block_pool.h"
+//Wyrmgus end
 #include "commands.h"
 #include "depend.h"
 #include "interface.h"
@@ -88,6 +91,14 @@
 
 unsigned SyncHash; /// Hash calculated to find sync failures
 
+//Wyrmgus start
+#define ORDER_POOL_GRANULARITY 16	/// order block sizes are rounded up to a multiple of this
+#define ORDER_POOL_SLAB_SIZE 64		/// quantity of order blocks allocated at once for a pool
+
+/// orders are created and deleted all the time (i.e. the still orders given when other orders finish), so their memory is kept in a pool
+static CBlockPool<ORDER_POOL_GRANULARITY, ORDER_POOL_SLAB_SIZE> OrderPool;
+//Wyrmgus end
+
 
 /*----------------------------------------------------------------------------
 --  Functions
@@ -98,6 +109,37 @@ COrder::~COrder()
 	Goal.Reset();
 }
 
+//Wyrmgus start
+/**
+**  Allocate the memory for an order from the pool for its size
+**
+**  @param size  Size of the concrete order class.
+*/
+/* static */ void *COrder::operator new(size_t size)
+{
+	return OrderPool.Allocate(size);
+}
+
+/**
+**  Give the memory of an order back to the pool for its size
+**
+**  @param ptr   Memory of the order.
+**  @param size  Size of the concrete order class.
+*/
+/* static */ void COrder::operator delete(void *ptr, size_t size)
+{
+	OrderPool.Free(ptr, size);
+}
+
+/**
+**  Print the allocation statistics of the order pools
+*/
+void PrintOrderPoolStatistics()
+{
+	OrderPool.PrintStatistics("orders");
+}
+//Wyrmgus end
+
 void COrder::SetGoal(CUnit *const new_goal)
 {
 	Goal = new_goal;
@@ -343,6 +385,9 @@ static void HandleBuffsEachCycle(CUnit &unit)
 		unit.Threshold = 0;
 	}
 
+	//Wyrmgus start
+	// spell cooldowns are stored as the game cycle at which they are over, so they don't need to be counted down
+	/*
 	// decrease spell countdown timers
 	for (size_t i = 0; i < unit.Type->Spells.size(); ++i) {
 		int spell_id = unit.Type->Spells[i]->Slot;
@@ -350,6 +395,8 @@ static void HandleBuffsEachCycle(CUnit &unit)
 			--unit.SpellCoolDownTimers[spell_id];
 		}
 	}
+	*/
+	//Wyrmgus end
 
 	for (std::map<CUnitType *, int>::const_iterator iterator = unit.Type->Stats[unit.Player->Index].UnitStock.begin(); iterator != unit.Type->Stats[unit.Player->Index].UnitStock.end(); ++iterator) {
 		CUnitType *unit_type = iterator->first;
@@ -359,9 +406,14 @@ static void HandleBuffsEachCycle(CUnit &unit)
 			continue;
 		}
 		
-		if (unit.GetUnitStockReplenishmentTimer(unit_type) > 0) {
-			unit.ChangeUnitStockReplenishmentTimer(unit_type, -1);
-			if (unit.GetUnitStockReplenishmentTimer(unit_type) == 0 && unit.GetUnitStock(unit_type) < unit_stock) { //if timer reached 0, replenish 1 of the stock
+		//replenishment timers are stored as the game cycle at which they expire, so only fire them when they are due
+		std::map<CUnitType *, unsigned long>::iterator timer_iterator = unit.UnitStockReplenishmentTimers.find(unit_type);
+		if (timer_iterator != unit.UnitStockReplenishmentTimers.end()) {
+			if (timer_iterator->second > GameCycle) {
+				continue;
+			}
+			unit.UnitStockReplenishmentTimers.erase(timer_iterator);
+			if (unit.GetUnitStock(unit_type) < unit_stock) { //if timer reached 0, replenish 1 of the stock
 				unit.ChangeUnitStock(unit_type, 1);
 			}
 		}
@@ -378,6 +430,12 @@ static void HandleBuffsEachCycle(CUnit &unit)
 	//Wyrmgus end
 	//  decrease spells effects time.
 	for (unsigned int i = 0; i < sizeof(SpellEffects) / sizeof(int); ++i) {
+		//Wyrmgus start
+		//an effect which is already over and decaying would be left unchanged, so skip the modified variable lookup for it
+		if (unit.Variable[SpellEffects[i]].Value == 0 && unit.Variable[SpellEffects[i]].Increase == -1) {
+			continue;
+		}
+		//Wyrmgus end
 		unit.Variable[SpellEffects[i]].Increase = -1;
 		IncreaseVariable(unit, SpellEffects[i]);
 	}
@@ -566,9 +624,80 @@ static void HandleUnitAction(CUnit &unit)
 	unit.Orders[0]->Execute(unit);
 }
 
+//Wyrmgus start
+/**
+**  Get the still order of a unit which has nothing but a still order
+**
+**  Stand ground orders never finish, so units standing ground never sleep.
+**
+**  @return  the order, or NULL if the unit has any other order
+*/
+static COrder_Still *GetStillOrder(CUnit &unit)
+{
+	if (unit.Orders.size() != 1 || unit.CurrentAction() != UnitActionStill) {
+		return NULL;
+	}
+	
+	return static_cast<COrder_Still *>(unit.CurrentOrder());
+}
+
+/**
+**  Call the batched OnEachCycle or OnEachSecond callbacks, once per unit type with a table of the numbers of all of its units.
+**
+**  @param begin        Begin of the units to handle.
+**  @param end          End of the units to handle.
+**  @param each_second  Whether to call the OnEachSecond callbacks, instead of the OnEachCycle ones.
+*/
+template <typename UNITP_ITERATOR>
+static void RunBatchedUnitTypeCallbacks(UNITP_ITERATOR begin, UNITP_ITERATOR end, bool each_second)
+{
+	static std::vector<std::vector<int> > unit_numbers; //indexed by unit type slot, reused between calls
+	static std::vector<const CUnitType *> types; //unit types with units to pass, in the order in which they were found
+	
+	for (UNITP_ITERATOR it = begin; it != end; ++it) {
+		CUnit &unit = **it;
+
+		if (unit.Destroyed) {
+			continue;
+		}
+		
+		const CUnitType &type = *unit.Type;
+		if (each_second ? (!type.OnEachSecond || !type.BatchOnEachSecond) : (!type.OnEachCycle || !type.BatchOnEachCycle)) {
+			continue;
+		}
+		
+		if (unit.IsUnusable(false)) {
+			continue;
+		}
+		
+		if (type.Slot >= (int) unit_numbers.size()) {
+			unit_numbers.resize(type.Slot + 1);
+		}
+		
+		if (unit_numbers[type.Slot].empty()) {
+			types.push_back(&type);
+		}
+		unit_numbers[type.Slot].push_back(UnitNumber(unit));
+	}
+	
+	for (size_t i = 0; i < types.size(); ++i) {
+		LuaCallback *callback = each_second ? types[i]->OnEachSecond : types[i]->OnEachCycle;
+		callback->pushPreamble();
+		callback->pushIntegers(unit_numbers[types[i]->Slot]);
+		callback->run();
+		unit_numbers[types[i]->Slot].clear();
+	}
+	types.clear();
+}
+//Wyrmgus end
+
 template <typename UNITP_ITERATOR>
 static void UnitActionsEachSecond(UNITP_ITERATOR begin, UNITP_ITERATOR end)
 {
+	//Wyrmgus start
+	RunBatchedUnitTypeCallbacks(begin, end, true);
+	//Wyrmgus end
+	
 	for (UNITP_ITERATOR it = begin; it != end; ++it) {
 		CUnit &unit = **it;
 
@@ -577,7 +706,10 @@ static void UnitActionsEachSecond(UNITP_ITERATOR begin, UNITP_ITERATOR end)
 		}
 
 		// OnEachSecond callback
-		if (unit.Type->OnEachSecond  && unit.IsUnusable(false) == false) {
+		//Wyrmgus start
+//		if (unit.Type->OnEachSecond  && unit.IsUnusable(false) == false) {
+		if (unit.Type->OnEachSecond && !unit.Type->BatchOnEachSecond && unit.IsUnusable(false) == false) {
+		//Wyrmgus end
 			unit.Type->OnEachSecond->pushPreamble();
 			unit.Type->OnEachSecond->pushInteger(UnitNumber(unit));
 			unit.Type->OnEachSecond->run();
@@ -645,6 +777,10 @@ static void DumpUnitInfo(CUnit &unit)
 template <typename UNITP_ITERATOR>
 static void UnitActionsEachCycle(UNITP_ITERATOR begin, UNITP_ITERATOR end)
 {
+	//Wyrmgus start
+	RunBatchedUnitTypeCallbacks(begin, end, false);
+	//Wyrmgus end
+	
 	for (UNITP_ITERATOR it = begin; it != end; ++it) {
 		CUnit &unit = **it;
 
@@ -658,7 +794,10 @@ static void UnitActionsEachCycle(UNITP_ITERATOR begin, UNITP_ITERATOR end)
 		}
 
 		// OnEachCycle callback
-		if (unit.Type->OnEachCycle && unit.IsUnusable(false) == false) {
+		//Wyrmgus start
+//		if (unit.Type->OnEachCycle && unit.IsUnusable(false) == false) {
+		if (unit.Type->OnEachCycle && !unit.Type->BatchOnEachCycle && unit.IsUnusable(false) == false) {
+		//Wyrmgus end
 			unit.Type->OnEachCycle->pushPreamble();
 			unit.Type->OnEachCycle->pushInteger(UnitNumber(unit));
 			unit.Type->OnEachCycle->run();
@@ -671,11 +810,34 @@ static void UnitActionsEachCycle(UNITP_ITERATOR begin, UNITP_ITERATOR end)
 			continue;
 		}
 
+		//Wyrmgus start
+//		try {
+//			HandleUnitAction(unit);
+//		} catch (AnimationDie_Exception &) {
+//			AnimationDie_OnCatch(unit);
+//		}
+		COrder_Still *still_order = GetStillOrder(unit);
+		if (unit.SleepCycle && (still_order == NULL || !still_order->IsAsleep(unit))) {
+			unit.SleepCycle = 0;
+		}
+		
 		try {
-			HandleUnitAction(unit);
+			if (unit.SleepCycle) {
+				still_order->ExecuteAsleep(unit);
+			} else {
+				HandleUnitAction(unit);
+				
+				//put the unit to sleep if it has nothing to do, so that it doesn't look for something to do each cycle
+				still_order = GetStillOrder(unit);
+				if (!unit.Destroyed && still_order != NULL && still_order->CanSleep(unit)) {
+					unit.SleepCycle = GameCycle;
+				}
+			}
 		} catch (AnimationDie_Exception &) {
+			unit.SleepCycle = 0;
 			AnimationDie_OnCatch(unit);
 		}
+		//Wyrmgus end
 
 		if (EnableUnitDebug) {
 			DumpUnitInfo(unit);
@@ -722,7 +884,12 @@ void UnitActions()
 {
 	const bool isASecondCycle = !(GameCycle % CYCLES_PER_SECOND);
 	// Unit list may be modified during loop... so make a copy
-	std::vector<CUnit *> table(UnitManager.begin(), UnitManager.end());
+	//Wyrmgus start
+//	std::vector<CUnit *> table(UnitManager.begin(), UnitManager.end());
+	//reuse the copy's storage between cycles
+	static std::vector<CUnit *> table;
+	table.assign(UnitManager.begin(), UnitManager.end());
+	//Wyrmgus end
 
 	// Check for things that only happen every second
 	if (isASecondCycle) {
@@ -742,4 +909,19 @@ void UnitActions()
 	//Wyrmgus end
 }
 
+//Wyrmgus start
+/**
+**  Wake up all sleeping units, so that they look for something to do in their next action.
+**
+**  Called on changes which may give idle units something to do anywhere on
+**  the map, such as diplomacy changes.
+*/
+void WakeUpSleepingUnits()
+{
+	for (CUnitManager::Iterator it = UnitManager.begin(); it != UnitManager.end(); ++it) {
+		(*it)->SleepCycle = 0;
+	}
+}
+//Wyrmgus end
+
 //@}
@@ -1463,14 +1463,14 @@ void CommandSharedVision(int player, bool state, int opponent)
 				CMapField &mf = *Map.Field(i, z);
 				CMapFieldPlayerInfo &mfp = mf.playerInfo;
 
-				if (mfp.Visible[player] && !mfp.Visible[opponent] && !Players[player].Revealed) {
-					mfp.Visible[opponent] = 1;
+				if (mfp.GetVisible(player) && !mfp.GetVisible(opponent) && !Players[player].Revealed) {
+					mfp.SetVisible(opponent, 1);
 					if (opponent == ThisPlayer->Index) {
 						Map.MarkSeenTile(mf, z);
 					}
 				}
-				if (mfp.Visible[opponent] && !mfp.Visible[player] && !Players[opponent].Revealed) {
-					mfp.Visible[player] = 1;
+				if (mfp.GetVisible(opponent) && !mfp.GetVisible(player) && !Players[opponent].Revealed) {
+					mfp.SetVisible(player, 1);
 					if (player == ThisPlayer->Index) {
 						Map.MarkSeenTile(mf, z);
 					}
@@ -1479,6 +1479,10 @@ void CommandSharedVision(int player, bool state, int opponent)
 		}
 		//Wyrmgus end
 	}
+	
+	//Wyrmgus start
+	HierarchicalPathfinderExplorationChanged();
+	//Wyrmgus end
 
 	// Do a real hardcore seen recount. Now we remark EVERYTHING
 	for (CUnitManager::Iterator it = UnitManager.begin(); it != UnitManager.end(); ++it) {
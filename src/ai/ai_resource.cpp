@@ -2187,9 +2187,10 @@ static void AiCheckPathwayConstruction()
 						
 						CUnit *test_worker = MakeUnitAndPlace(unit.tilePos + Vec2i((unit.Type->TileWidth - 1) / 2, (unit.Type->TileHeight - 1) / 2), *test_worker_type, &Players[PlayerNumNeutral], unit.MapLayer);
 						char worker_path[64];
+						AStarContextLease astar_context;
 						
 						//make the first path
-						int worker_path_length = AStarFindPath(test_worker->tilePos, depot->tilePos, depot->Type->TileWidth, depot->Type->TileHeight, test_worker->Type->TileWidth, test_worker->Type->TileHeight, 0, 1, worker_path, 64, *test_worker, 0, unit.MapLayer, false);
+						int worker_path_length = AStarFindPath(*astar_context, test_worker->tilePos, depot->tilePos, depot->Type->TileWidth, depot->Type->TileHeight, test_worker->Type->TileWidth, test_worker->Type->TileHeight, 0, 1, worker_path, 64, *test_worker, 0, unit.MapLayer, false);
 						Vec2i worker_path_pos(test_worker->tilePos);
 						std::vector<Vec2i> first_path_tiles;
 						while (worker_path_length > 0 && worker_path_length <= 64) {
@@ -2212,7 +2213,7 @@ static void AiCheckPathwayConstruction()
 						}
 						
 						//make the second path
-						worker_path_length = AStarFindPath(test_worker->tilePos, depot->tilePos, depot->Type->TileWidth, depot->Type->TileHeight, test_worker->Type->TileWidth, test_worker->Type->TileHeight, 0, 1, worker_path, 64, *test_worker, 0, unit.MapLayer, false);
+						worker_path_length = AStarFindPath(*astar_context, test_worker->tilePos, depot->tilePos, depot->Type->TileWidth, depot->Type->TileHeight, test_worker->Type->TileWidth, test_worker->Type->TileHeight, 0, 1, worker_path, 64, *test_worker, 0, unit.MapLayer, false);
 						worker_path_pos = test_worker->tilePos;
 						while (worker_path_length > 0 && worker_path_length <= 64) {
 							Vec2i pos_change(0, 0);
@@ -2532,8 +2532,8 @@ void CEditor::Init()
 
 		//Wyrmgus start
 //		Map.Fields = new CMapField[Map.Info.MapWidth * Map.Info.MapHeight];
-		Map.Fields.clear();
-		Map.Fields.push_back(new CMapField[Map.Info.MapWidth * Map.Info.MapHeight]);
+		Map.ClearFieldLayers();
+		Map.AddFieldLayer(Map.Info.MapWidth, Map.Info.MapHeight);
 		Map.Info.MapWidths.clear();
 		Map.Info.MapWidths.push_back(Map.Info.MapWidth);
 		Map.Info.MapHeights.clear();
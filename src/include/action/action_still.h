@@ -50,7 +50,15 @@ public:
 	virtual void OnAnimationAttack(CUnit &unit);
 	virtual PixelPos Show(const CViewport &vp, const PixelPos &lastScreenPos) const;
 	virtual void UpdatePathFinderData(PathFinderInput &input) { UpdatePathFinderData_NotCalled(input); }
+	//Wyrmgus start
+	bool CanSleep(const CUnit &unit) const;
+	bool IsAsleep(const CUnit &unit) const;
+	void ExecuteAsleep(CUnit &unit);
+	//Wyrmgus end
 private:
+	//Wyrmgus start
+	int GetSleepWatchRange(const CUnit &unit) const;
+	//Wyrmgus end
 	bool AutoAttackStand(CUnit &unit);
 	bool AutoCastStand(CUnit &unit);
 private:
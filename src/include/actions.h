@@ -104,6 +104,11 @@ public:
 	}
 	virtual ~COrder();
 
+	//Wyrmgus start
+	static void *operator new(size_t size);
+	static void operator delete(void *ptr, size_t size);
+	//Wyrmgus end
+
 	virtual COrder *Clone() const = 0;
 	virtual void Execute(CUnit &unit) = 0;
 	virtual void Cancel(CUnit &unit) {}
@@ -239,6 +244,13 @@ extern void CclParseOrder(lua_State *l, CUnit &unit, COrderPtr *order);
 /// Handle the actions of all units each game cycle
 extern void UnitActions();
 
+//Wyrmgus start
+/// Print the allocation statistics of the order pools
+extern void PrintOrderPoolStatistics();
+/// Wake up all sleeping units
+extern void WakeUpSleepingUnits();
+//Wyrmgus end
+
 //@}
 
 #endif // !__ACTIONS_H__
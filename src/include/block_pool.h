@@ -0,0 +1,140 @@
+//       _________ __                 __
+//      /   _____//  |_____________ _/  |______     ____  __ __  ______
+//      \_____  \\   __\_  __ \__  \\   __\__  \   / ___\|  |  \/  ___/
+//      /        \|  |  |  | \// __ \|  |  / __ \_/ /_/  >  |  /\___ |
+//     /_______  /|__|  |__|  (____  /__| (____  /\___  /|____//____  >
+//             \/                  \/          \//_____/            \/
+//  ______________________                           ______________________
+//                        T H E   W A R   B E G I N S
+//         Stratagus - A free fantasy real time strategy game engine
+//
+/**@name block_pool.h - The memory block pool headerfile. */
+//
+//      This program is free software; you can redistribute it and/or modify
+//      it under the terms of the GNU General Public License as published by
+//      the Free Software Foundation; only version 2 of the License.
+//
+//      This program is distributed in the hope that it will be useful,
+//      but WITHOUT ANY WARRANTY; without even the implied warranty of
+//      MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//      GNU General Public License for more details.
+//
+//      You should have received a copy of the GNU General Public License
+//      along with this program; if not, write to the Free Software
+//      Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
+//      02111-1307, USA.
+//
+
+#ifndef __BLOCK_POOL_H__
+#define __BLOCK_POOL_H__
+
+//@{
+
+#include <algorithm>
+#include <vector>
+
+/*----------------------------------------------------------------------------
+--  Declarations
+----------------------------------------------------------------------------*/
+
+/**
+**  Free lists of memory blocks for objects of a class hierarchy, one for each block size
+**
+**  Blocks are carved out of slabs, and go back to the free list for their size when their object is deleted, so that
+**  objects which are created and deleted all the time don't go through the heap. The memory of the slabs is never given
+**  back. Used by the operator new and operator delete of the base class, which get the size of the concrete class.
+**
+**  GRANULARITY is the multiple to which the block sizes are rounded up, and SLAB_SIZE the quantity of blocks
+**  allocated at once for a block size.
+*/
+template <size_t GRANULARITY, size_t SLAB_SIZE>
+class CBlockPool
+{
+	/// Free list of the blocks of a given size
+	class CSizePool
+	{
+	public:
+		CSizePool() : Allocated(0), InUse(0), PeakInUse(0), Allocations(0)
+		{
+		}
+
+		std::vector<void *> FreeBlocks;	/// blocks available for new objects
+		unsigned int Allocated;			/// quantity of blocks carved out of slabs
+		unsigned int InUse;				/// quantity of blocks holding an object
+		unsigned int PeakInUse;			/// highest quantity of blocks holding an object at once
+		unsigned long Allocations;		/// quantity of objects allocated from the pool
+	};
+
+public:
+	/**
+	**  Allocate a block from the free list for its size
+	**
+	**  @param size  Size of the object's concrete class.
+	*/
+	void *Allocate(size_t size)
+	{
+		const size_t pool_index = (size + GRANULARITY - 1) / GRANULARITY;
+		if (pool_index >= this->Pools.size()) {
+			this->Pools.resize(pool_index + 1);
+		}
+		CSizePool &pool = this->Pools[pool_index];
+
+		if (pool.FreeBlocks.empty()) {
+			const size_t block_size = pool_index * GRANULARITY;
+			char *slab = static_cast<char *>(::operator new(block_size * SLAB_SIZE));
+			for (size_t i = SLAB_SIZE; i > 0; --i) {
+				pool.FreeBlocks.push_back(slab + (i - 1) * block_size);
+			}
+			pool.Allocated += SLAB_SIZE;
+		}
+
+		void *block = pool.FreeBlocks.back();
+		pool.FreeBlocks.pop_back();
+		++pool.InUse;
+		pool.PeakInUse = std::max(pool.PeakInUse, pool.InUse);
+		++pool.Allocations;
+		return block;
+	}
+
+	/**
+	**  Give a block back to the free list for its size
+	**
+	**  @param ptr   The block.
+	**  @param size  Size of the object's concrete class.
+	*/
+	void Free(void *ptr, size_t size)
+	{
+		if (ptr == NULL) {
+			return;
+		}
+
+		const size_t pool_index = (size + GRANULARITY - 1) / GRANULARITY;
+		Assert(pool_index < this->Pools.size());
+		CSizePool &pool = this->Pools[pool_index];
+		pool.FreeBlocks.push_back(ptr);
+		--pool.InUse;
+	}
+
+	/**
+	**  Print the allocation statistics of the free lists
+	**
+	**  @param name  Name of the objects, in plural.
+	*/
+	void PrintStatistics(const char *name) const
+	{
+		for (size_t i = 0; i < this->Pools.size(); ++i) {
+			const CSizePool &pool = this->Pools[i];
+			if (pool.Allocated == 0) {
+				continue;
+			}
+			fprintf(stdout, "Pool of %d byte blocks for %s: %u blocks allocated, %u in use (peak %u), %lu %s allocated.\n", (int) (i * GRANULARITY), name, pool.Allocated, pool.InUse, pool.PeakInUse, pool.Allocations, name);
+		}
+	}
+
+private:
+	std::vector<CSizePool> Pools;	/// free lists, indexed by block size divided by the granularity
+};
+
+//@}
+
+#endif // !__BLOCK_POOL_H__
@@ -144,6 +144,14 @@ extern bool CheckDependByIdent(const CUnit &unit, const std::string &target, boo
 extern bool CheckDependByType(const CPlayer &player, const CUnitType &type, bool ignore_units = false, bool is_predependency = false);
 extern bool CheckDependByType(const CUnit &unit, const CUnitType &type, bool ignore_units = false, bool is_predependency = false);
 //Wyrmgus end
+//Wyrmgus start
+/// Invalidate the cached dependency results of a player
+extern void InvalidatePlayerDependencies(const CPlayer &player);
+/// Invalidate the cached dependency results of all players
+extern void InvalidateDependencies();
+/// Notify the dependency cache that a player's count of units of a type changed
+extern void UnitTypeCountChanged(const CPlayer &player, const CUnitType &type, int old_count, int new_count);
+//Wyrmgus end
 //@}
 
 #endif // !__DEPEND_H__
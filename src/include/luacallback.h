@@ -50,6 +50,9 @@ public:
 private:
 	lua_State *luastate;
 	int luaref;
+	//Wyrmgus start
+	int tracebackref;	/// registry reference to the traceback handler, obtained on the first call
+	//Wyrmgus end
 	int arguments;
 	int rescount;
 	int base;
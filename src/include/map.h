@@ -125,6 +125,10 @@ class CRegion;
 #define MaxMapHeight 512  /// max map height supported
 //Wyrmgus end
 
+//Wyrmgus start
+#define UNIT_BUCKET_SIZE 8 /// width and height in tiles of each bucket of the unit bucket grid
+//Wyrmgus end
+
 //Wyrmgus start
 enum DegreeLevels {
 	ExtremelyHighDegreeLevel,
@@ -376,6 +380,9 @@ public:
 	void CleanFogOfWar();
 	
 	//Wyrmgus start
+	void AddFieldLayer(int width, int height);
+	void ClearFieldLayers();
+	size_t GetFieldMemoryUsage(int z) const;
 	void SetTileTerrain(const Vec2i &pos, CTerrainType *terrain, int z);
 	void RemoveTileOverlayTerrain(const Vec2i &pos, int z);
 	void SetOverlayTerrainDestroyed(const Vec2i &pos, bool destroyed, int z);
@@ -490,6 +497,20 @@ public:
 	/// Remove unit from cache
 	void Remove(CUnit &unit);
 
+	//Wyrmgus start
+	/// Get whether any unit entered or left the buckets overlapping an area since a given game cycle
+	bool HasUnitBucketChangedSince(const Vec2i &min_pos, const Vec2i &max_pos, int z, unsigned long cycle) const;
+	/// Mark the bucket of the unit bucket grid containing a tile as changed
+	void MarkUnitBucketChanged(const Vec2i &pos, int z);
+	/// Mark the buckets of the unit bucket grid which a unit overlaps as changed
+	void MarkUnitBucketsChanged(const CUnit &unit);
+	/// Get the bucket of the unit bucket grid containing a tile
+	CUnitCache &UnitBucket(const Vec2i &pos, int z)
+	{
+		return this->UnitBuckets[z][(pos.y / UNIT_BUCKET_SIZE) * ((this->Info.MapWidths[z] + UNIT_BUCKET_SIZE - 1) / UNIT_BUCKET_SIZE) + pos.x / UNIT_BUCKET_SIZE];
+	}
+	//Wyrmgus end
+
 	//Wyrmgus start
 //	void Clamp(Vec2i &pos) const;
 	void Clamp(Vec2i &pos, int z) const;
@@ -553,6 +574,9 @@ public:
 	std::vector<std::vector<CUnit *>> LayerConnectors;	/// connectors in a layer which lead to other layers
 	std::map<int, std::vector<std::tuple<Vec2i, Vec2i, CMapTemplate *>>> SubtemplateAreas;
 	std::vector<CUnit *> SettlementUnits;	/// the town hall / settlement site units
+	std::vector<std::vector<CUnitCache>> UnitBuckets;	/// the units in each bucket of the unit bucket grid, for each map layer
+	std::vector<std::vector<unsigned long>> UnitBucketCycles;	/// the game cycle at which a unit last entered or left each bucket of the unit bucket grid, for each map layer
+	std::vector<CMapFieldVisibilityPlane *> VisibilityPlanes;	/// the per-player visibility counters of the fields, for each map layer
 	//Wyrmgus end
 
 	CMapInfo Info;             /// descriptive information
@@ -650,6 +674,12 @@ extern void MapSight(const CPlayer &player, const Vec2i &pos, int w,
 //					 int h, int range, MapMarkerFunc *marker);
 					 int h, int range, MapMarkerFunc *marker, int z);
 					 //Wyrmgus end
+//Wyrmgus start
+/// Mark sight changes on the tiles of a sight area which are not within another one
+extern void MapSightDifference(const CPlayer &player, const Vec2i &pos, int w, int h, int range, const Vec2i &excluded_pos, int excluded_range, MapMarkerFunc *marker, int z);
+/// Notify the sight cache that whether a tile blocks sight may have changed
+extern void MapSightTileChanged(const Vec2i &pos, int z);
+//Wyrmgus end
 /// Update fog of war
 extern void UpdateFogOfWarChange();
 
@@ -763,12 +793,29 @@ extern void ChangeCurrentMapLayer(int z);
 extern void SetTimeOfDay(int time_of_day, int z = 0);
 //Wyrmgus end
 
+// in map_draw.cpp
+
+//Wyrmgus start
+/// Mark the cached terrain image of the chunk containing a tile as needing to be drawn again
+extern void MarkTerrainCacheDirty(const Vec2i &pos, int z);
+/// Free the cached terrain images
+extern void CleanTerrainCache();
+//Wyrmgus end
+
 // in unit.c
 
 /// Mark on vision table the Sight of the unit.
 void MapMarkUnitSight(CUnit &unit);
 /// Unmark on vision table the Sight of the unit.
 void MapUnmarkUnitSight(CUnit &unit);
+//Wyrmgus start
+/// Check whether the sight of the unit can be updated by only (un)marking the tiles which enter or leave it
+bool CanUpdateUnitSightDifference(const CUnit &unit);
+/// Mark on vision table the Sight of the unit which is not within its sight from another position or with another range.
+void MapMarkUnitSightDifference(CUnit &unit, int range, const Vec2i &excluded_pos, int excluded_range);
+/// Unmark on vision table the Sight of the unit which is not within its sight from another position or with another range.
+void MapUnmarkUnitSightDifference(CUnit &unit, int range, const Vec2i &excluded_pos, int excluded_range);
+//Wyrmgus end
 
 /*----------------------------------------------------------------------------
 --  Defines
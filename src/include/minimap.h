@@ -35,6 +35,7 @@
 #include "color.h"
 #include "vec2i.h"
 
+class CUnit;
 class CViewport;
 
 struct SDL_Surface;
@@ -70,6 +71,10 @@ public:
 	void UpdateXY(const Vec2i &pos, int z);
 	//Wyrmgus end
 	void UpdateSeenXY(const Vec2i &) {}
+	//Wyrmgus start
+	void UpdateFogXY(const Vec2i &pos, int z);
+	void UpdateUnitDot(const CUnit &unit);
+	//Wyrmgus end
 	void Update();
 	void Create();
 #if defined(USE_OPENGL) || defined(USE_GLES)
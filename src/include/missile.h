@@ -426,6 +426,11 @@ protected:
 public:
 	virtual ~Missile();
 
+	//Wyrmgus start
+	static void *operator new(size_t size);
+	static void operator delete(void *ptr, size_t size);
+	//Wyrmgus end
+
 	//Wyrmgus start
 //	static Missile *Init(const MissileType &mtype, const PixelPos &startPos, const PixelPos &destPos);
 	static Missile *Init(const MissileType &mtype, const PixelPos &startPos, const PixelPos &destPos, int z);
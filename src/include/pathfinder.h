@@ -48,6 +48,10 @@
 class CUnit;
 class CFile;
 struct lua_State;
+//Wyrmgus start
+class AStarContext;
+class CPlayer;
+//Wyrmgus end
 
 /**
 **  Result codes of the pathfinder.
@@ -124,11 +128,36 @@ public:
 	char Path[MAX_PATH_LENGTH]; /// directions of stored path
 };
 
+//Wyrmgus start
+/**
+**  State of the asynchronous path request of a unit.
+*/
+enum PathRequestStates {
+	PathRequestNone,      /// no request made
+	PathRequestPending,   /// request made, the path will be available by the next game cycle (requests are never pending between game cycles)
+	PathRequestCompleted  /// the path has been stored in the output
+};
+//Wyrmgus end
+
 class PathFinderData
 {
 public:
+	//Wyrmgus start
+	PathFinderData() : RequestState(PathRequestNone), RequestIndex(-1), RequestResult(PF_WAIT), RequestRetries(0), RequestAfterBlocked(false) {}
+
+	void SaveRequest(CFile &file) const;
+	void LoadRequest(lua_State *l);
+	//Wyrmgus end
+
 	PathFinderInput input;
 	PathFinderOutput output;
+	//Wyrmgus start
+	int RequestState;         /// state of the asynchronous path request
+	int RequestIndex;         /// index of the pending path request in the request queue
+	int RequestResult;        /// result of the completed path request
+	int RequestRetries;       /// how many solved requests in a row were discarded because the goal changed
+	bool RequestAfterBlocked; /// whether the request was made because the path was blocked
+	//Wyrmgus end
 };
 
 
@@ -233,6 +262,10 @@ extern void FreePathfinder();
 
 /// Returns the next element of the path
 extern int NextPathElement(CUnit &unit, short int *xdp, short int *ydp);
+//Wyrmgus start
+/// Solve the path requests made during the game cycle, and store their paths in the units
+extern void CompletePathRequests();
+//Wyrmgus end
 /// Return distance to unit.
 //Wyrmgus start
 //extern int UnitReachable(const CUnit &unit, const CUnit &dst, int range);
@@ -259,8 +292,38 @@ extern void SetAStarUnknownTerrainCost(int cost);
 extern int GetAStarUnknownTerrainCost();
 
 //Wyrmgus start
+/// Start or stop recording the path queries, for benchmarking
+extern void SetAStarRecordQueries(bool record);
+/// Replay the recorded path queries and print their timings
+extern void AStarReplayQueries(int repeat);
+//Wyrmgus end
+
+//Wyrmgus start
+/// Get an a* search context from the pool
+extern AStarContext *AcquireAStarContext();
+/// Give an a* search context back to the pool
+extern void ReleaseAStarContext(AStarContext *context);
+
+/**
+**  Holds an a* search context from the pool for as long as it is in scope.
+*/
+class AStarContextLease
+{
+public:
+	AStarContextLease() : context(AcquireAStarContext()) {}
+	~AStarContextLease() { ReleaseAStarContext(context); }
+
+	AStarContext &operator*() const { return *context; }
+
+private:
+	AStarContextLease(const AStarContextLease &);
+	AStarContextLease &operator=(const AStarContextLease &);
+
+	AStarContext *context;
+};
+
 /// Find and a* path for a unit
-extern int AStarFindPath(const Vec2i &startPos, const Vec2i &goalPos, int gw, int gh,
+extern int AStarFindPath(AStarContext &context, const Vec2i &startPos, const Vec2i &goalPos, int gw, int gh,
 						 int tilesizex, int tilesizey, int minrange,
 						 //Wyrmgus start
 //						 int maxrange, char *path, int pathlen, const CUnit &unit);
@@ -268,6 +331,28 @@ extern int AStarFindPath(const Vec2i &startPos, const Vec2i &goalPos, int gw, in
 						 //Wyrmgus end
 //Wyrmgus end
 
+//Wyrmgus start
+//
+// in hpa.cpp
+//
+
+/// Most nodes the a* may expand when pathing to a waypoint of a hierarchical route, about the area within 32 tiles of the unit
+#define PF_WAYPOINT_MAX_EXPANDED_NODES 4096
+
+extern void InitHierarchicalPathfinder();
+extern void FreeHierarchicalPathfinder();
+/// Mark the hierarchical pathfinding graphs of a tile as needing repair
+extern void HierarchicalPathfinderTileChanged(const Vec2i &pos, int z);
+/// Mark the hierarchical pathfinding graphs of a player's team as needing repair, as a tile was explored
+extern void HierarchicalPathfinderTileExplored(const CPlayer &player, const Vec2i &pos, int z);
+/// Drop the hierarchical pathfinding graphs built from explored terrain
+extern void HierarchicalPathfinderExplorationChanged();
+/// Get the next waypoint of a long route for a unit
+extern bool HierarchicalPathfinderGetWaypoint(const CUnit &unit, const Vec2i &goalPos, int range, int z, Vec2i &waypoint);
+/// Check whether a goal may be reachable for a unit, using the connected regions of the map layer
+extern bool HierarchicalPathfinderMayReach(const CUnit &unit, const Vec2i &goalPos, int w, int h, int range, int z);
+//Wyrmgus end
+
 extern void PathfinderCclRegister();
 
 //@}
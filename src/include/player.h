@@ -165,11 +165,11 @@ public:
 	int SpeedUpgrade;                /// speed factor for upgrading
 	int SpeedResearch;               /// speed factor for researching
 
-	std::map<const CUnitType *, int> UnitTypesCount;  						/// total units of unit-type
-	std::map<const CUnitType *, int> UnitTypesUnderConstructionCount;  		/// total under construction units of unit-type
-	std::map<const CUnitType *, int> UnitTypesAiActiveCount;  				/// total units of unit-type that have their AI set to active
-	std::map<const CUnitType *, std::vector<CUnit *>> UnitsByType;			/// units owned by this player for each type
-	std::map<const CUnitType *, std::vector<CUnit *>> AiActiveUnitsByType;	/// AI active units owned by this player for each type
+	std::vector<int> UnitTypesCount;  						/// total units of unit-type, indexed by unit type slot
+	std::vector<int> UnitTypesUnderConstructionCount;  		/// total under construction units of unit-type, indexed by unit type slot
+	std::vector<int> UnitTypesAiActiveCount;  				/// total units of unit-type that have their AI set to active, indexed by unit type slot
+	std::vector<std::vector<CUnit *>> UnitsByType;			/// units owned by this player for each type, indexed by unit type slot
+	std::vector<std::vector<CUnit *>> AiActiveUnitsByType;	/// AI active units owned by this player for each type, indexed by unit type slot
 	std::vector<CUnit *> Heroes;											/// hero units owned by this player
 	std::vector<CDeity *> Deities;											/// deities chosen by this player
 	std::vector<CQuest *> AvailableQuests;									/// quests available to this player
@@ -1084,6 +1084,15 @@ extern void GraphicPlayerPixels(int player, const CGraphic &sprite);
 /// Output debug information for players
 extern void DebugPlayers();
 
+//Wyrmgus start
+/// Recalculate the vision masks, after the shared vision or revealed state of a player has changed
+extern void PlayerVisionChanged();
+/// Get the players with which the player mutually shares vision, as a bit field
+extern unsigned int GetMutualSharedVisionMask(const CPlayer &player);
+/// Get the players which have been revealed, as a bit field
+extern unsigned int GetRevealedPlayersMask();
+//Wyrmgus end
+
 void FreePlayerColors();
 
 /// register ccl features
@@ -240,6 +240,11 @@ struct UnitDesc;
 */
 struct StringDesc;
 
+//Wyrmgus start
+class CNumberProgram;
+class CStringProgram;
+//Wyrmgus end
+
 /// for Bin operand  a ?? b
 struct BinOp {
 	NumberDesc *Left;           /// Left operand.
@@ -250,6 +255,13 @@ struct BinOp {
 **  Number description.
 */
 struct NumberDesc {
+	//Wyrmgus start
+	NumberDesc() : Program(NULL)
+	{
+	}
+	
+	mutable CNumberProgram *Program;	/// compiled form of the description, created when it is first evaluated
+	//Wyrmgus end
 	ENumber e;       /// which number.
 	union {
 		unsigned int Index; /// index of the lua function.
@@ -309,6 +321,13 @@ struct UnitDesc {
 **  String description.
 */
 struct StringDesc {
+	//Wyrmgus start
+	StringDesc() : Program(NULL)
+	{
+	}
+	
+	mutable CStringProgram *Program;	/// compiled form of the description, created when it is first evaluated
+	//Wyrmgus end
 	EString e;       /// which number.
 	union {
 		unsigned int Index; /// index of the lua function.
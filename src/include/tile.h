@@ -156,19 +156,105 @@ struct lua_State;
 --  Map - field
 ----------------------------------------------------------------------------*/
 
+//Wyrmgus start
+/**
+**  The per-player visibility counters of the fields of a map layer.
+**
+**  Each counter is kept in a contiguous plane per player, indexed by the
+**  tile index within the map layer, instead of inline in every CMapField.
+**  A player's plane is only allocated when a non-zero value is first
+**  written to it, so that unused player slots and rarely used counters
+**  (radar, cloak and ethereal detection) take up no memory.
+**
+**  Which players have explored and which currently see each field is
+**  additionally kept as a bit field per field, so that whether a field
+**  is explored or visible for a team can be checked with a single mask.
+*/
+class CMapFieldVisibilityPlane
+{
+public:
+	explicit CMapFieldVisibilityPlane(unsigned int size) : Size(size), ExploredMask(size, 0), VisibleMask(size, 0)
+	{
+	}
+
+	template <typename T>
+	T GetValue(const std::vector<T> &plane, unsigned int index) const
+	{
+		return plane.empty() ? 0 : plane[index];
+	}
+
+	template <typename T>
+	void SetValue(std::vector<T> &plane, unsigned int index, T value)
+	{
+		if (plane.empty()) {
+			if (value == 0) {
+				return;
+			}
+			plane.resize(Size, 0);
+		}
+		plane[index] = value;
+	}
+
+	void SetVisible(int player, unsigned int index, unsigned short value)
+	{
+		SetValue(Visible[player], index, value);
+		if (value != 0) {
+			ExploredMask[index] |= (1 << player);
+		} else {
+			ExploredMask[index] &= ~(1 << player);
+		}
+		if (value >= 2) {
+			VisibleMask[index] |= (1 << player);
+		} else {
+			VisibleMask[index] &= ~(1 << player);
+		}
+	}
+
+	/**
+	**  Get the sight counters of a player starting at a field, allocating
+	**  them if necessary, so that a span of them can be updated directly.
+	**  Only counters which stay at or above 2 may be changed through it,
+	**  so that the explored and visible bit fields remain valid.
+	*/
+	unsigned short *GetVisibleSpan(int player, unsigned int index)
+	{
+		if (Visible[player].empty()) {
+			Visible[player].resize(Size, 0);
+		}
+		return &Visible[player][index];
+	}
+
+	size_t GetMemoryUsage() const;
+
+public:
+	unsigned int Size;									/// number of fields in the map layer
+	std::vector<unsigned short> Visible[PlayerMax];		/// Seen counter 0 unexplored
+	std::vector<unsigned char> VisCloak[PlayerMax];		/// Visiblity for cloaking.
+	std::vector<unsigned char> VisEthereal[PlayerMax];	/// Visiblity for ethereal.
+	std::vector<unsigned char> Radar[PlayerMax];		/// Visiblity for radar.
+	std::vector<unsigned char> RadarJammer[PlayerMax];	/// Jamming capabilities.
+	std::vector<unsigned int> ExploredMask;				/// players for which each field is explored, as a bit field
+	std::vector<unsigned int> VisibleMask;				/// players for which each field is visible, as a bit field
+};
+//Wyrmgus end
+
 class CMapFieldPlayerInfo
 {
 public:
 	//Wyrmgus start
 //	CMapFieldPlayerInfo() : SeenTile(0)
-	CMapFieldPlayerInfo() : SeenTerrain(NULL), SeenOverlayTerrain(NULL), SeenSolidTile(0), SeenOverlaySolidTile(0)
+	CMapFieldPlayerInfo() : SeenTerrain(NULL), SeenOverlayTerrain(NULL), SeenSolidTile(0), SeenOverlaySolidTile(0), VisibilityPlane(NULL), PlaneIndex(0)
 	//Wyrmgus end
 	{
+		//Wyrmgus start
+		/*
 		memset(Visible, 0, sizeof(Visible));
 		memset(VisCloak, 0, sizeof(VisCloak));
 		memset(VisEthereal, 0, sizeof(VisEthereal));
 		memset(Radar, 0, sizeof(Radar));
 		memset(RadarJammer, 0, sizeof(RadarJammer));
+		*/
+		//Wyrmgus end
 	}
 
 	/// Check if a field for the user is explored.
@@ -190,6 +276,20 @@ public:
 	*/
 	unsigned char TeamVisibilityState(const CPlayer &player) const;
 
+	//Wyrmgus start
+	unsigned short GetVisible(int player) const { return VisibilityPlane->GetValue(VisibilityPlane->Visible[player], PlaneIndex); }
+	unsigned char GetVisCloak(int player) const { return VisibilityPlane->GetValue(VisibilityPlane->VisCloak[player], PlaneIndex); }
+	unsigned char GetVisEthereal(int player) const { return VisibilityPlane->GetValue(VisibilityPlane->VisEthereal[player], PlaneIndex); }
+	unsigned char GetRadar(int player) const { return VisibilityPlane->GetValue(VisibilityPlane->Radar[player], PlaneIndex); }
+	unsigned char GetRadarJammer(int player) const { return VisibilityPlane->GetValue(VisibilityPlane->RadarJammer[player], PlaneIndex); }
+	unsigned int GetExploredMask() const { return VisibilityPlane->ExploredMask[PlaneIndex]; }
+	void SetVisible(int player, unsigned short value) { VisibilityPlane->SetVisible(player, PlaneIndex, value); }
+	void SetVisCloak(int player, unsigned char value) { VisibilityPlane->SetValue(VisibilityPlane->VisCloak[player], PlaneIndex, value); }
+	void SetVisEthereal(int player, unsigned char value) { VisibilityPlane->SetValue(VisibilityPlane->VisEthereal[player], PlaneIndex, value); }
+	void SetRadar(int player, unsigned char value) { VisibilityPlane->SetValue(VisibilityPlane->Radar[player], PlaneIndex, value); }
+	void SetRadarJammer(int player, unsigned char value) { VisibilityPlane->SetValue(VisibilityPlane->RadarJammer[player], PlaneIndex, value); }
+	//Wyrmgus end
+
 public:
 	//Wyrmgus start
 //	unsigned short SeenTile;              /// last seen tile (FOW)
@@ -200,11 +300,17 @@ public:
 	std::vector<std::pair<CTerrainType *, short>> SeenTransitionTiles;			/// Transition tiles; the pair contains the terrain type and the tile index
 	std::vector<std::pair<CTerrainType *, short>> SeenOverlayTransitionTiles;		/// Overlay transition tiles; the pair contains the terrain type and the tile index
 	//Wyrmgus end
+	//Wyrmgus start
+	/*
 	unsigned short Visible[PlayerMax];    /// Seen counter 0 unexplored
 	unsigned char VisCloak[PlayerMax];    /// Visiblity for cloaking.
 	unsigned char VisEthereal[PlayerMax];    /// Visiblity for ethereal.
 	unsigned char Radar[PlayerMax];       /// Visiblity for radar.
 	unsigned char RadarJammer[PlayerMax]; /// Jamming capabilities.
+	*/
+	CMapFieldVisibilityPlane *VisibilityPlane;	/// the visibility plane of the field's map layer
+	unsigned int PlaneIndex;					/// the index of the field in its visibility plane
+	//Wyrmgus end
 };
 
 /// Describes a field of the map
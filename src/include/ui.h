@@ -646,6 +646,11 @@ extern void UpdateLoadingBar();
 extern void IncItemsLoaded();
 extern void ResetItemsToLoad();
 
+//Wyrmgus start
+/// Draw frames with the selected viewport at the given positions and print how long each stage of drawing took
+extern void BenchmarkRendering(int frames, const std::vector<Vec2i> &positions);
+//Wyrmgus end
+
 //@}
 
 #endif // !__UI_H__
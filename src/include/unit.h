@@ -139,7 +139,7 @@ class CUnit
 public:
 	//Wyrmgus start
 //	CUnit() : tilePos(-1, -1), pathFinderData(NULL), SavedOrder(NULL), NewOrder(NULL), CriticalOrder(NULL) { Init(); }
-	CUnit() : tilePos(-1, -1), RallyPointPos(-1, -1), MapLayer(0), RallyPointMapLayer(0), pathFinderData(NULL), SavedOrder(NULL), NewOrder(NULL), CriticalOrder(NULL) { Init(); }
+	CUnit() : tilePos(-1, -1), MapLayer(0), CriticalOrder(NULL), RallyPointPos(-1, -1), RallyPointMapLayer(0), pathFinderData(NULL), SavedOrder(NULL), NewOrder(NULL) { Init(); }
 	//Wyrmgus end
 
 	void Init();
@@ -417,6 +417,8 @@ public:
 	int GetUnitStockReplenishmentTimer(CUnitType *unit_type) const;
 	void SetUnitStockReplenishmentTimer(CUnitType *unit_type, int quantity);
 	void ChangeUnitStockReplenishmentTimer(CUnitType *unit_type, int quantity);
+	int GetSpellCoolDownTimer(int spell_slot) const;
+	void SetSpellCoolDownTimer(int spell_slot, int cool_down);
 	int GetResourceStep(const int resource) const;
 	int GetTotalInsideCount(const CPlayer *player = NULL, const bool ignore_items = true, const bool ignore_saved_cargo = false, const CUnitType *type = NULL) const;
 	bool CanAttack(bool count_inside = true) const;
@@ -474,6 +476,55 @@ public:
 	CUnitManagerData UnitManagerData;
 	size_t PlayerSlot;  /// index in Player->Units
 
+	//Wyrmgus start
+	//the fields used by the per-cycle passes over the units are kept together, so that these passes touch few cache lines of each unit
+	Vec2i tilePos; /// Map position X
+	int MapLayer;			/// in which map layer the unit is
+	unsigned int Offset;/// Map position as flat index offset (x + y * w)
+
+	const CUnitType  *Type;        /// Pointer to unit-type (peon,...)
+	CPlayer    *Player;            /// Owner of this unit
+	const CUnitStats *Stats;       /// Current unit stats
+
+	CVariable *Variable; /// array of User Defined variables.
+
+	std::vector<COrder *> Orders; /// orders to process
+	COrder *CriticalOrder;      /// order to do as possible in breakable animation.
+
+	struct _unit_anim_ {
+		const CAnimation *Anim;      /// Anim
+		const CAnimation *CurrAnim;  /// CurrAnim
+		int Wait;                    /// Wait
+		int Unbreakable;             /// Unbreakable
+	} Anim, WaitBackup;
+
+	unsigned long TTL;  /// time to live
+	unsigned long Attacked;      /// gamecycle unit was last attacked
+	unsigned long SleepCycle;    /// gamecycle the idle unit fell asleep, 0 if it is awake
+	unsigned int Wait;          /// action counter
+	int Threshold;              /// The counter while ai unit couldn't change target.
+
+	unsigned Blink : 3;          /// Let selection rectangle blink
+	unsigned Moving : 1;         /// The unit is moving
+	unsigned ReCast : 1;         /// Recast again next cycle
+	unsigned AutoRepair : 1;     /// True if unit tries to repair on still action.
+
+	unsigned Burning : 1;        /// unit is burning
+	unsigned Destroyed : 1;      /// unit is destroyed pending reference
+	unsigned Removed : 1;        /// unit is removed (not on map)
+	unsigned Selected : 1;       /// unit is selected
+
+	unsigned Constructed : 1;    /// Unit is in construction
+	unsigned Active : 1;         /// Unit is active for AI
+	unsigned Boarded : 1;        /// Unit is on board a transporter.
+	unsigned CacheLock : 1;      /// Unit is on lock by unitcache operations.
+
+	unsigned Summoned : 1;       /// Unit is summoned using spells.
+	unsigned Waiting : 1;        /// Unit is waiting and playing its still animation
+	unsigned MineLow : 1;        /// This mine got a notification about its resources being low
+	unsigned int SelectGeneration; /// generation of the last unit selection which gathered this unit, to avoid gathering it twice
+	//Wyrmgus end
+
 	int    InsideCount;   /// Number of units inside.
 	int    BoardCount;    /// Number of units transported inside.
 	CUnit *UnitInside;    /// Pointer to one of the units inside.
@@ -493,18 +544,11 @@ public:
 	std::vector<CUnit *> SoldUnits;						/// units available for sale at this unit
 	//Wyrmgus end
 	
-	Vec2i tilePos; /// Map position X
 	//Wyrmgus start
 	Vec2i RallyPointPos;	/// used for storing the rally point position (where units trained by this unit will be sent to)
-	int MapLayer;			/// in which map layer the unit is
 	int RallyPointMapLayer;	/// in which map layer the unit's rally point is
 	//Wyrmgus end
 
-	unsigned int Offset;/// Map position as flat index offset (x + y * w)
-
-	const CUnitType  *Type;        /// Pointer to unit-type (peon,...)
-	CPlayer    *Player;            /// Owner of this unit
-	const CUnitStats *Stats;       /// Current unit stats
 	int         CurrentSightRange; /// Unit's Current Sight Range
 
 	// Pathfinding stuff:
@@ -544,28 +588,9 @@ public:
 	unsigned char CurrentResource;
 	int ResourcesHeld;      /// Resources Held by a unit
 	std::map<CUnitType *, int> UnitStock; 						/// How many of each unit type this unit has stocked
-	std::map<CUnitType *, int> UnitStockReplenishmentTimers; 	/// Replenishment timer for each unit type stock
+	std::map<CUnitType *, unsigned long> UnitStockReplenishmentTimers; 	/// Game cycle at which each unit type stock is replenished
 
 	unsigned char DamagedType;   /// Index of damage type of unit which damaged this unit
-	unsigned long Attacked;      /// gamecycle unit was last attacked
-	unsigned Blink : 3;          /// Let selection rectangle blink
-	unsigned Moving : 1;         /// The unit is moving
-	unsigned ReCast : 1;         /// Recast again next cycle
-	unsigned AutoRepair : 1;     /// True if unit tries to repair on still action.
-
-	unsigned Burning : 1;        /// unit is burning
-	unsigned Destroyed : 1;      /// unit is destroyed pending reference
-	unsigned Removed : 1;        /// unit is removed (not on map)
-	unsigned Selected : 1;       /// unit is selected
-
-	unsigned Constructed : 1;    /// Unit is in construction
-	unsigned Active : 1;         /// Unit is active for AI
-	unsigned Boarded : 1;        /// Unit is on board a transporter.
-	unsigned CacheLock : 1;      /// Unit is on lock by unitcache operations.
-
-	unsigned Summoned : 1;       /// Unit is summoned using spells.
-	unsigned Waiting : 1;        /// Unit is waiting and playing its still animation
-	unsigned MineLow : 1;        /// This mine got a notification about its resources being low
 	
 	unsigned TeamSelected;  /// unit is selected by a team member.
 	CPlayer *RescuedFrom;        /// The original owner of a rescued unit.
@@ -586,33 +611,19 @@ unsigned    Destroyed : PlayerMax;  /// Unit seen destroyed or not
 unsigned    ByPlayer : PlayerMax;   /// Track unit seen by player
 	} Seen;
 
-	CVariable *Variable; /// array of User Defined variables.
-
-	unsigned long TTL;  /// time to live
-
 	unsigned int GroupId;       /// unit belongs to this group id
 	unsigned int LastGroup;     /// unit belongs to this last group
-
-	unsigned int Wait;          /// action counter
-	int Threshold;              /// The counter while ai unit couldn't change target.
 	
 	unsigned char StepCount;	/// How many steps the unit has taken without stopping (maximum 10)
 
-	struct _unit_anim_ {
-		const CAnimation *Anim;      /// Anim
-		const CAnimation *CurrAnim;  /// CurrAnim
-		int Wait;                    /// Wait
-		int Unbreakable;             /// Unbreakable
-	} Anim, WaitBackup;
-
-
-	std::vector<COrder *> Orders; /// orders to process
 	COrder *SavedOrder;         /// order to continue after current
 	COrder *NewOrder;           /// order for new trained units
-	COrder *CriticalOrder;      /// order to do as possible in breakable animation.
 
 	char *AutoCastSpell;        /// spells to auto cast
-	int *SpellCoolDownTimers;   /// how much time unit need to wait before spell will be ready
+	//Wyrmgus start
+//	int *SpellCoolDownTimers;   /// how much time unit need to wait before spell will be ready
+	unsigned long *SpellCoolDownTimers;   /// game cycle at which each spell will be ready again
+	//Wyrmgus end
 
 	CUnit *Goal; /// Generic/Teleporter goal pointer
 };
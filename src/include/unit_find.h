@@ -281,6 +281,11 @@ private:
 	//Wyrmgus end
 };
 
+//Wyrmgus start
+/// Generation of the last unit selection, see CUnit::SelectGeneration
+extern unsigned int UnitSelectGeneration;
+//Wyrmgus end
+
 //Wyrmgus start
 //void Select(const Vec2i &ltPos, const Vec2i &rbPos, std::vector<CUnit *> &units);
 //void SelectFixed(const Vec2i &ltPos, const Vec2i &rbPos, std::vector<CUnit *> &units);
@@ -313,39 +318,98 @@ void SelectFixed(const Vec2i &ltPos, const Vec2i &rbPos, std::vector<CUnit *> &u
 		middle_y = (rbPos.y + ltPos.y) / 2;
 		radius = ((middle_x - ltPos.x) + (middle_y - ltPos.y)) / 2;
 	}
-	//Wyrmgus end
-
-	for (Vec2i posIt = ltPos; posIt.y != rbPos.y + 1; ++posIt.y) {
-		for (posIt.x = ltPos.x; posIt.x != rbPos.x + 1; ++posIt.x) {
-			//Wyrmgus start
-			if (circle) {
-				double rel_x = posIt.x - middle_x;
-				double rel_y = posIt.y - middle_y;
-				double my = radius * radius - rel_x * rel_x;
-				if ((rel_y * rel_y) > my) {
-					continue;
+	
+	// the units are first gathered without calling the predicate, so that selections made by it can't disturb the marks of this one
+	const unsigned int generation = ++UnitSelectGeneration;
+	std::vector<CUnit *> candidates;
+	
+	// for large areas, go through the units in the overlapping buckets of the unit bucket grid instead of through the cache of every tile
+	if ((rbPos.x - ltPos.x + 1) * (rbPos.y - ltPos.y + 1) > UNIT_BUCKET_SIZE * UNIT_BUCKET_SIZE && z < (int) Map.UnitBuckets.size() && !Map.UnitBuckets[z].empty()) {
+		// the units are sorted by the first of their tiles in the area, and then by their place in that tile's cache, to get the same order as from the tile caches
+		std::vector<std::pair<std::pair<int, int>, CUnit *>> sorted_candidates;
+		
+		for (int bucket_y = ltPos.y / UNIT_BUCKET_SIZE; bucket_y <= rbPos.y / UNIT_BUCKET_SIZE; ++bucket_y) {
+			for (int bucket_x = ltPos.x / UNIT_BUCKET_SIZE; bucket_x <= rbPos.x / UNIT_BUCKET_SIZE; ++bucket_x) {
+				const CUnitCache &bucket = Map.UnitBucket(Vec2i(bucket_x * UNIT_BUCKET_SIZE, bucket_y * UNIT_BUCKET_SIZE), z);
+
+				for (size_t i = 0; i != bucket.size(); ++i) {
+					CUnit &unit = *bucket[i];
+
+					if (unit.SelectGeneration == generation) {
+						continue;
+					}
+
+					// find the first of the unit's tiles in the area
+					const Vec2i unit_min_pos(std::max<int>(unit.tilePos.x, ltPos.x), std::max<int>(unit.tilePos.y, ltPos.y));
+					const Vec2i unit_max_pos(std::min<int>(unit.tilePos.x + unit.Type->TileWidth - 1, rbPos.x), std::min<int>(unit.tilePos.y + unit.Type->TileHeight - 1, rbPos.y));
+					bool in_area = false;
+					Vec2i posIt;
+					for (posIt.y = unit_min_pos.y; posIt.y <= unit_max_pos.y; ++posIt.y) {
+						for (posIt.x = unit_min_pos.x; posIt.x <= unit_max_pos.x; ++posIt.x) {
+							if (circle) {
+								double rel_x = posIt.x - middle_x;
+								double rel_y = posIt.y - middle_y;
+								double my = radius * radius - rel_x * rel_x;
+								if ((rel_y * rel_y) > my) {
+									continue;
+								}
+							}
+							in_area = true;
+							break;
+						}
+						if (in_area) {
+							break;
+						}
+					}
+					if (!in_area) {
+						continue;
+					}
+
+					unit.SelectGeneration = generation;
+					const CUnitCache &cache = Map.Field(posIt, z)->UnitCache;
+					const int cache_index = std::find(cache.begin(), cache.end(), &unit) - cache.begin();
+					sorted_candidates.push_back(std::pair<std::pair<int, int>, CUnit *>(std::pair<int, int>(Map.getIndex(posIt, z), cache_index), &unit));
 				}
 			}
-			//Wyrmgus end
-			//Wyrmgus start
-//			const CMapField &mf = *Map.Field(posIt);
-			const CMapField &mf = *Map.Field(posIt, z);
-			//Wyrmgus end
-			const CUnitCache &cache = mf.UnitCache;
+		}
+		
+		std::sort(sorted_candidates.begin(), sorted_candidates.end());
+		candidates.reserve(sorted_candidates.size());
+		for (size_t i = 0; i != sorted_candidates.size(); ++i) {
+			candidates.push_back(sorted_candidates[i].second);
+		}
+	} else {
+		for (Vec2i posIt = ltPos; posIt.y != rbPos.y + 1; ++posIt.y) {
+			for (posIt.x = ltPos.x; posIt.x != rbPos.x + 1; ++posIt.x) {
+				if (circle) {
+					double rel_x = posIt.x - middle_x;
+					double rel_y = posIt.y - middle_y;
+					double my = radius * radius - rel_x * rel_x;
+					if ((rel_y * rel_y) > my) {
+						continue;
+					}
+				}
+				const CUnitCache &cache = Map.Field(posIt, z)->UnitCache;
 
-			for (size_t i = 0; i != cache.size(); ++i) {
-				CUnit &unit = *cache[i];
+				for (size_t i = 0; i != cache.size(); ++i) {
+					CUnit &unit = *cache[i];
 
-				if (unit.CacheLock == 0 && pred(&unit)) {
-					unit.CacheLock = 1;
-					units.push_back(&unit);
+					if (unit.SelectGeneration == generation) {
+						continue;
+					}
+					unit.SelectGeneration = generation;
+					candidates.push_back(&unit);
 				}
 			}
 		}
 	}
-	for (size_t i = 0; i != units.size(); ++i) {
-		units[i]->CacheLock = 0;
+	
+	for (size_t i = 0; i != candidates.size(); ++i) {
+		if (pred(candidates[i])) {
+			units.push_back(candidates[i]);
+		}
 	}
+	//Wyrmgus end
 }
 
 template <typename Pred>
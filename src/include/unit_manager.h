@@ -38,6 +38,10 @@
 #include <vector>
 #include <list>
 
+//Wyrmgus start
+#define UNIT_ARENA_CHUNK_SIZE 256	/// quantity of units in each chunk of the unit arena
+//Wyrmgus end
+
 
 /*----------------------------------------------------------------------------
 --  Declarations
@@ -73,9 +77,17 @@ public:
 	unsigned int GetUsedSlotCount() const;
 
 private:
+	//Wyrmgus start
+	CUnit *NewSlotUnit();
+	void FreeArena();
+	//Wyrmgus end
+
 	std::vector<CUnit *> units;
 	std::vector<CUnit *> unitSlots;
 	std::list<CUnit *> releasedUnits;
+	//Wyrmgus start
+	std::vector<char *> arenaChunks;	/// memory of the unit arena; each chunk holds the units of UNIT_ARENA_CHUNK_SIZE consecutive slots
+	//Wyrmgus end
 	CUnit *lastCreated;
 };
 
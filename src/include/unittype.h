@@ -998,6 +998,10 @@ public:
 	LuaCallback *OnHit;             /// lua function called when unit is hit
 	LuaCallback *OnEachCycle;       /// lua function called every cycle
 	LuaCallback *OnEachSecond;      /// lua function called every second
+	//Wyrmgus start
+	bool BatchOnEachCycle;			/// whether OnEachCycle is called once per cycle with a table of the numbers of all units of the type, instead of once per unit
+	bool BatchOnEachSecond;			/// whether OnEachSecond is called once per second with a table of the numbers of all units of the type, instead of once per unit
+	//Wyrmgus end
 	LuaCallback *OnInit;            /// lua function called on unit init
 
 	int TeleportCost;               /// mana used for teleportation
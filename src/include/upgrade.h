@@ -89,6 +89,10 @@ extern void UpgradeAcquire(CPlayer &player, const CUpgrade *upgrade);
 extern void UpgradeLost(CPlayer &player, int id);
 /// Apply researched upgrades when map is loading
 extern void ApplyUpgrades();
+//Wyrmgus start
+/// Time finding the units affected by the modifiers of the players' acquired upgrades
+extern void BenchmarkUpgradeModifierUnitSearch(int repeat);
+//Wyrmgus end
 
 extern void ApplyIndividualUpgradeModifier(CUnit &unit, const CUpgradeModifier *um); /// Apply upgrade modifier of an individual upgrade
 //Wyrmgus start
@@ -157,6 +157,9 @@ public:
 	void SetOriginalSize();
 	//Wyrmgus start
 	SDL_Surface *SetTimeOfDay(int time, bool flipped = false);
+#if defined(USE_OPENGL) || defined(USE_GLES)
+	GLuint *GetTextures(int time_of_day = 0);
+#endif
 	//Wyrmgus end
 	bool TransparentPixel(int x, int y);
 	void MakeShadow();
@@ -254,6 +257,10 @@ protected:
 public:
 	//Wyrmgus start
 	void MakePlayerColorSurface(int player_color, bool flipped = false, int time_of_day = 0);
+	SDL_Surface *GetPlayerColorSurface(int player_color, bool flipped = false, int time_of_day = 0);
+#if defined(USE_OPENGL) || defined(USE_GLES)
+	GLuint *GetPlayerColorTextures(int player_color, int time_of_day = 0);
+#endif
 	//Wyrmgus end
 	//Wyrmgus start
 	void DrawPlayerColorSub(int player, int gx, int gy, int w, int h, int x, int y);
@@ -278,10 +285,7 @@ public:
 			return Surface;
 		}
 		
-		if (!PlayerColorSurfaces[player_color]) {
-			MakePlayerColorSurface(player_color, false, NoTimeOfDay);
-		}
-		return PlayerColorSurfaces[player_color];
+		return GetPlayerColorSurface(player_color, false, NoTimeOfDay);
 	}
 	//Wyrmgus end
 
@@ -524,6 +528,11 @@ extern int SkipFrames;
 /// Fullscreen or windowed set from commandline.
 extern char VideoForceFullScreen;
 
+//Wyrmgus start
+/// Draw to an offscreen surface without opening a window, set from commandline.
+extern char VideoHeadless;
+//Wyrmgus end
+
 /// Next frame ticks
 extern double NextFrameTicks;
 
@@ -533,6 +542,49 @@ extern unsigned long FrameCounter;
 /// Counts quantity of slow frames
 extern unsigned long SlowFrameCounter;
 
+//Wyrmgus start
+/// Counts display updates, for the caches of drawn images to know which images were used in the current frame
+extern unsigned long DisplayFrameCounter;
+//Wyrmgus end
+
+//Wyrmgus start
+/// Stages of drawing a frame, which can be timed separately
+enum RenderStages {
+	RenderStageTerrain,
+	RenderStageUnits,
+	RenderStageMissiles,
+	RenderStageFog,
+	RenderStageMinimap,
+	RenderStagePanels,
+	
+	MaxRenderStages
+};
+
+/// Whether the time spent in each stage of drawing is being measured
+extern bool RenderStageTiming;
+
+/// Microseconds spent in each stage of drawing while it was measured
+extern unsigned long long RenderStageTimes[MaxRenderStages];
+
+/**
+**  Adds the time from its construction to its destruction to a stage of drawing, if the stages are being timed.
+**
+**  Time spent in timers constructed while it exists is only counted for the stage of those timers.
+*/
+class CRenderStageTimer
+{
+public:
+	explicit CRenderStageTimer(RenderStages stage);
+	~CRenderStageTimer();
+
+private:
+	RenderStages Stage;				/// stage to which the time is added, or MaxRenderStages if it is not being timed
+	unsigned long long StartTime;	/// when the timer was constructed, in microseconds
+	unsigned long long NestedTime;	/// time spent in timers constructed while this one existed, in microseconds
+	CRenderStageTimer *Parent;		/// timer which existed when this one was constructed
+};
+//Wyrmgus end
+
 /// Initialize Pixels[] for all players.
 /// (bring Players[] in sync with Pixels[])
 extern void SetPlayersPalette();
@@ -566,6 +618,13 @@ extern int VideoValidResolution(int w, int h);
 /// Load graphic from PNG file
 extern int LoadGraphicPNG(CGraphic *g);
 
+//Wyrmgus start
+/// Set the memory budget of the cache of player color and time of day sprite variants
+extern void SetSpriteVariantCacheBudget(int megabytes);
+/// Print the hit rate and memory use of the sprite variant cache
+extern void PrintSpriteVariantCacheStatistics();
+//Wyrmgus end
+
 #if defined(USE_OPENGL) || defined(USE_GLES)
 
 /// Make an OpenGL texture
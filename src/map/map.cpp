@@ -47,6 +47,9 @@
 #include "game.h" // for the SaveGameLoading variable
 //Wyrmgus end
 #include "iolib.h"
+//Wyrmgus start
+#include "pathfinder.h"
+//Wyrmgus end
 #include "player.h"
 //Wyrmgus start
 #include "province.h"
@@ -353,7 +356,7 @@ void CMapTemplate::Apply(Vec2i template_start_pos, Vec2i map_start_pos, int z)
 	if (z >= (int) Map.Fields.size()) {
 		Map.Info.MapWidths.push_back(std::min(this->Width * this->Scale, Map.Info.MapWidth));
 		Map.Info.MapHeights.push_back(std::min(this->Height * this->Scale, Map.Info.MapHeight));
-		Map.Fields.push_back(new CMapField[Map.Info.MapWidths[z] * Map.Info.MapHeights[z]]);
+		Map.AddFieldLayer(Map.Info.MapWidths[z], Map.Info.MapHeights[z]);
 		Map.TimeOfDay.push_back(NoTimeOfDay);
 		Map.Planes.push_back(this->Plane);
 		Map.Worlds.push_back(this->World);
@@ -1266,6 +1269,13 @@ void CMap::MarkSeenTile(CMapField &mf, int z)
 //	const unsigned int seentile = mf.playerInfo.SeenTile;
 	//Wyrmgus end
 
+	//Wyrmgus start
+	// this is called whenever the tile's visibility changes for the team of the player, so update its fog on the minimap
+	const unsigned int seen_index = &mf - this->Fields[z];
+	const Vec2i seen_pos(seen_index % this->Info.MapWidths[z], seen_index / this->Info.MapWidths[z]);
+	UI.Minimap.UpdateFogXY(seen_pos, z);
+	//Wyrmgus end
+
 	//  Nothing changed? Seeing already the correct tile.
 	//Wyrmgus start
 //	if (tile == seentile) {
@@ -1276,6 +1286,8 @@ void CMap::MarkSeenTile(CMapField &mf, int z)
 	//Wyrmgus start
 //	mf.playerInfo.SeenTile = tile;
 	mf.UpdateSeenTile();
+	
+	MarkTerrainCacheDirty(seen_pos, z);
 	//Wyrmgus end
 
 #ifdef MINIMAP_UPDATE
@@ -1370,12 +1382,13 @@ void CMap::Reveal(bool only_person_players)
 			CMapFieldPlayerInfo &playerInfo = mf.playerInfo;
 			for (int p = 0; p < PlayerMax; ++p) {
 				if (Players[p].Type == PlayerPerson || !only_person_players) {
-					playerInfo.Visible[p] = std::max<unsigned short>(1, playerInfo.Visible[p]);
+					playerInfo.SetVisible(p, std::max<unsigned short>(1, playerInfo.GetVisible(p)));
 				}
 			}
 			MarkSeenTile(mf, z);
 		}
 	}
+	HierarchicalPathfinderExplorationChanged();
 	//Wyrmgus end
 	//  Global seen recount. Simple and effective.
 	for (CUnitManager::Iterator it = UnitManager.begin(); it != UnitManager.end(); ++it) {
@@ -2178,7 +2191,7 @@ void CMap::Create()
 
 	//Wyrmgus start
 //	this->Fields = new CMapField[this->Info.MapWidth * this->Info.MapHeight];
-	this->Fields.push_back(new CMapField[this->Info.MapWidth * this->Info.MapHeight]);
+	this->AddFieldLayer(this->Info.MapWidth, this->Info.MapHeight);
 	this->Info.MapWidths.push_back(this->Info.MapWidth);
 	this->Info.MapHeights.push_back(this->Info.MapHeight);
 	if (!GameSettings.Inside && !GameSettings.NoTimeOfDay && Editor.Running == EditorNotRunning) {
@@ -2193,6 +2206,52 @@ void CMap::Create()
 	//Wyrmgus end
 }
 
+//Wyrmgus start
+/**
+**  Allocate the fields of a new map layer, together with their visibility plane.
+**
+**  @param width   Width of the map layer.
+**  @param height  Height of the map layer.
+*/
+void CMap::AddFieldLayer(int width, int height)
+{
+	const unsigned int size = width * height;
+	CMapField *fields = new CMapField[size];
+	CMapFieldVisibilityPlane *visibility_plane = new CMapFieldVisibilityPlane(size);
+	for (unsigned int i = 0; i < size; ++i) {
+		fields[i].playerInfo.VisibilityPlane = visibility_plane;
+		fields[i].playerInfo.PlaneIndex = i;
+	}
+	this->Fields.push_back(fields);
+	this->VisibilityPlanes.push_back(visibility_plane);
+}
+
+/**
+**  Free the fields of all map layers.
+*/
+void CMap::ClearFieldLayers()
+{
+	for (size_t z = 0; z < this->Fields.size(); ++z) {
+		delete[] this->Fields[z];
+	}
+	this->Fields.clear();
+	for (size_t z = 0; z < this->VisibilityPlanes.size(); ++z) {
+		delete this->VisibilityPlanes[z];
+	}
+	this->VisibilityPlanes.clear();
+}
+
+/**
+**  Get the number of bytes used by the fields of a map layer and by their visibility plane.
+**
+**  @param z  Map layer.
+*/
+size_t CMap::GetFieldMemoryUsage(int z) const
+{
+	return this->Info.MapWidths[z] * this->Info.MapHeights[z] * sizeof(CMapField) + this->VisibilityPlanes[z]->GetMemoryUsage();
+}
+//Wyrmgus end
+
 /**
 **  Initialize the fog of war.
 **  Build tables, setup functions.
@@ -2214,10 +2273,7 @@ void CMap::Clean()
 
 	//Wyrmgus start
 //	delete[] this->Fields;
-	for (size_t z = 0; z < this->Fields.size(); ++z) {
-		delete[] this->Fields[z];
-	}
-	this->Fields.clear();
+	this->ClearFieldLayers();
 	this->TimeOfDay.clear();
 	this->BorderLandmasses.clear();
 	this->Planes.clear();
@@ -2225,6 +2281,9 @@ void CMap::Clean()
 	this->SurfaceLayers.clear();
 	this->LayerConnectors.clear();
 	this->SettlementUnits.clear();
+	this->UnitBuckets.clear();
+	this->UnitBucketCycles.clear();
+	CleanTerrainCache();
 	//Wyrmgus end
 
 	// Tileset freed by Tileset?
@@ -2485,6 +2544,8 @@ void CMap::SetTileTerrain(const Vec2i &pos, CTerrainType *terrain, int z)
 	
 	mf.SetTerrain(terrain);
 	
+	MarkTerrainCacheDirty(pos, z);
+	
 	if (terrain->Overlay) {
 		//remove decorations if the overlay terrain has changed
 		std::vector<CUnit *> table;
@@ -2503,6 +2564,8 @@ void CMap::SetTileTerrain(const Vec2i &pos, CTerrainType *terrain, int z)
 	this->CalculateTileTransitions(pos, false, z); //recalculate both, since one may have changed the other
 	this->CalculateTileTransitions(pos, true, z);
 	this->CalculateTileTerrainFeature(pos, z);
+	HierarchicalPathfinderTileChanged(pos, z);
+	MapSightTileChanged(pos, z);
 	
 	if (mf.playerInfo.IsTeamVisible(*ThisPlayer)) {
 		MarkSeenTile(mf, z);
@@ -2567,6 +2630,8 @@ void CMap::RemoveTileOverlayTerrain(const Vec2i &pos, int z)
 	
 	this->CalculateTileTransitions(pos, true, z);
 	this->CalculateTileTerrainFeature(pos, z);
+	HierarchicalPathfinderTileChanged(pos, z);
+	MapSightTileChanged(pos, z);
 	
 	if (mf.playerInfo.IsTeamVisible(*ThisPlayer)) {
 		MarkSeenTile(mf, z);
@@ -2641,6 +2706,8 @@ void CMap::SetOverlayTerrainDestroyed(const Vec2i &pos, bool destroyed, int z)
 	}
 	
 	this->CalculateTileTransitions(pos, true, z);
+	HierarchicalPathfinderTileChanged(pos, z);
+	MapSightTileChanged(pos, z);
 	
 	if (mf.playerInfo.IsTeamVisible(*ThisPlayer)) {
 		MarkSeenTile(mf, z);
@@ -2811,6 +2878,9 @@ static int GetTransitionType(std::vector<int> &adjacent_directions, bool allow_s
 void CMap::CalculateTileTransitions(const Vec2i &pos, bool overlay, int z)
 {
 	CMapField &mf = *this->Field(pos, z);
+	
+	MarkTerrainCacheDirty(pos, z);
+	
 	CTerrainType *terrain = NULL;
 	if (overlay) {
 		terrain = mf.OverlayTerrain;
@@ -3133,6 +3203,8 @@ void CMap::CalculateTileOwnershipTransition(const Vec2i &pos, int z)
 	
 	CMapField &mf = *this->Field(pos, z);
 	
+	MarkTerrainCacheDirty(pos, z);
+	
 	mf.OwnershipBorderTile = -1;
 
 	if (mf.Owner == -1) {
@@ -47,6 +47,364 @@
 #include "unittype.h"
 #include "ui.h"
 #include "video.h"
+//Wyrmgus start
+#include "../video/intern_video.h"
+//Wyrmgus end
+
+//Wyrmgus start
+#define TERRAIN_CACHE_CHUNK_SIZE 16		/// width and height in tiles of the chunks of the terrain cache
+#define TERRAIN_CACHE_MAX_SURFACES 48	/// how many chunk images the terrain cache keeps before freeing the least recently drawn ones
+
+/**
+**  Image of the terrain of a chunk of tiles, as drawn by the software renderer
+*/
+class CTerrainCacheChunk
+{
+public:
+	CTerrainCacheChunk() : Surface(NULL), Dirty(true), LastUsed(0) {}
+
+	SDL_Surface *Surface;	/// image of the terrain of the chunk, or NULL if it has not been drawn
+	bool Dirty;				/// whether the terrain of the chunk changed since the image was drawn
+	unsigned long LastUsed;	/// display frame in which the image was last drawn to the screen
+};
+
+/**
+**  Images of the terrain of the chunks of a map layer
+*/
+class CTerrainCacheLayer
+{
+public:
+	CTerrainCacheLayer() : ChunksPerRow(0), Player(-1), RevealMap(false), TimeOfDay(-1) {}
+
+	std::vector<CTerrainCacheChunk> Chunks;	/// chunks of the map layer, row by row
+	int ChunksPerRow;						/// quantity of chunks in a row
+	int Player;								/// player for whom the seen terrain was drawn
+	bool RevealMap;							/// whether the actual terrain was drawn instead of the seen one
+	int TimeOfDay;							/// time of day with which the terrain was drawn
+	std::vector<IntColor> PlayerColors;		/// colors of the players with which the player color parts of the terrain were drawn
+};
+
+static std::vector<CTerrainCacheLayer> TerrainCache;	/// terrain cache for each map layer
+static int TerrainCacheSurfaces = 0;					/// quantity of chunk images in the terrain cache
+static int TerrainCacheBitsPerPixel = 0;				/// pixel depth of the screen for which the chunk images were made
+
+/**
+**  Draw the terrain of a map field.
+**
+**  @param mf  Map field.
+**  @param dx  Screen X position of the tile.
+**  @param dy  Screen Y position of the tile.
+*/
+static void DrawMapFieldTerrain(const CMapField &mf, int dx, int dy)
+{
+	if (ReplayRevealMap) {
+		bool is_unpassable = mf.OverlayTerrain && (mf.OverlayTerrain->Flags & MapFieldUnpassable) && std::find(mf.OverlayTerrain->DestroyedTiles.begin(), mf.OverlayTerrain->DestroyedTiles.end(), mf.OverlaySolidTile) == mf.OverlayTerrain->DestroyedTiles.end();
+		if (mf.Terrain && mf.Terrain->Graphics) {
+			mf.Terrain->Graphics->DrawFrameClip(mf.SolidTile + (mf.Terrain == mf.Terrain ? mf.AnimationFrame : 0), dx, dy, false);
+		}
+		for (size_t i = 0; i != mf.TransitionTiles.size(); ++i) {
+			if (mf.TransitionTiles[i].first->Graphics) {
+				mf.TransitionTiles[i].first->Graphics->DrawFrameClip(mf.TransitionTiles[i].second, dx, dy, false);
+			}
+		}
+		if (mf.Owner != -1 && mf.OwnershipBorderTile != -1 && Map.BorderTerrain && is_unpassable) { //if the tile is not passable, draw the border under its overlay, but otherwise, draw the border over it
+			if (Map.BorderTerrain->Graphics) {
+				Map.BorderTerrain->Graphics->DrawFrameClip(mf.OwnershipBorderTile, dx, dy, false);
+			}
+			if (Map.BorderTerrain->PlayerColorGraphics) {
+				Map.BorderTerrain->PlayerColorGraphics->DrawPlayerColorFrameClip(mf.Owner, mf.OwnershipBorderTile, dx, dy, false);
+			}
+		}
+		if (mf.OverlayTerrain && mf.OverlayTransitionTiles.size() == 0) {
+			if (mf.OverlayTerrain->Graphics) {
+				mf.OverlayTerrain->Graphics->DrawFrameClip(mf.OverlaySolidTile + (mf.OverlayTerrain == mf.OverlayTerrain ? mf.OverlayAnimationFrame : 0), dx, dy, false);
+			}
+			if (mf.OverlayTerrain->PlayerColorGraphics) {
+				mf.OverlayTerrain->PlayerColorGraphics->DrawPlayerColorFrameClip((mf.Owner != -1) ? mf.Owner : PlayerNumNeutral, mf.OverlaySolidTile + (mf.OverlayTerrain == mf.OverlayTerrain ? mf.OverlayAnimationFrame : 0), dx, dy, false);
+			}
+		}
+		for (size_t i = 0; i != mf.OverlayTransitionTiles.size(); ++i) {
+			if (mf.OverlayTransitionTiles[i].first->Graphics) {
+				mf.OverlayTransitionTiles[i].first->Graphics->DrawFrameClip(mf.OverlayTransitionTiles[i].second, dx, dy, false);
+			}
+			if (mf.OverlayTransitionTiles[i].first->PlayerColorGraphics) {
+				mf.OverlayTransitionTiles[i].first->PlayerColorGraphics->DrawPlayerColorFrameClip((mf.Owner != -1) ? mf.Owner : PlayerNumNeutral, mf.OverlayTransitionTiles[i].second, dx, dy, false);
+			}
+		}
+		if (mf.Owner != -1 && mf.OwnershipBorderTile != -1 && Map.BorderTerrain && !is_unpassable) { //if the tile is not passable, draw the border under its overlay, but otherwise, draw the border over it
+			if (Map.BorderTerrain->Graphics) {
+				Map.BorderTerrain->Graphics->DrawFrameClip(mf.OwnershipBorderTile, dx, dy, false);
+			}
+			if (Map.BorderTerrain->PlayerColorGraphics) {
+				Map.BorderTerrain->PlayerColorGraphics->DrawPlayerColorFrameClip(mf.Owner, mf.OwnershipBorderTile, dx, dy, false);
+			}
+		}
+		for (size_t i = 0; i != mf.OverlayTransitionTiles.size(); ++i) {
+			if (mf.OverlayTransitionTiles[i].first->ElevationGraphics) {
+				mf.OverlayTransitionTiles[i].first->ElevationGraphics->DrawFrameClip(mf.OverlayTransitionTiles[i].second, dx, dy, false);
+			}
+		}
+	} else {
+		bool is_unpassable_seen = mf.playerInfo.SeenOverlayTerrain && (mf.playerInfo.SeenOverlayTerrain->Flags & MapFieldUnpassable) && std::find(mf.playerInfo.SeenOverlayTerrain->DestroyedTiles.begin(), mf.playerInfo.SeenOverlayTerrain->DestroyedTiles.end(), mf.playerInfo.SeenOverlaySolidTile) == mf.playerInfo.SeenOverlayTerrain->DestroyedTiles.end();
+		if (mf.playerInfo.SeenTerrain && mf.playerInfo.SeenTerrain->Graphics) {
+			mf.playerInfo.SeenTerrain->Graphics->DrawFrameClip(mf.playerInfo.SeenSolidTile + (mf.playerInfo.SeenTerrain == mf.Terrain ? mf.AnimationFrame : 0), dx, dy, false);
+		}
+		for (size_t i = 0; i != mf.playerInfo.SeenTransitionTiles.size(); ++i) {
+			if (mf.playerInfo.SeenTransitionTiles[i].first->Graphics) {
+				mf.playerInfo.SeenTransitionTiles[i].first->Graphics->DrawFrameClip(mf.playerInfo.SeenTransitionTiles[i].second, dx, dy, false);
+			}
+		}
+		if (mf.Owner != -1 && mf.OwnershipBorderTile != -1 && Map.BorderTerrain && is_unpassable_seen) {
+			if (Map.BorderTerrain->Graphics) {
+				Map.BorderTerrain->Graphics->DrawFrameClip(mf.OwnershipBorderTile, dx, dy, false);
+			}
+			if (Map.BorderTerrain->PlayerColorGraphics) {
+				Map.BorderTerrain->PlayerColorGraphics->DrawPlayerColorFrameClip(mf.Owner, mf.OwnershipBorderTile, dx, dy, false);
+			}
+		}
+		if (mf.playerInfo.SeenOverlayTerrain && mf.playerInfo.SeenOverlayTransitionTiles.size() == 0) {
+			if (mf.playerInfo.SeenOverlayTerrain->Graphics) {
+				mf.playerInfo.SeenOverlayTerrain->Graphics->DrawFrameClip(mf.playerInfo.SeenOverlaySolidTile + (mf.playerInfo.SeenOverlayTerrain == mf.OverlayTerrain ? mf.OverlayAnimationFrame : 0), dx, dy, false);
+			}
+			if (mf.playerInfo.SeenOverlayTerrain->PlayerColorGraphics) {
+				mf.playerInfo.SeenOverlayTerrain->PlayerColorGraphics->DrawPlayerColorFrameClip((mf.Owner != -1) ? mf.Owner : PlayerNumNeutral, mf.playerInfo.SeenOverlaySolidTile + (mf.playerInfo.SeenOverlayTerrain == mf.OverlayTerrain ? mf.OverlayAnimationFrame : 0), dx, dy, false);
+			}
+		}
+		for (size_t i = 0; i != mf.playerInfo.SeenOverlayTransitionTiles.size(); ++i) {
+			if (mf.playerInfo.SeenOverlayTransitionTiles[i].first->Graphics) {
+				mf.playerInfo.SeenOverlayTransitionTiles[i].first->Graphics->DrawFrameClip(mf.playerInfo.SeenOverlayTransitionTiles[i].second, dx, dy, false);
+			}
+			if (mf.playerInfo.SeenOverlayTransitionTiles[i].first->PlayerColorGraphics) {
+				mf.playerInfo.SeenOverlayTransitionTiles[i].first->PlayerColorGraphics->DrawPlayerColorFrameClip((mf.Owner != -1) ? mf.Owner : PlayerNumNeutral, mf.playerInfo.SeenOverlayTransitionTiles[i].second, dx, dy, false);
+			}
+		}
+		if (mf.Owner != -1 && mf.OwnershipBorderTile != -1 && Map.BorderTerrain && !is_unpassable_seen) {
+			if (Map.BorderTerrain->Graphics) {
+				Map.BorderTerrain->Graphics->DrawFrameClip(mf.OwnershipBorderTile, dx, dy, false);
+			}
+			if (Map.BorderTerrain->PlayerColorGraphics) {
+				Map.BorderTerrain->PlayerColorGraphics->DrawPlayerColorFrameClip(mf.Owner, mf.OwnershipBorderTile, dx, dy, false);
+			}
+		}
+		for (size_t i = 0; i != mf.playerInfo.SeenOverlayTransitionTiles.size(); ++i) {
+			if (mf.playerInfo.SeenOverlayTransitionTiles[i].first->ElevationGraphics) {
+				mf.playerInfo.SeenOverlayTransitionTiles[i].first->ElevationGraphics->DrawFrameClip(mf.playerInfo.SeenOverlayTransitionTiles[i].second, dx, dy, false);
+			}
+		}
+	}
+}
+
+/**
+**  Free the image of a chunk of the terrain cache.
+*/
+static void FreeTerrainCacheChunk(CTerrainCacheChunk &chunk)
+{
+	if (chunk.Surface) {
+		SDL_FreeSurface(chunk.Surface);
+		chunk.Surface = NULL;
+		--TerrainCacheSurfaces;
+	}
+	chunk.Dirty = true;
+}
+
+/**
+**  Free the image of the chunk which was drawn to the screen the longest time ago, other than the ones drawn in the current frame.
+*/
+static void FreeLeastRecentlyUsedTerrainCacheChunk()
+{
+	CTerrainCacheChunk *oldest_chunk = NULL;
+	
+	for (size_t z = 0; z < TerrainCache.size(); ++z) {
+		for (size_t i = 0; i < TerrainCache[z].Chunks.size(); ++i) {
+			CTerrainCacheChunk &chunk = TerrainCache[z].Chunks[i];
+			if (chunk.Surface && chunk.LastUsed != DisplayFrameCounter && (!oldest_chunk || chunk.LastUsed < oldest_chunk->LastUsed)) {
+				oldest_chunk = &chunk;
+			}
+		}
+	}
+	
+	if (oldest_chunk) {
+		FreeTerrainCacheChunk(*oldest_chunk);
+	}
+}
+
+/**
+**  Draw the terrain of a chunk into its image.
+**
+**  @param chunk      Chunk of the terrain cache.
+**  @param chunk_pos  Map position of the top left tile of the chunk.
+**  @param z          Map layer of the chunk.
+*/
+static void RenderTerrainCacheChunk(CTerrainCacheChunk &chunk, const Vec2i &chunk_pos, int z)
+{
+	if (!chunk.Surface) {
+		if (TerrainCacheSurfaces >= TERRAIN_CACHE_MAX_SURFACES) {
+			FreeLeastRecentlyUsedTerrainCacheChunk();
+		}
+		
+		const SDL_PixelFormat *format = TheScreen->format;
+		chunk.Surface = SDL_CreateRGBSurface(SDL_SWSURFACE, TERRAIN_CACHE_CHUNK_SIZE * PixelTileSize.x, TERRAIN_CACHE_CHUNK_SIZE * PixelTileSize.y, format->BitsPerPixel, format->Rmask, format->Gmask, format->Bmask, 0);
+		if (!chunk.Surface) {
+			return;
+		}
+		++TerrainCacheSurfaces;
+	}
+	
+	const int width = std::min(TERRAIN_CACHE_CHUNK_SIZE, Map.Info.MapWidths[z] - chunk_pos.x);
+	const int height = std::min(TERRAIN_CACHE_CHUNK_SIZE, Map.Info.MapHeights[z] - chunk_pos.y);
+	
+	SDL_FillRect(chunk.Surface, NULL, 0);
+	
+	//draw the tiles with the usual functions, but into the image of the chunk instead of the screen
+	SDL_Surface *screen = TheScreen;
+	TheScreen = chunk.Surface;
+	PushClipping();
+	ClipX1 = 0;
+	ClipY1 = 0;
+	ClipX2 = width * PixelTileSize.x - 1;
+	ClipY2 = height * PixelTileSize.y - 1;
+	
+	for (int y = 0; y < height; ++y) {
+		for (int x = 0; x < width; ++x) {
+			DrawMapFieldTerrain(*Map.Field(chunk_pos.x + x, chunk_pos.y + y, z), x * PixelTileSize.x, y * PixelTileSize.y);
+		}
+	}
+	
+	PopClipping();
+	TheScreen = screen;
+	
+	chunk.Dirty = false;
+}
+
+/**
+**  Draw part of the image of a chunk to the screen, clipped.
+**
+**  @param chunk   Chunk of the terrain cache.
+**  @param x       Screen X position of the chunk.
+**  @param y       Screen Y position of the chunk.
+**  @param width   Width in pixels of the part of the chunk on the map.
+**  @param height  Height in pixels of the part of the chunk on the map.
+*/
+static void DrawTerrainCacheChunk(const CTerrainCacheChunk &chunk, int x, int y, int width, int height)
+{
+	const int oldx = x;
+	const int oldy = y;
+	CLIP_RECTANGLE(x, y, width, height);
+	
+	SDL_Rect srect = {Sint16(x - oldx), Sint16(y - oldy), Uint16(width), Uint16(height)};
+	SDL_Rect drect = {Sint16(x), Sint16(y), 0, 0};
+	SDL_BlitSurface(chunk.Surface, &srect, TheScreen, &drect);
+}
+
+/**
+**  Draw the map background of a viewport from the terrain cache, drawing the terrain of the chunks which changed since they were last drawn.
+**
+**  @param vp  Viewport.
+*/
+static void DrawTerrainCacheInViewport(const CViewport &vp)
+{
+	const int z = CurrentMapLayer;
+	
+	if (TheScreen->format->BitsPerPixel != TerrainCacheBitsPerPixel) {
+		CleanTerrainCache();
+		TerrainCacheBitsPerPixel = TheScreen->format->BitsPerPixel;
+	}
+	
+	if (z >= (int) TerrainCache.size()) {
+		TerrainCache.resize(z + 1);
+	}
+	CTerrainCacheLayer &layer = TerrainCache[z];
+	
+	const int chunks_per_row = (Map.Info.MapWidths[z] + TERRAIN_CACHE_CHUNK_SIZE - 1) / TERRAIN_CACHE_CHUNK_SIZE;
+	const int chunk_rows = (Map.Info.MapHeights[z] + TERRAIN_CACHE_CHUNK_SIZE - 1) / TERRAIN_CACHE_CHUNK_SIZE;
+	if (layer.ChunksPerRow != chunks_per_row || (int) layer.Chunks.size() != chunks_per_row * chunk_rows) {
+		for (size_t i = 0; i < layer.Chunks.size(); ++i) {
+			FreeTerrainCacheChunk(layer.Chunks[i]);
+		}
+		layer.Chunks.clear();
+		layer.Chunks.resize(chunks_per_row * chunk_rows);
+		layer.ChunksPerRow = chunks_per_row;
+	}
+	
+	//the whole layer has to be drawn again if what is shown of it changed
+	const int player = ThisPlayer ? ThisPlayer->Index : -1;
+	const int time_of_day = z < (int) Map.TimeOfDay.size() ? Map.TimeOfDay[z] : 0;
+	bool player_colors_changed = layer.PlayerColors.size() != PlayerMax;
+	for (int i = 0; i < PlayerMax && !player_colors_changed; ++i) {
+		player_colors_changed = layer.PlayerColors[i] != Players[i].Color;
+	}
+	if (layer.Player != player || layer.RevealMap != ReplayRevealMap || layer.TimeOfDay != time_of_day || player_colors_changed) {
+		for (size_t i = 0; i < layer.Chunks.size(); ++i) {
+			layer.Chunks[i].Dirty = true;
+		}
+		layer.Player = player;
+		layer.RevealMap = ReplayRevealMap;
+		layer.TimeOfDay = time_of_day;
+		layer.PlayerColors.resize(PlayerMax);
+		for (int i = 0; i < PlayerMax; ++i) {
+			layer.PlayerColors[i] = Players[i].Color;
+		}
+	}
+	
+	Vec2i min_pos(std::max<int>(vp.MapPos.x, 0), std::max<int>(vp.MapPos.y, 0));
+	Vec2i max_pos(std::min(vp.MapPos.x + vp.MapWidth - 1, Map.Info.MapWidths[z] - 1), std::min(vp.MapPos.y + vp.MapHeight - 1, Map.Info.MapHeights[z] - 1));
+	if (min_pos.x > max_pos.x || min_pos.y > max_pos.y) {
+		return;
+	}
+	
+	for (int chunk_y = min_pos.y / TERRAIN_CACHE_CHUNK_SIZE; chunk_y <= max_pos.y / TERRAIN_CACHE_CHUNK_SIZE; ++chunk_y) {
+		for (int chunk_x = min_pos.x / TERRAIN_CACHE_CHUNK_SIZE; chunk_x <= max_pos.x / TERRAIN_CACHE_CHUNK_SIZE; ++chunk_x) {
+			CTerrainCacheChunk &chunk = layer.Chunks[chunk_y * chunks_per_row + chunk_x];
+			const Vec2i chunk_pos(chunk_x * TERRAIN_CACHE_CHUNK_SIZE, chunk_y * TERRAIN_CACHE_CHUNK_SIZE);
+			
+			if (chunk.Dirty || !chunk.Surface) {
+				RenderTerrainCacheChunk(chunk, chunk_pos, z);
+				if (!chunk.Surface) {
+					continue;
+				}
+			}
+			chunk.LastUsed = DisplayFrameCounter;
+			
+			const PixelPos screen_pos = vp.TilePosToScreen_TopLeft(chunk_pos);
+			const int width = std::min(TERRAIN_CACHE_CHUNK_SIZE, Map.Info.MapWidths[z] - chunk_pos.x) * PixelTileSize.x;
+			const int height = std::min(TERRAIN_CACHE_CHUNK_SIZE, Map.Info.MapHeights[z] - chunk_pos.y) * PixelTileSize.y;
+			DrawTerrainCacheChunk(chunk, screen_pos.x, screen_pos.y, width, height);
+		}
+	}
+}
+
+/**
+**  Mark the terrain of the chunk containing a tile as needing to be drawn again.
+**
+**  @param pos  Map tile position.
+**  @param z    Map layer.
+*/
+void MarkTerrainCacheDirty(const Vec2i &pos, int z)
+{
+	if (z < 0 || z >= (int) TerrainCache.size() || TerrainCache[z].Chunks.empty()) {
+		return;
+	}
+	
+	CTerrainCacheLayer &layer = TerrainCache[z];
+	const size_t index = (pos.y / TERRAIN_CACHE_CHUNK_SIZE) * layer.ChunksPerRow + pos.x / TERRAIN_CACHE_CHUNK_SIZE;
+	if (index < layer.Chunks.size()) {
+		layer.Chunks[index].Dirty = true;
+	}
+}
+
+/**
+**  Free the terrain cache.
+*/
+void CleanTerrainCache()
+{
+	for (size_t z = 0; z < TerrainCache.size(); ++z) {
+		for (size_t i = 0; i < TerrainCache[z].Chunks.size(); ++i) {
+			FreeTerrainCacheChunk(TerrainCache[z].Chunks[i]);
+		}
+	}
+	TerrainCache.clear();
+}
+//Wyrmgus end
 
 
 CViewport::CViewport() : MapWidth(0), MapHeight(0), Unit(NULL)
@@ -249,6 +607,19 @@ void CViewport::Center(const PixelPos &mapPixelPos)
 */
 void CViewport::DrawMapBackgroundInViewport() const
 {
+	//Wyrmgus start
+	CRenderStageTimer render_stage_timer(RenderStageTerrain);
+	
+	//the software renderer draws the terrain from images of chunks of tiles, which are only drawn again when the terrain in them changes
+#if defined(USE_OPENGL) || defined(USE_GLES)
+	if (!UseOpenGL)
+#endif
+	{
+		DrawTerrainCacheInViewport(*this);
+		return;
+	}
+	//Wyrmgus end
+	
 	int ex = this->BottomRightPos.x;
 	int ey = this->BottomRightPos.y;
 	int sy = this->MapPos.y;
@@ -295,101 +666,7 @@ void CViewport::DrawMapBackgroundInViewport() const
 			//Wyrmgus end
 			//Wyrmgus start
 //			Map.TileGraphic->DrawFrameClip(tile, dx, dy);
-			if (ReplayRevealMap) {
-				bool is_unpassable = mf.OverlayTerrain && (mf.OverlayTerrain->Flags & MapFieldUnpassable) && std::find(mf.OverlayTerrain->DestroyedTiles.begin(), mf.OverlayTerrain->DestroyedTiles.end(), mf.OverlaySolidTile) == mf.OverlayTerrain->DestroyedTiles.end();
-				if (mf.Terrain && mf.Terrain->Graphics) {
-					mf.Terrain->Graphics->DrawFrameClip(mf.SolidTile + (mf.Terrain == mf.Terrain ? mf.AnimationFrame : 0), dx, dy, false);
-				}
-				for (size_t i = 0; i != mf.TransitionTiles.size(); ++i) {
-					if (mf.TransitionTiles[i].first->Graphics) {
-						mf.TransitionTiles[i].first->Graphics->DrawFrameClip(mf.TransitionTiles[i].second, dx, dy, false);
-					}
-				}
-				if (mf.Owner != -1 && mf.OwnershipBorderTile != -1 && Map.BorderTerrain && is_unpassable) { //if the tile is not passable, draw the border under its overlay, but otherwise, draw the border over it
-					if (Map.BorderTerrain->Graphics) {
-						Map.BorderTerrain->Graphics->DrawFrameClip(mf.OwnershipBorderTile, dx, dy, false);
-					}
-					if (Map.BorderTerrain->PlayerColorGraphics) {
-						Map.BorderTerrain->PlayerColorGraphics->DrawPlayerColorFrameClip(mf.Owner, mf.OwnershipBorderTile, dx, dy, false);
-					}
-				}
-				if (mf.OverlayTerrain && mf.OverlayTransitionTiles.size() == 0) {
-					if (mf.OverlayTerrain->Graphics) {
-						mf.OverlayTerrain->Graphics->DrawFrameClip(mf.OverlaySolidTile + (mf.OverlayTerrain == mf.OverlayTerrain ? mf.OverlayAnimationFrame : 0), dx, dy, false);
-					}
-					if (mf.OverlayTerrain->PlayerColorGraphics) {
-						mf.OverlayTerrain->PlayerColorGraphics->DrawPlayerColorFrameClip((mf.Owner != -1) ? mf.Owner : PlayerNumNeutral, mf.OverlaySolidTile + (mf.OverlayTerrain == mf.OverlayTerrain ? mf.OverlayAnimationFrame : 0), dx, dy, false);
-					}
-				}
-				for (size_t i = 0; i != mf.OverlayTransitionTiles.size(); ++i) {
-					if (mf.OverlayTransitionTiles[i].first->Graphics) {
-						mf.OverlayTransitionTiles[i].first->Graphics->DrawFrameClip(mf.OverlayTransitionTiles[i].second, dx, dy, false);
-					}
-					if (mf.OverlayTransitionTiles[i].first->PlayerColorGraphics) {
-						mf.OverlayTransitionTiles[i].first->PlayerColorGraphics->DrawPlayerColorFrameClip((mf.Owner != -1) ? mf.Owner : PlayerNumNeutral, mf.OverlayTransitionTiles[i].second, dx, dy, false);
-					}
-				}
-				if (mf.Owner != -1 && mf.OwnershipBorderTile != -1 && Map.BorderTerrain && !is_unpassable) { //if the tile is not passable, draw the border under its overlay, but otherwise, draw the border over it
-					if (Map.BorderTerrain->Graphics) {
-						Map.BorderTerrain->Graphics->DrawFrameClip(mf.OwnershipBorderTile, dx, dy, false);
-					}
-					if (Map.BorderTerrain->PlayerColorGraphics) {
-						Map.BorderTerrain->PlayerColorGraphics->DrawPlayerColorFrameClip(mf.Owner, mf.OwnershipBorderTile, dx, dy, false);
-					}
-				}
-				for (size_t i = 0; i != mf.OverlayTransitionTiles.size(); ++i) {
-					if (mf.OverlayTransitionTiles[i].first->ElevationGraphics) {
-						mf.OverlayTransitionTiles[i].first->ElevationGraphics->DrawFrameClip(mf.OverlayTransitionTiles[i].second, dx, dy, false);
-					}
-				}
-			} else {
-				bool is_unpassable_seen = mf.playerInfo.SeenOverlayTerrain && (mf.playerInfo.SeenOverlayTerrain->Flags & MapFieldUnpassable) && std::find(mf.playerInfo.SeenOverlayTerrain->DestroyedTiles.begin(), mf.playerInfo.SeenOverlayTerrain->DestroyedTiles.end(), mf.playerInfo.SeenOverlaySolidTile) == mf.playerInfo.SeenOverlayTerrain->DestroyedTiles.end();
-				if (mf.playerInfo.SeenTerrain && mf.playerInfo.SeenTerrain->Graphics) {
-					mf.playerInfo.SeenTerrain->Graphics->DrawFrameClip(mf.playerInfo.SeenSolidTile + (mf.playerInfo.SeenTerrain == mf.Terrain ? mf.AnimationFrame : 0), dx, dy, false);
-				}
-				for (size_t i = 0; i != mf.playerInfo.SeenTransitionTiles.size(); ++i) {
-					if (mf.playerInfo.SeenTransitionTiles[i].first->Graphics) {
-						mf.playerInfo.SeenTransitionTiles[i].first->Graphics->DrawFrameClip(mf.playerInfo.SeenTransitionTiles[i].second, dx, dy, false);
-					}
-				}
-				if (mf.Owner != -1 && mf.OwnershipBorderTile != -1 && Map.BorderTerrain && is_unpassable_seen) {
-					if (Map.BorderTerrain->Graphics) {
-						Map.BorderTerrain->Graphics->DrawFrameClip(mf.OwnershipBorderTile, dx, dy, false);
-					}
-					if (Map.BorderTerrain->PlayerColorGraphics) {
-						Map.BorderTerrain->PlayerColorGraphics->DrawPlayerColorFrameClip(mf.Owner, mf.OwnershipBorderTile, dx, dy, false);
-					}
-				}
-				if (mf.playerInfo.SeenOverlayTerrain && mf.playerInfo.SeenOverlayTransitionTiles.size() == 0) {
-					if (mf.playerInfo.SeenOverlayTerrain->Graphics) {
-						mf.playerInfo.SeenOverlayTerrain->Graphics->DrawFrameClip(mf.playerInfo.SeenOverlaySolidTile + (mf.playerInfo.SeenOverlayTerrain == mf.OverlayTerrain ? mf.OverlayAnimationFrame : 0), dx, dy, false);
-					}
-					if (mf.playerInfo.SeenOverlayTerrain->PlayerColorGraphics) {
-						mf.playerInfo.SeenOverlayTerrain->PlayerColorGraphics->DrawPlayerColorFrameClip((mf.Owner != -1) ? mf.Owner : PlayerNumNeutral, mf.playerInfo.SeenOverlaySolidTile + (mf.playerInfo.SeenOverlayTerrain == mf.OverlayTerrain ? mf.OverlayAnimationFrame : 0), dx, dy, false);
-					}
-				}
-				for (size_t i = 0; i != mf.playerInfo.SeenOverlayTransitionTiles.size(); ++i) {
-					if (mf.playerInfo.SeenOverlayTransitionTiles[i].first->Graphics) {
-						mf.playerInfo.SeenOverlayTransitionTiles[i].first->Graphics->DrawFrameClip(mf.playerInfo.SeenOverlayTransitionTiles[i].second, dx, dy, false);
-					}
-					if (mf.playerInfo.SeenOverlayTransitionTiles[i].first->PlayerColorGraphics) {
-						mf.playerInfo.SeenOverlayTransitionTiles[i].first->PlayerColorGraphics->DrawPlayerColorFrameClip((mf.Owner != -1) ? mf.Owner : PlayerNumNeutral, mf.playerInfo.SeenOverlayTransitionTiles[i].second, dx, dy, false);
-					}
-				}
-				if (mf.Owner != -1 && mf.OwnershipBorderTile != -1 && Map.BorderTerrain && !is_unpassable_seen) {
-					if (Map.BorderTerrain->Graphics) {
-						Map.BorderTerrain->Graphics->DrawFrameClip(mf.OwnershipBorderTile, dx, dy, false);
-					}
-					if (Map.BorderTerrain->PlayerColorGraphics) {
-						Map.BorderTerrain->PlayerColorGraphics->DrawPlayerColorFrameClip(mf.Owner, mf.OwnershipBorderTile, dx, dy, false);
-					}
-				}
-				for (size_t i = 0; i != mf.playerInfo.SeenOverlayTransitionTiles.size(); ++i) {
-					if (mf.playerInfo.SeenOverlayTransitionTiles[i].first->ElevationGraphics) {
-						mf.playerInfo.SeenOverlayTransitionTiles[i].first->ElevationGraphics->DrawFrameClip(mf.playerInfo.SeenOverlayTransitionTiles[i].second, dx, dy, false);
-					}
-				}
-			}
+			DrawMapFieldTerrain(mf, dx, dy);
 			//Wyrmgus end
 			++sx;
 			dx += PixelTileSize.x;
@@ -42,6 +42,7 @@
 #include "minimap.h"
 #include "player.h"
 //Wyrmgus start
+#include "pathfinder.h"
 #include "tileset.h"
 //Wyrmgus end
 #include "ui.h"
@@ -81,6 +82,31 @@ static std::vector<std::vector<unsigned short>> VisibleTable;
 static SDL_Surface *OnlyFogSurface;
 static CGraphic *AlphaFogG;
 
+//Wyrmgus start
+static std::vector<std::vector<int>> SightRowHalfWidths;	/// for each sight range, how far the sight area extends horizontally at each vertical distance
+
+#define OBSTACLE_SIGHT_REGION_SIZE 16		/// size of the regions for which terrain changes are tracked by the obstacle sight cache
+#define OBSTACLE_SIGHT_CACHE_MAX_SIZE 4096	/// maximum number of obstacle sights kept in the cache
+
+/**
+**  The tiles visible from a tile when sight is blocked by obstacles.
+*/
+class CObstacleSight
+{
+public:
+	CObstacleSight() : Stamp(0)
+	{
+	}
+
+	unsigned int Stamp;					/// the terrain version when the sight was calculated
+	std::vector<unsigned char> Visible;	/// whether each tile of the square around the origin is visible, in rows
+};
+
+static std::map<unsigned long long, CObstacleSight> ObstacleSightCache;	/// the cached obstacle sights, keyed by map layer, range and origin tile
+static std::vector<std::vector<unsigned int>> ObstacleSightRegionVersions;	/// the terrain version of each region, for each map layer
+static unsigned int ObstacleSightVersion = 0;		/// the latest terrain version
+//Wyrmgus end
+
 /*----------------------------------------------------------------------------
 --  Functions
 ----------------------------------------------------------------------------*/
@@ -281,16 +307,32 @@ void MapMarkTileSight(const CPlayer &player, const unsigned int index, int z)
 //	CMapField &mf = *Map.Field(index);
 	CMapField &mf = *Map.Field(index, z);
 	//Wyrmgus end
-	unsigned short *v = &(mf.playerInfo.Visible[player.Index]);
-	if (*v == 0 || *v == 1) { // Unexplored or unseen
+	//Wyrmgus start
+//	unsigned short *v = &(mf.playerInfo.Visible[player.Index]);
+	const unsigned short v = mf.playerInfo.GetVisible(player.Index);
+	//Wyrmgus end
+	//Wyrmgus start
+//	if (*v == 0 || *v == 1) { // Unexplored or unseen
+	if (v == 0 || v == 1) { // Unexplored or unseen
+	//Wyrmgus end
 		// When there is no fog only unexplored tiles are marked.
-		if (!Map.NoFogOfWar || *v == 0) {
+		//Wyrmgus start
+//		if (!Map.NoFogOfWar || *v == 0) {
+		if (!Map.NoFogOfWar || v == 0) {
+		//Wyrmgus end
 			//Wyrmgus start
 //			UnitsOnTileMarkSeen(player, mf, 0);
 			UnitsOnTileMarkSeen(player, mf, 0, 0);
 			//Wyrmgus end
 		}
-		*v = 2;
+		//Wyrmgus start
+//		*v = 2;
+		mf.playerInfo.SetVisible(player.Index, 2);
+		if (v == 0) {
+			HierarchicalPathfinderTileExplored(player, Vec2i(index % Map.Info.MapWidths[z], index / Map.Info.MapWidths[z]), z);
+		}
+		Map.MarkUnitBucketChanged(Vec2i(index % Map.Info.MapWidths[z], index / Map.Info.MapWidths[z]), z); // wake up sleeping units which may now see something
+		//Wyrmgus end
 		if (mf.playerInfo.IsTeamVisible(*ThisPlayer)) {
 			//Wyrmgus start
 //			Map.MarkSeenTile(mf);
@@ -299,8 +341,12 @@ void MapMarkTileSight(const CPlayer &player, const unsigned int index, int z)
 		}
 		return;
 	}
-	Assert(*v != 65535);
-	++*v;
+	//Wyrmgus start
+//	Assert(*v != 65535);
+//	++*v;
+	Assert(v != 65535);
+	mf.playerInfo.SetVisible(player.Index, v + 1);
+	//Wyrmgus end
 }
 
 //Wyrmgus start
@@ -331,8 +377,12 @@ void MapUnmarkTileSight(const CPlayer &player, const unsigned int index, int z)
 //	CMapField &mf = *Map.Field(index);
 	CMapField &mf = *Map.Field(index, z);
 	//Wyrmgus end
-	unsigned short *v = &mf.playerInfo.Visible[player.Index];
-	switch (*v) {
+	//Wyrmgus start
+//	unsigned short *v = &mf.playerInfo.Visible[player.Index];
+//	switch (*v) {
+	const unsigned short v = mf.playerInfo.GetVisible(player.Index);
+	switch (v) {
+	//Wyrmgus end
 		case 0:  // Unexplored
 		case 1:
 			// This happens when we unmark everything in CommandSharedVision
@@ -345,6 +395,9 @@ void MapUnmarkTileSight(const CPlayer &player, const unsigned int index, int z)
 				UnitsOnTileUnmarkSeen(player, mf, 0, 0);
 				//Wyrmgus end
 			}
+			//Wyrmgus start
+			Map.MarkUnitBucketChanged(Vec2i(index % Map.Info.MapWidths[z], index / Map.Info.MapWidths[z]), z); // wake up sleeping units which may have lost sight of their target
+			//Wyrmgus end
 			// Check visible Tile, then deduct...
 			if (mf.playerInfo.IsTeamVisible(*ThisPlayer)) {
 				//Wyrmgus start
@@ -353,7 +406,10 @@ void MapUnmarkTileSight(const CPlayer &player, const unsigned int index, int z)
 				//Wyrmgus end
 			}
 		default:  // seen -> seen
-			--*v;
+			//Wyrmgus start
+//			--*v;
+			mf.playerInfo.SetVisible(player.Index, v - 1);
+			//Wyrmgus end
 			break;
 	}
 }
@@ -386,15 +442,24 @@ void MapMarkTileDetectCloak(const CPlayer &player, const unsigned int index, int
 //	CMapField &mf = *Map.Field(index);
 	CMapField &mf = *Map.Field(index, z);
 	//Wyrmgus end
-	unsigned char *v = &mf.playerInfo.VisCloak[player.Index];
-	if (*v == 0) {
+	//Wyrmgus start
+//	unsigned char *v = &mf.playerInfo.VisCloak[player.Index];
+//	if (*v == 0) {
+	const unsigned char v = mf.playerInfo.GetVisCloak(player.Index);
+	if (v == 0) {
+	//Wyrmgus end
 		//Wyrmgus start
 //		UnitsOnTileMarkSeen(player, mf, 1);
 		UnitsOnTileMarkSeen(player, mf, 1, 0);
+		Map.MarkUnitBucketChanged(Vec2i(index % Map.Info.MapWidths[z], index / Map.Info.MapWidths[z]), z);
 		//Wyrmgus end
 	}
-	Assert(*v != 255);
-	++*v;
+	//Wyrmgus start
+//	Assert(*v != 255);
+//	++*v;
+	Assert(v != 255);
+	mf.playerInfo.SetVisCloak(player.Index, v + 1);
+	//Wyrmgus end
 }
 
 //Wyrmgus start
@@ -423,15 +488,24 @@ void MapUnmarkTileDetectCloak(const CPlayer &player, const unsigned int index, i
 //	CMapField &mf = *Map.Field(index);
 	CMapField &mf = *Map.Field(index, z);
 	//Wyrmgus end
-	unsigned char *v = &mf.playerInfo.VisCloak[player.Index];
-	Assert(*v != 0);
-	if (*v == 1) {
+	//Wyrmgus start
+//	unsigned char *v = &mf.playerInfo.VisCloak[player.Index];
+//	Assert(*v != 0);
+//	if (*v == 1) {
+	const unsigned char v = mf.playerInfo.GetVisCloak(player.Index);
+	Assert(v != 0);
+	if (v == 1) {
+	//Wyrmgus end
 		//Wyrmgus start
 //		UnitsOnTileUnmarkSeen(player, mf, 1);
 		UnitsOnTileUnmarkSeen(player, mf, 1, 0);
+		Map.MarkUnitBucketChanged(Vec2i(index % Map.Info.MapWidths[z], index / Map.Info.MapWidths[z]), z);
 		//Wyrmgus end
 	}
-	--*v;
+	//Wyrmgus start
+//	--*v;
+	mf.playerInfo.SetVisCloak(player.Index, v - 1);
+	//Wyrmgus end
 }
 
 //Wyrmgus start
@@ -455,12 +529,13 @@ void MapUnmarkTileDetectCloak(const CPlayer &player, const Vec2i &pos, int z)
 void MapMarkTileDetectEthereal(const CPlayer &player, const unsigned int index, int z)
 {
 	CMapField &mf = *Map.Field(index, z);
-	unsigned char *v = &mf.playerInfo.VisEthereal[player.Index];
-	if (*v == 0) {
+	const unsigned char v = mf.playerInfo.GetVisEthereal(player.Index);
+	if (v == 0) {
 		UnitsOnTileMarkSeen(player, mf, 0, 1);
+		Map.MarkUnitBucketChanged(Vec2i(index % Map.Info.MapWidths[z], index / Map.Info.MapWidths[z]), z);
 	}
-	Assert(*v != 255);
-	++*v;
+	Assert(v != 255);
+	mf.playerInfo.SetVisEthereal(player.Index, v + 1);
 }
 
 void MapMarkTileDetectEthereal(const CPlayer &player, const Vec2i &pos, int z)
@@ -477,18 +552,318 @@ void MapMarkTileDetectEthereal(const CPlayer &player, const Vec2i &pos, int z)
 void MapUnmarkTileDetectEthereal(const CPlayer &player, const unsigned int index, int z)
 {
 	CMapField &mf = *Map.Field(index, z);
-	unsigned char *v = &mf.playerInfo.VisEthereal[player.Index];
-	Assert(*v != 0);
-	if (*v == 1) {
+	const unsigned char v = mf.playerInfo.GetVisEthereal(player.Index);
+	Assert(v != 0);
+	if (v == 1) {
 		UnitsOnTileUnmarkSeen(player, mf, 0, 1);
+		Map.MarkUnitBucketChanged(Vec2i(index % Map.Info.MapWidths[z], index / Map.Info.MapWidths[z]), z);
 	}
-	--*v;
+	mf.playerInfo.SetVisEthereal(player.Index, v - 1);
 }
 
 void MapUnmarkTileDetectEthereal(const CPlayer &player, const Vec2i &pos, int z)
 {
 	MapUnmarkTileDetectEthereal(player, Map.getIndex(pos, z), z);
 }
+
+/**
+**  Mark the sight of a horizontal span of tiles.
+**
+**  The sight counters of tiles which are already visible only need to be
+**  incremented, which is done for the whole span at once in a loop the
+**  compiler can vectorize; only if the span contains tiles which become
+**  visible are these marked one by one.
+**
+**  @param player  Player to mark sight.
+**  @param index   First tile of the span.
+**  @param length  Number of tiles in the span.
+*/
+static void MapMarkTileSightSpan(const CPlayer &player, const unsigned int index, const int length, int z)
+{
+	unsigned short *v = Map.VisibilityPlanes[z]->GetVisibleSpan(player.Index, index);
+	
+	int unseen = 0;
+	for (int i = 0; i < length; ++i) {
+		unseen += v[i] < 2;
+	}
+	
+	if (unseen == 0) {
+		for (int i = 0; i < length; ++i) {
+			++v[i];
+		}
+		return;
+	}
+	
+	for (int i = 0; i < length; ++i) {
+		if (v[i] < 2) {
+			MapMarkTileSight(player, index + i, z);
+		} else {
+			Assert(v[i] != 65535);
+			++v[i];
+		}
+	}
+}
+
+/**
+**  Unmark the sight of a horizontal span of tiles.
+**
+**  @param player  Player to unmark sight.
+**  @param index   First tile of the span.
+**  @param length  Number of tiles in the span.
+*/
+static void MapUnmarkTileSightSpan(const CPlayer &player, const unsigned int index, const int length, int z)
+{
+	if (Map.VisibilityPlanes[z]->Visible[player.Index].empty()) { // nothing has been explored by the player in this map layer
+		return;
+	}
+	unsigned short *v = Map.VisibilityPlanes[z]->GetVisibleSpan(player.Index, index);
+	
+	int leaving_sight = 0;
+	for (int i = 0; i < length; ++i) {
+		leaving_sight += v[i] <= 2;
+	}
+	
+	if (leaving_sight == 0) {
+		for (int i = 0; i < length; ++i) {
+			--v[i];
+		}
+		return;
+	}
+	
+	for (int i = 0; i < length; ++i) {
+		if (v[i] <= 2) {
+			MapUnmarkTileSight(player, index + i, z);
+		} else {
+			--v[i];
+		}
+	}
+}
+
+/**
+**  Check whether a marker can be applied to a whole span of tiles at once, see MapMarkerSightSpan.
+*/
+static bool IsSightSpanMarker(MapMarkerFunc *marker)
+{
+	MapMarkerFunc *const mark_tile_sight = MapMarkTileSight;
+	MapMarkerFunc *const unmark_tile_sight = MapUnmarkTileSight;
+	return marker == mark_tile_sight || marker == unmark_tile_sight;
+}
+
+/**
+**  Apply a sight marker to a horizontal span of tiles at once.
+**
+**  @param player  Player to mark sight.
+**  @param pos     First tile of the span.
+**  @param length  Number of tiles in the span.
+**  @param marker  MapMarkTileSight or MapUnmarkTileSight.
+*/
+static void MapMarkerSightSpan(const CPlayer &player, const Vec2i &pos, int length, MapMarkerFunc *marker, int z)
+{
+	MapMarkerFunc *const mark_tile_sight = MapMarkTileSight;
+	if (marker == mark_tile_sight) {
+		MapMarkTileSightSpan(player, Map.getIndex(pos, z), length, z);
+	} else {
+		MapUnmarkTileSightSpan(player, Map.getIndex(pos, z), length, z);
+	}
+}
+
+static inline int FloorDiv(int numerator, int denominator)
+{
+	return numerator >= 0 ? numerator / denominator : -((denominator - numerator - 1) / denominator);
+}
+
+static inline bool IsObstacleSightBlocked(const Vec2i &pos, int z)
+{
+	return !Map.Info.IsPointOnMap(pos, z) || (Map.Field(pos, z)->Flags & MapFieldAirUnpassable);
+}
+
+/**
+**  A row of tiles scanned by the shadowcasting, with the slopes which delimit it.
+**
+**  The slopes are kept as fractions, so that the result does not depend on floating point rounding.
+*/
+class CSightRow
+{
+public:
+	CSightRow(int depth, int start_numerator, int start_denominator, int end_numerator, int end_denominator) :
+		Depth(depth), StartNumerator(start_numerator), StartDenominator(start_denominator), EndNumerator(end_numerator), EndDenominator(end_denominator)
+	{
+	}
+
+	int Depth;
+	int StartNumerator;
+	int StartDenominator;
+	int EndNumerator;
+	int EndDenominator;
+};
+
+/**
+**  Calculate which tiles are visible from a tile, when sight is blocked by
+**  air unpassable tiles, using symmetric shadowcasting.
+**
+**  Each of the four quadrants around the origin is scanned row by row,
+**  narrowing the slopes which delimit the visible part of the next row
+**  whenever an obstacle is found. Obstacle tiles themselves are visible,
+**  while other tiles are only visible if the origin would also be visible
+**  from them.
+**
+**  @param origin   Tile from which to calculate the sight.
+**  @param range    Range of the sight; the whole square of this radius around the origin is calculated.
+**  @param visible  Filled with whether each tile of the square is visible, in rows.
+*/
+static void CalculateObstacleSight(const Vec2i &origin, int range, int z, std::vector<unsigned char> &visible)
+{
+	const int size = range * 2 + 1;
+	visible.assign(size * size, 0);
+	visible[range * size + range] = 1;
+	
+	std::vector<CSightRow> rows;
+	for (int quadrant = 0; quadrant < 4; ++quadrant) {
+		rows.push_back(CSightRow(1, -1, 1, 1, 1));
+		while (!rows.empty()) {
+			CSightRow row = rows.back();
+			rows.pop_back();
+			if (row.Depth > range) {
+				continue;
+			}
+			
+			const int min_col = FloorDiv(2 * row.Depth * row.StartNumerator + row.StartDenominator, 2 * row.StartDenominator);
+			const int max_col = -FloorDiv(row.EndDenominator - 2 * row.Depth * row.EndNumerator, 2 * row.EndDenominator);
+			bool has_previous = false;
+			bool previous_blocked = false;
+			for (int col = min_col; col <= max_col; ++col) {
+				Vec2i offset;
+				switch (quadrant) {
+					case 0:
+						offset = Vec2i(col, -row.Depth);
+						break;
+					case 1:
+						offset = Vec2i(row.Depth, col);
+						break;
+					case 2:
+						offset = Vec2i(col, row.Depth);
+						break;
+					default:
+						offset = Vec2i(-row.Depth, col);
+						break;
+				}
+				const bool blocked = IsObstacleSightBlocked(origin + offset, z);
+				const bool symmetric = col * row.StartDenominator >= row.Depth * row.StartNumerator && col * row.EndDenominator <= row.Depth * row.EndNumerator;
+				if (blocked || symmetric) {
+					visible[(offset.y + range) * size + offset.x + range] = 1;
+				}
+				if (has_previous && previous_blocked && !blocked) {
+					row.StartNumerator = 2 * col - 1;
+					row.StartDenominator = 2 * row.Depth;
+				}
+				if (has_previous && !previous_blocked && blocked) {
+					rows.push_back(CSightRow(row.Depth + 1, row.StartNumerator, row.StartDenominator, 2 * col - 1, 2 * row.Depth));
+				}
+				has_previous = true;
+				previous_blocked = blocked;
+			}
+			if (has_previous && !previous_blocked) {
+				rows.push_back(CSightRow(row.Depth + 1, row.StartNumerator, row.StartDenominator, row.EndNumerator, row.EndDenominator));
+			}
+		}
+	}
+}
+
+/**
+**  Get the tiles visible from a tile when sight is blocked by obstacles,
+**  calculating them if they are not cached or if the terrain around the
+**  tile has changed since they were cached.
+*/
+static const std::vector<unsigned char> &GetObstacleSight(const Vec2i &origin, int range, int z)
+{
+	if (z >= (int) ObstacleSightRegionVersions.size()) {
+		ObstacleSightRegionVersions.resize(z + 1);
+	}
+	std::vector<unsigned int> &region_versions = ObstacleSightRegionVersions[z];
+	const int regions_per_row = (Map.Info.MapWidths[z] + OBSTACLE_SIGHT_REGION_SIZE - 1) / OBSTACLE_SIGHT_REGION_SIZE;
+	if (region_versions.empty()) {
+		region_versions.resize(regions_per_row * ((Map.Info.MapHeights[z] + OBSTACLE_SIGHT_REGION_SIZE - 1) / OBSTACLE_SIGHT_REGION_SIZE), 0);
+	}
+	
+	const unsigned long long key = ((unsigned long long) z << 48) | ((unsigned long long) range << 32) | Map.getIndex(origin, z);
+	CObstacleSight &sight = ObstacleSightCache[key];
+	
+	if (!sight.Visible.empty()) {
+		const int min_region_x = std::max(0, origin.x - range) / OBSTACLE_SIGHT_REGION_SIZE;
+		const int max_region_x = std::min(Map.Info.MapWidths[z] - 1, origin.x + range) / OBSTACLE_SIGHT_REGION_SIZE;
+		const int min_region_y = std::max(0, origin.y - range) / OBSTACLE_SIGHT_REGION_SIZE;
+		const int max_region_y = std::min(Map.Info.MapHeights[z] - 1, origin.y + range) / OBSTACLE_SIGHT_REGION_SIZE;
+		bool changed = false;
+		for (int region_y = min_region_y; region_y <= max_region_y && !changed; ++region_y) {
+			for (int region_x = min_region_x; region_x <= max_region_x; ++region_x) {
+				if (region_versions[region_y * regions_per_row + region_x] > sight.Stamp) {
+					changed = true;
+					break;
+				}
+			}
+		}
+		if (!changed) {
+			return sight.Visible;
+		}
+	}
+	
+	CalculateObstacleSight(origin, range, z, sight.Visible);
+	sight.Stamp = ObstacleSightVersion;
+	return sight.Visible;
+}
+
+/**
+**  Get the tiles visible from each of the tiles of a unit, when sight is blocked by obstacles.
+**
+**  @param pos     Location of the unit.
+**  @param w       Width of the unit, in square.
+**  @param h       Height of the unit, in square.
+**  @param range   Range of the sight from each of the unit's tiles.
+**  @param sights  Filled with the sight of each of the unit's tiles, in rows.
+*/
+static void GetObstacleSights(const Vec2i &pos, int w, int h, int range, int z, std::vector<const std::vector<unsigned char> *> &sights)
+{
+	if (ObstacleSightCache.size() >= OBSTACLE_SIGHT_CACHE_MAX_SIZE) {
+		ObstacleSightCache.clear();
+	}
+	
+	for (int y = 0; y < h; ++y) {
+		for (int x = 0; x < w; ++x) {
+			sights.push_back(&GetObstacleSight(pos + Vec2i(x, y), range, z));
+		}
+	}
+}
+
+/**
+**  Check whether a tile is visible from any of the tiles of a unit, when sight is blocked by obstacles.
+*/
+static bool IsTileInObstacleSight(const std::vector<const std::vector<unsigned char> *> &sights, const Vec2i &pos, int w, int h, int range, const Vec2i &mpos)
+{
+	const int size = range * 2 + 1;
+	for (int y = 0; y < h; ++y) {
+		for (int x = 0; x < w; ++x) {
+			const Vec2i offset = mpos - (pos + Vec2i(x, y));
+			if (abs(offset.x) <= range && abs(offset.y) <= range && (*sights[y * w + x])[(offset.y + range) * size + offset.x + range]) {
+				return true;
+			}
+		}
+	}
+	return false;
+}
+
+/**
+**  Notify the obstacle sight cache that whether a tile blocks sight may have changed.
+**
+**  @param pos  Location of the tile.
+*/
+void MapSightTileChanged(const Vec2i &pos, int z)
+{
+	if (z >= (int) ObstacleSightRegionVersions.size() || ObstacleSightRegionVersions[z].empty()) { // no sight has been cached for the map layer
+		return;
+	}
+	const int regions_per_row = (Map.Info.MapWidths[z] + OBSTACLE_SIGHT_REGION_SIZE - 1) / OBSTACLE_SIGHT_REGION_SIZE;
+	ObstacleSightRegionVersions[z][(pos.y / OBSTACLE_SIGHT_REGION_SIZE) * regions_per_row + pos.x / OBSTACLE_SIGHT_REGION_SIZE] = ++ObstacleSightVersion;
+}
 //Wyrmgus end
 
 /**
@@ -512,15 +887,17 @@ void MapSight(const CPlayer &player, const Vec2i &pos, int w, int h, int range,
 	}
 	
 	//Wyrmgus start
-	std::vector<unsigned long> obstacle_flags;
-	int max_obstacle_difference = 1; //how many tiles are seen after the obstacle; set to 1 here so that the obstacle tiles themselves don't have fog drawn over them
+	std::vector<const std::vector<unsigned char> *> obstacle_sights; //the tiles visible from each of the unit's tiles, if sight is blocked by obstacles
+	const int obstacle_sight_range = range + std::max(w, h) - 1; //the sight from each of the unit's tiles must cover the whole sight area
 	
 	if (marker == MapMarkTileOwnership || marker == MapUnmarkTileOwnership) {
 	} else {
 		if (Map.IsLayerUnderground(z)) {
-			obstacle_flags.push_back(MapFieldAirUnpassable);
+			GetObstacleSights(pos, w, h, obstacle_sight_range, z, obstacle_sights);
 		}
 	}
+	
+	const bool sight_span = obstacle_sights.empty() && IsSightSpanMarker(marker);
 	//Wyrmgus end
 	
 	// Up hemi-cyle
@@ -540,29 +917,16 @@ void MapSight(const CPlayer &player, const Vec2i &pos, int w, int h, int range,
 		const unsigned int index = mpos.y * Map.Info.MapWidths[z];
 		//Wyrmgus end
 #endif
+		//Wyrmgus start
+		if (sight_span) {
+			MapMarkerSightSpan(player, mpos, maxx - minx, marker, z);
+			continue;
+		}
+		//Wyrmgus end
 
 		for (mpos.x = minx; mpos.x < maxx; ++mpos.x) {
 			//Wyrmgus start
-			bool obstacle_check = true;
-			for (size_t i = 0; i < obstacle_flags.size(); ++i) {
-				bool obstacle_subcheck = false;
-				for (int x = 0; x < w; ++x) {
-					for (int y = 0; y < h; ++y) {
-						if (CheckObstaclesBetweenTiles(pos + Vec2i(x, y), mpos, obstacle_flags[i], z, max_obstacle_difference)) { //the obstacle must be avoidable from at least one of the unit's tiles
-							obstacle_subcheck = true;
-							break;
-						}
-					}
-					if (obstacle_subcheck) {
-						break;
-					}
-				}
-				if (!obstacle_subcheck) {
-					obstacle_check = false;
-					break;
-				}
-			}
-			if (!obstacle_check) {
+			if (!obstacle_sights.empty() && !IsTileInObstacleSight(obstacle_sights, pos, w, h, obstacle_sight_range, mpos)) { //the tile must be visible from at least one of the unit's tiles
 				continue;
 			}
 			//Wyrmgus end
@@ -597,29 +961,16 @@ void MapSight(const CPlayer &player, const Vec2i &pos, int w, int h, int range,
 		const unsigned int index = mpos.y * Map.Info.MapWidths[z];
 		//Wyrmgus end
 #endif
+		//Wyrmgus start
+		if (sight_span) {
+			MapMarkerSightSpan(player, mpos, maxx - minx, marker, z);
+			continue;
+		}
+		//Wyrmgus end
 
 		for (mpos.x = minx; mpos.x < maxx; ++mpos.x) {
 			//Wyrmgus start
-			bool obstacle_check = true;
-			for (size_t i = 0; i < obstacle_flags.size(); ++i) {
-				bool obstacle_subcheck = false;
-				for (int x = 0; x < w; ++x) {
-					for (int y = 0; y < h; ++y) {
-						if (CheckObstaclesBetweenTiles(pos + Vec2i(x, y), mpos, obstacle_flags[i], z, max_obstacle_difference)) { //the obstacle must be avoidable from at least one of the unit's tiles
-							obstacle_subcheck = true;
-							break;
-						}
-					}
-					if (obstacle_subcheck) {
-						break;
-					}
-				}
-				if (!obstacle_subcheck) {
-					obstacle_check = false;
-					break;
-				}
-			}
-			if (!obstacle_check) {
+			if (!obstacle_sights.empty() && !IsTileInObstacleSight(obstacle_sights, pos, w, h, obstacle_sight_range, mpos)) { //the tile must be visible from at least one of the unit's tiles
 				continue;
 			}
 			//Wyrmgus end
@@ -660,29 +1011,16 @@ void MapSight(const CPlayer &player, const Vec2i &pos, int w, int h, int range,
 		const unsigned int index = mpos.y * Map.Info.MapWidths[z];
 		//Wyrmgus end
 #endif
+		//Wyrmgus start
+		if (sight_span) {
+			MapMarkerSightSpan(player, mpos, maxx - minx, marker, z);
+			continue;
+		}
+		//Wyrmgus end
 
 		for (mpos.x = minx; mpos.x < maxx; ++mpos.x) {
 			//Wyrmgus start
-			bool obstacle_check = true;
-			for (size_t i = 0; i < obstacle_flags.size(); ++i) {
-				bool obstacle_subcheck = false;
-				for (int x = 0; x < w; ++x) {
-					for (int y = 0; y < h; ++y) {
-						if (CheckObstaclesBetweenTiles(pos + Vec2i(x, y), mpos, obstacle_flags[i], z, max_obstacle_difference)) { //the obstacle must be avoidable from at least one of the unit's tiles
-							obstacle_subcheck = true;
-							break;
-						}
-					}
-					if (obstacle_subcheck) {
-						break;
-					}
-				}
-				if (!obstacle_subcheck) {
-					obstacle_check = false;
-					break;
-				}
-			}
-			if (!obstacle_check) {
+			if (!obstacle_sights.empty() && !IsTileInObstacleSight(obstacle_sights, pos, w, h, obstacle_sight_range, mpos)) { //the tile must be visible from at least one of the unit's tiles
 				continue;
 			}
 			//Wyrmgus end
@@ -706,6 +1044,111 @@ void MapSight(const CPlayer &player, const Vec2i &pos, int w, int h, int range,
 	}
 }
 
+//Wyrmgus start
+/**
+**  Get how far a sight area extends horizontally beyond the unit, at a given vertical distance from it.
+**
+**  @param range     Sight range.
+**  @param distance  Vertical distance from the unit, 0 for the rows the unit occupies.
+*/
+static int GetSightRowHalfWidth(int range, int distance)
+{
+	if (range >= (int) SightRowHalfWidths.size()) {
+		SightRowHalfWidths.resize(range + 1);
+	}
+	std::vector<int> &half_widths = SightRowHalfWidths[range];
+	if (half_widths.empty()) {
+		half_widths.resize(range + 1);
+		half_widths[0] = range;
+		for (int i = 1; i <= range; ++i) {
+			half_widths[i] = isqrt(square(range + 1) - square(i) - 1);
+		}
+	}
+	return half_widths[distance];
+}
+
+/**
+**  Get the tiles of a map row which are within a sight area, as marked by MapSight.
+**
+**  @return  true if any tile of the row is within the sight area.
+*/
+static bool GetSightRowSpan(const Vec2i &pos, int w, int h, int range, int y, int z, int &minx, int &maxx)
+{
+	if (!range) {
+		return false;
+	}
+	
+	int distance = 0;
+	if (y < pos.y) {
+		distance = pos.y - y;
+	} else if (y >= pos.y + h) {
+		distance = y - (pos.y + h - 1);
+	}
+	if (distance > range) {
+		return false;
+	}
+	
+	const int half_width = GetSightRowHalfWidth(range, distance);
+	minx = std::max(0, pos.x - half_width);
+	maxx = std::min(Map.Info.MapWidths[z], pos.x + w + half_width);
+	return minx < maxx;
+}
+
+/**
+**  Mark the tiles of a sight area which are not within another sight area.
+**
+**  Used to update the sight of a unit which has moved by a tile, or whose
+**  sight range has changed, by only (un)marking the tiles which enter or
+**  leave its sight, instead of unmarking and marking again its whole
+**  sight area. Obstacles are not checked, so this must not be used for
+**  underground map layers.
+**
+**  @param player          player to mark the sight for (not unit owner)
+**  @param pos             location to mark
+**  @param w               width to mark, in square
+**  @param h               height to mark, in square
+**  @param range           Radius to mark.
+**  @param excluded_pos    location of the sight area whose tiles are not marked
+**  @param excluded_range  Radius of the sight area whose tiles are not marked.
+**  @param marker          Function to mark or unmark sight
+*/
+void MapSightDifference(const CPlayer &player, const Vec2i &pos, int w, int h, int range, const Vec2i &excluded_pos, int excluded_range, MapMarkerFunc *marker, int z)
+{
+	const int miny = std::max(0, pos.y - range);
+	const int maxy = std::min(Map.Info.MapHeights[z], pos.y + h + range);
+	
+	for (int y = miny; y < maxy; ++y) {
+		int minx;
+		int maxx;
+		if (!GetSightRowSpan(pos, w, h, range, y, z, minx, maxx)) {
+			continue;
+		}
+		int excluded_minx;
+		int excluded_maxx;
+		if (!GetSightRowSpan(excluded_pos, w, h, excluded_range, y, z, excluded_minx, excluded_maxx)) {
+			excluded_minx = maxx;
+			excluded_maxx = maxx;
+		}
+		Vec2i mpos(minx, y);
+#ifdef MARKER_ON_INDEX
+		const unsigned int index = mpos.y * Map.Info.MapWidths[z];
+#endif
+
+		for (mpos.x = minx; mpos.x < maxx; ++mpos.x) {
+			if (mpos.x >= excluded_minx && mpos.x < excluded_maxx) {
+				mpos.x = excluded_maxx - 1;
+				continue;
+			}
+#ifdef MARKER_ON_INDEX
+			marker(player, mpos.x + index, z);
+#else
+			marker(player, mpos, z);
+#endif
+		}
+	}
+}
+//Wyrmgus end
+
 /**
 **  Update fog of war.
 */
@@ -1041,6 +1484,10 @@ static void DrawFogOfWarTile(int sx, int sy, int dx, int dy)
 */
 void CViewport::DrawMapFogOfWar() const
 {
+	//Wyrmgus start
+	CRenderStageTimer render_stage_timer(RenderStageFog);
+	//Wyrmgus end
+
 	// flags must redraw or not
 	if (ReplayRevealMap) {
 		return;
@@ -1218,6 +1665,11 @@ void CMap::InitFogOfWar()
 void CMap::CleanFogOfWar()
 {
 	VisibleTable.clear();
+	//Wyrmgus start
+	ObstacleSightCache.clear();
+	ObstacleSightRegionVersions.clear();
+	ObstacleSightVersion = 0;
+	//Wyrmgus end
 
 	CGraphic::Free(Map.FogGraphic);
 	FogGraphic = NULL;
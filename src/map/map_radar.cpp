@@ -49,31 +49,50 @@
 static inline unsigned char
 IsTileRadarVisible(const CPlayer &pradar, const CPlayer &punit, const CMapFieldPlayerInfo &mfp)
 {
-	if (mfp.RadarJammer[punit.Index]) {
+	//Wyrmgus start
+//	if (mfp.RadarJammer[punit.Index]) {
+	if (mfp.GetRadarJammer(punit.Index)) {
+	//Wyrmgus end
 		return 0;
 	}
 
 	int p = pradar.Index;
 	if (pradar.IsVisionSharing()) {
-		const unsigned char *const radar = mfp.Radar;
-		const unsigned char *const jamming = mfp.RadarJammer;
+		//Wyrmgus start
+//		const unsigned char *const radar = mfp.Radar;
+//		const unsigned char *const jamming = mfp.RadarJammer;
+		//Wyrmgus end
 		unsigned char radarvision = 0;
 		// Check jamming first, if we are jammed, exit
 		for (int i = 0; i < PlayerMax; ++i) {
 			if (i != p) {
-				if (jamming[i] > 0 && punit.IsBothSharedVision(Players[i])) {
+				//Wyrmgus start
+//				if (jamming[i] > 0 && punit.IsBothSharedVision(Players[i])) {
+				if (mfp.GetRadarJammer(i) > 0 && punit.IsBothSharedVision(Players[i])) {
+				//Wyrmgus end
 					// We are jammed, return nothing
 					return 0;
 				}
-				if (radar[i] > 0 && pradar.IsBothSharedVision(Players[i])) {
-					radarvision |= radar[i];
+				//Wyrmgus start
+//				if (radar[i] > 0 && pradar.IsBothSharedVision(Players[i])) {
+//					radarvision |= radar[i];
+				const unsigned char radar = mfp.GetRadar(i);
+				if (radar > 0 && pradar.IsBothSharedVision(Players[i])) {
+					radarvision |= radar;
+				//Wyrmgus end
 				}
 			}
 		}
 		// Can't exit until the end, as we might be jammed
-		return (radarvision | mfp.Radar[p]);
+		//Wyrmgus start
+//		return (radarvision | mfp.Radar[p]);
+		return (radarvision | mfp.GetRadar(p));
+		//Wyrmgus end
 	}
-	return mfp.Radar[p];
+	//Wyrmgus start
+//	return mfp.Radar[p];
+	return mfp.GetRadar(p);
+	//Wyrmgus end
 }
 
 
@@ -120,8 +139,9 @@ void MapMarkTileRadar(const CPlayer &player, const unsigned int index, int z)
 	//Wyrmgus start
 //	Assert(Map.Field(index)->playerInfo.Radar[player.Index] != 255);
 //	Map.Field(index)->playerInfo.Radar[player.Index]++;
-	Assert(Map.Field(index, z)->playerInfo.Radar[player.Index] != 255);
-	Map.Field(index, z)->playerInfo.Radar[player.Index]++;
+	CMapFieldPlayerInfo &mfp = Map.Field(index, z)->playerInfo;
+	Assert(mfp.GetRadar(player.Index) != 255);
+	mfp.SetRadar(player.Index, mfp.GetRadar(player.Index) + 1);
 	//Wyrmgus end
 }
 
@@ -154,11 +174,15 @@ void MapUnmarkTileRadar(const CPlayer &player, const unsigned int index, int z)
 	// Reduce radar coverage if it exists.
 	//Wyrmgus start
 //	unsigned char *v = &(Map.Field(index)->playerInfo.Radar[player.Index]);
-	unsigned char *v = &(Map.Field(index, z)->playerInfo.Radar[player.Index]);
-	//Wyrmgus end
-	if (*v) {
-		--*v;
+//	if (*v) {
+//		--*v;
+//	}
+	CMapFieldPlayerInfo &mfp = Map.Field(index, z)->playerInfo;
+	const unsigned char v = mfp.GetRadar(player.Index);
+	if (v) {
+		mfp.SetRadar(player.Index, v - 1);
 	}
+	//Wyrmgus end
 }
 
 //Wyrmgus start
@@ -190,8 +214,9 @@ void MapMarkTileRadarJammer(const CPlayer &player, const unsigned int index, int
 	//Wyrmgus start
 //	Assert(Map.Field(index)->playerInfo.RadarJammer[player.Index] != 255);
 //	Map.Field(index)->playerInfo.RadarJammer[player.Index]++;
-	Assert(Map.Field(index, z)->playerInfo.RadarJammer[player.Index] != 255);
-	Map.Field(index, z)->playerInfo.RadarJammer[player.Index]++;
+	CMapFieldPlayerInfo &mfp = Map.Field(index, z)->playerInfo;
+	Assert(mfp.GetRadarJammer(player.Index) != 255);
+	mfp.SetRadarJammer(player.Index, mfp.GetRadarJammer(player.Index) + 1);
 	//Wyrmgus end
 }
 
@@ -223,11 +248,15 @@ void MapUnmarkTileRadarJammer(const CPlayer &player, const unsigned int index, i
 	// Reduce radar coverage if it exists.
 	//Wyrmgus start
 //	unsigned char *v = &(Map.Field(index)->playerInfo.RadarJammer[player.Index]);
-	unsigned char *v = &(Map.Field(index, z)->playerInfo.RadarJammer[player.Index]);
-	//Wyrmgus end
-	if (*v) {
-		--*v;
+//	if (*v) {
+//		--*v;
+//	}
+	CMapFieldPlayerInfo &mfp = Map.Field(index, z)->playerInfo;
+	const unsigned char v = mfp.GetRadarJammer(player.Index);
+	if (v) {
+		mfp.SetRadarJammer(player.Index, v - 1);
 	}
+	//Wyrmgus end
 }
 
 //Wyrmgus start
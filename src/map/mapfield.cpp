@@ -384,7 +384,10 @@ void CMapField::Save(CFile &file) const
 	}
 	//Wyrmgus end
 	for (int i = 0; i != PlayerMax; ++i) {
-		if (playerInfo.Visible[i] == 1) {
+		//Wyrmgus start
+//		if (playerInfo.Visible[i] == 1) {
+		if (playerInfo.GetVisible(i) == 1) {
+		//Wyrmgus end
 			file.printf(", \"explored\", %d", i);
 		}
 	}
@@ -569,7 +572,10 @@ void CMapField::parse(lua_State *l)
 		} else if (!strcmp(value, "explored")) {
 		//Wyrmgus end
 			++j;
-			this->playerInfo.Visible[LuaToNumber(l, -1, j + 1)] = 1;
+			//Wyrmgus start
+//			this->playerInfo.Visible[LuaToNumber(l, -1, j + 1)] = 1;
+			this->playerInfo.SetVisible(LuaToNumber(l, -1, j + 1), 1);
+			//Wyrmgus end
 		} else if (!strcmp(value, "human")) {
 			this->Flags |= MapFieldHuman;
 		} else if (!strcmp(value, "land")) {
@@ -695,6 +701,26 @@ bool CMapField::isAOrcWall() const
 */
 //Wyrmgus end
 
+//Wyrmgus start
+//
+//  CMapFieldVisibilityPlane
+//
+
+/**
+**  Get the number of bytes allocated for the visibility counters of the plane.
+*/
+size_t CMapFieldVisibilityPlane::GetMemoryUsage() const
+{
+	size_t bytes = 0;
+	for (int i = 0; i < PlayerMax; ++i) {
+		bytes += Visible[i].capacity() * sizeof(unsigned short);
+		bytes += VisCloak[i].capacity() + VisEthereal[i].capacity() + Radar[i].capacity() + RadarJammer[i].capacity();
+	}
+	bytes += (ExploredMask.capacity() + VisibleMask.capacity()) * sizeof(unsigned int);
+	return bytes;
+}
+//Wyrmgus end
+
 //
 //  CMapFieldPlayerInfo
 //
@@ -704,26 +730,36 @@ unsigned char CMapFieldPlayerInfo::TeamVisibilityState(const CPlayer &player) co
 	if (IsVisible(player)) {
 		return 2;
 	}
+	//Wyrmgus start
+	/*
 	unsigned char maxVision = 0;
 	if (IsExplored(player)) {
 		maxVision = 1;
 	}
 	for (int i = 0; i != PlayerMax ; ++i) {
-		//Wyrmgus start
 //		if (player.IsBothSharedVision(Players[i])) {
 		if (player.IsBothSharedVision(Players[i]) || Players[i].Revealed) {
-		//Wyrmgus end
-			//Wyrmgus start
-			if (Players[i].Revealed && !player.IsBothSharedVision(Players[i]) && Visible[i] < 2) { //don't show a revealed player's explored tiles, only the currently visible ones
+			if (Players[i].Revealed && !player.IsBothSharedVision(Players[i]) && GetVisible(i) < 2) { //don't show a revealed player's explored tiles, only the currently visible ones
 				continue;
 			}
-			//Wyrmgus end
-			maxVision = std::max<unsigned char>(maxVision, Visible[i]);
+//			maxVision = std::max<unsigned char>(maxVision, Visible[i]);
+			maxVision = std::max<unsigned char>(maxVision, GetVisible(i));
 			if (maxVision >= 2) {
 				return 2;
 			}
 		}
 	}
+	*/
+	const unsigned int shared_vision_mask = GetMutualSharedVisionMask(player);
+	if (VisibilityPlane->VisibleMask[PlaneIndex] & (shared_vision_mask | GetRevealedPlayersMask())) {
+		return 2;
+	}
+	//don't show a revealed player's explored tiles, only the currently visible ones
+	unsigned char maxVision = 0;
+	if (VisibilityPlane->ExploredMask[PlaneIndex] & ((1 << player.Index) | shared_vision_mask)) {
+		maxVision = 1;
+	}
+	//Wyrmgus end
 	if (maxVision == 1 && Map.NoFogOfWar) {
 		return 2;
 	}
@@ -732,20 +768,26 @@ unsigned char CMapFieldPlayerInfo::TeamVisibilityState(const CPlayer &player) co
 
 bool CMapFieldPlayerInfo::IsExplored(const CPlayer &player) const
 {
-	return Visible[player.Index] != 0;
+	//Wyrmgus start
+//	return Visible[player.Index] != 0;
+	return GetVisible(player.Index) != 0;
+	//Wyrmgus end
 }
 
 //Wyrmgus start
 bool CMapFieldPlayerInfo::IsTeamExplored(const CPlayer &player) const
 {
-	return Visible[player.Index] != 0 || TeamVisibilityState(player) != 0;
+	return GetVisible(player.Index) != 0 || TeamVisibilityState(player) != 0;
 }
 //Wyrmgus end
 
 bool CMapFieldPlayerInfo::IsVisible(const CPlayer &player) const
 {
 	const bool fogOfWar = !Map.NoFogOfWar;
-	return Visible[player.Index] >= 2 || (!fogOfWar && IsExplored(player));
+	//Wyrmgus start
+//	return Visible[player.Index] >= 2 || (!fogOfWar && IsExplored(player));
+	return GetVisible(player.Index) >= 2 || (!fogOfWar && IsExplored(player));
+	//Wyrmgus end
 }
 
 bool CMapFieldPlayerInfo::IsTeamVisible(const CPlayer &player) const
@@ -67,6 +67,11 @@
 
 #define SCALE_PRECISION 100
 
+//Wyrmgus start
+#define MINIMAP_CELL_SIZE 8	/// the size in pixels of the cells in which the minimap is composited again
+#define MINIMAP_DOT_RECHECK_SLOTS 64	/// the number of unit slots whose minimap dots are checked again on each update regardless of changes
+//Wyrmgus end
+
 
 /*----------------------------------------------------------------------------
 --  Variables
@@ -127,6 +132,57 @@ struct MinimapEvent {
 } MinimapEvents[MAX_MINIMAP_EVENTS];
 int NumMinimapEvents;
 
+//Wyrmgus start
+/**
+**  The dot drawn for a unit on the minimap
+*/
+class CMinimapUnitDot
+{
+public:
+	CMinimapUnitDot() : X(0), Y(0), W(0), H(0), Color(0), Shown(false), Blinking(false), Queued(false), ShownIndex(-1)
+	{
+	}
+	
+	bool IsSameDot(const CMinimapUnitDot &other) const
+	{
+		return this->X == other.X && this->Y == other.Y && this->W == other.W && this->H == other.H && this->Color == other.Color;
+	}
+
+	int X;						/// left pixel of the dot
+	int Y;						/// top pixel of the dot
+	int W;						/// width of the dot in pixels
+	int H;						/// height of the dot in pixels
+	Uint32 Color;				/// color of the dot
+	bool Shown;					/// whether the dot is currently drawn on the minimap
+	bool Blinking;				/// whether the dot blinks because its unit was attacked, and so must be checked again on each update
+	bool Queued;				/// whether the dot's unit slot is in the list of dots to check on the next update
+	int ShownIndex;				/// the index of the dot's unit slot in the list of drawn dots, if it is drawn
+};
+
+static std::vector<std::vector<unsigned char>> MinimapCellDirty;	/// whether each cell of the minimap must be composited again, for each map layer
+static std::vector<std::vector<int>> MinimapDirtyCells;				/// the cells of the minimap which must be composited again, for each map layer
+#if defined(USE_OPENGL) || defined(USE_GLES)
+static std::vector<bool> MinimapTextureDirty;						/// whether the minimap surface has changed since it was last uploaded to its texture, for each map layer
+#endif
+
+static std::vector<CMinimapUnitDot> MinimapUnitDots;	/// the dot last drawn for each unit slot
+static std::vector<int> MinimapShownDotSlots;			/// the unit slots whose dots are drawn, in drawing order
+static std::vector<int> MinimapQueuedDotSlots;			/// the unit slots whose dots must be checked on the next update
+static std::vector<int> MinimapSelectedDotSlots;		/// the unit slots which were selected when their dots were last checked
+static unsigned int MinimapDotRecheckSlot = 0;			/// the next unit slot to be checked by the rolling recheck of the dots
+static bool MinimapDotsChanged = true;					/// whether the dots of all units must be checked on the next update
+static int MinimapDotMapLayer = -1;						/// the map layer on which the unit dots are drawn
+static bool MinimapDotShowSelected = false;				/// whether the selected units were shown when the dots were last checked
+static bool MinimapDotEditorRunning = false;			/// whether the editor was running when the dots were last checked
+static std::vector<IntColor> MinimapDotPlayerColors;	/// the colors of the players when the dots were last checked
+
+static const CPlayer *MinimapVisionPlayer = NULL;		/// the player whose vision the minimap fog was composited for
+static unsigned int MinimapVisionPlayersMask = 0;		/// the players sharing vision with that player or revealed when the minimap fog was composited
+static bool MinimapVisionRevealMap = false;				/// whether the map was revealed when the minimap fog was composited
+static bool MinimapVisionNoFogOfWar = false;			/// whether there was no fog of war when the minimap fog was composited
+static bool MinimapVisionWithTerrain = false;			/// whether the minimap was composited with terrain
+//Wyrmgus end
+
 
 /*----------------------------------------------------------------------------
 -- Functions
@@ -164,6 +220,61 @@ static void CreateMinimapTexture(int z)
 }
 #endif
 
+//Wyrmgus start
+/**
+**  Mark a rectangle of the minimap as needing to be composited again
+**
+**  @param z  The map layer of the minimap.
+**  @param x  The left pixel of the rectangle.
+**  @param y  The top pixel of the rectangle.
+**  @param w  The width of the rectangle.
+**  @param h  The height of the rectangle.
+*/
+static void MarkMinimapRectDirty(int z, int x, int y, int w, int h)
+{
+	if (z < 0 || z >= (int) MinimapCellDirty.size()) {
+		return;
+	}
+	
+	const int min_x = std::max(0, x);
+	const int min_y = std::max(0, y);
+	const int max_x = std::min(UI.Minimap.W, x + w) - 1;
+	const int max_y = std::min(UI.Minimap.H, y + h) - 1;
+	if (max_x < min_x || max_y < min_y) {
+		return;
+	}
+	
+	const int cells_x = (UI.Minimap.W + MINIMAP_CELL_SIZE - 1) / MINIMAP_CELL_SIZE;
+	for (int cell_y = min_y / MINIMAP_CELL_SIZE; cell_y <= max_y / MINIMAP_CELL_SIZE; ++cell_y) {
+		for (int cell_x = min_x / MINIMAP_CELL_SIZE; cell_x <= max_x / MINIMAP_CELL_SIZE; ++cell_x) {
+			const int cell = cell_x + cell_y * cells_x;
+			if (!MinimapCellDirty[z][cell]) {
+				MinimapCellDirty[z][cell] = 1;
+				MinimapDirtyCells[z].push_back(cell);
+			}
+		}
+	}
+}
+
+/**
+**  Mark the minimap pixels of a map tile as needing to be composited again
+**
+**  @param pos  The map position of the tile.
+**  @param z    The map layer of the tile.
+*/
+static void MarkMinimapTileDirty(const Vec2i &pos, int z)
+{
+	if (z < 0 || z >= (int) MinimapCellDirty.size() || !Map.Info.IsPointOnMap(pos, z)) {
+		return;
+	}
+	
+	// include a pixel of margin, as the conversion tables round the pixel positions of tiles
+	const int x = UI.Minimap.XOffset[z] + Map2MinimapX[z][pos.x] - 1;
+	const int y = UI.Minimap.YOffset[z] + Map2MinimapY[z][pos.y] - 1;
+	MarkMinimapRectDirty(z, x, y, MinimapScaleX[z] / MINIMAP_FAC + 3, MinimapScaleY[z] / MINIMAP_FAC + 3);
+}
+//Wyrmgus end
+
 /**
 **  Create a mini-map from the tiles of the map.
 **
@@ -296,6 +407,22 @@ void CMinimap::Create()
 
 		UpdateTerrain(z);
 	}
+	
+	const int cell_count = ((W + MINIMAP_CELL_SIZE - 1) / MINIMAP_CELL_SIZE) * ((H + MINIMAP_CELL_SIZE - 1) / MINIMAP_CELL_SIZE);
+	MinimapCellDirty.assign(Map.Fields.size(), std::vector<unsigned char>(cell_count, 0));
+	MinimapDirtyCells.assign(Map.Fields.size(), std::vector<int>());
+#if defined(USE_OPENGL) || defined(USE_GLES)
+	MinimapTextureDirty.assign(Map.Fields.size(), true);
+#endif
+	for (size_t z = 0; z < Map.Fields.size(); ++z) {
+		MarkMinimapRectDirty(z, 0, 0, W, H);
+	}
+	MinimapUnitDots.clear();
+	MinimapShownDotSlots.clear();
+	MinimapQueuedDotSlots.clear();
+	MinimapSelectedDotSlots.clear();
+	MinimapDotsChanged = true;
+	MinimapDotMapLayer = -1;
 	//Wyrmgus end
 
 	NumMinimapEvents = 0;
@@ -806,11 +933,56 @@ void CMinimap::UpdateXY(const Vec2i &pos, int z)
 		}
 	}
 	//Wyrmgus end
+	
+	//Wyrmgus start
+	MarkMinimapTileDirty(pos, z);
+	//Wyrmgus end
+}
+
+//Wyrmgus start
+/**
+**  Update the minimap fog of a single tile after its visibility changed
+**
+**  @param pos  The map position to update in the minimap
+**  @param z    The map layer of the position
+*/
+void CMinimap::UpdateFogXY(const Vec2i &pos, int z)
+{
+	MarkMinimapTileDirty(pos, z);
+	
+	// whether the units on the tile are shown depends on its visibility
+	const CUnitCache &cache = Map.Field(pos, z)->UnitCache;
+	for (size_t i = 0; i < cache.size(); ++i) {
+		this->UpdateUnitDot(*cache[i]);
+	}
+}
+
+/**
+**  Mark the dot of a unit as needing to be checked on the next update of
+**  the minimap. Called when the unit is placed, moved or removed, changes
+**  owner, is attacked, or goes under or out of the fog of war.
+*/
+void CMinimap::UpdateUnitDot(const CUnit &unit)
+{
+	const int slot = UnitNumber(unit);
+	if (slot < 0) {
+		return;
+	}
+	if (slot >= (int) MinimapUnitDots.size()) {
+		MinimapUnitDots.resize(slot + 1);
+	}
+	if (!MinimapUnitDots[slot].Queued) {
+		MinimapUnitDots[slot].Queued = true;
+		MinimapQueuedDotSlots.push_back(slot);
+	}
 }
+//Wyrmgus end
 
 /**
 **  Draw a unit on the minimap.
 */
+//Wyrmgus start
+/*
 static void DrawUnitOn(CUnit &unit, int red_phase)
 {
 	const CUnitType *type;
@@ -913,12 +1085,230 @@ static void DrawUnitOn(CUnit &unit, int red_phase)
 		}
 	}
 }
+*/
+
+/**
+**  Get the dot of a unit on the minimap.
+**
+**  @return  False if the unit is not drawn on the minimap.
+*/
+static bool GetUnitDot(const CUnit &unit, int red_phase, CMinimapUnitDot &dot)
+{
+	const CUnitType *type;
+
+	if (Editor.Running || ReplayRevealMap || unit.IsVisible(*ThisPlayer)) {
+		type = unit.Type;
+	} else {
+		type = unit.Seen.Type;
+		// This will happen for radar if the unit has not been seen and we
+		// have it on radar.
+		if (!type) {
+			type = unit.Type;
+		}
+	}
+
+	//don't draw decorations or diminutive fauna units on the minimap
+	if (type->BoolFlag[DECORATION_INDEX].value || (type->BoolFlag[DIMINUTIVE_INDEX].value && type->BoolFlag[FAUNA_INDEX].value)) {
+		return false;
+	}
+
+	dot.Blinking = false;
+	if (unit.GetDisplayPlayer() == PlayerNumNeutral) {
+		dot.Color = Video.MapRGB(TheScreen->format, type->NeutralMinimapColorRGB);
+	} else if (unit.Player == ThisPlayer && !Editor.Running) {
+		dot.Blinking = unit.Attacked && unit.Attacked + ATTACK_BLINK_DURATION > GameCycle;
+		if (dot.Blinking && (red_phase || unit.Attacked + ATTACK_RED_DURATION > GameCycle)) {
+			dot.Color = ColorRed;
+		} else if (UI.Minimap.ShowSelected && unit.Selected) {
+			dot.Color = ColorWhite;
+		} else {
+			dot.Color = ColorGreen;
+		}
+	} else {
+		dot.Color = unit.Player->Color;
+	}
+
+	// the dot covers the unit's tiles, plus one pixel to the left and top
+	dot.X = UI.Minimap.XOffset[CurrentMapLayer] + Map2MinimapX[CurrentMapLayer][unit.tilePos.x];
+	dot.Y = UI.Minimap.YOffset[CurrentMapLayer] + Map2MinimapY[CurrentMapLayer][unit.tilePos.y];
+	dot.W = std::min(Map2MinimapX[CurrentMapLayer][type->TileWidth] + 1, UI.Minimap.W - dot.X);
+	dot.H = std::min(Map2MinimapY[CurrentMapLayer][type->TileHeight] + 1, UI.Minimap.H - dot.Y);
+	return true;
+}
+
+/**
+**  Set the color of a pixel of the minimap surface of the current map layer.
+*/
+static inline void SetMinimapPixel(int mx, int my, Uint32 color, int bpp)
+{
+#if defined(USE_OPENGL) || defined(USE_GLES)
+	if (UseOpenGL) {
+		*(Uint32 *)&(MinimapSurfaceGL[CurrentMapLayer][(mx + my * MinimapTextureWidth[CurrentMapLayer]) * 4]) = color;
+	} else
+#endif
+	{
+		const unsigned int index = mx * bpp + my * MinimapSurface[CurrentMapLayer]->pitch;
+		if (bpp == 2) {
+			*(Uint16 *)&((Uint8 *)MinimapSurface[CurrentMapLayer]->pixels)[index] = color;
+		} else {
+			*(Uint32 *)&((Uint8 *)MinimapSurface[CurrentMapLayer]->pixels)[index] = color;
+		}
+	}
+}
+
+/**
+**  Draw a unit dot on the minimap, in the cells which are being composited again.
+*/
+static void DrawUnitDot(const CMinimapUnitDot &dot, int bpp)
+{
+	const std::vector<unsigned char> &cell_dirty = MinimapCellDirty[CurrentMapLayer];
+	const int cells_x = (UI.Minimap.W + MINIMAP_CELL_SIZE - 1) / MINIMAP_CELL_SIZE;
+
+	for (int my = dot.Y; my < dot.Y + dot.H; ++my) {
+		const unsigned char *cell_row = &cell_dirty[(my / MINIMAP_CELL_SIZE) * cells_x];
+		for (int mx = dot.X; mx < dot.X + dot.W; ++mx) {
+			if (cell_row[mx / MINIMAP_CELL_SIZE]) {
+				SetMinimapPixel(mx, my, dot.Color, bpp);
+			}
+		}
+	}
+}
+
+/**
+**  Check the minimap dot of a unit slot, marking the cells of the old and
+**  new dot as needing to be composited again if the dot changed.
+*/
+static void CheckUnitDot(int slot, int red_phase)
+{
+	const int z = CurrentMapLayer;
+	const CUnit &unit = UnitManager.GetSlotUnit(slot);
+	CMinimapUnitDot &old_dot = MinimapUnitDots[slot];
+	
+	// released slots have no type
+	CMinimapUnitDot dot;
+	dot.Shown = unit.Type != NULL && unit.MapLayer == z && unit.IsVisibleOnMinimap() && GetUnitDot(unit, red_phase, dot);
+	
+	old_dot.Blinking = dot.Shown && dot.Blinking;
+	if (old_dot.Shown == dot.Shown && (!dot.Shown || dot.IsSameDot(old_dot))) {
+		return;
+	}
+	
+	if (old_dot.Shown) {
+		MarkMinimapRectDirty(z, old_dot.X, old_dot.Y, old_dot.W, old_dot.H);
+		if (!dot.Shown) {
+			// the last drawn dot takes the place of this one, and so is now drawn earlier
+			const int last_slot = MinimapShownDotSlots.back();
+			CMinimapUnitDot &last_dot = MinimapUnitDots[last_slot];
+			MinimapShownDotSlots[old_dot.ShownIndex] = last_slot;
+			last_dot.ShownIndex = old_dot.ShownIndex;
+			MinimapShownDotSlots.pop_back();
+			old_dot.ShownIndex = -1;
+			MarkMinimapRectDirty(z, last_dot.X, last_dot.Y, last_dot.W, last_dot.H);
+		}
+	} else {
+		old_dot.ShownIndex = MinimapShownDotSlots.size();
+		MinimapShownDotSlots.push_back(slot);
+	}
+	if (dot.Shown) {
+		MarkMinimapRectDirty(z, dot.X, dot.Y, dot.W, dot.H);
+	}
+	
+	old_dot.X = dot.X;
+	old_dot.Y = dot.Y;
+	old_dot.W = dot.W;
+	old_dot.H = dot.H;
+	old_dot.Color = dot.Color;
+	old_dot.Shown = dot.Shown;
+}
+
+/**
+**  Check the minimap dots of the units which changed since the last update.
+**
+**  The dots are checked when their unit is placed, moved or removed, changes
+**  owner, is attacked, or goes under or out of the fog of war, and on each
+**  update while they blink or their unit is or was selected. The dots of all
+**  units are only checked again when the layer, vision, editor mode or player
+**  colors change. A few slots are also checked again on each update, so that
+**  the rarer changes of how units are shown (e.g. becoming invisible) still
+**  reach the minimap.
+*/
+static void UpdateUnitDots(int red_phase)
+{
+	const unsigned int slot_count = UnitManager.GetUsedSlotCount();
+	if (slot_count > MinimapUnitDots.size()) {
+		MinimapUnitDots.resize(slot_count);
+	}
+	
+	bool player_colors_changed = MinimapDotPlayerColors.size() != (size_t) PlayerMax;
+	for (int p = 0; p < PlayerMax && !player_colors_changed; ++p) {
+		player_colors_changed = MinimapDotPlayerColors[p] != Players[p].Color;
+	}
+	if (player_colors_changed) {
+		MinimapDotPlayerColors.resize(PlayerMax);
+		for (int p = 0; p < PlayerMax; ++p) {
+			MinimapDotPlayerColors[p] = Players[p].Color;
+		}
+	}
+	
+	if (MinimapDotsChanged || player_colors_changed || MinimapDotShowSelected != UI.Minimap.ShowSelected || MinimapDotEditorRunning != Editor.Running) {
+		MinimapDotsChanged = false;
+		MinimapDotShowSelected = UI.Minimap.ShowSelected;
+		MinimapDotEditorRunning = Editor.Running;
+		for (size_t i = 0; i < MinimapQueuedDotSlots.size(); ++i) {
+			MinimapUnitDots[MinimapQueuedDotSlots[i]].Queued = false;
+		}
+		MinimapQueuedDotSlots.clear();
+		for (unsigned int slot = 0; slot < slot_count; ++slot) {
+			CheckUnitDot(slot, red_phase);
+		}
+		return;
+	}
+	
+	// the selection changes without going through the map, so the dots of the units which are or were selected are checked again
+	for (size_t i = 0; i < MinimapSelectedDotSlots.size(); ++i) {
+		UI.Minimap.UpdateUnitDot(UnitManager.GetSlotUnit(MinimapSelectedDotSlots[i]));
+	}
+	MinimapSelectedDotSlots.clear();
+	if (UI.Minimap.ShowSelected) {
+		for (size_t i = 0; i < Selected.size(); ++i) {
+			MinimapSelectedDotSlots.push_back(UnitNumber(*Selected[i]));
+			UI.Minimap.UpdateUnitDot(*Selected[i]);
+		}
+	}
+	
+	for (size_t i = 0; i < MinimapShownDotSlots.size(); ++i) {
+		if (MinimapUnitDots[MinimapShownDotSlots[i]].Blinking) {
+			UI.Minimap.UpdateUnitDot(UnitManager.GetSlotUnit(MinimapShownDotSlots[i]));
+		}
+	}
+	
+	for (unsigned int i = 0; i < MINIMAP_DOT_RECHECK_SLOTS && i < slot_count; ++i) {
+		if (MinimapDotRecheckSlot >= slot_count) {
+			MinimapDotRecheckSlot = 0;
+		}
+		UI.Minimap.UpdateUnitDot(UnitManager.GetSlotUnit(MinimapDotRecheckSlot++));
+	}
+	
+	for (size_t i = 0; i < MinimapQueuedDotSlots.size(); ++i) {
+		const int slot = MinimapQueuedDotSlots[i];
+		MinimapUnitDots[slot].Queued = false;
+		CheckUnitDot(slot, red_phase);
+	}
+	MinimapQueuedDotSlots.clear();
+}
+//Wyrmgus end
 
 /**
 **  Update the minimap with the current game information
 */
+//Wyrmgus start
+/*
 void CMinimap::Update()
 {
+	//Wyrmgus start
+	CRenderStageTimer render_stage_timer(RenderStageMinimap);
+	//Wyrmgus end
+
 	static int red_phase;
 
 	int red_phase_changed = red_phase != (int)((FrameCounter / FRAMES_PER_SECOND) & 1);
@@ -1091,6 +1481,166 @@ void CMinimap::Update()
 		//Wyrmgus end
 	}
 }
+*/
+void CMinimap::Update()
+{
+	CRenderStageTimer render_stage_timer(RenderStageMinimap);
+
+	static int red_phase;
+
+	int red_phase_changed = red_phase != (int)((FrameCounter / FRAMES_PER_SECOND) & 1);
+	if (red_phase_changed) {
+		red_phase = !red_phase;
+	}
+	
+	const int z = CurrentMapLayer;
+	if (z < 0 || z >= (int) MinimapCellDirty.size()) {
+		return;
+	}
+	
+	// switching map layers or changing whose vision is shown requires compositing the whole minimap again
+	if (MinimapDotMapLayer != z) {
+		for (size_t i = 0; i < MinimapShownDotSlots.size(); ++i) {
+			MinimapUnitDots[MinimapShownDotSlots[i]].Shown = false;
+			MinimapUnitDots[MinimapShownDotSlots[i]].ShownIndex = -1;
+		}
+		MinimapShownDotSlots.clear();
+		MinimapDotsChanged = true;
+		if (MinimapDotMapLayer >= 0) {
+			MarkMinimapRectDirty(MinimapDotMapLayer, 0, 0, W, H);
+		}
+		MinimapDotMapLayer = z;
+		MarkMinimapRectDirty(z, 0, 0, W, H);
+	}
+	
+	const unsigned int vision_players_mask = ThisPlayer ? (GetMutualSharedVisionMask(*ThisPlayer) | GetRevealedPlayersMask()) : 0;
+	if (MinimapVisionPlayer != ThisPlayer || MinimapVisionPlayersMask != vision_players_mask || MinimapVisionRevealMap != (ReplayRevealMap != 0) || MinimapVisionNoFogOfWar != Map.NoFogOfWar || MinimapVisionWithTerrain != WithTerrain) {
+		MinimapVisionPlayer = ThisPlayer;
+		MinimapVisionPlayersMask = vision_players_mask;
+		MinimapVisionRevealMap = ReplayRevealMap != 0;
+		MinimapVisionNoFogOfWar = Map.NoFogOfWar;
+		MinimapVisionWithTerrain = WithTerrain;
+		MarkMinimapRectDirty(z, 0, 0, W, H);
+		MinimapDotsChanged = true;
+	}
+	
+	UpdateUnitDots(red_phase);
+	
+	std::vector<int> &dirty_cells = MinimapDirtyCells[z];
+	if (dirty_cells.empty()) {
+		return;
+	}
+	
+	const int cells_x = (W + MINIMAP_CELL_SIZE - 1) / MINIMAP_CELL_SIZE;
+
+	int bpp;
+	Uint32 black;
+#if defined(USE_OPENGL) || defined(USE_GLES)
+	if (UseOpenGL) {
+		bpp = 0;
+		black = Video.MapRGB(0, 0, 0, 0);
+	} else
+#endif
+	{
+		bpp = MinimapSurface[z]->format->BytesPerPixel;
+		black = ColorBlack;
+	}
+
+	//
+	// Restore the background and terrain of the changed cells
+	//
+	for (size_t i = 0; i < dirty_cells.size(); ++i) {
+		const int cell_x = (dirty_cells[i] % cells_x) * MINIMAP_CELL_SIZE;
+		const int cell_y = (dirty_cells[i] / cells_x) * MINIMAP_CELL_SIZE;
+		const int cell_w = std::min(MINIMAP_CELL_SIZE, W - cell_x);
+		const int cell_h = std::min(MINIMAP_CELL_SIZE, H - cell_y);
+		
+#if defined(USE_OPENGL) || defined(USE_GLES)
+		if (UseOpenGL) {
+			for (int my = cell_y; my < cell_y + cell_h; ++my) {
+				const int index = (cell_x + my * MinimapTextureWidth[z]) * 4;
+				if (WithTerrain) {
+					memcpy(&MinimapSurfaceGL[z][index], &MinimapTerrainSurfaceGL[z][index], cell_w * 4);
+				} else if (!Transparent) {
+					memset(&MinimapSurfaceGL[z][index], 0, cell_w * 4);
+				}
+			}
+		} else
+#endif
+		{
+			SDL_Rect rect = {Sint16(cell_x), Sint16(cell_y), Uint16(cell_w), Uint16(cell_h)};
+			if (!Transparent) {
+				SDL_FillRect(MinimapSurface[z], &rect, SDL_MapRGB(MinimapSurface[z]->format, 0, 0, 0));
+			}
+			if (WithTerrain) {
+				SDL_Rect drect = rect;
+				SDL_BlitSurface(MinimapTerrainSurface[z], &rect, MinimapSurface[z], &drect);
+			}
+		}
+	}
+
+#if defined(USE_OPENGL) || defined(USE_GLES)
+	if (!UseOpenGL)
+#endif
+	{
+		SDL_LockSurface(MinimapSurface[z]);
+	}
+
+	//
+	// Draw the fog of the changed cells
+	//
+	for (size_t i = 0; i < dirty_cells.size(); ++i) {
+		const int cell_x = (dirty_cells[i] % cells_x) * MINIMAP_CELL_SIZE;
+		const int cell_y = (dirty_cells[i] / cells_x) * MINIMAP_CELL_SIZE;
+		const int cell_w = std::min(MINIMAP_CELL_SIZE, W - cell_x);
+		const int cell_h = std::min(MINIMAP_CELL_SIZE, H - cell_y);
+		
+		for (int my = cell_y; my < cell_y + cell_h; ++my) {
+			for (int mx = cell_x; mx < cell_x + cell_w; ++mx) {
+				if (mx < XOffset[z] || mx >= W - XOffset[z] || my < YOffset[z] || my >= H - YOffset[z]) {
+					SetMinimapPixel(mx, my, black, bpp);
+					continue;
+				}
+				
+				int visiontype; // 0 unexplored, 1 explored, >1 visible.
+
+				if (ReplayRevealMap) {
+					visiontype = 2;
+				} else {
+					const Vec2i tilePos(Minimap2MapX[z][mx], Minimap2MapY[z][my] / Map.Info.MapWidths[z]);
+					visiontype = Map.Field(tilePos, z)->playerInfo.TeamVisibilityState(*ThisPlayer);
+				}
+
+				if (visiontype == 0 || (visiontype == 1 && ((mx & 1) != (my & 1)))) {
+					SetMinimapPixel(mx, my, black, bpp);
+				}
+			}
+		}
+	}
+
+	//
+	// Draw the units in the changed cells
+	//
+	for (size_t i = 0; i < MinimapShownDotSlots.size(); ++i) {
+		DrawUnitDot(MinimapUnitDots[MinimapShownDotSlots[i]], bpp);
+	}
+
+#if defined(USE_OPENGL) || defined(USE_GLES)
+	if (!UseOpenGL)
+#endif
+	{
+		SDL_UnlockSurface(MinimapSurface[z]);
+	}
+	
+	for (size_t i = 0; i < dirty_cells.size(); ++i) {
+		MinimapCellDirty[z][dirty_cells[i]] = 0;
+	}
+	dirty_cells.clear();
+#if defined(USE_OPENGL) || defined(USE_GLES)
+	MinimapTextureDirty[z] = true;
+#endif
+}
+//Wyrmgus end
 
 /**
 **  Draw the minimap events
@@ -1116,6 +1666,10 @@ static void DrawEvents()
 */
 void CMinimap::Draw() const
 {
+	//Wyrmgus start
+	CRenderStageTimer render_stage_timer(RenderStageMinimap);
+	//Wyrmgus end
+
 #if defined(USE_OPENGL) || defined(USE_GLES)
 	if (UseOpenGL) {
 		//Wyrmgus start
@@ -1125,8 +1679,12 @@ void CMinimap::Draw() const
 		//Wyrmgus start
 //		glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, MinimapTextureWidth, MinimapTextureHeight,
 //						GL_RGBA, GL_UNSIGNED_BYTE, MinimapSurfaceGL);
-		glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, MinimapTextureWidth[CurrentMapLayer], MinimapTextureHeight[CurrentMapLayer],
-						GL_RGBA, GL_UNSIGNED_BYTE, MinimapSurfaceGL[CurrentMapLayer]);
+		// only upload the minimap surface if it changed since the last upload
+		if (CurrentMapLayer < (int) MinimapTextureDirty.size() && MinimapTextureDirty[CurrentMapLayer]) {
+			glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, MinimapTextureWidth[CurrentMapLayer], MinimapTextureHeight[CurrentMapLayer],
+							GL_RGBA, GL_UNSIGNED_BYTE, MinimapSurfaceGL[CurrentMapLayer]);
+			MinimapTextureDirty[CurrentMapLayer] = false;
+		}
 		//Wyrmgus end
 
 #ifdef USE_GLES
@@ -1324,6 +1882,18 @@ void CMinimap::Destroy()
 	MinimapScaleY.clear();
 	XOffset.clear();
 	YOffset.clear();
+	MinimapCellDirty.clear();
+	MinimapDirtyCells.clear();
+#if defined(USE_OPENGL) || defined(USE_GLES)
+	MinimapTextureDirty.clear();
+#endif
+	MinimapUnitDots.clear();
+	MinimapShownDotSlots.clear();
+	MinimapQueuedDotSlots.clear();
+	MinimapSelectedDotSlots.clear();
+	MinimapDotsChanged = true;
+	MinimapDotMapLayer = -1;
+	MinimapVisionPlayer = NULL;
 	//Wyrmgus end
 }
 
@@ -1332,6 +1902,10 @@ void CMinimap::Destroy()
 */
 void CMinimap::DrawViewportArea(const CViewport &viewport) const
 {
+	//Wyrmgus start
+	CRenderStageTimer render_stage_timer(RenderStageMinimap);
+	//Wyrmgus end
+
 	// Determine and save region below minimap cursor
 	const PixelPos screenPos = TilePosToScreenPos(viewport.MapPos);
 	//Wyrmgus start
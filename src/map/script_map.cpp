@@ -108,11 +108,8 @@ static int CclStratagusMap(lua_State *l)
 					//Wyrmgus start
 //					delete[] Map.Fields;
 //					Map.Fields = new CMapField[Map.Info.MapWidth * Map.Info.MapHeight];
-					for (size_t z = 0; z < Map.Fields.size(); ++z) {
-						delete[] Map.Fields[z];
-					}
-					Map.Fields.clear();
-					Map.Fields.push_back(new CMapField[Map.Info.MapWidth * Map.Info.MapHeight]);
+					Map.ClearFieldLayers();
+					Map.AddFieldLayer(Map.Info.MapWidth, Map.Info.MapHeight);
 					Map.Info.MapWidths.clear();
 					Map.Info.MapWidths.push_back(Map.Info.MapWidth);
 					Map.Info.MapHeights.clear();
@@ -143,7 +140,7 @@ static int CclStratagusMap(lua_State *l)
 						int map_layer_height = LuaToNumber(l, -1, 2);
 						Map.Info.MapWidths.push_back(map_layer_width);
 						Map.Info.MapHeights.push_back(map_layer_height);
-						Map.Fields.push_back(new CMapField[map_layer_width * map_layer_height]);
+						Map.AddFieldLayer(map_layer_width, map_layer_height);
 						lua_pop(l, 1);
 					}
 					lua_pop(l, 1);
@@ -2319,6 +2316,34 @@ static int CclGetTerrainFeatures(lua_State *l)
 	}
 	return 1;
 }
+
+/**
+**  Print how many bytes per tile the fields of each map layer use.
+**
+**  The per-tile size the fields would have with the visibility counters
+**  stored inline (as they were before being moved to visibility planes)
+**  is printed alongside, for comparison.
+**
+**  @param l  Lua state.
+*/
+static int CclPrintMapMemoryUsage(lua_State *l)
+{
+	LuaCheckArgs(l, 0);
+	
+	const size_t inline_visibility_size = PlayerMax * (sizeof(unsigned short) + 4 * sizeof(unsigned char));
+	const size_t inline_field_size = sizeof(CMapField) - sizeof(CMapFieldVisibilityPlane *) - sizeof(unsigned int) + inline_visibility_size;
+	
+	for (size_t z = 0; z < Map.Fields.size(); ++z) {
+		const size_t tiles = Map.Info.MapWidths[z] * Map.Info.MapHeights[z];
+		if (tiles == 0) {
+			continue;
+		}
+		const size_t visibility_bytes = Map.VisibilityPlanes[z]->GetMemoryUsage();
+		fprintf(stdout, "Map layer %d: %d tiles, %d bytes per tile (%d in the field, %d in visibility planes); %d bytes per tile with inline visibility counters.\n", (int) z, (int) tiles, (int) (Map.GetFieldMemoryUsage(z) / tiles), (int) sizeof(CMapField), (int) (visibility_bytes / tiles), (int) inline_field_size);
+	}
+	
+	return 0;
+}
 //Wyrmgus end
 
 /**
@@ -2379,6 +2404,7 @@ void MapCclRegister()
 	lua_register(Lua, "SetMapTemplateUnit", CclSetMapTemplateUnit);
 	lua_register(Lua, "SetMapTemplateHero", CclSetMapTemplateHero);
 	lua_register(Lua, "SetMapTemplateLayerConnector", CclSetMapTemplateLayerConnector);
+	lua_register(Lua, "PrintMapMemoryUsage", CclPrintMapMemoryUsage);
 //	lua_register(Lua, "CreateMapTemplateTerrainFile", CclCreateMapTemplateTerrainFile);
 	//Wyrmgus end
 }
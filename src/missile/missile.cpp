@@ -42,6 +42,9 @@
 #include "action/action_spellcast.h"
 #include "actions.h"
 #include "animation.h"
+//Wyrmgus start
+#include "block_pool.h"
+//Wyrmgus end
 #include "font.h"
 #include "iolib.h"
 #include "luacallback.h"
@@ -72,6 +75,20 @@ unsigned int Missile::Count = 0;
 static std::vector<Missile *> GlobalMissiles;    /// all global missiles on map
 static std::vector<Missile *> LocalMissiles;     /// all local missiles on map
 
+//Wyrmgus start
+#define MISSILE_POOL_GRANULARITY 16	/// missile block sizes are rounded up to a multiple of this
+#define MISSILE_POOL_SLAB_SIZE 64	/// quantity of missile blocks allocated at once for a pool
+
+#define MISSILE_BUCKET_SIZE 16		/// width and height in tiles of the buckets of the missile bucket grid
+
+/// missiles live for a few seconds at most, so their memory is kept in a pool instead of going through the heap for each arrow
+static CBlockPool<MISSILE_POOL_GRANULARITY, MISSILE_POOL_SLAB_SIZE> MissilePool;
+
+static std::vector<std::vector<std::vector<Missile *>>> MissileBuckets;	/// the global missiles in each bucket of the missile bucket grid, for each map layer
+static int MissileBucketMargin = 0;		/// how many tiles a missile in the buckets can extend beyond the tile of its position
+static bool MissileBucketsDirty = true;	/// whether missiles were created or moved since the buckets were last built
+//Wyrmgus end
+
 /// lookup table for missile names
 typedef std::map<std::string, MissileType *> MissileTypeMap;
 static MissileTypeMap MissileTypes;
@@ -156,6 +173,84 @@ MissileType *NewMissileTypeSlot(const std::string &ident)
 	return mtype;
 }
 
+//Wyrmgus start
+/**
+**  Allocate the memory for a missile from the pool for its size
+**
+**  @param size  Size of the concrete missile class.
+*/
+/* static */ void *Missile::operator new(size_t size)
+{
+	return MissilePool.Allocate(size);
+}
+
+/**
+**  Give the memory of a missile back to the pool for its size
+**
+**  @param ptr   Memory of the missile.
+**  @param size  Size of the concrete missile class.
+*/
+/* static */ void Missile::operator delete(void *ptr, size_t size)
+{
+	MissilePool.Free(ptr, size);
+}
+
+/**
+**  Empty the missile buckets, keeping their storage, and size them for the current map layers.
+*/
+static void ClearMissileBuckets()
+{
+	MissileBuckets.resize(Map.Info.MapWidths.size());
+	
+	for (size_t z = 0; z < MissileBuckets.size(); ++z) {
+		const size_t bucket_count = ((Map.Info.MapWidths[z] + MISSILE_BUCKET_SIZE - 1) / MISSILE_BUCKET_SIZE) * ((Map.Info.MapHeights[z] + MISSILE_BUCKET_SIZE - 1) / MISSILE_BUCKET_SIZE);
+		MissileBuckets[z].resize(bucket_count);
+		for (size_t i = 0; i < MissileBuckets[z].size(); ++i) {
+			MissileBuckets[z][i].clear();
+		}
+	}
+	
+	MissileBucketMargin = 0;
+}
+
+/**
+**  Add a missile to the bucket of the tile of its position.
+**
+**  @param missile  Missile to add.
+*/
+static void AddMissileToBuckets(Missile &missile)
+{
+	const int z = missile.MapLayer;
+	if (z < 0 || z >= (int) MissileBuckets.size() || MissileBuckets[z].empty()) {
+		return;
+	}
+	
+	Vec2i tile_pos = Map.MapPixelPosToTilePos(missile.position);
+	Map.Clamp(tile_pos, z);
+	
+	const int buckets_per_row = (Map.Info.MapWidths[z] + MISSILE_BUCKET_SIZE - 1) / MISSILE_BUCKET_SIZE;
+	MissileBuckets[z][(tile_pos.y / MISSILE_BUCKET_SIZE) * buckets_per_row + tile_pos.x / MISSILE_BUCKET_SIZE].push_back(&missile);
+	
+	//the area of a missile spans from the tile of its position to the tile of its position plus its size and a tile of margin (see GetMissileMapArea)
+	const int missile_tile_size = std::max((missile.Type->Width() + PixelTileSize.x - 1) / PixelTileSize.x, (missile.Type->Height() + PixelTileSize.y - 1) / PixelTileSize.y) + 1;
+	MissileBucketMargin = std::max(MissileBucketMargin, missile_tile_size);
+}
+
+/**
+**  Rebuild the missile buckets from the global missiles.
+*/
+static void RebuildMissileBuckets()
+{
+	ClearMissileBuckets();
+	
+	for (size_t i = 0; i < GlobalMissiles.size(); ++i) {
+		AddMissileToBuckets(*GlobalMissiles[i]);
+	}
+	
+	MissileBucketsDirty = false;
+}
+//Wyrmgus end
+
 /**
 **  Constructor
 */
@@ -292,6 +387,9 @@ Missile *MakeMissile(const MissileType &mtype, const PixelPos &startPos, const P
 	//Wyrmgus end
 
 	GlobalMissiles.push_back(missile);
+	//Wyrmgus start
+	MissileBucketsDirty = true;
+	//Wyrmgus end
 	return missile;
 }
 
@@ -978,6 +1076,10 @@ void MissileType::DrawMissileType(int frame, const PixelPos &pos) const
 */
 void Missile::DrawMissile(const CViewport &vp) const
 {
+	//Wyrmgus start
+	CRenderStageTimer render_stage_timer(RenderStageMissiles);
+	//Wyrmgus end
+
 	Assert(this->Type);
 	CUnit *sunit = this->SourceUnit;
 	// FIXME: I should copy SourcePlayer for second level missiles.
@@ -1019,9 +1121,15 @@ static bool MissileDrawLevelCompare(const Missile *const l, const Missile *const
 */
 void FindAndSortMissiles(const CViewport &vp, std::vector<Missile *> &table)
 {
+	//Wyrmgus start
+	CRenderStageTimer render_stage_timer(RenderStageMissiles);
+	//Wyrmgus end
+
 	typedef std::vector<Missile *>::const_iterator MissilePtrConstiterator;
 
 	// Loop through global missiles, then through locals.
+	//Wyrmgus start
+	/*
 	for (MissilePtrConstiterator i = GlobalMissiles.begin(); i != GlobalMissiles.end(); ++i) {
 		Missile &missile = *(*i);
 		//Wyrmgus start
@@ -1035,6 +1143,38 @@ void FindAndSortMissiles(const CViewport &vp, std::vector<Missile *> &table)
 			table.push_back(&missile);
 		}
 	}
+	*/
+	//only look at the global missiles in the buckets which overlap the viewport
+	if (MissileBucketsDirty) {
+		RebuildMissileBuckets();
+	}
+	
+	if (CurrentMapLayer >= 0 && CurrentMapLayer < (int) MissileBuckets.size() && !MissileBuckets[CurrentMapLayer].empty()) {
+		const int z = CurrentMapLayer;
+		const int buckets_per_row = (Map.Info.MapWidths[z] + MISSILE_BUCKET_SIZE - 1) / MISSILE_BUCKET_SIZE;
+		
+		Vec2i min_pos(vp.MapPos.x - MissileBucketMargin, vp.MapPos.y - MissileBucketMargin);
+		Vec2i max_pos(vp.MapPos.x + vp.MapWidth - 1, vp.MapPos.y + vp.MapHeight - 1);
+		Map.Clamp(min_pos, z);
+		Map.Clamp(max_pos, z);
+		
+		for (int y = min_pos.y / MISSILE_BUCKET_SIZE; y <= max_pos.y / MISSILE_BUCKET_SIZE; ++y) {
+			for (int x = min_pos.x / MISSILE_BUCKET_SIZE; x <= max_pos.x / MISSILE_BUCKET_SIZE; ++x) {
+				const std::vector<Missile *> &bucket = MissileBuckets[z][y * buckets_per_row + x];
+				for (MissilePtrConstiterator i = bucket.begin(); i != bucket.end(); ++i) {
+					Missile &missile = *(*i);
+					if (missile.Delay || missile.Hidden || missile.MapLayer != CurrentMapLayer) {
+						continue;  // delayed or hidden -> aren't shown
+					}
+					// Draw only visible missiles
+					if (MissileVisibleInViewport(vp, missile)) {
+						table.push_back(&missile);
+					}
+				}
+			}
+		}
+	}
+	//Wyrmgus end
 
 	for (MissilePtrConstiterator i = LocalMissiles.begin(); i != LocalMissiles.end(); ++i) {
 		Missile &missile = *(*i);
@@ -1741,9 +1881,14 @@ void Missile::NextMissileFrameCycle()
 **
 **  @param missiles  Table of missiles.
 */
-static void MissilesActionLoop(std::vector<Missile *> &missiles)
+//Wyrmgus start
+//static void MissilesActionLoop(std::vector<Missile *> &missiles)
+static void MissilesActionLoop(std::vector<Missile *> &missiles, bool global)
+//Wyrmgus end
 {
-	for (size_t i = 0; i != missiles.size(); /* empty */) {
+	//Wyrmgus start
+	/*
+	for (size_t i = 0; i != missiles.size(); ) {
 		Missile &missile = *missiles[i];
 
 		if (missile.Delay) {
@@ -1772,6 +1917,47 @@ static void MissilesActionLoop(std::vector<Missile *> &missiles)
 		}
 		++i;
 	}
+	*/
+	//dead missiles are removed by moving the live ones down over them as the loop goes, and truncating the array once at the end, instead of erasing each from the middle of the array; the global missiles are put in the buckets as they are kept
+	if (global) {
+		ClearMissileBuckets();
+	}
+	
+	size_t live = 0;
+	for (size_t i = 0; i != missiles.size(); ++i) {
+		Missile &missile = *missiles[i];
+
+		if (missile.Delay) {
+			missile.Delay--;
+		} else {
+			if (missile.TTL > 0) {
+				missile.TTL--;  // overall time to live if specified
+			}
+			if (missile.TTL == 0) {
+				delete &missile;
+				continue;
+			}
+			Assert(missile.Wait);
+			if (--missile.Wait == 0) {  // wait until time is over
+				missile.Action(); // may create other missiles, and so modifies the array
+				if (missile.TTL == 0) {
+					delete &missile;
+					continue;
+				}
+			}
+		}
+		
+		missiles[live++] = &missile;
+		if (global) {
+			AddMissileToBuckets(missile);
+		}
+	}
+	missiles.resize(live);
+	
+	if (global) {
+		MissileBucketsDirty = false;
+	}
+	//Wyrmgus end
 }
 
 /**
@@ -1779,8 +1965,12 @@ static void MissilesActionLoop(std::vector<Missile *> &missiles)
 */
 void MissileActions()
 {
-	MissilesActionLoop(GlobalMissiles);
-	MissilesActionLoop(LocalMissiles);
+	//Wyrmgus start
+//	MissilesActionLoop(GlobalMissiles);
+//	MissilesActionLoop(LocalMissiles);
+	MissilesActionLoop(GlobalMissiles, true);
+	MissilesActionLoop(LocalMissiles, false);
+	//Wyrmgus end
 }
 
 /**
@@ -1990,6 +2180,10 @@ void CleanMissiles()
 		delete *i;
 	}
 	LocalMissiles.clear();
+	//Wyrmgus start
+	MissileBuckets.clear();
+	MissileBucketsDirty = true;
+	//Wyrmgus end
 }
 
 void FreeBurningBuildingFrames()
@@ -41,11 +41,20 @@
 #include "tileset.h"
 #include "unit.h"
 #include "unit_find.h"
+//Wyrmgus start
+#include "unit_manager.h"
+//Wyrmgus end
 
 #include "pathfinder.h"
 
 #include <stdio.h>
 
+//Wyrmgus start
+#include <atomic>
+
+#include "SDL.h"
+//Wyrmgus end
+
 /*----------------------------------------------------------------------------
 --  Declarations
 ----------------------------------------------------------------------------*/
@@ -55,11 +64,17 @@ struct Node {
 	short int CostToGoal;     /// Estimated cost to goal
 	char InGoal;        /// is this point in the goal
 	char Direction;     /// Direction for trace back
+	//Wyrmgus start
+	int OpenIndex;      /// Position in the open set heap + 1, 0 if not in the open set
+	//Wyrmgus end
 };
 
 struct Open {
 	Vec2i pos;
-	short int Costs; /// complete costs to goal
+	//Wyrmgus start
+//	short int Costs; /// complete costs to goal
+	int Costs; /// complete costs to goal
+	//Wyrmgus end
 	//Wyrmgus start
 //	unsigned short int O;     /// Offset into matrix
 	unsigned int O;     /// Offset into matrix
@@ -90,21 +105,20 @@ std::vector<int> Heading2O[9];//heading to offset
 //Wyrmgus end
 const int XY2Heading[3][3] = { {7, 6, 5}, {0, 0, 4}, {1, 2, 3}};
 
-/// cost matrix
 //Wyrmgus start
-//static Node *AStarMatrix;
-static std::vector<Node *> AStarMatrix;
-//Wyrmgus end
+/*
+/// cost matrix
+static Node *AStarMatrix;
 
 /// a list of close nodes, helps to speed up the matrix cleaning
+static int *CloseSet;
+static int CloseSetSize;
+*/
+//Wyrmgus end
 //Wyrmgus start
-//static int *CloseSet;
-//static int CloseSetSize;
 //static int Threshold;
 //static int OpenSetMaxSize;
 //static int AStarMatrixSize;
-static std::vector<int *> CloseSet;
-static std::vector<int> CloseSetSize;
 static std::vector<int> Threshold;
 static std::vector<int> OpenSetMaxSize;
 static std::vector<int> AStarMatrixSize;
@@ -125,29 +139,86 @@ static std::vector<int> AStarMapWidth;
 static std::vector<int> AStarMapHeight;
 //Wyrmgus end
 
+//Wyrmgus start
+/*
 static int AStarGoalX;
 static int AStarGoalY;
 
+/// The set of Open nodes
+static Open *OpenSet;
+/// The size of the open node set
+static int OpenSetSize;
+
+static int *CostMoveToCache;
+*/
+
 /**
-**  The Open set is handled by a stored array
-**  the end of the array holds the item with the smallest cost.
+**  The search state of a single A* query.
+**
+**  Every search works on its own context, so several searches can run at
+**  the same time (i.e. from worker threads). Contexts are pooled, see
+**  AcquireAStarContext().
+**
+**  The per-layer buffers are only allocated when a search is first run on
+**  that layer.
 */
+class AStarContext
+{
+public:
+	AStarContext();
+	~AStarContext();
+
+	void PrepareLayer(int z);
+
+	std::vector<Node *> Matrix;         /// cost matrix
+	std::vector<int *> CloseSet;        /// a list of close nodes, helps to speed up the matrix cleaning
+	std::vector<int> CloseSetSize;      /// the size of the close node set
+	/**
+	**  The Open set is an indexed 4-ary heap stored in an array: the front
+	**  of the array holds the item with the smallest cost, and the children
+	**  of the item at position i are at positions 4 * i + 1 to 4 * i + 4.
+	**  Each node of the cost matrix stores its position in the heap plus one
+	**  (Node::OpenIndex), so that an open node whose cost decreases can be
+	**  moved towards the front without searching the heap for it.
+	*/
+	std::vector<Open *> OpenSet;        /// the set of Open nodes
+	std::vector<int> OpenSetSize;       /// the size of the open node set
+	std::vector<int *> CostMoveToCache; /// cached move costs of the searching unit
+	int GoalX;                          /// goal of the current search
+	int GoalY;
+};
 
-/// The set of Open nodes
-//Wyrmgus start
-//static Open *OpenSet;
-static std::vector<Open *> OpenSet;
-//Wyrmgus end
-/// The size of the open node set
-//Wyrmgus start
-//static int OpenSetSize;
-static std::vector<int> OpenSetSize;
-//Wyrmgus end
+/**
+**  A path query recorded for benchmarking the pathfinder.
+*/
+struct AStarQuery {
+	int UnitSlot;
+	Vec2i StartPos;
+	Vec2i GoalPos;
+	int GoalWidth;
+	int GoalHeight;
+	int MinRange;
+	int MaxRange;
+	int PathLength;
+	int MaxLength;
+	int MapLayer;
+	bool AllowDiagonal;
+};
 
-//Wyrmgus start
-//static int *CostMoveToCache;
-static std::vector<int *> CostMoveToCache;
+static const size_t AStarMaxRecordedQueries = 65536;	/// the most path queries kept in a recording
+
+static std::atomic<bool> AStarRecordingQueries(false);	/// whether path queries are being recorded, read by the path worker threads
+static std::vector<AStarQuery> AStarRecordedQueries;	/// the recorded path queries, protected by the context pool mutex
+static unsigned long AStarDroppedQueries = 0;			/// how many queries did not fit in the recording
+
+/// all the contexts allocated for the current map
+static std::vector<AStarContext *> AStarContexts;
+/// the contexts which are not in use by a search
+static std::vector<AStarContext *> AStarFreeContexts;
+/// protects the context pool
+static SDL_mutex *AStarContextMutex = NULL;
 //Wyrmgus end
+
 static const int CacheNotSet = -5;
 
 /*----------------------------------------------------------------------------
@@ -309,29 +380,26 @@ void InitAStar()
 
 	for (size_t z = 0; z < Map.Fields.size(); ++z) {
 		// Should only be called once
-		Assert(AStarMatrix.size() <= z);
+		Assert(AStarMapWidth.size() <= z);
 	
 		AStarMapWidth.push_back(Map.Info.MapWidths[z]);
 		AStarMapHeight.push_back(Map.Info.MapHeights[z]);
 		
 		AStarMatrixSize.push_back(sizeof(Node) * AStarMapWidth[z] * AStarMapHeight[z]);
-		AStarMatrix.push_back(new Node[AStarMapWidth[z] * AStarMapHeight[z]]);
-		memset(AStarMatrix[z], 0, AStarMatrixSize[z]);
 
 		Threshold.push_back(AStarMapWidth[z] * AStarMapHeight[z] / MAX_CLOSE_SET_RATIO);
-		CloseSet.push_back(new int[Threshold[z]]);
-		CloseSetSize.push_back(0);
 
 		OpenSetMaxSize.push_back(AStarMapWidth[z] * AStarMapHeight[z] / MAX_OPEN_SET_RATIO);
-		OpenSet.push_back(new Open[OpenSetMaxSize[z]]);
-		OpenSetSize.push_back(0);
-
-		CostMoveToCache.push_back(new int[AStarMapWidth[z] * AStarMapHeight[z]]);
 
 		for (int i = 0; i < 9; ++i) {
 			Heading2O[i].push_back(Heading2Y[i] * AStarMapWidth[z]);
 		}
 	}
+	
+	Assert(AStarContexts.empty());
+	if (!AStarContextMutex) {
+		AStarContextMutex = SDL_CreateMutex();
+	}
 	//Wyrmgus end
 
 	ProfileInit();
@@ -359,31 +427,18 @@ void FreeAStar()
 	delete[] CostMoveToCache;
 	CostMoveToCache = NULL;
 	*/
-	for (size_t z = 0; z < AStarMatrix.size(); ++z) {
-		delete[] AStarMatrix[z];
-		AStarMatrix[z] = NULL;
+	SDL_LockMutex(AStarContextMutex);
+	// all searches must have been finished when the map is freed
+	Assert(AStarFreeContexts.size() == AStarContexts.size());
+	for (size_t i = 0; i < AStarContexts.size(); ++i) {
+		delete AStarContexts[i];
 	}
-	AStarMatrix.clear();
+	AStarContexts.clear();
+	AStarFreeContexts.clear();
+	SDL_UnlockMutex(AStarContextMutex);
 	AStarMatrixSize.clear();
 	Threshold.clear();
-	for (size_t z = 0; z < CloseSet.size(); ++z) {
-		delete[] CloseSet[z];
-		CloseSet[z] = NULL;
-	}
-	CloseSet.clear();
-	CloseSetSize.clear();
-	for (size_t z = 0; z < OpenSet.size(); ++z) {
-		delete[] OpenSet[z];
-		OpenSet[z] = NULL;
-	}
-	OpenSet.clear();
-	OpenSetSize.clear();
 	OpenSetMaxSize.clear();
-	for (size_t z = 0; z < CostMoveToCache.size(); ++z) {
-		delete[] CostMoveToCache[z];
-		CostMoveToCache[z] = NULL;
-	}
-	CostMoveToCache.clear();
 	
 	for (int i = 0; i < 9; ++i) {
 		Heading2O[i].clear();
@@ -393,17 +448,92 @@ void FreeAStar()
 	ProfilePrint();
 }
 
+//Wyrmgus start
+AStarContext::AStarContext() : GoalX(0), GoalY(0)
+{
+	Matrix.resize(AStarMapWidth.size(), NULL);
+	CloseSet.resize(AStarMapWidth.size(), NULL);
+	CloseSetSize.resize(AStarMapWidth.size(), 0);
+	OpenSet.resize(AStarMapWidth.size(), NULL);
+	OpenSetSize.resize(AStarMapWidth.size(), 0);
+	CostMoveToCache.resize(AStarMapWidth.size(), NULL);
+}
+
+AStarContext::~AStarContext()
+{
+	for (size_t z = 0; z < Matrix.size(); ++z) {
+		delete[] Matrix[z];
+		delete[] CloseSet[z];
+		delete[] OpenSet[z];
+		delete[] CostMoveToCache[z];
+	}
+}
+
+/**
+**  Allocate the buffers of a layer, if that hasn't been done yet.
+**
+**  @param z  Map layer.
+*/
+void AStarContext::PrepareLayer(int z)
+{
+	if (Matrix[z]) {
+		return;
+	}
+	
+	Matrix[z] = new Node[AStarMapWidth[z] * AStarMapHeight[z]];
+	memset(Matrix[z], 0, AStarMatrixSize[z]);
+	CloseSet[z] = new int[Threshold[z]];
+	CloseSetSize[z] = 0;
+	OpenSet[z] = new Open[OpenSetMaxSize[z]];
+	OpenSetSize[z] = 0;
+	CostMoveToCache[z] = new int[AStarMapWidth[z] * AStarMapHeight[z]];
+	std::fill(CostMoveToCache[z], CostMoveToCache[z] + AStarMapWidth[z] * AStarMapHeight[z], CacheNotSet);
+}
+
+/**
+**  Get a search context from the pool, creating a new one if all of them are in use.
+**
+**  Can be called from any thread; the context must be given back with ReleaseAStarContext.
+*/
+AStarContext *AcquireAStarContext()
+{
+	AStarContext *context = NULL;
+	
+	SDL_LockMutex(AStarContextMutex);
+	if (!AStarFreeContexts.empty()) {
+		context = AStarFreeContexts.back();
+		AStarFreeContexts.pop_back();
+	} else {
+		context = new AStarContext;
+		AStarContexts.push_back(context);
+	}
+	SDL_UnlockMutex(AStarContextMutex);
+	
+	return context;
+}
+
+/**
+**  Give a search context back to the pool.
+*/
+void ReleaseAStarContext(AStarContext *context)
+{
+	SDL_LockMutex(AStarContextMutex);
+	AStarFreeContexts.push_back(context);
+	SDL_UnlockMutex(AStarContextMutex);
+}
+//Wyrmgus end
+
 /**
 **  Prepare pathfinder.
 */
 //Wyrmgus start
 //static void AStarPrepare()
-static void AStarPrepare(int z)
+static void AStarPrepare(AStarContext &context, int z)
 //Wyrmgus end
 {
 	//Wyrmgus start
 //	memset(AStarMatrix, 0, AStarMatrixSize);
-	memset(AStarMatrix[z], 0, AStarMatrixSize[z]);
+	memset(context.Matrix[z], 0, AStarMatrixSize[z]);
 	//Wyrmgus end
 }
 
@@ -412,26 +542,27 @@ static void AStarPrepare(int z)
 */
 //Wyrmgus start
 //static void AStarCleanUp()
-static void AStarCleanUp(int z)
+static void AStarCleanUp(AStarContext &context, int z)
 //Wyrmgus end
 {
 	ProfileBegin("AStarCleanUp");
 
 	//Wyrmgus start
 //	if (CloseSetSize >= Threshold) {
-	if (CloseSetSize[z] >= Threshold[z]) {
+	if (context.CloseSetSize[z] >= Threshold[z]) {
 	//Wyrmgus end
 		//Wyrmgus start
 //		AStarPrepare();
-		AStarPrepare(z);
+		AStarPrepare(context, z);
 		//Wyrmgus end
 	} else {
-		for (int i = 0; i < CloseSetSize[z]; ++i) {
+		for (int i = 0; i < context.CloseSetSize[z]; ++i) {
 			//Wyrmgus start
 //			AStarMatrix[CloseSet[i]].CostFromStart = 0;
 //			AStarMatrix[CloseSet[i]].InGoal = 0;
-			AStarMatrix[z][CloseSet[z][i]].CostFromStart = 0;
-			AStarMatrix[z][CloseSet[z][i]].InGoal = 0;
+			context.Matrix[z][context.CloseSet[z][i]].CostFromStart = 0;
+			context.Matrix[z][context.CloseSet[z][i]].InGoal = 0;
+			context.Matrix[z][context.CloseSet[z][i]].OpenIndex = 0;
 			//Wyrmgus end
 		}
 	}
@@ -440,7 +571,7 @@ static void AStarCleanUp(int z)
 
 //Wyrmgus start
 //static void CostMoveToCacheCleanUp()
-static void CostMoveToCacheCleanUp(int z)
+static void CostMoveToCacheCleanUp(AStarContext &context, int z)
 //Wyrmgus end
 {
 	ProfileBegin("CostMoveToCacheCleanUp");
@@ -451,7 +582,7 @@ static void CostMoveToCacheCleanUp(int z)
 #if 1
 	//Wyrmgus start
 //	int *ptr = CostMoveToCache;
-	int *ptr = CostMoveToCache[z];
+	int *ptr = context.CostMoveToCache[z];
 	//Wyrmgus end
 #ifdef __x86_64__
 	union {
@@ -487,20 +618,110 @@ static void CostMoveToCacheCleanUp(int z)
 	for (int i = 0; i < AStarMapMax; ++i) {
 		//Wyrmgus start
 //		CostMoveToCache[i] = CacheNotSet;
-		CostMoveToCache[z][i] = CacheNotSet;
+		context.CostMoveToCache[z][i] = CacheNotSet;
 		//Wyrmgus end
 	}
 #endif
 	ProfileEnd("CostMoveToCacheCleanUp");
 }
 
+//Wyrmgus start
+/**
+**  The open set is an indexed d-ary heap: the item with the smallest cost is
+**  at the front, and each node of the matrix knows its position in the heap,
+**  so that finding and re-costing an open node doesn't require a search.
+*/
+#define ASTAR_HEAP_ARITY 4
+//Wyrmgus end
+
 /**
 **  Find the best node in the current open node set
 **  Returns the position of this node in the open node set
 */
 //Wyrmgus start
 //#define AStarFindMinimum() (OpenSetSize - 1)
-#define AStarFindMinimum(z) (OpenSetSize[(z)] - 1)
+#define AStarFindMinimum(z) (0)
+//Wyrmgus end
+
+//Wyrmgus start
+/**
+**  Check whether an open node should be expanded before another one.
+**
+**  Nodes with lower total costs come first, ties are broken by the
+**  estimated cost to goal and then by the distance to the goal.
+*/
+static inline bool AStarOpenBefore(const AStarContext &context, const Open &lhs, const Open &rhs, int z)
+{
+	if (lhs.Costs != rhs.Costs) {
+		return lhs.Costs < rhs.Costs;
+	}
+	const int lhsCostToGoal = context.Matrix[z][lhs.O].CostToGoal;
+	const int rhsCostToGoal = context.Matrix[z][rhs.O].CostToGoal;
+	if (lhsCostToGoal != rhsCostToGoal) {
+		return lhsCostToGoal < rhsCostToGoal;
+	}
+	const int lhsDist = MyAbs(lhs.pos.x - context.GoalX) + MyAbs(lhs.pos.y - context.GoalY);
+	const int rhsDist = MyAbs(rhs.pos.x - context.GoalX) + MyAbs(rhs.pos.y - context.GoalY);
+	return lhsDist < rhsDist;
+}
+
+/**
+**  Place an open node at a heap position, updating the index in the matrix.
+*/
+static inline void AStarHeapSet(AStarContext &context, int pos, const Open &node, int z)
+{
+	context.OpenSet[z][pos] = node;
+	context.Matrix[z][node.O].OpenIndex = pos + 1;
+}
+
+/**
+**  Move an open node towards the front of the heap until its parent comes before it.
+*/
+static void AStarHeapSiftUp(AStarContext &context, int pos, int z)
+{
+	Open *heap = context.OpenSet[z];
+	const Open node = heap[pos];
+
+	while (pos > 0) {
+		const int parent = (pos - 1) / ASTAR_HEAP_ARITY;
+		if (!AStarOpenBefore(context, node, heap[parent], z)) {
+			break;
+		}
+		AStarHeapSet(context, pos, heap[parent], z);
+		pos = parent;
+	}
+	AStarHeapSet(context, pos, node, z);
+}
+
+/**
+**  Move an open node towards the back of the heap until it comes before all its children.
+*/
+static void AStarHeapSiftDown(AStarContext &context, int pos, int z)
+{
+	Open *heap = context.OpenSet[z];
+	const int size = context.OpenSetSize[z];
+	const Open node = heap[pos];
+
+	while (true) {
+		const int firstChild = pos * ASTAR_HEAP_ARITY + 1;
+		if (firstChild >= size) {
+			break;
+		}
+		const int lastChild = std::min(firstChild + ASTAR_HEAP_ARITY, size);
+		int best = firstChild;
+		for (int child = firstChild + 1; child < lastChild; ++child) {
+			if (AStarOpenBefore(context, heap[child], heap[best], z)) {
+				best = child;
+			}
+		}
+		if (!AStarOpenBefore(context, heap[best], node, z)) {
+			break;
+		}
+		AStarHeapSet(context, pos, heap[best], z);
+		pos = best;
+	}
+	AStarHeapSet(context, pos, node, z);
+}
 //Wyrmgus end
 
 /**
@@ -508,17 +729,21 @@ static void CostMoveToCacheCleanUp(int z)
 */
 //Wyrmgus start
 //static void AStarRemoveMinimum(int pos)
-static void AStarRemoveMinimum(int pos, int z)
+static void AStarRemoveMinimum(AStarContext &context, int pos, int z)
 //Wyrmgus end
 {
 	//Wyrmgus start
 //	Assert(pos == OpenSetSize - 1);
-	Assert(pos == OpenSetSize[z] - 1);
-	//Wyrmgus end
-
-	//Wyrmgus start
+//
 //	OpenSetSize--;
-	OpenSetSize[z]--;
+	Assert(pos == 0 && context.OpenSetSize[z] > 0);
+
+	context.Matrix[z][context.OpenSet[z][0].O].OpenIndex = 0;
+	context.OpenSetSize[z]--;
+	if (context.OpenSetSize[z] > 0) {
+		context.OpenSet[z][0] = context.OpenSet[z][context.OpenSetSize[z]];
+		AStarHeapSiftDown(context, 0, z);
+	}
 	//Wyrmgus end
 }
 
@@ -529,24 +754,14 @@ static void AStarRemoveMinimum(int pos, int z)
 */
 //Wyrmgus start
 //static inline int AStarAddNode(const Vec2i &pos, int o, int costs)
-static inline int AStarAddNode(const Vec2i &pos, int o, int costs, int z)
+static inline int AStarAddNode(AStarContext &context, const Vec2i &pos, int o, int costs, int z)
 //Wyrmgus end
 {
 	ProfileBegin("AStarAddNode");
 
-	//Wyrmgus start
-//	int bigi = 0, smalli = OpenSetSize;
-	int bigi = 0, smalli = OpenSetSize[z];
-	//Wyrmgus end
-	int midcost;
-	int midi;
-	int midCostToGoal;
-	int midDist;
-	const Open *open;
-
 	//Wyrmgus start
 //	if (OpenSetSize + 1 >= OpenSetMaxSize) {
-	if (OpenSetSize[z] + 1 >= OpenSetMaxSize[z]) {
+	if (context.OpenSetSize[z] + 1 >= OpenSetMaxSize[z]) {
 	//Wyrmgus end
 		fprintf(stderr, "A* internal error: raise Open Set Max Size "
 				//Wyrmgus start
@@ -558,64 +773,12 @@ static inline int AStarAddNode(const Vec2i &pos, int o, int costs, int z)
 	}
 
 	//Wyrmgus start
-//	const int costToGoal = AStarMatrix[o].CostToGoal;
-	const int costToGoal = AStarMatrix[z][o].CostToGoal;
-	//Wyrmgus end
-	const int dist = MyAbs(pos.x - AStarGoalX) + MyAbs(pos.y - AStarGoalY);
-
-	// find where we should insert this node.
-	// binary search where to insert the new node
-	while (bigi < smalli) {
-		midi = (smalli + bigi) >> 1;
-		//Wyrmgus start
-//		open = &OpenSet[midi];
-		open = &OpenSet[z][midi];
-		//Wyrmgus end
-		midcost = open->Costs;
-		//Wyrmgus start
-//		midCostToGoal = AStarMatrix[open->O].CostToGoal;
-		midCostToGoal = AStarMatrix[z][open->O].CostToGoal;
-		//Wyrmgus end
-		midDist = MyAbs(open->pos.x - AStarGoalX) + MyAbs(open->pos.y - AStarGoalY);
-		if (costs > midcost || (costs == midcost
-								&& (costToGoal > midCostToGoal || (costToGoal == midCostToGoal
-																   && dist > midDist)))) {
-			smalli = midi;
-		} else if (costs < midcost || (costs == midcost
-									   && (costToGoal < midCostToGoal || (costToGoal == midCostToGoal
-											   && dist < midDist)))) {
-			if (bigi == midi) {
-				bigi++;
-			} else {
-				bigi = midi;
-			}
-		} else {
-			bigi = midi;
-			smalli = midi;
-		}
-	}
-
-	//Wyrmgus start
-//	if (OpenSetSize > bigi) {
-	if (OpenSetSize[z] > bigi) {
-	//Wyrmgus end
-		// free a the slot for our node
-		//Wyrmgus start
-//		memmove(&OpenSet[bigi + 1], &OpenSet[bigi], (OpenSetSize - bigi) * sizeof(Open));
-		memmove(&OpenSet[z][bigi + 1], &OpenSet[z][bigi], (OpenSetSize[z] - bigi) * sizeof(Open));
-		//Wyrmgus end
-	}
-
-	// fill our new node
-	//Wyrmgus start
-//	OpenSet[bigi].pos = pos;
-//	OpenSet[bigi].O = o;
-//	OpenSet[bigi].Costs = costs;
-//	++OpenSetSize;
-	OpenSet[z][bigi].pos = pos;
-	OpenSet[z][bigi].O = o;
-	OpenSet[z][bigi].Costs = costs;
-	++OpenSetSize[z];
+	const int pos_in_heap = context.OpenSetSize[z]++;
+	Open &node = context.OpenSet[z][pos_in_heap];
+	node.pos = pos;
+	node.O = o;
+	node.Costs = costs;
+	AStarHeapSiftUp(context, pos_in_heap, z);
 	//Wyrmgus end
 
 	ProfileEnd("AStarAddNode");
@@ -630,27 +793,28 @@ static inline int AStarAddNode(const Vec2i &pos, int o, int costs, int z)
 */
 //Wyrmgus start
 //static void AStarReplaceNode(int pos)
-static void AStarReplaceNode(int pos, int z)
+static void AStarReplaceNode(AStarContext &context, int pos, int z)
 //Wyrmgus end
 {
 	ProfileBegin("AStarReplaceNode");
 
+	//Wyrmgus start
+	/*
 	Open node;
 
 	// Remove the outdated node
-	//Wyrmgus start
-//	node = OpenSet[pos];
-//	OpenSetSize--;
-//	memmove(&OpenSet[pos], &OpenSet[pos+1], sizeof(Open) * (OpenSetSize-pos));
-	node = OpenSet[z][pos];
-	OpenSetSize[z]--;
-	memmove(&OpenSet[z][pos], &OpenSet[z][pos+1], sizeof(Open) * (OpenSetSize[z]-pos));
-	//Wyrmgus end
+	node = OpenSet[pos];
+	OpenSetSize--;
+	memmove(&OpenSet[pos], &OpenSet[pos+1], sizeof(Open) * (OpenSetSize-pos));
 
 	// Re-add the node with the new cost
-	//Wyrmgus start
-//	AStarAddNode(node.pos, node.O, node.Costs);
-	AStarAddNode(node.pos, node.O, node.Costs, z);
+	AStarAddNode(node.pos, node.O, node.Costs);
+	*/
+	// the new cost is lower than the old one, so the node can only move towards the front of the heap
+	Open &node = context.OpenSet[z][pos];
+	const Node &matrixNode = context.Matrix[z][node.O];
+	node.Costs = matrixNode.CostFromStart + matrixNode.CostToGoal;
+	AStarHeapSiftUp(context, pos, z);
 	//Wyrmgus end
 	ProfileEnd("AStarReplaceNode");
 }
@@ -663,25 +827,24 @@ static void AStarReplaceNode(int pos, int z)
 */
 //Wyrmgus start
 //static int AStarFindNode(int eo)
-static int AStarFindNode(int eo, int z)
+static int AStarFindNode(AStarContext &context, int eo, int z)
 //Wyrmgus end
 {
+	//Wyrmgus start
+	/*
 	ProfileBegin("AStarFindNode");
 
-	//Wyrmgus start
-//	for (int i = 0; i < OpenSetSize; ++i) {
-	for (int i = 0; i < OpenSetSize[z]; ++i) {
-	//Wyrmgus end
-		//Wyrmgus start
-//		if (OpenSet[i].O == eo) {
-		if (OpenSet[z][i].O == eo) {
-		//Wyrmgus end
+	for (int i = 0; i < OpenSetSize; ++i) {
+		if (OpenSet[i].O == eo) {
 			ProfileEnd("AStarFindNode");
 			return i;
 		}
 	}
 	ProfileEnd("AStarFindNode");
 	return -1;
+	*/
+	return context.Matrix[z][eo].OpenIndex - 1;
+	//Wyrmgus end
 }
 
 /**
@@ -689,16 +852,16 @@ static int AStarFindNode(int eo, int z)
 */
 //Wyrmgus start
 //static void AStarAddToClose(int node)
-static void AStarAddToClose(int node, int z)
+static void AStarAddToClose(AStarContext &context, int node, int z)
 //Wyrmgus end
 {
 	//Wyrmgus start
 //	if (CloseSetSize < Threshold) {
-	if (CloseSetSize[z] < Threshold[z]) {
+	if (context.CloseSetSize[z] < Threshold[z]) {
 	//Wyrmgus end
 		//Wyrmgus start
 //		CloseSet[CloseSetSize++] = node;
-		CloseSet[z][CloseSetSize[z]++] = node;
+		context.CloseSet[z][context.CloseSetSize[z]++] = node;
 		//Wyrmgus end
 	}
 }
@@ -829,7 +992,7 @@ static int CostMoveToCallBack_Default(unsigned int index, const CUnit &unit, int
 */
 //Wyrmgus start
 //static inline int CostMoveTo(unsigned int index, const CUnit &unit)
-static inline int CostMoveTo(unsigned int index, const CUnit &unit, int z)
+static inline int CostMoveTo(AStarContext &context, unsigned int index, const CUnit &unit, int z)
 //Wyrmgus end
 {
 	//Wyrmgus start
@@ -840,7 +1003,7 @@ static inline int CostMoveTo(unsigned int index, const CUnit &unit, int z)
 	//Wyrmgus end
 	//Wyrmgus start
 //	int *c = &CostMoveToCache[index];
-	int *c = &CostMoveToCache[z][index];
+	int *c = &context.CostMoveToCache[z][index];
 	//Wyrmgus end
 	if (*c != CacheNotSet) {
 		return *c;
@@ -855,8 +1018,12 @@ static inline int CostMoveTo(unsigned int index, const CUnit &unit, int z)
 class AStarGoalMarker
 {
 public:
-	AStarGoalMarker(const CUnit &unit, bool *goal_reachable) :
-		unit(unit), goal_reachable(goal_reachable)
+	//Wyrmgus start
+//	AStarGoalMarker(const CUnit &unit, bool *goal_reachable) :
+//		unit(unit), goal_reachable(goal_reachable)
+	AStarGoalMarker(AStarContext &context, const CUnit &unit, bool *goal_reachable) :
+		context(context), unit(unit), goal_reachable(goal_reachable)
+	//Wyrmgus end
 	{}
 
 	//Wyrmgus start
@@ -866,20 +1033,23 @@ public:
 	{
 		//Wyrmgus start
 //		if (CostMoveTo(offset, unit) >= 0) {
-		if (CostMoveTo(offset, unit, z) >= 0) {
+		if (CostMoveTo(context, offset, unit, z) >= 0) {
 		//Wyrmgus end
 			//Wyrmgus start
 //			AStarMatrix[offset].InGoal = 1;
-			AStarMatrix[z][offset].InGoal = 1;
+			context.Matrix[z][offset].InGoal = 1;
 			//Wyrmgus end
 			*goal_reachable = true;
 		}
 		//Wyrmgus start
 //		AStarAddToClose(offset);
-		AStarAddToClose(offset, z);
+		AStarAddToClose(context, offset, z);
 		//Wyrmgus end
 	}
 private:
+	//Wyrmgus start
+	AStarContext &context;
+	//Wyrmgus end
 	const CUnit &unit;
 	bool *goal_reachable;
 };
@@ -1110,7 +1280,7 @@ private:
 /**
 **  MarkAStarGoal
 */
-static int AStarMarkGoal(const Vec2i &goal, int gw, int gh,
+static int AStarMarkGoal(AStarContext &context, const Vec2i &goal, int gw, int gh,
 						 //Wyrmgus start
 //						 int tilesizex, int tilesizey, int minrange, int maxrange, const CUnit &unit)
 						 int tilesizex, int tilesizey, int minrange, int maxrange, const CUnit &unit, int z)
@@ -1130,11 +1300,11 @@ static int AStarMarkGoal(const Vec2i &goal, int gw, int gh,
 //		unsigned int offset = GetIndex(goal.x, goal.y);
 //		if (CostMoveTo(offset, unit) >= 0) {
 		unsigned int offset = GetIndex(goal.x, goal.y, z);
-		if (CostMoveTo(offset, unit, z) >= 0) {
+		if (CostMoveTo(context, offset, unit, z) >= 0) {
 		//Wyrmgus end
 			//Wyrmgus start
 //			AStarMatrix[offset].InGoal = 1;
-			AStarMatrix[z][offset].InGoal = 1;
+			context.Matrix[z][offset].InGoal = 1;
 			//Wyrmgus end
 			ProfileEnd("AStarMarkGoal");
 			return 1;
@@ -1149,7 +1319,10 @@ static int AStarMarkGoal(const Vec2i &goal, int gw, int gh,
 	gw = std::max(gw, 1);
 	gh = std::max(gh, 1);
 
-	AStarGoalMarker aStarGoalMarker(unit, &goal_reachable);
+	//Wyrmgus start
+//	AStarGoalMarker aStarGoalMarker(unit, &goal_reachable);
+	AStarGoalMarker aStarGoalMarker(context, unit, &goal_reachable);
+	//Wyrmgus end
 	MinMaxRangeVisitor<AStarGoalMarker> visitor(aStarGoalMarker);
 
 	const Vec2i goalBottomRigth(goal.x + gw - 1, goal.y + gh - 1);
@@ -1176,7 +1349,7 @@ static int AStarMarkGoal(const Vec2i &goal, int gw, int gh,
 */
 //Wyrmgus start
 //static int AStarSavePath(const Vec2i &startPos, const Vec2i &endPos, char *path, int pathLen)
-static int AStarSavePath(const Vec2i &startPos, const Vec2i &endPos, char *path, int pathLen, int z)
+static int AStarSavePath(AStarContext &context, const Vec2i &startPos, const Vec2i &endPos, char *path, int pathLen, int z)
 //Wyrmgus end
 {
 	ProfileBegin("AStarSavePath");
@@ -1195,7 +1368,7 @@ static int AStarSavePath(const Vec2i &startPos, const Vec2i &endPos, char *path,
 	while (curr != startPos) {
 		//Wyrmgus start
 //		direction = AStarMatrix[currO + curr.x].Direction;
-		direction = AStarMatrix[z][currO + curr.x].Direction;
+		direction = context.Matrix[z][currO + curr.x].Direction;
 		//Wyrmgus end
 		curr.x -= Heading2X[direction];
 		curr.y -= Heading2Y[direction];
@@ -1218,7 +1391,7 @@ static int AStarSavePath(const Vec2i &startPos, const Vec2i &endPos, char *path,
 		while (curr != startPos) {
 			//Wyrmgus start
 //			direction = AStarMatrix[currO + curr.x].Direction;
-			direction = AStarMatrix[z][currO + curr.x].Direction;
+			direction = context.Matrix[z][currO + curr.x].Direction;
 			//Wyrmgus end
 			curr.x -= Heading2X[direction];
 			curr.y -= Heading2Y[direction];
@@ -1280,7 +1453,8 @@ static int AStarFindSimplePath(const Vec2i &startPos, const Vec2i &goal, int gw,
 		// Move to adjacent cell
 		//Wyrmgus start
 //		if (CostMoveTo(GetIndex(goal.x, goal.y), unit) == -1) {
-		if (CostMoveTo(GetIndex(goal.x, goal.y, z), unit, z) == -1) {
+		// the move cost cache of the context still holds the values of its previous search, so don't use it here
+		if (CostMoveToCallBack_Default(GetIndex(goal.x, goal.y, z), unit, z) == -1) {
 		//Wyrmgus end
 			ProfileEnd("AStarFindSimplePath");
 			return PF_UNREACHABLE;
@@ -1300,7 +1474,10 @@ static int AStarFindSimplePath(const Vec2i &startPos, const Vec2i &goal, int gw,
 /**
 **  Find path.
 */
-int AStarFindPath(const Vec2i &startPos, const Vec2i &goalPos, int gw, int gh,
+//Wyrmgus start
+//int AStarFindPath(const Vec2i &startPos, const Vec2i &goalPos, int gw, int gh,
+int AStarFindPath(AStarContext &context, const Vec2i &startPos, const Vec2i &goalPos, int gw, int gh,
+//Wyrmgus end
 				  int tilesizex, int tilesizey, int minrange, int maxrange,
 				  //Wyrmgus start
 //				  char *path, int pathlen, const CUnit &unit)
@@ -1316,12 +1493,38 @@ int AStarFindPath(const Vec2i &startPos, const Vec2i &goalPos, int gw, int gh,
 	}
 	
 	allow_diagonal = allow_diagonal && !unit.Type->BoolFlag[RAIL_INDEX].value; //rail units cannot move diagonally
+	
+	context.PrepareLayer(z);
+	
+	if (AStarRecordingQueries) {
+		AStarQuery query;
+		query.UnitSlot = UnitNumber(unit);
+		query.StartPos = startPos;
+		query.GoalPos = goalPos;
+		query.GoalWidth = gw;
+		query.GoalHeight = gh;
+		query.MinRange = minrange;
+		query.MaxRange = maxrange;
+		query.PathLength = path ? pathlen : 0;
+		query.MaxLength = max_length;
+		query.MapLayer = z;
+		query.AllowDiagonal = allow_diagonal;
+		SDL_LockMutex(AStarContextMutex);
+		if (!AStarRecordingQueries) {
+			// the recording was stopped since the check above
+		} else if (AStarRecordedQueries.size() < AStarMaxRecordedQueries) {
+			AStarRecordedQueries.push_back(query);
+		} else {
+			++AStarDroppedQueries;
+		}
+		SDL_UnlockMutex(AStarContextMutex);
+	}
 	//Wyrmgus end
 
 	ProfileBegin("AStarFindPath");
 
-	AStarGoalX = goalPos.x;
-	AStarGoalY = goalPos.y;
+	context.GoalX = goalPos.x;
+	context.GoalY = goalPos.y;
 
 	//  Check for simple cases first
 	int ret = AStarFindSimplePath(startPos, goalPos, gw, gh, tilesizex, tilesizey,
@@ -1338,20 +1541,20 @@ int AStarFindPath(const Vec2i &startPos, const Vec2i &goalPos, int gw, int gh,
 	//Wyrmgus start
 //	AStarCleanUp();
 //	CostMoveToCacheCleanUp();
-	AStarCleanUp(z);
-	CostMoveToCacheCleanUp(z);
+	AStarCleanUp(context, z);
+	CostMoveToCacheCleanUp(context, z);
 	//Wyrmgus end
 
 	//Wyrmgus start
 //	OpenSetSize = 0;
 //	CloseSetSize = 0;
-	OpenSetSize[z] = 0;
-	CloseSetSize[z] = 0;
+	context.OpenSetSize[z] = 0;
+	context.CloseSetSize[z] = 0;
 	//Wyrmgus end
 
 	//Wyrmgus start
 //	if (!AStarMarkGoal(goalPos, gw, gh, tilesizex, tilesizey, minrange, maxrange, unit)) {
-	if (!AStarMarkGoal(goalPos, gw, gh, tilesizex, tilesizey, minrange, maxrange, unit, z)) {
+	if (!AStarMarkGoal(context, goalPos, gw, gh, tilesizex, tilesizey, minrange, maxrange, unit, z)) {
 	//Wyrmgus end
 		// goal is not reachable
 		ret = PF_UNREACHABLE;
@@ -1367,12 +1570,12 @@ int AStarFindPath(const Vec2i &startPos, const Vec2i &goalPos, int gw, int gh,
 	// 0 as a way to represent nodes that we have not visited yet.
 	//Wyrmgus start
 //	AStarMatrix[eo].CostFromStart = 1;
-	AStarMatrix[z][eo].CostFromStart = 1;
+	context.Matrix[z][eo].CostFromStart = 1;
 	//Wyrmgus end
 	// 8 to say we are came from nowhere.
 	//Wyrmgus start
 //	AStarMatrix[eo].Direction = 8;
-	AStarMatrix[z][eo].Direction = 8;
+	context.Matrix[z][eo].Direction = 8;
 	//Wyrmgus end
 
 	// place start point in open, it that failed, try another pathfinder
@@ -1380,8 +1583,8 @@ int AStarFindPath(const Vec2i &startPos, const Vec2i &goalPos, int gw, int gh,
 	//Wyrmgus start
 //	AStarMatrix[eo].CostToGoal = costToGoal;
 //	if (AStarAddNode(startPos, eo, 1 + costToGoal) == PF_FAILED) {
-	AStarMatrix[z][eo].CostToGoal = costToGoal;
-	if (AStarAddNode(startPos, eo, 1 + costToGoal, z) == PF_FAILED) {
+	context.Matrix[z][eo].CostToGoal = costToGoal;
+	if (AStarAddNode(context, startPos, eo, 1 + costToGoal, z) == PF_FAILED) {
 	//Wyrmgus end
 		ret = PF_FAILED;
 		ProfileEnd("AStarFindPath");
@@ -1390,8 +1593,8 @@ int AStarFindPath(const Vec2i &startPos, const Vec2i &goalPos, int gw, int gh,
 	//Wyrmgus start
 //	AStarAddToClose(OpenSet[0].O);
 //	if (AStarMatrix[eo].InGoal) {
-	AStarAddToClose(OpenSet[z][0].O, z);
-	if (AStarMatrix[z][eo].InGoal) {
+	AStarAddToClose(context, context.OpenSet[z][0].O, z);
+	if (context.Matrix[z][eo].InGoal) {
 	//Wyrmgus end
 		ret = PF_REACHED;
 		ProfileEnd("AStarFindPath");
@@ -1420,20 +1623,20 @@ int AStarFindPath(const Vec2i &startPos, const Vec2i &goalPos, int gw, int gh,
 //		const int y = OpenSet[shortest].pos.y;
 //		const int o = OpenSet[shortest].O;
 		const int shortest = AStarFindMinimum(z);
-		const int x = OpenSet[z][shortest].pos.x;
-		const int y = OpenSet[z][shortest].pos.y;
-		const int o = OpenSet[z][shortest].O;
+		const int x = context.OpenSet[z][shortest].pos.x;
+		const int y = context.OpenSet[z][shortest].pos.y;
+		const int o = context.OpenSet[z][shortest].O;
 		//Wyrmgus end
 
 		//Wyrmgus start
 //		AStarRemoveMinimum(shortest);
-		AStarRemoveMinimum(shortest, z);
+		AStarRemoveMinimum(context, shortest, z);
 		//Wyrmgus end
 
 		// If we have reached the goal, then exit.
 		//Wyrmgus start
 //		if (AStarMatrix[o].InGoal == 1) {
-		if (AStarMatrix[z][o].InGoal == 1) {
+		if (context.Matrix[z][o].InGoal == 1) {
 		//Wyrmgus end
 			endPos.x = x;
 			endPos.y = y;
@@ -1458,8 +1661,8 @@ int AStarFindPath(const Vec2i &startPos, const Vec2i &goalPos, int gw, int gh,
 		//Wyrmgus start
 //		const int px = x - Heading2X[(int)AStarMatrix[o].Direction];
 //		const int py = y - Heading2Y[(int)AStarMatrix[o].Direction];
-		const int px = x - Heading2X[(int)AStarMatrix[z][o].Direction];
-		const int py = y - Heading2Y[(int)AStarMatrix[z][o].Direction];
+		const int px = x - Heading2X[(int)context.Matrix[z][o].Direction];
+		const int py = y - Heading2Y[(int)context.Matrix[z][o].Direction];
 		//Wyrmgus end
 
 		for (int i = 0; i < 8; ++i) {
@@ -1503,7 +1706,7 @@ int AStarFindPath(const Vec2i &startPos, const Vec2i &goalPos, int gw, int gh,
 			// or if we have a better path to it, we add it to open set
 			//Wyrmgus start
 //			int new_cost = CostMoveTo(eo, unit);
-			int new_cost = CostMoveTo(eo, unit, z);
+			int new_cost = CostMoveTo(context, eo, unit, z);
 			//Wyrmgus end
 			if (new_cost == -1) {
 				// uncrossable tile
@@ -1515,22 +1718,22 @@ int AStarFindPath(const Vec2i &startPos, const Vec2i &goalPos, int gw, int gh,
 			//Wyrmgus start
 //			new_cost += AStarMatrix[o].CostFromStart;
 //			if (AStarMatrix[eo].CostFromStart == 0) {
-			new_cost += AStarMatrix[z][o].CostFromStart;
-			if (AStarMatrix[z][eo].CostFromStart == 0) {
+			new_cost += context.Matrix[z][o].CostFromStart;
+			if (context.Matrix[z][eo].CostFromStart == 0) {
 			//Wyrmgus end
 				// we are sure the current node has not been already visited
 				//Wyrmgus start
 //				AStarMatrix[eo].CostFromStart = new_cost;
 //				AStarMatrix[eo].Direction = i;
-				AStarMatrix[z][eo].CostFromStart = new_cost;
-				AStarMatrix[z][eo].Direction = i;
+				context.Matrix[z][eo].CostFromStart = new_cost;
+				context.Matrix[z][eo].Direction = i;
 				//Wyrmgus end
 				costToGoal = AStarCosts(endPos, goalPos);
 				//Wyrmgus start
 //				AStarMatrix[eo].CostToGoal = costToGoal;
 //				if (AStarAddNode(endPos, eo, AStarMatrix[eo].CostFromStart + costToGoal) == PF_FAILED) {
-				AStarMatrix[z][eo].CostToGoal = costToGoal;
-				if (AStarAddNode(endPos, eo, AStarMatrix[z][eo].CostFromStart + costToGoal, z) == PF_FAILED) {
+				context.Matrix[z][eo].CostToGoal = costToGoal;
+				if (AStarAddNode(context, endPos, eo, context.Matrix[z][eo].CostFromStart + costToGoal, z) == PF_FAILED) {
 				//Wyrmgus end
 					ret = PF_FAILED;
 					ProfileEnd("AStarFindPath");
@@ -1539,32 +1742,32 @@ int AStarFindPath(const Vec2i &startPos, const Vec2i &goalPos, int gw, int gh,
 				// we add the point to the close set
 				//Wyrmgus start
 //				AStarAddToClose(eo);
-				AStarAddToClose(eo, z);
+				AStarAddToClose(context, eo, z);
 				//Wyrmgus end
 			//Wyrmgus start
 //			} else if (new_cost < AStarMatrix[eo].CostFromStart) {
-			} else if (new_cost < AStarMatrix[z][eo].CostFromStart) {
+			} else if (new_cost < context.Matrix[z][eo].CostFromStart) {
 			//Wyrmgus end
 				// Already visited node, but we have here a better path
 				// I know, it's redundant (but simpler like this)
 				//Wyrmgus start
 //				AStarMatrix[eo].CostFromStart = new_cost;
 //				AStarMatrix[eo].Direction = i;
-				AStarMatrix[z][eo].CostFromStart = new_cost;
-				AStarMatrix[z][eo].Direction = i;
+				context.Matrix[z][eo].CostFromStart = new_cost;
+				context.Matrix[z][eo].Direction = i;
 				//Wyrmgus end
 				// this point might be already in the OpenSet
 				//Wyrmgus start
 //				const int j = AStarFindNode(eo);
-				const int j = AStarFindNode(eo, z);
+				const int j = AStarFindNode(context, eo, z);
 				//Wyrmgus end
 				if (j == -1) {
 					costToGoal = AStarCosts(endPos, goalPos);
 					//Wyrmgus start
 //					AStarMatrix[eo].CostToGoal = costToGoal;
 //					if (AStarAddNode(endPos, eo, AStarMatrix[eo].CostFromStart + costToGoal) == PF_FAILED) {
-					AStarMatrix[z][eo].CostToGoal = costToGoal;
-					if (AStarAddNode(endPos, eo, AStarMatrix[z][eo].CostFromStart + costToGoal, z) == PF_FAILED) {
+					context.Matrix[z][eo].CostToGoal = costToGoal;
+					if (AStarAddNode(context, endPos, eo, context.Matrix[z][eo].CostFromStart + costToGoal, z) == PF_FAILED) {
 					//Wyrmgus end
 						ret = PF_FAILED;
 						ProfileEnd("AStarFindPath");
@@ -1575,8 +1778,8 @@ int AStarFindPath(const Vec2i &startPos, const Vec2i &goalPos, int gw, int gh,
 					//Wyrmgus start
 //					AStarMatrix[eo].CostToGoal = costToGoal;
 //					AStarReplaceNode(j);
-					AStarMatrix[z][eo].CostToGoal = costToGoal;
-					AStarReplaceNode(j, z);
+					context.Matrix[z][eo].CostToGoal = costToGoal;
+					AStarReplaceNode(context, j, z);
 					//Wyrmgus end
 				}
 				// we don't have to add this point to the close set
@@ -1584,7 +1787,7 @@ int AStarFindPath(const Vec2i &startPos, const Vec2i &goalPos, int gw, int gh,
 		}
 		//Wyrmgus start
 //		if (OpenSetSize <= 0) { // no new nodes generated
-		if (OpenSetSize[z] <= 0) { // no new nodes generated
+		if (context.OpenSetSize[z] <= 0) { // no new nodes generated
 		//Wyrmgus end
 			ret = PF_UNREACHABLE;
 			ProfileEnd("AStarFindPath");
@@ -1598,7 +1801,7 @@ int AStarFindPath(const Vec2i &startPos, const Vec2i &goalPos, int gw, int gh,
 
 	//Wyrmgus start
 //	const int path_length = AStarSavePath(startPos, endPos, path, pathlen);
-	const int path_length = AStarSavePath(startPos, endPos, path, pathlen, z);
+	const int path_length = AStarSavePath(context, startPos, endPos, path, pathlen, z);
 	//Wyrmgus end
 
 	ret = path_length;
@@ -1619,7 +1822,7 @@ struct StatsNode {
 
 //Wyrmgus start
 //StatsNode *AStarGetStats()
-StatsNode *AStarGetStats(int z)
+StatsNode *AStarGetStats(AStarContext &context, int z)
 //Wyrmgus end
 {
 	//Wyrmgus start
@@ -1629,7 +1832,7 @@ StatsNode *AStarGetStats(int z)
 	StatsNode *s = stats;
 	//Wyrmgus start
 //	Node *m = AStarMatrix;
-	Node *m = AStarMatrix[z];
+	Node *m = context.Matrix[z];
 	//Wyrmgus end
 
 	//Wyrmgus start
@@ -1651,11 +1854,11 @@ StatsNode *AStarGetStats(int z)
 
 	//Wyrmgus start
 //	for (int i = 0; i < OpenSetSize; ++i) {
-	for (int i = 0; i < OpenSetSize[z]; ++i) {
+	for (int i = 0; i < context.OpenSetSize[z]; ++i) {
 	//Wyrmgus end
 		//Wyrmgus start
 //		stats[OpenSet[i].O].Costs = OpenSet[i].Costs;
-		stats[OpenSet[z][i].O].Costs = OpenSet[z][i].Costs;
+		stats[context.OpenSet[z][i].O].Costs = context.OpenSet[z][i].Costs;
 		//Wyrmgus end
 	}
 	return stats;
@@ -1666,6 +1869,82 @@ void AStarFreeStats(StatsNode *stats)
 	delete[] stats;
 }
 
+//Wyrmgus start
+/*----------------------------------------------------------------------------
+--  Benchmark
+----------------------------------------------------------------------------*/
+
+/**
+**  Start or stop recording the path queries made to the pathfinder.
+**
+**  Starting a recording discards the queries recorded before.
+**  At most AStarMaxRecordedQueries queries are kept, later ones are only counted.
+*/
+void SetAStarRecordQueries(bool record)
+{
+	SDL_LockMutex(AStarContextMutex);
+	if (record && !AStarRecordingQueries) {
+		AStarRecordedQueries.clear();
+		AStarDroppedQueries = 0;
+	}
+	AStarRecordingQueries = record;
+	if (!record && AStarDroppedQueries > 0) {
+		fprintf(stdout, "A* recording: %lu queries dropped after the first %d\n", AStarDroppedQueries, (int) AStarMaxRecordedQueries);
+	}
+	SDL_UnlockMutex(AStarContextMutex);
+}
+
+/**
+**  Replay the recorded path queries and print how long they took.
+**
+**  Queries whose unit is no longer on the map layer it was searching on are skipped.
+**
+**  @param repeat  How many times to replay the queries.
+*/
+void AStarReplayQueries(int repeat)
+{
+	// stop the path workers from appending to the recording while it is replayed
+	SDL_LockMutex(AStarContextMutex);
+	const bool was_recording = AStarRecordingQueries;
+	AStarRecordingQueries = false;
+	SDL_UnlockMutex(AStarContextMutex);
+	
+	AStarContextLease context;
+	char path[PathFinderOutput::MAX_PATH_LENGTH];
+	unsigned long replayed = 0;
+	unsigned long reachable = 0;
+	const unsigned long start_ticks = SDL_GetTicks();
+	
+	for (int i = 0; i < repeat; ++i) {
+		for (size_t j = 0; j < AStarRecordedQueries.size(); ++j) {
+			const AStarQuery &query = AStarRecordedQueries[j];
+			if (query.UnitSlot < 0 || query.UnitSlot >= (int) UnitManager.GetUsedSlotCount()) {
+				continue;
+			}
+			const CUnit &unit = UnitManager.GetSlotUnit(query.UnitSlot);
+			if (!unit.IsAliveOnMap() || unit.MapLayer != query.MapLayer || !Map.Info.IsPointOnMap(query.StartPos, query.MapLayer)) {
+				continue;
+			}
+			const int ret = AStarFindPath(*context, query.StartPos, query.GoalPos, query.GoalWidth, query.GoalHeight,
+										  unit.Type->TileWidth, unit.Type->TileHeight, query.MinRange, query.MaxRange,
+										  query.PathLength ? path : NULL, std::min<int>(query.PathLength, PathFinderOutput::MAX_PATH_LENGTH),
+										  unit, query.MaxLength, query.MapLayer, query.AllowDiagonal);
+			++replayed;
+			if (ret >= PF_REACHED) {
+				++reachable;
+			}
+		}
+	}
+	
+	const unsigned long ticks = SDL_GetTicks() - start_ticks;
+	fprintf(stdout, "A* benchmark: %lu queries (%lu reachable) in %lu ms, %.4f ms per query\n", replayed, reachable, ticks, replayed ? (double) ticks / replayed : 0.0);
+	
+	SDL_LockMutex(AStarContextMutex);
+	AStarRecordingQueries = was_recording;
+	SDL_UnlockMutex(AStarContextMutex);
+}
+//Wyrmgus end
+
 /*----------------------------------------------------------------------------
 --  Configurable costs
 ----------------------------------------------------------------------------*/
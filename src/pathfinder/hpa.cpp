@@ -0,0 +1,1018 @@
+//       _________ __                 __
+//      /   _____//  |_____________ _/  |______     ____  __ __  ______
+//      \_____  \\   __\_  __ \__  \\   __\__  \   / ___\|  |  \/  ___/
+//      /        \|  |  |  | \// __ \|  |  / __ \_/ /_/  >  |  /\___ |
+//     /_______  /|__|  |__|  (____  /__| (____  /\___  /|____//____  >
+//             \/                  \/          \//_____/            \/
+//  ______________________                           ______________________
+//                        T H E   W A R   B E G I N S
+//         Stratagus - A free fantasy real time strategy game engine
+//
+/**@name hpa.cpp - The hierarchical path finder routines. */
+//
+//      (c) Copyright 2018 by Andrettin
+//
+//      This program is free software; you can redistribute it and/or modify
+//      it under the terms of the GNU General Public License as published by
+//      the Free Software Foundation; only version 2 of the License.
+//
+//      This program is distributed in the hope that it will be useful,
+//      but WITHOUT ANY WARRANTY; without even the implied warranty of
+//      MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//      GNU General Public License for more details.
+//
+//      You should have received a copy of the GNU General Public License
+//      along with this program; if not, write to the Free Software
+//      Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
+//      02111-1307, USA.
+//
+
+//@{
+
+/*----------------------------------------------------------------------------
+--  Includes
+----------------------------------------------------------------------------*/
+
+#include "stratagus.h"
+
+#include "pathfinder.h"
+
+#include "map.h"
+#include "player.h"
+#include "tileset.h"
+#include "unit.h"
+#include "unittype.h"
+
+#include <algorithm>
+#include <map>
+#include <queue>
+
+/*----------------------------------------------------------------------------
+--  Declarations
+----------------------------------------------------------------------------*/
+
+/**
+**  The map layers are divided into square clusters of tiles. Where two
+**  adjacent clusters can be crossed between, entrance nodes are placed on
+**  both sides of their border, and the costs of moving between the nodes of
+**  each cluster are precomputed. Long routes are then planned over this
+**  abstract graph, which has a handful of nodes per cluster, and only the
+**  next stretch of the route is searched with the tile a* (see NewPath).
+**
+**  Passability only takes into account terrain and fixed units (i.e.
+**  buildings), moving units are left for the tile a* to deal with. Like in
+**  the tile a*, tiles which the player's team hasn't explored are taken to
+**  be passable, so each player has its own graphs, unless the a* is set to
+**  know unseen terrain.
+**
+**  The graphs also keep the connected regions of their layer: the tiles of
+**  each cluster are split into local components, which are then joined
+**  across the cluster borders. A goal without any tiles in the region of
+**  the unit can't be reached, so the tile a* doesn't need to be run.
+**
+**  The graphs are only used from the game logic thread.
+*/
+
+#define HPA_CLUSTER_SIZE 16
+
+/// Runs of crossable border tiles at least this long get an entrance at each end, instead of one in the middle
+#define HPA_LONG_ENTRANCE_LENGTH 8
+
+/// Routes are only planned hierarchically if the goal is further away than this
+#define HPA_MIN_DISTANCE (2 * HPA_CLUSTER_SIZE)
+
+/// The next waypoint of a route is the furthest route node within this distance
+#define HPA_WAYPOINT_DISTANCE (2 * HPA_CLUSTER_SIZE)
+
+/// Goals with a larger area around them than this are not checked with the connected regions
+#define HPA_MAX_REACH_AREA 1024
+
+/**
+**  An entrance node of a cluster.
+*/
+class HPANode
+{
+public:
+	explicit HPANode(const Vec2i &pos) : Pos(pos) {}
+
+	Vec2i Pos;                /// tile of the node
+	std::vector<Vec2i> Exits; /// tiles of neighboring clusters which can be entered from the node
+};
+
+/**
+**  A connection between a local component of a cluster and one of a neighboring cluster.
+*/
+class HPAComponentLink
+{
+public:
+	HPAComponentLink(int component, int neighbor_cluster, int neighbor_component) : Component(component), NeighborCluster(neighbor_cluster), NeighborComponent(neighbor_component) {}
+
+	bool operator <(const HPAComponentLink &other) const
+	{
+		if (this->Component != other.Component) {
+			return this->Component < other.Component;
+		}
+		if (this->NeighborCluster != other.NeighborCluster) {
+			return this->NeighborCluster < other.NeighborCluster;
+		}
+		return this->NeighborComponent < other.NeighborComponent;
+	}
+
+	bool operator ==(const HPAComponentLink &other) const
+	{
+		return this->Component == other.Component && this->NeighborCluster == other.NeighborCluster && this->NeighborComponent == other.NeighborComponent;
+	}
+
+	int Component;
+	int NeighborCluster;
+	int NeighborComponent;
+};
+
+class HPACluster
+{
+public:
+	HPACluster() : Dirty(true), ComponentCount(0), ComponentOffset(0), ComponentsDirty(true) {}
+
+	std::vector<HPANode> Nodes;
+	std::vector<int> Distances;         /// costs of moving between each pair of nodes within the cluster, -1 if not possible
+	bool Dirty;                         /// whether the nodes have to be rebuilt
+	std::vector<short> TileComponents;  /// local component of each tile of the cluster, -1 if not passable
+	int ComponentCount;
+	int ComponentOffset;                /// index of the first local component of the cluster in the graph
+	bool ComponentsDirty;               /// whether the local components have to be rebuilt
+	std::vector<HPAComponentLink> ComponentLinks; /// connections of the local components across the east and south borders of the cluster
+};
+
+/**
+**  The cluster graph of a map layer, for units with a given movement mask.
+*/
+class HPAGraph
+{
+public:
+	HPAGraph(int z, int mask, int player);
+
+	void MarkDirty(const Vec2i &pos);
+	bool IsTerrainPassable(const Vec2i &pos) const;
+	bool FindRoute(const Vec2i &startPos, const Vec2i &goalPos, std::vector<Vec2i> &route);
+	int GetRegion(const Vec2i &pos);
+
+	int Player;               /// the player whose explored terrain the graph is built from, or -1 if all terrain is known
+	unsigned int TeamMask;    /// the players whose explored tiles count as explored for the graph
+
+private:
+	bool IsPassable(const Vec2i &pos) const;
+	int GetClusterIndex(const Vec2i &pos) const;
+	void GetClusterBounds(int cluster_index, Vec2i &min_pos, Vec2i &max_pos) const;
+	int FindNode(int cluster_index, const Vec2i &pos) const;
+	void AddEntrance(int cluster_index, const Vec2i &pos, const Vec2i &exit_pos);
+	void AddBorderEntrances(int cluster_index, const Vec2i &start, const Vec2i &step, const Vec2i &exit_offset, int length);
+	void BuildNodes(int cluster_index);
+	void BuildDistances(int cluster_index);
+	void CalculateClusterCosts(int cluster_index, const Vec2i &start_pos, std::vector<int> &costs) const;
+	void Repair();
+	void BuildComponents(int cluster_index);
+	void BuildComponentLinks(int cluster_index);
+	void RepairRegions();
+
+	int MapLayer;
+	int Mask;
+	int Width;
+	int Height;
+	int ClustersX;
+	int ClustersY;
+	std::vector<HPACluster> Clusters;
+	bool HasDirtyClusters;
+	std::vector<int> ComponentRegions; /// connected region of each local component
+	bool HasDirtyComponents;
+};
+
+/*----------------------------------------------------------------------------
+--  Variables
+----------------------------------------------------------------------------*/
+
+/// The cluster graphs of each map layer, by movement mask and player
+static std::vector<std::map<std::pair<int, int>, HPAGraph *>> HPAGraphs;
+
+/*----------------------------------------------------------------------------
+--  Functions
+----------------------------------------------------------------------------*/
+
+HPAGraph::HPAGraph(int z, int mask, int player) : Player(player), TeamMask(0), MapLayer(z), Mask(mask), HasDirtyClusters(true), HasDirtyComponents(true)
+{
+	if (player != -1) {
+		this->TeamMask = (1 << player) | GetMutualSharedVisionMask(Players[player]);
+	}
+	this->Width = Map.Info.MapWidths[z];
+	this->Height = Map.Info.MapHeights[z];
+	this->ClustersX = (this->Width + HPA_CLUSTER_SIZE - 1) / HPA_CLUSTER_SIZE;
+	this->ClustersY = (this->Height + HPA_CLUSTER_SIZE - 1) / HPA_CLUSTER_SIZE;
+	this->Clusters.resize(this->ClustersX * this->ClustersY);
+}
+
+/**
+**  Mark the cluster of a tile for rebuilding, since its passability changed.
+*/
+void HPAGraph::MarkDirty(const Vec2i &pos)
+{
+	HPACluster &cluster = this->Clusters[this->GetClusterIndex(pos)];
+	cluster.Dirty = true;
+	cluster.ComponentsDirty = true;
+	this->HasDirtyClusters = true;
+	this->HasDirtyComponents = true;
+}
+
+/**
+**  Check whether the terrain and fixed units of a tile let units of the graph's movement mask through.
+*/
+bool HPAGraph::IsTerrainPassable(const Vec2i &pos) const
+{
+	const CMapField &mf = *Map.Field(pos, this->MapLayer);
+	unsigned long check_flags = mf.Flags;
+	if (check_flags & MapFieldBridge) {
+		check_flags &= ~(MapFieldWaterAllowed | MapFieldCoastAllowed);
+	}
+	return (check_flags & this->Mask & ~(MapFieldLandUnit | MapFieldAirUnit | MapFieldSeaUnit)) == 0;
+}
+
+/**
+**  Check whether units of the graph's movement mask can pass through a tile.
+**
+**  Mirrors the terrain part of the a* move cost function, for which tiles
+**  unexplored by the player's team can always be passed through.
+*/
+bool HPAGraph::IsPassable(const Vec2i &pos) const
+{
+	if (this->Player != -1 && (Map.Field(pos, this->MapLayer)->playerInfo.GetExploredMask() & this->TeamMask) == 0) {
+		return true;
+	}
+	return this->IsTerrainPassable(pos);
+}
+
+int HPAGraph::GetClusterIndex(const Vec2i &pos) const
+{
+	return (pos.y / HPA_CLUSTER_SIZE) * this->ClustersX + pos.x / HPA_CLUSTER_SIZE;
+}
+
+void HPAGraph::GetClusterBounds(int cluster_index, Vec2i &min_pos, Vec2i &max_pos) const
+{
+	min_pos.x = (cluster_index % this->ClustersX) * HPA_CLUSTER_SIZE;
+	min_pos.y = (cluster_index / this->ClustersX) * HPA_CLUSTER_SIZE;
+	max_pos.x = std::min(min_pos.x + HPA_CLUSTER_SIZE, this->Width) - 1;
+	max_pos.y = std::min(min_pos.y + HPA_CLUSTER_SIZE, this->Height) - 1;
+}
+
+/**
+**  Get the index of the node at a tile in a cluster, or -1 if there is none.
+*/
+int HPAGraph::FindNode(int cluster_index, const Vec2i &pos) const
+{
+	const std::vector<HPANode> &nodes = this->Clusters[cluster_index].Nodes;
+	for (size_t i = 0; i < nodes.size(); ++i) {
+		if (nodes[i].Pos == pos) {
+			return i;
+		}
+	}
+	return -1;
+}
+
+void HPAGraph::AddEntrance(int cluster_index, const Vec2i &pos, const Vec2i &exit_pos)
+{
+	std::vector<HPANode> &nodes = this->Clusters[cluster_index].Nodes;
+	int node_index = this->FindNode(cluster_index, pos);
+	if (node_index == -1) {
+		nodes.push_back(HPANode(pos));
+		node_index = nodes.size() - 1;
+	}
+	nodes[node_index].Exits.push_back(exit_pos);
+}
+
+/**
+**  Add the entrances of one border of a cluster.
+**
+**  @param cluster_index  The cluster.
+**  @param start          The first tile of the border, inside the cluster.
+**  @param step           Offset between two consecutive tiles of the border.
+**  @param exit_offset    Offset from a border tile to the adjacent tile of the neighboring cluster.
+**  @param length         Number of tiles in the border.
+*/
+void HPAGraph::AddBorderEntrances(int cluster_index, const Vec2i &start, const Vec2i &step, const Vec2i &exit_offset, int length)
+{
+	int run_start = -1;
+	for (int i = 0; i <= length; ++i) {
+		const Vec2i pos(start.x + step.x * i, start.y + step.y * i);
+		const Vec2i exit_pos(pos.x + exit_offset.x, pos.y + exit_offset.y);
+		const bool crossable = i < length && this->IsPassable(pos) && this->IsPassable(exit_pos);
+
+		if (crossable) {
+			if (run_start == -1) {
+				run_start = i;
+			}
+			continue;
+		}
+
+		if (run_start == -1) {
+			continue;
+		}
+
+		const int run_end = i - 1;
+		if (run_end - run_start + 1 >= HPA_LONG_ENTRANCE_LENGTH) {
+			const int ends[2] = { run_start, run_end };
+			for (int j = 0; j < 2; ++j) {
+				const Vec2i entrance_pos(start.x + step.x * ends[j], start.y + step.y * ends[j]);
+				this->AddEntrance(cluster_index, entrance_pos, Vec2i(entrance_pos.x + exit_offset.x, entrance_pos.y + exit_offset.y));
+			}
+		} else {
+			const int middle = (run_start + run_end) / 2;
+			const Vec2i entrance_pos(start.x + step.x * middle, start.y + step.y * middle);
+			this->AddEntrance(cluster_index, entrance_pos, Vec2i(entrance_pos.x + exit_offset.x, entrance_pos.y + exit_offset.y));
+		}
+		run_start = -1;
+	}
+}
+
+/**
+**  Rebuild the entrance nodes of a cluster.
+**
+**  The entrances of a border are placed the same way from both of its
+**  sides, so the nodes of neighboring clusters always match.
+*/
+void HPAGraph::BuildNodes(int cluster_index)
+{
+	HPACluster &cluster = this->Clusters[cluster_index];
+	cluster.Nodes.clear();
+
+	Vec2i min_pos;
+	Vec2i max_pos;
+	this->GetClusterBounds(cluster_index, min_pos, max_pos);
+	const int width = max_pos.x - min_pos.x + 1;
+	const int height = max_pos.y - min_pos.y + 1;
+
+	if (min_pos.y > 0) {
+		this->AddBorderEntrances(cluster_index, min_pos, Vec2i(1, 0), Vec2i(0, -1), width);
+	}
+	if (max_pos.y < this->Height - 1) {
+		this->AddBorderEntrances(cluster_index, Vec2i(min_pos.x, max_pos.y), Vec2i(1, 0), Vec2i(0, 1), width);
+	}
+	if (min_pos.x > 0) {
+		this->AddBorderEntrances(cluster_index, min_pos, Vec2i(0, 1), Vec2i(-1, 0), height);
+	}
+	if (max_pos.x < this->Width - 1) {
+		this->AddBorderEntrances(cluster_index, Vec2i(max_pos.x, min_pos.y), Vec2i(0, 1), Vec2i(1, 0), height);
+	}
+}
+
+/**
+**  Calculate the cost of moving from a tile to each tile of its cluster.
+**
+**  @param cluster_index  The cluster.
+**  @param start_pos      The tile from which to start, it doesn't need to be passable.
+**  @param costs          Filled with the costs of each tile of the cluster, -1 if it can't be reached.
+*/
+void HPAGraph::CalculateClusterCosts(int cluster_index, const Vec2i &start_pos, std::vector<int> &costs) const
+{
+	Vec2i min_pos;
+	Vec2i max_pos;
+	this->GetClusterBounds(cluster_index, min_pos, max_pos);
+	const int width = max_pos.x - min_pos.x + 1;
+	const int height = max_pos.y - min_pos.y + 1;
+
+	costs.assign(width * height, -1);
+
+	std::priority_queue<std::pair<int, int>, std::vector<std::pair<int, int>>, std::greater<std::pair<int, int>>> queue;
+	const int start_index = (start_pos.y - min_pos.y) * width + start_pos.x - min_pos.x;
+	costs[start_index] = 0;
+	queue.push(std::pair<int, int>(0, start_index));
+
+	while (!queue.empty()) {
+		const int cost = queue.top().first;
+		const int index = queue.top().second;
+		queue.pop();
+
+		if (cost > costs[index]) {
+			continue;
+		}
+
+		const Vec2i pos(min_pos.x + index % width, min_pos.y + index / width);
+		for (int i = 0; i < 8; ++i) {
+			const Vec2i new_pos(pos.x + Heading2X[i], pos.y + Heading2Y[i]);
+			if (new_pos.x < min_pos.x || new_pos.x > max_pos.x || new_pos.y < min_pos.y || new_pos.y > max_pos.y) {
+				continue;
+			}
+			if (!this->IsPassable(new_pos)) {
+				continue;
+			}
+			const int new_index = (new_pos.y - min_pos.y) * width + new_pos.x - min_pos.x;
+			const int new_cost = cost + 1 + Map.Field(new_pos, this->MapLayer)->getCost();
+			if (costs[new_index] == -1 || new_cost < costs[new_index]) {
+				costs[new_index] = new_cost;
+				queue.push(std::pair<int, int>(new_cost, new_index));
+			}
+		}
+	}
+}
+
+/**
+**  Rebuild the costs of moving between the nodes of a cluster.
+*/
+void HPAGraph::BuildDistances(int cluster_index)
+{
+	HPACluster &cluster = this->Clusters[cluster_index];
+	const size_t node_count = cluster.Nodes.size();
+	cluster.Distances.assign(node_count * node_count, -1);
+
+	Vec2i min_pos;
+	Vec2i max_pos;
+	this->GetClusterBounds(cluster_index, min_pos, max_pos);
+	const int width = max_pos.x - min_pos.x + 1;
+
+	std::vector<int> costs;
+	for (size_t i = 0; i < node_count; ++i) {
+		this->CalculateClusterCosts(cluster_index, cluster.Nodes[i].Pos, costs);
+		for (size_t j = 0; j < node_count; ++j) {
+			const Vec2i &pos = cluster.Nodes[j].Pos;
+			cluster.Distances[i * node_count + j] = costs[(pos.y - min_pos.y) * width + pos.x - min_pos.x];
+		}
+	}
+}
+
+/**
+**  Rebuild the dirty clusters, and their neighbors (as they share their borders).
+*/
+void HPAGraph::Repair()
+{
+	if (!this->HasDirtyClusters) {
+		return;
+	}
+
+	std::vector<bool> rebuild(this->Clusters.size(), false);
+	for (size_t i = 0; i < this->Clusters.size(); ++i) {
+		if (!this->Clusters[i].Dirty) {
+			continue;
+		}
+		const int cluster_x = i % this->ClustersX;
+		const int cluster_y = i / this->ClustersX;
+		rebuild[i] = true;
+		if (cluster_x > 0) {
+			rebuild[i - 1] = true;
+		}
+		if (cluster_x < this->ClustersX - 1) {
+			rebuild[i + 1] = true;
+		}
+		if (cluster_y > 0) {
+			rebuild[i - this->ClustersX] = true;
+		}
+		if (cluster_y < this->ClustersY - 1) {
+			rebuild[i + this->ClustersX] = true;
+		}
+	}
+
+	for (size_t i = 0; i < this->Clusters.size(); ++i) {
+		if (rebuild[i]) {
+			this->BuildNodes(i);
+			this->BuildDistances(i);
+			this->Clusters[i].Dirty = false;
+		}
+	}
+
+	this->HasDirtyClusters = false;
+}
+
+/**
+**  Rebuild the local components of a cluster, by flood filling its passable tiles.
+*/
+void HPAGraph::BuildComponents(int cluster_index)
+{
+	HPACluster &cluster = this->Clusters[cluster_index];
+
+	Vec2i min_pos;
+	Vec2i max_pos;
+	this->GetClusterBounds(cluster_index, min_pos, max_pos);
+	const int width = max_pos.x - min_pos.x + 1;
+	const int height = max_pos.y - min_pos.y + 1;
+
+	cluster.TileComponents.assign(width * height, -1);
+	cluster.ComponentCount = 0;
+
+	std::vector<bool> passable(width * height);
+	for (int i = 0; i < width * height; ++i) {
+		passable[i] = this->IsPassable(Vec2i(min_pos.x + i % width, min_pos.y + i / width));
+	}
+
+	std::vector<int> stack;
+	for (int i = 0; i < width * height; ++i) {
+		if (!passable[i] || cluster.TileComponents[i] != -1) {
+			continue;
+		}
+
+		const short component = cluster.ComponentCount++;
+		cluster.TileComponents[i] = component;
+		stack.push_back(i);
+		while (!stack.empty()) {
+			const int index = stack.back();
+			stack.pop_back();
+			const int x = index % width;
+			const int y = index / width;
+			for (int j = 0; j < 8; ++j) {
+				const int new_x = x + Heading2X[j];
+				const int new_y = y + Heading2Y[j];
+				if (new_x < 0 || new_x >= width || new_y < 0 || new_y >= height) {
+					continue;
+				}
+				const int new_index = new_y * width + new_x;
+				if (passable[new_index] && cluster.TileComponents[new_index] == -1) {
+					cluster.TileComponents[new_index] = component;
+					stack.push_back(new_index);
+				}
+			}
+		}
+	}
+
+	cluster.ComponentsDirty = false;
+}
+
+static int FindComponentRoot(std::vector<int> &parents, int component)
+{
+	while (parents[component] != component) {
+		parents[component] = parents[parents[component]];
+		component = parents[component];
+	}
+	return component;
+}
+
+/**
+**  Rebuild the connections of a cluster's local components to those of
+**  the clusters across its east and south borders (including the diagonals).
+*/
+void HPAGraph::BuildComponentLinks(int cluster_index)
+{
+	HPACluster &cluster = this->Clusters[cluster_index];
+	cluster.ComponentLinks.clear();
+
+	Vec2i min_pos;
+	Vec2i max_pos;
+	this->GetClusterBounds(cluster_index, min_pos, max_pos);
+	const int width = max_pos.x - min_pos.x + 1;
+
+	for (int y = min_pos.y; y <= max_pos.y; ++y) {
+		for (int x = min_pos.x; x <= max_pos.x; ++x) {
+			if (x != max_pos.x && y != max_pos.y) {
+				continue;
+			}
+			const int component = cluster.TileComponents[(y - min_pos.y) * width + x - min_pos.x];
+			if (component == -1) {
+				continue;
+			}
+
+			const Vec2i neighbors[4] = { Vec2i(x + 1, y - 1), Vec2i(x + 1, y), Vec2i(x + 1, y + 1), Vec2i(x - 1, y + 1) };
+			for (int j = 0; j < 4; ++j) {
+				const Vec2i &neighbor_pos = neighbors[j];
+				if (neighbor_pos.x < 0 || neighbor_pos.x >= this->Width || neighbor_pos.y < 0 || neighbor_pos.y >= this->Height) {
+					continue;
+				}
+				const int neighbor_cluster_index = this->GetClusterIndex(neighbor_pos);
+				if (neighbor_cluster_index == cluster_index) {
+					continue;
+				}
+				const HPACluster &neighbor_cluster = this->Clusters[neighbor_cluster_index];
+				Vec2i neighbor_min_pos;
+				Vec2i neighbor_max_pos;
+				this->GetClusterBounds(neighbor_cluster_index, neighbor_min_pos, neighbor_max_pos);
+				const int neighbor_width = neighbor_max_pos.x - neighbor_min_pos.x + 1;
+				const int neighbor_component = neighbor_cluster.TileComponents[(neighbor_pos.y - neighbor_min_pos.y) * neighbor_width + neighbor_pos.x - neighbor_min_pos.x];
+				if (neighbor_component != -1) {
+					cluster.ComponentLinks.push_back(HPAComponentLink(component, neighbor_cluster_index, neighbor_component));
+				}
+			}
+		}
+	}
+
+	std::sort(cluster.ComponentLinks.begin(), cluster.ComponentLinks.end());
+	cluster.ComponentLinks.erase(std::unique(cluster.ComponentLinks.begin(), cluster.ComponentLinks.end()), cluster.ComponentLinks.end());
+}
+
+/**
+**  Rebuild the local components of the dirty clusters, and join the
+**  components of all clusters into connected regions.
+**
+**  Only the dirty clusters have to be flood filled again, since they are
+**  the only ones which could have been split, and only the borders they
+**  share with their neighbors have to be scanned again; the regions are
+**  then joined from the connections kept for each cluster, which are few.
+*/
+void HPAGraph::RepairRegions()
+{
+	if (!this->HasDirtyComponents) {
+		return;
+	}
+
+	// the links of a cluster point to its east, south, south-east, south-west and north-east neighbors,
+	// so those of the clusters to the west, north, north-west, north-east and south-west of a rebuilt one have to be redone
+	std::vector<bool> relink(this->Clusters.size(), false);
+	int component_count = 0;
+	for (size_t i = 0; i < this->Clusters.size(); ++i) {
+		HPACluster &cluster = this->Clusters[i];
+		if (cluster.ComponentsDirty) {
+			this->BuildComponents(i);
+
+			const int cluster_x = i % this->ClustersX;
+			const int cluster_y = i / this->ClustersX;
+			for (int offset_y = -1; offset_y <= 1; ++offset_y) {
+				for (int offset_x = -1; offset_x <= 1; ++offset_x) {
+					if (offset_x == 1 && offset_y == 0) { // east
+						continue;
+					}
+					if (offset_y == 1 && offset_x >= 0) { // south and south-east
+						continue;
+					}
+					const int neighbor_x = cluster_x + offset_x;
+					const int neighbor_y = cluster_y + offset_y;
+					if (neighbor_x >= 0 && neighbor_x < this->ClustersX && neighbor_y >= 0 && neighbor_y < this->ClustersY) {
+						relink[neighbor_y * this->ClustersX + neighbor_x] = true;
+					}
+				}
+			}
+		}
+		cluster.ComponentOffset = component_count;
+		component_count += cluster.ComponentCount;
+	}
+
+	std::vector<int> parents(component_count);
+	for (int i = 0; i < component_count; ++i) {
+		parents[i] = i;
+	}
+
+	for (size_t i = 0; i < this->Clusters.size(); ++i) {
+		if (relink[i]) {
+			this->BuildComponentLinks(i);
+		}
+
+		const HPACluster &cluster = this->Clusters[i];
+		for (size_t j = 0; j < cluster.ComponentLinks.size(); ++j) {
+			const HPAComponentLink &link = cluster.ComponentLinks[j];
+			const int root = FindComponentRoot(parents, cluster.ComponentOffset + link.Component);
+			const int neighbor_root = FindComponentRoot(parents, this->Clusters[link.NeighborCluster].ComponentOffset + link.NeighborComponent);
+			if (root != neighbor_root) {
+				parents[std::max(root, neighbor_root)] = std::min(root, neighbor_root);
+			}
+		}
+	}
+
+	this->ComponentRegions.resize(component_count);
+	for (int i = 0; i < component_count; ++i) {
+		this->ComponentRegions[i] = FindComponentRoot(parents, i);
+	}
+
+	this->HasDirtyComponents = false;
+}
+
+/**
+**  Get the connected region of a tile.
+**
+**  @return  The region, or -1 if the tile isn't passable.
+*/
+int HPAGraph::GetRegion(const Vec2i &pos)
+{
+	this->RepairRegions();
+
+	const int cluster_index = this->GetClusterIndex(pos);
+	const HPACluster &cluster = this->Clusters[cluster_index];
+	Vec2i min_pos;
+	Vec2i max_pos;
+	this->GetClusterBounds(cluster_index, min_pos, max_pos);
+	const int component = cluster.TileComponents[(pos.y - min_pos.y) * (max_pos.x - min_pos.x + 1) + pos.x - min_pos.x];
+	if (component == -1) {
+		return -1;
+	}
+	return this->ComponentRegions[cluster.ComponentOffset + component];
+}
+
+/**
+**  Plan a route over the cluster graph.
+**
+**  @param startPos  Start tile.
+**  @param goalPos   Goal tile.
+**  @param route     Filled with the tiles of the nodes passed through, followed by the goal.
+**
+**  @return          True if a route was found.
+*/
+bool HPAGraph::FindRoute(const Vec2i &startPos, const Vec2i &goalPos, std::vector<Vec2i> &route)
+{
+	this->Repair();
+
+	route.clear();
+
+	const int start_cluster = this->GetClusterIndex(startPos);
+	const int goal_cluster = this->GetClusterIndex(goalPos);
+
+	// give each node of the graph a global index
+	std::vector<int> cluster_offsets(this->Clusters.size() + 1, 0);
+	for (size_t i = 0; i < this->Clusters.size(); ++i) {
+		cluster_offsets[i + 1] = cluster_offsets[i] + this->Clusters[i].Nodes.size();
+	}
+	const int node_count = cluster_offsets.back();
+	const int goal_node = node_count; // virtual node for the goal tile
+
+	std::vector<int> costs(node_count + 1, -1);
+	std::vector<int> parents(node_count + 1, -1);
+	std::vector<bool> closed(node_count + 1, false);
+	std::priority_queue<std::pair<int, int>, std::vector<std::pair<int, int>>, std::greater<std::pair<int, int>>> open;
+
+	std::vector<int> tile_costs;
+	Vec2i min_pos;
+	Vec2i max_pos;
+
+	// costs from the goal tile to the nodes of its cluster; movement costs are close enough to symmetric for planning
+	this->GetClusterBounds(goal_cluster, min_pos, max_pos);
+	const int goal_cluster_width = max_pos.x - min_pos.x + 1;
+	std::vector<int> goal_costs;
+	this->CalculateClusterCosts(goal_cluster, goalPos, goal_costs);
+	const Vec2i goal_cluster_min_pos = min_pos;
+
+	// start by moving from the start tile to the nodes of its cluster
+	this->GetClusterBounds(start_cluster, min_pos, max_pos);
+	const int start_cluster_width = max_pos.x - min_pos.x + 1;
+	this->CalculateClusterCosts(start_cluster, startPos, tile_costs);
+	const std::vector<HPANode> &start_nodes = this->Clusters[start_cluster].Nodes;
+	for (size_t i = 0; i < start_nodes.size(); ++i) {
+		const Vec2i &pos = start_nodes[i].Pos;
+		const int cost = tile_costs[(pos.y - min_pos.y) * start_cluster_width + pos.x - min_pos.x];
+		if (cost == -1) {
+			continue;
+		}
+		const int node = cluster_offsets[start_cluster] + i;
+		costs[node] = cost;
+		const Vec2i diff = goalPos - pos;
+		open.push(std::pair<int, int>(cost + std::max(abs(diff.x), abs(diff.y)), node));
+	}
+
+	while (!open.empty()) {
+		const int node = open.top().second;
+		open.pop();
+
+		if (closed[node]) {
+			continue;
+		}
+		closed[node] = true;
+
+		if (node == goal_node) {
+			break;
+		}
+
+		const int cluster_index = std::upper_bound(cluster_offsets.begin(), cluster_offsets.end(), node) - cluster_offsets.begin() - 1;
+		const HPACluster &cluster = this->Clusters[cluster_index];
+		const int node_index = node - cluster_offsets[cluster_index];
+		const HPANode &hpa_node = cluster.Nodes[node_index];
+		const int cost = costs[node];
+
+		std::vector<std::pair<int, int>> successors; // pairs of node and cost of moving to it
+
+		// the goal tile, if in this cluster
+		if (cluster_index == goal_cluster) {
+			const int goal_cost = goal_costs[(hpa_node.Pos.y - goal_cluster_min_pos.y) * goal_cluster_width + hpa_node.Pos.x - goal_cluster_min_pos.x];
+			if (goal_cost != -1) {
+				successors.push_back(std::pair<int, int>(goal_node, goal_cost));
+			}
+		}
+
+		// the other nodes of the cluster
+		const size_t cluster_node_count = cluster.Nodes.size();
+		for (size_t i = 0; i < cluster_node_count; ++i) {
+			const int distance = cluster.Distances[node_index * cluster_node_count + i];
+			if ((int) i != node_index && distance != -1) {
+				successors.push_back(std::pair<int, int>(cluster_offsets[cluster_index] + i, distance));
+			}
+		}
+
+		// the nodes of neighboring clusters
+		for (size_t i = 0; i < hpa_node.Exits.size(); ++i) {
+			const Vec2i &exit_pos = hpa_node.Exits[i];
+			const int exit_cluster = this->GetClusterIndex(exit_pos);
+			const int exit_node = this->FindNode(exit_cluster, exit_pos);
+			if (exit_node != -1) {
+				successors.push_back(std::pair<int, int>(cluster_offsets[exit_cluster] + exit_node, 1 + Map.Field(exit_pos, this->MapLayer)->getCost()));
+			}
+		}
+
+		for (size_t i = 0; i < successors.size(); ++i) {
+			const int successor = successors[i].first;
+			const int new_cost = cost + successors[i].second;
+			if (closed[successor] || (costs[successor] != -1 && costs[successor] <= new_cost)) {
+				continue;
+			}
+			costs[successor] = new_cost;
+			parents[successor] = node;
+			int heuristic = 0;
+			if (successor != goal_node) {
+				const int successor_cluster = std::upper_bound(cluster_offsets.begin(), cluster_offsets.end(), successor) - cluster_offsets.begin() - 1;
+				const Vec2i diff = goalPos - this->Clusters[successor_cluster].Nodes[successor - cluster_offsets[successor_cluster]].Pos;
+				heuristic = std::max(abs(diff.x), abs(diff.y));
+			}
+			open.push(std::pair<int, int>(new_cost + heuristic, successor));
+		}
+	}
+
+	if (!closed[goal_node]) {
+		return false;
+	}
+
+	route.push_back(goalPos);
+	for (int node = parents[goal_node]; node != -1; node = parents[node]) {
+		const int cluster_index = std::upper_bound(cluster_offsets.begin(), cluster_offsets.end(), node) - cluster_offsets.begin() - 1;
+		route.push_back(this->Clusters[cluster_index].Nodes[node - cluster_offsets[cluster_index]].Pos);
+	}
+	std::reverse(route.begin(), route.end());
+	return true;
+}
+
+/**
+**  Get the cluster graph of a map layer for a unit, creating it if necessary.
+*/
+static HPAGraph *GetHPAGraph(const CUnit &unit, int z)
+{
+	const int player = AStarKnowUnseenTerrain ? -1 : unit.Player->Index;
+	HPAGraph *&graph = HPAGraphs[z][std::pair<int, int>(unit.Type->MovementMask, player)];
+	if (!graph) {
+		graph = new HPAGraph(z, unit.Type->MovementMask, player);
+	}
+	return graph;
+}
+
+/**
+**  Init the hierarchical pathfinder.
+*/
+void InitHierarchicalPathfinder()
+{
+	HPAGraphs.resize(Map.Fields.size());
+}
+
+/**
+**  Free the hierarchical pathfinder.
+*/
+void FreeHierarchicalPathfinder()
+{
+	for (size_t z = 0; z < HPAGraphs.size(); ++z) {
+		for (std::map<std::pair<int, int>, HPAGraph *>::iterator iterator = HPAGraphs[z].begin(); iterator != HPAGraphs[z].end(); ++iterator) {
+			delete iterator->second;
+		}
+	}
+	HPAGraphs.clear();
+}
+
+/**
+**  Tell the hierarchical pathfinder that the passability of a tile may have changed.
+**
+**  @param pos  Map tile position.
+**  @param z    Map layer.
+*/
+void HierarchicalPathfinderTileChanged(const Vec2i &pos, int z)
+{
+	if (z >= (int) HPAGraphs.size()) {
+		return;
+	}
+
+	for (std::map<std::pair<int, int>, HPAGraph *>::iterator iterator = HPAGraphs[z].begin(); iterator != HPAGraphs[z].end(); ++iterator) {
+		iterator->second->MarkDirty(pos);
+	}
+}
+
+/**
+**  Tell the hierarchical pathfinder that a player explored a tile for the first time.
+**
+**  Only the graphs of the player's team in which the tile can't be passed
+**  through have to be repaired, as it was passable while unexplored.
+**
+**  @param player  The player.
+**  @param pos     Map tile position.
+**  @param z       Map layer.
+*/
+void HierarchicalPathfinderTileExplored(const CPlayer &player, const Vec2i &pos, int z)
+{
+	if (z >= (int) HPAGraphs.size()) {
+		return;
+	}
+
+	for (std::map<std::pair<int, int>, HPAGraph *>::iterator iterator = HPAGraphs[z].begin(); iterator != HPAGraphs[z].end(); ++iterator) {
+		HPAGraph &graph = *iterator->second;
+		if ((graph.TeamMask & (1 << player.Index)) && !graph.IsTerrainPassable(pos)) {
+			graph.MarkDirty(pos);
+		}
+	}
+}
+
+/**
+**  Tell the hierarchical pathfinder that which tiles players count as explored changed wholesale.
+**
+**  Called when the map is revealed or shared vision changes; the graphs
+**  built from explored terrain are dropped, to be built again when needed.
+*/
+void HierarchicalPathfinderExplorationChanged()
+{
+	for (size_t z = 0; z < HPAGraphs.size(); ++z) {
+		std::map<std::pair<int, int>, HPAGraph *>::iterator iterator = HPAGraphs[z].begin();
+		while (iterator != HPAGraphs[z].end()) {
+			if (iterator->second->Player != -1) {
+				delete iterator->second;
+				HPAGraphs[z].erase(iterator++);
+			} else {
+				++iterator;
+			}
+		}
+	}
+}
+
+/**
+**  Get the next waypoint for a unit travelling to a far away goal.
+**
+**  @param unit      The unit.
+**  @param goalPos   Goal tile.
+**  @param range     How far from the goal tile the unit may stop.
+**  @param z         Map layer of the goal.
+**  @param waypoint  Set to the tile to which the unit should path next.
+**
+**  @return          True if a waypoint was set, false if the tile a* should be used directly.
+*/
+bool HierarchicalPathfinderGetWaypoint(const CUnit &unit, const Vec2i &goalPos, int range, int z, Vec2i &waypoint)
+{
+	if (unit.MapLayer != z || z >= (int) HPAGraphs.size()) {
+		return false;
+	}
+
+	// the clusters are built for units of one tile which can move diagonally
+	if (unit.Type->TileWidth != 1 || unit.Type->TileHeight != 1 || unit.Type->BoolFlag[RAIL_INDEX].value) {
+		return false;
+	}
+
+	const Vec2i diff = goalPos - unit.tilePos;
+	if (std::max(abs(diff.x), abs(diff.y)) <= HPA_MIN_DISTANCE + range) {
+		return false;
+	}
+
+	std::vector<Vec2i> route;
+	if (!GetHPAGraph(unit, z)->FindRoute(unit.tilePos, goalPos, route)) {
+		return false;
+	}
+
+	waypoint = unit.tilePos;
+
+	// path to the furthest node of the route which is still close by
+	for (size_t i = 0; i < route.size(); ++i) {
+		const Vec2i node_diff = route[i] - unit.tilePos;
+		if (std::max(abs(node_diff.x), abs(node_diff.y)) > HPA_WAYPOINT_DISTANCE) {
+			break;
+		}
+		if (route[i] == goalPos) {
+			return false;
+		}
+		waypoint = route[i];
+	}
+
+	return waypoint != unit.tilePos;
+}
+
+/**
+**  Check whether a goal may be reachable for a unit, using the connected regions.
+**
+**  Only terrain and buildings are taken into account, so a goal which may
+**  be reachable still needs to be checked with the tile a*.
+**
+**  @param unit     The unit.
+**  @param goalPos  Goal tile.
+**  @param w        Width of the goal.
+**  @param h        Height of the goal.
+**  @param range    Range to the goal.
+**  @param z        Map layer of the goal.
+**
+**  @return         False if the goal can't be reached.
+*/
+bool HierarchicalPathfinderMayReach(const CUnit &unit, const Vec2i &goalPos, int w, int h, int range, int z)
+{
+	if (unit.MapLayer != z || z >= (int) HPAGraphs.size()) {
+		return true;
+	}
+
+	HPAGraph &graph = *GetHPAGraph(unit, z);
+	const int region = graph.GetRegion(unit.tilePos);
+	if (region == -1) {
+		// the unit isn't on a passable tile (i.e. it is inside a building), so nothing can be told
+		return true;
+	}
+
+	// the tiles from which the goal may be reached, as a superset of what the tile a* accepts
+	const int margin = std::max(range, 1);
+	const Vec2i min_pos(std::max(goalPos.x - margin - unit.Type->TileWidth + 1, 0), std::max(goalPos.y - margin - unit.Type->TileHeight + 1, 0));
+	const Vec2i max_pos(std::min(goalPos.x + w - 1 + margin, Map.Info.MapWidths[z] - 1), std::min(goalPos.y + h - 1 + margin, Map.Info.MapHeights[z] - 1));
+	if ((max_pos.x - min_pos.x + 1) * (max_pos.y - min_pos.y + 1) > HPA_MAX_REACH_AREA) {
+		return true;
+	}
+
+	for (int y = min_pos.y; y <= max_pos.y; ++y) {
+		for (int x = min_pos.x; x <= max_pos.x; ++x) {
+			if (graph.GetRegion(Vec2i(x, y)) == region) {
+				return true;
+			}
+		}
+	}
+	return false;
+}
+
+//@}
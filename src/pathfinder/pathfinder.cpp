@@ -44,6 +44,10 @@
 #include "unittype.h"
 #include "unit.h"
 
+//Wyrmgus start
+#include "SDL.h"
+//Wyrmgus end
+
 //astar.cpp
 
 /// Init the a* data structures
@@ -71,6 +75,56 @@ extern int AStarFindPath(const Vec2i &startPos, const Vec2i &goalPos, int gw, in
 --  Variables
 ----------------------------------------------------------------------------*/
 
+//Wyrmgus start
+/**
+**  Path requests are made by units while they act in a game cycle, and
+**  are all solved together once the units have acted, by worker threads
+**  and the game logic thread (see CompletePathRequests()). The game logic
+**  thread waits for the requests to be solved, so the game state doesn't
+**  change while the threads read it, the paths found don't depend on the
+**  timing of the threads, and each unit gets its path at a fixed game
+**  cycle, which keeps multiplayer games and replays in sync. No requests
+**  are left pending between game cycles, so there are none to be saved.
+*/
+
+#define PATH_REQUEST_THREADS 3
+
+/// How many solved path requests in a row may be discarded because the goal changed, before the path is found right away
+#define PATH_REQUEST_MAX_RETRIES 2
+
+/**
+**  A path request, with a copy of the unit's path finder input as it was
+**  when the request was made.
+*/
+class PathRequest
+{
+public:
+	PathRequest() : Unit(NULL), Valid(false), HasWaypoint(false), Result(PF_FAILED) {}
+
+	CUnit *Unit;
+	PathFinderInput Input;
+	bool Valid;              /// whether the request is still to be solved
+	bool HasWaypoint;        /// whether to path to the waypoint instead of to the goal
+	Vec2i Waypoint;          /// the next waypoint of the hierarchical route to the goal
+	PathFinderOutput Output;
+	int Result;
+};
+
+static std::vector<PathRequest> PathRequests;           /// the path requests made in the current game cycle
+static size_t NextPathRequest = 0;                      /// index of the next path request to be solved
+static size_t SolvedPathRequests = 0;                   /// number of dispatched path requests solved
+static bool PathRequestsDispatched = false;             /// whether the path requests are being solved
+static bool PathRequestThreadsRunning = false;
+static std::vector<SDL_Thread *> PathRequestThreads;
+static SDL_mutex *PathRequestMutex = NULL;
+static SDL_cond *PathRequestCond = NULL;                /// signalled when path requests are dispatched
+static SDL_cond *PathRequestsSolvedCond = NULL;         /// signalled when all dispatched path requests are solved
+
+static void InitPathRequests();
+static void FreePathRequests();
+static void DropPathRequests();
+//Wyrmgus end
+
 void TerrainTraversal::SetSize(unsigned int width, unsigned int height)
 {
 	m_values.resize((width + 2) * (height + 2));
@@ -182,6 +236,8 @@ void InitPathfinder()
 	//Wyrmgus start
 //	InitAStar(Map.Info.MapWidth, Map.Info.MapHeight);
 	InitAStar();
+	InitHierarchicalPathfinder();
+	InitPathRequests();
 	//Wyrmgus end
 }
 
@@ -190,7 +246,13 @@ void InitPathfinder()
 */
 void FreePathfinder()
 {
+	//Wyrmgus start
+	FreePathRequests();
+	//Wyrmgus end
 	FreeAStar();
+	//Wyrmgus start
+	FreeHierarchicalPathfinder();
+	//Wyrmgus end
 }
 
 /*----------------------------------------------------------------------------
@@ -221,8 +283,14 @@ int PlaceReachable(const CUnit &src, const Vec2i &goalPos, int w, int h, int min
 	//Wyrmgus end
 	
 	int i = PF_FAILED;
+	//Wyrmgus start
+	if ((!src.Container || !from_outside_container) && !HierarchicalPathfinderMayReach(src, goalPos, w, h, range, z)) {
+		return 0;
+	}
+	//Wyrmgus end
+	AStarContextLease context;
 	if (!src.Container || !from_outside_container) {
-		i = AStarFindPath(src.tilePos, goalPos, w, h,
+		i = AStarFindPath(*context, src.tilePos, goalPos, w, h,
 						  src.Type->TileWidth, src.Type->TileHeight,
 						  minrange, range, NULL, 0, src, max_length, z);
 	} else {
@@ -238,7 +306,7 @@ int PlaceReachable(const CUnit &src, const Vec2i &goalPos, int w, int h, int min
 				if (!Map.Info.IsPointOnMap(it, src.Container->MapLayer)) {
 					continue;
 				}
-				temp_i = AStarFindPath(it, goalPos, w, h,
+				temp_i = AStarFindPath(*context, it, goalPos, w, h,
 						  src.Type->TileWidth, src.Type->TileHeight,
 						  minrange, range, NULL, 0, src, max_length, z);
 						  
@@ -420,19 +488,47 @@ PathFinderOutput::PathFinderOutput()
 **  @return      >0 remaining path length, 0 wait for path, -1
 **               reached goal, -2 can't reach the goal.
 */
-static int NewPath(PathFinderInput &input, PathFinderOutput &output)
+//Wyrmgus start
+//static int NewPath(PathFinderInput &input, PathFinderOutput &output)
+static int NewPath(PathFinderInput &input, PathFinderOutput &output, const Vec2i *waypoint)
+//Wyrmgus end
 {
 	char *path = output.Path;
+	//Wyrmgus start
+	AStarContextLease context;
+
+	// for far away goals, only path to the next waypoint of the hierarchical route;
+	// the search is bounded, so that if it fails (i.e. because units are in the
+	// way) the full search made afterwards costs little more than on its own
+	int i = PF_FAILED;
+	if (waypoint != NULL) {
+		i = AStarFindPath(*context, input.GetUnitPos(), *waypoint, 0, 0,
+						  input.GetUnitSize().x, input.GetUnitSize().y, 0, 0,
+						  path, PathFinderOutput::MAX_PATH_LENGTH,
+						  *input.GetUnit(), PF_WAYPOINT_MAX_EXPANDED_NODES, input.GetGoalMapLayer());
+		if (i <= 0) {
+			i = PF_FAILED;
+		}
+	}
+
+	if (i == PF_FAILED) {
+		i = AStarFindPath(*context, input.GetUnitPos(), input.GetGoalPos(),
+						  input.GetGoalSize().x, input.GetGoalSize().y,
+						  input.GetUnitSize().x, input.GetUnitSize().y,
+						  input.GetMinRange(), input.GetMaxRange(),
+						  path, PathFinderOutput::MAX_PATH_LENGTH,
+						  *input.GetUnit(), 0, input.GetGoalMapLayer());
+	}
+	/*
 	int i = AStarFindPath(input.GetUnitPos(),
 						  input.GetGoalPos(),
 						  input.GetGoalSize().x, input.GetGoalSize().y,
 						  input.GetUnitSize().x, input.GetUnitSize().y,
 						  input.GetMinRange(), input.GetMaxRange(),
 						  path, PathFinderOutput::MAX_PATH_LENGTH,
-						  //Wyrmgus start
-//						  *input.GetUnit());
-						  *input.GetUnit(), 0, input.GetGoalMapLayer());
-						  //Wyrmgus end
+						  *input.GetUnit());
+	*/
+	//Wyrmgus end
 	input.PathRacalculated();
 	if (i == PF_FAILED) {
 		i = PF_UNREACHABLE;
@@ -449,6 +545,219 @@ static int NewPath(PathFinderInput &input, PathFinderOutput &output)
 	return i;
 }
 
+//Wyrmgus start
+/**
+**  Get the next waypoint for a path, if its goal is far away.
+**
+**  Must be called from the game logic thread.
+*/
+static bool GetPathWaypoint(const PathFinderInput &input, Vec2i &waypoint)
+{
+	const int range = input.GetMaxRange() + std::max(input.GetGoalSize().x, input.GetGoalSize().y);
+	return HierarchicalPathfinderGetWaypoint(*input.GetUnit(), input.GetGoalPos(), range, input.GetGoalMapLayer(), waypoint);
+}
+
+static int NewPath(PathFinderInput &input, PathFinderOutput &output)
+{
+	Vec2i waypoint;
+	const bool has_waypoint = GetPathWaypoint(input, waypoint);
+	return NewPath(input, output, has_waypoint ? &waypoint : NULL);
+}
+
+/**
+**  Solve the dispatched path requests, until there are none left.
+**
+**  Called by the worker threads, and by the game logic thread while waiting for them.
+*/
+static void SolvePathRequests()
+{
+	SDL_LockMutex(PathRequestMutex);
+	while (PathRequestsDispatched && NextPathRequest < PathRequests.size()) {
+		PathRequest &request = PathRequests[NextPathRequest++];
+		SDL_UnlockMutex(PathRequestMutex);
+
+		if (request.Valid) {
+			request.Result = NewPath(request.Input, request.Output, request.HasWaypoint ? &request.Waypoint : NULL);
+		}
+
+		SDL_LockMutex(PathRequestMutex);
+		++SolvedPathRequests;
+		if (SolvedPathRequests == PathRequests.size()) {
+			SDL_CondSignal(PathRequestsSolvedCond);
+		}
+	}
+	SDL_UnlockMutex(PathRequestMutex);
+}
+
+static int PathRequestThread(void *)
+{
+	SDL_LockMutex(PathRequestMutex);
+	while (PathRequestThreadsRunning) {
+		if (PathRequestsDispatched && NextPathRequest < PathRequests.size()) {
+			SDL_UnlockMutex(PathRequestMutex);
+			SolvePathRequests();
+			SDL_LockMutex(PathRequestMutex);
+		} else {
+			SDL_CondWait(PathRequestCond, PathRequestMutex);
+		}
+	}
+	SDL_UnlockMutex(PathRequestMutex);
+
+	return 0;
+}
+
+static void InitPathRequests()
+{
+	if (PathRequestThreadsRunning) {
+		return;
+	}
+
+	PathRequestMutex = SDL_CreateMutex();
+	PathRequestCond = SDL_CreateCond();
+	PathRequestsSolvedCond = SDL_CreateCond();
+	PathRequestThreadsRunning = true;
+	for (int i = 0; i < PATH_REQUEST_THREADS; ++i) {
+		PathRequestThreads.push_back(SDL_CreateThread(PathRequestThread, NULL));
+	}
+}
+
+static void FreePathRequests()
+{
+	if (!PathRequestThreadsRunning) {
+		return;
+	}
+
+	DropPathRequests();
+
+	SDL_LockMutex(PathRequestMutex);
+	PathRequestThreadsRunning = false;
+	SDL_CondBroadcast(PathRequestCond);
+	SDL_UnlockMutex(PathRequestMutex);
+	for (size_t i = 0; i < PathRequestThreads.size(); ++i) {
+		SDL_WaitThread(PathRequestThreads[i], NULL);
+	}
+	PathRequestThreads.clear();
+
+	SDL_DestroyCond(PathRequestsSolvedCond);
+	SDL_DestroyCond(PathRequestCond);
+	SDL_DestroyMutex(PathRequestMutex);
+	PathRequestsSolvedCond = NULL;
+	PathRequestCond = NULL;
+	PathRequestMutex = NULL;
+}
+
+/**
+**  Request a new path for a unit, which will be available by the next game cycle.
+*/
+static void RequestPath(CUnit &unit)
+{
+	PathFinderData &data = *unit.pathFinderData;
+
+	if (data.RequestState != PathRequestPending) {
+		data.RequestState = PathRequestPending;
+		data.RequestIndex = PathRequests.size();
+		PathRequests.push_back(PathRequest());
+	}
+
+	PathRequest &request = PathRequests[data.RequestIndex];
+	request.Unit = &unit;
+	request.Input = data.input;
+	data.input.PathRacalculated();
+	data.output.Length = 0;
+}
+
+/**
+**  Start solving the path requests made during the game cycle.
+**
+**  Until they have been solved, the game state must not be changed.
+*/
+static void DispatchPathRequests()
+{
+	if (PathRequests.empty() || PathRequestsDispatched) {
+		return;
+	}
+
+	for (size_t i = 0; i < PathRequests.size(); ++i) {
+		PathRequest &request = PathRequests[i];
+		CUnit &unit = *request.Unit;
+		request.Valid = unit.Type != NULL && !unit.Destroyed && unit.IsAliveOnMap() && unit.pathFinderData->RequestState == PathRequestPending && unit.pathFinderData->RequestIndex == (int) i;
+		if (request.Valid) {
+			request.HasWaypoint = GetPathWaypoint(request.Input, request.Waypoint);
+		}
+	}
+
+	SDL_LockMutex(PathRequestMutex);
+	NextPathRequest = 0;
+	SolvedPathRequests = 0;
+	PathRequestsDispatched = true;
+	SDL_CondBroadcast(PathRequestCond);
+	SDL_UnlockMutex(PathRequestMutex);
+}
+
+/**
+**  Drop the path requests which haven't been solved, i.e. when the game ends.
+*/
+static void DropPathRequests()
+{
+	for (size_t i = 0; i < PathRequests.size(); ++i) {
+		CUnit &unit = *PathRequests[i].Unit;
+		if (unit.Type != NULL && unit.pathFinderData->RequestIndex == (int) i) {
+			unit.pathFinderData->RequestState = PathRequestNone;
+			unit.pathFinderData->RequestIndex = -1;
+		}
+	}
+	PathRequests.clear();
+}
+
+/**
+**  Solve the path requests made during the game cycle, and store their paths in the units.
+**
+**  Called once the units have acted in a game cycle, so that their paths
+**  are available when they act in the next one.
+*/
+void CompletePathRequests()
+{
+	if (PathRequests.empty()) {
+		return;
+	}
+
+	DispatchPathRequests();
+	SolvePathRequests();
+
+	SDL_LockMutex(PathRequestMutex);
+	while (SolvedPathRequests < PathRequests.size()) {
+		SDL_CondWait(PathRequestsSolvedCond, PathRequestMutex);
+	}
+	PathRequestsDispatched = false;
+	SDL_UnlockMutex(PathRequestMutex);
+
+	for (size_t i = 0; i < PathRequests.size(); ++i) {
+		const PathRequest &request = PathRequests[i];
+		CUnit &unit = *request.Unit;
+		if (unit.Type == NULL) {
+			continue;
+		}
+
+		PathFinderData &data = *unit.pathFinderData;
+		if (data.RequestState != PathRequestPending || data.RequestIndex != (int) i) {
+			continue;
+		}
+
+		data.RequestIndex = -1;
+		if (!request.Valid) {
+			// the unit left the map, so it will have to make a new request
+			data.RequestState = PathRequestNone;
+			continue;
+		}
+		data.RequestState = PathRequestCompleted;
+		data.RequestResult = request.Result;
+		data.output.Length = request.Output.Length;
+		memcpy(data.output.Path, request.Output.Path, sizeof(data.output.Path));
+	}
+	PathRequests.clear();
+}
+//Wyrmgus end
+
 /**
 **  Returns the next element of a path.
 **
@@ -470,9 +779,41 @@ int NextPathElement(CUnit &unit, short int *pxd, short int *pyd)
 	*pxd = 0;
 	*pyd = 0;
 
+	//Wyrmgus start
+	PathFinderData &data = *unit.pathFinderData;
+	bool path_request_completed = false;
+	bool path_request_after_blocked = false;
+	if (data.RequestState == PathRequestCompleted) {
+		data.RequestState = PathRequestNone;
+		path_request_after_blocked = data.RequestAfterBlocked;
+		data.RequestAfterBlocked = false;
+		if (!input.IsRecalculateNeeded()) {
+			path_request_completed = true;
+			data.RequestRetries = 0;
+		} else {
+			// the goal changed since the request was made (i.e. it is a moving unit)
+			++data.RequestRetries;
+		}
+	}
+	//Wyrmgus end
+
 	// Goal has moved, need to recalculate path or no cached path
-	if (output.Length <= 0 || input.IsRecalculateNeeded()) {
-		const int result = NewPath(input, output);
+	//Wyrmgus start
+//	if (output.Length <= 0 || input.IsRecalculateNeeded()) {
+//		const int result = NewPath(input, output);
+	if (path_request_completed || output.Length <= 0 || input.IsRecalculateNeeded()) {
+		int result;
+		if (path_request_completed) {
+			result = data.RequestResult;
+		} else if (data.RequestRetries >= PATH_REQUEST_MAX_RETRIES) {
+			// the goal keeps changing before the requests are solved, so don't make the unit wait any longer
+			data.RequestRetries = 0;
+			result = NewPath(input, output);
+		} else {
+			RequestPath(unit);
+			return PF_WAIT;
+		}
+	//Wyrmgus end
 
 		if (result == PF_UNREACHABLE) {
 			output.Length = 0;
@@ -490,7 +831,13 @@ int NextPathElement(CUnit &unit, short int *pxd, short int *pyd)
 	output.Length--;
 	//Wyrmgus start
 //	if (!UnitCanBeAt(unit, unit.tilePos + dir)) {
-	if (!UnitCanBeAt(unit, unit.tilePos + dir, unit.MapLayer)) {
+	if (path_request_after_blocked && !UnitCanBeAt(unit, unit.tilePos + dir, unit.MapLayer)) {
+		// There may be unit in the way, Astar may allow you to walk onto it.
+		++output.Length;
+		result = PF_UNREACHABLE;
+		*pxd = 0;
+		*pyd = 0;
+	} else if (!UnitCanBeAt(unit, unit.tilePos + dir, unit.MapLayer)) {
 	//Wyrmgus end
 		// If obstructing unit is moving, wait for a bit.
 		if (output.Fast) {
@@ -504,6 +851,14 @@ int NextPathElement(CUnit &unit, short int *pxd, short int *pyd)
 		}
 		if (output.Fast == 0 && result != 0) {
 			AstarDebugPrint("WAIT expired\n");
+			//Wyrmgus start
+			// the new path is checked for the obstruction once the request is solved
+			RequestPath(unit);
+			data.RequestAfterBlocked = true;
+			*pxd = 0;
+			*pyd = 0;
+			return PF_WAIT;
+			/*
 			result = NewPath(input, output);
 			if (result > 0) {
 				*pxd = Heading2X[(int)output.Path[(int)output.Length - 1]];
@@ -521,6 +876,8 @@ int NextPathElement(CUnit &unit, short int *pxd, short int *pyd)
 					output.Length--;
 				}
 			}
+			*/
+			//Wyrmgus end
 		}
 	}
 	if (result != PF_WAIT) {
@@ -101,12 +101,46 @@ static int CclAStar(lua_State *l)
 	return 0;
 }
 
+//Wyrmgus start
+/**
+**  Start or stop recording the path queries made to the pathfinder.
+**
+**  @param l  Lua state.
+*/
+static int CclRecordPathQueries(lua_State *l)
+{
+	LuaCheckArgs(l, 1);
+	SetAStarRecordQueries(LuaToBoolean(l, 1));
+	return 0;
+}
+
+/**
+**  Replay the recorded path queries and print how long they took.
+**
+**  @param l  Lua state.
+*/
+static int CclReplayPathQueries(lua_State *l)
+{
+	const int args = lua_gettop(l);
+	if (args > 1) {
+		LuaError(l, "incorrect argument");
+	}
+	const int repeat = args == 1 ? LuaToNumber(l, 1) : 1;
+	AStarReplayQueries(repeat);
+	return 0;
+}
+//Wyrmgus end
+
 /**
 **  Register CCL features for pathfinder.
 */
 void PathfinderCclRegister()
 {
 	lua_register(Lua, "AStar", CclAStar);
+	//Wyrmgus start
+	lua_register(Lua, "RecordPathQueries", CclRecordPathQueries);
+	lua_register(Lua, "ReplayPathQueries", CclReplayPathQueries);
+	//Wyrmgus end
 }
 
 //@}
@@ -57,6 +57,14 @@
 
 #include "SDL.h"
 
+//Wyrmgus start
+#include <atomic>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+//Wyrmgus end
+
 #ifdef USE_OAML
 #include <oaml.h>
 #endif
@@ -113,6 +121,39 @@ static struct {
 	bool Running;
 } Audio;
 
+//Wyrmgus start
+#define MUSIC_RING_SIZE 131072	/// number of 16 bit samples in the music ring buffer, must be a power of two
+#define MUSIC_DECODE_SIZE 8192	/// number of 16 bit samples decoded at once into the music ring buffer
+
+/// A replacement of the music sample, handed by the main thread to the music decoder thread
+struct MusicSampleChange {
+	CSample *Sample;			/// new music sample, or NULL to stop the music
+	unsigned int Generation;	/// generation of the music which the change starts
+};
+
+/**
+**  Music decoded ahead of the mixer in the output format, so that the mixer never has to read or convert the music itself
+**
+**  The music sample (MusicChannel.Sample) belongs to the decoder thread, which reads and converts it without holding any
+**  lock. Replacing it only publishes a MusicSampleChange, which the decoder takes before decoding its next part; each
+**  replacement starts a new generation of the music, and the mixer skips what was decoded for older generations.
+*/
+static struct {
+	short *Ring;							/// ring buffer of decoded samples
+	std::atomic<unsigned int> ReadPos;		/// how many samples the mixer consumed from the ring buffer
+	std::atomic<unsigned int> WritePos;		/// how many samples the decoder wrote to the ring buffer
+	std::atomic<unsigned int> StartPos;		/// value of WritePos when the decoder started decoding the generation it is decoding
+	std::atomic<unsigned int> DecodedGeneration;	/// generation of the music which the decoder is decoding
+	std::atomic<unsigned int> Generation;	/// generation of the last music sample set, increased each time it is replaced
+	std::atomic<MusicSampleChange *> PendingChange;	/// replacement of the music sample not yet taken by the decoder
+	std::atomic<bool> Finished;				/// whether the decoder reached the end of the music sample
+	std::vector<char> Buffer;				/// raw data read from the music sample, converted in place
+	SDL_mutex *Lock;						/// only used to wait for the condition
+	SDL_cond *Cond;							/// signalled when there is room in the ring buffer or a new music sample
+	SDL_Thread *Thread;
+} MusicDecoder;
+//Wyrmgus end
+
 #ifdef USE_OAML
 #ifndef SDL_AUDIO_BITSIZE
 #define SDL_AUDIO_BITSIZE(x) (x&0xFF)
@@ -160,17 +201,203 @@ static int ConvertToStereo32(const char *src, char *dest, int frequency,
 	return acvt.len_mult * bytes;
 }
 
+//Wyrmgus start
+/**
+**  Check whether a sample is already in the output format (44100 hz, stereo, 16 bits per channel)
+**
+**  @param sample  Sample to check
+*/
+static bool SampleIsInOutputFormat(const CSample &sample)
+{
+	return sample.Frequency == 44100 && sample.SampleSize == 16 && sample.Channels == 2;
+}
+
+/**
+**  Convert a sample loaded in memory to the output format, so that it does not have to be converted each time it is mixed
+**
+**  @param sample  Sample to convert
+*/
+static void ConvertSampleToOutputFormat(CSample &sample)
+{
+	if (sample.Buffer == NULL || sample.Channels == 0 || sample.SampleSize < 8) {
+		return;
+	}
+	
+	//only convert whole frames
+	const int frame_size = sample.Channels * (sample.SampleSize / 8);
+	const int len = sample.Len - sample.Len % frame_size;
+	
+	if (!SampleIsInOutputFormat(sample)) {
+		SDL_AudioCVT acvt;
+		if (SDL_BuildAudioCVT(&acvt, sample.SampleSize == 8 ? AUDIO_U8 : AUDIO_S16SYS, sample.Channels, sample.Frequency, AUDIO_S16SYS, 2, 44100) < 0) {
+			return;
+		}
+		
+		unsigned char *buffer = new unsigned char[len * acvt.len_mult];
+		memcpy(buffer, sample.Buffer, len);
+		acvt.buf = buffer;
+		acvt.len = len;
+		if (SDL_ConvertAudio(&acvt) < 0) {
+			delete[] buffer;
+			return;
+		}
+		
+		delete[] sample.Buffer;
+		sample.Buffer = buffer;
+		sample.Len = acvt.len_cvt;
+		sample.Frequency = 44100;
+		sample.SampleSize = 16;
+		sample.BitsPerSample = 16;
+		sample.Channels = 2;
+	}
+	
+	//the mixer advances through the sample a frame at a time, so its length must be a whole number of frames for it to be seen as finished
+	sample.Len -= sample.Len % 4;
+}
+
+/**
+**  Add stereo 16 bit samples to the stereo 32 bit mix, scaled by a gain for each side.
+**
+**  @param src         Input samples, interleaved left and right.
+**  @param buffer      Buffer for mixed samples.
+**  @param size        Number of samples to add (counting both sides).
+**  @param left_gain   Gain of the left side, in 65536ths.
+**  @param right_gain  Gain of the right side, in 65536ths.
+*/
+static void MixStereo16ToStereo32(const short *src, int *buffer, int size, int left_gain, int right_gain)
+{
+	int i = 0;
+	
+#ifdef __SSE2__
+	const __m128i gains = _mm_set_epi16(right_gain, left_gain, right_gain, left_gain, right_gain, left_gain, right_gain, left_gain);
+	for (; i + 8 <= size; i += 8) {
+		const __m128i scaled = _mm_mulhi_epi16(_mm_loadu_si128((const __m128i *)(src + i)), gains);
+		const __m128i low = _mm_srai_epi32(_mm_unpacklo_epi16(scaled, scaled), 16);
+		const __m128i high = _mm_srai_epi32(_mm_unpackhi_epi16(scaled, scaled), 16);
+		_mm_storeu_si128((__m128i *)(buffer + i), _mm_add_epi32(_mm_loadu_si128((const __m128i *)(buffer + i)), low));
+		_mm_storeu_si128((__m128i *)(buffer + i + 4), _mm_add_epi32(_mm_loadu_si128((const __m128i *)(buffer + i + 4)), high));
+	}
+#endif
+	
+	for (; i + 1 < size; i += 2) {
+		buffer[i] += (src[i] * left_gain) >> 16;
+		buffer[i + 1] += (src[i + 1] * right_gain) >> 16;
+	}
+}
+
+/**
+**  Decode the next part of the music sample into the music ring buffer.
+**
+**  Only called by the music decoder thread, and there must be room for at least twice MUSIC_DECODE_SIZE samples in the ring buffer.
+*/
+static void DecodeMusic()
+{
+	CSample &sample = *MusicChannel.Sample;
+	
+	SDL_AudioCVT acvt;
+	if (sample.Channels == 0 || sample.SampleSize < 8 || SDL_BuildAudioCVT(&acvt, sample.SampleSize == 8 ? AUDIO_U8 : AUDIO_S16SYS, sample.Channels, sample.Frequency, AUDIO_S16SYS, 2, 44100) < 0) {
+		MusicDecoder.Finished = true;
+		return;
+	}
+	
+	//read as many whole frames as give about MUSIC_DECODE_SIZE samples once converted
+	const int frame_size = sample.Channels * (sample.SampleSize / 8);
+	const int len = std::max(frame_size, (int) ((long long) MUSIC_DECODE_SIZE * sizeof(short) * sample.Frequency * frame_size / 176400) / frame_size * frame_size);
+	if ((int) MusicDecoder.Buffer.size() < len * acvt.len_mult) {
+		MusicDecoder.Buffer.resize(len * acvt.len_mult);
+	}
+	
+	const int read = sample.Read(&MusicDecoder.Buffer[0], len);
+	
+	acvt.buf = (Uint8 *) &MusicDecoder.Buffer[0];
+	acvt.len = read;
+	const int count = (read > 0 && SDL_ConvertAudio(&acvt) == 0) ? std::min(acvt.len_cvt / (int) sizeof(short), MUSIC_DECODE_SIZE * 2) & ~1 : 0;
+	
+	const short *samples = (const short *) &MusicDecoder.Buffer[0];
+	const unsigned int write_pos = MusicDecoder.WritePos.load(std::memory_order_relaxed);
+	for (int i = 0; i < count; ++i) {
+		MusicDecoder.Ring[(write_pos + i) & (MUSIC_RING_SIZE - 1)] = samples[i];
+	}
+	MusicDecoder.WritePos.store(write_pos + count, std::memory_order_release);
+	
+	if (read < len) { // End reached
+		MusicDecoder.Finished = true;
+	}
+}
+
+/**
+**  Music decoder thread.
+*/
+static int MusicDecoderThread(void *)
+{
+	while (Audio.Running == true) {
+		MusicSampleChange *change = MusicDecoder.PendingChange.exchange(NULL, std::memory_order_acquire);
+		if (change != NULL) {
+			delete MusicChannel.Sample;
+			MusicChannel.Sample = change->Sample;
+			MusicDecoder.Finished = false;
+			MusicDecoder.StartPos.store(MusicDecoder.WritePos.load(std::memory_order_relaxed), std::memory_order_relaxed);
+			MusicDecoder.DecodedGeneration.store(change->Generation, std::memory_order_release);
+			delete change;
+		}
+		
+		//the sample is freed here as soon as it has been decoded to its end, so that the mixer never has to free it
+		if (MusicChannel.Sample != NULL && MusicDecoder.Finished) {
+			delete MusicChannel.Sample;
+			MusicChannel.Sample = NULL;
+		}
+		
+		const unsigned int used = MusicDecoder.WritePos.load(std::memory_order_relaxed) - MusicDecoder.ReadPos.load(std::memory_order_acquire);
+		if (MusicChannel.Sample == NULL || MusicDecoder.Finished || MUSIC_RING_SIZE - used < MUSIC_DECODE_SIZE * 2) {
+			SDL_LockMutex(MusicDecoder.Lock);
+			if (MusicDecoder.PendingChange.load(std::memory_order_relaxed) == NULL) {
+				SDL_CondWaitTimeout(MusicDecoder.Cond, MusicDecoder.Lock, 100);
+			}
+			SDL_UnlockMutex(MusicDecoder.Lock);
+		} else {
+			DecodeMusic();
+		}
+	}
+
+	return 0;
+}
+
+/**
+**  Replace the music sample, discarding what was decoded of the previous one.
+**
+**  Doesn't wait for the music decoder: the change is only published, and the decoder deletes the previous sample when it takes it.
+**  Only called by the main thread, as it allocates the change and may free a superseded sample; never by the mixer.
+**  The audio lock must be held, so that the generation of the music doesn't change while the mixer reads the music ring buffer.
+**
+**  @param sample  New music sample, or NULL.
+*/
+static void SetMusicSample(CSample *sample)
+{
+	MusicSampleChange *change = new MusicSampleChange;
+	change->Sample = sample;
+	change->Generation = MusicDecoder.Generation.load(std::memory_order_relaxed) + 1;
+	MusicDecoder.Generation.store(change->Generation, std::memory_order_relaxed);
+	
+	//a change which the decoder didn't take yet is superseded, and its sample was never touched by the decoder
+	MusicSampleChange *superseded = MusicDecoder.PendingChange.exchange(change, std::memory_order_acq_rel);
+	if (superseded != NULL) {
+		delete superseded->Sample;
+		delete superseded;
+	}
+	SDL_CondSignal(MusicDecoder.Cond);
+}
+//Wyrmgus end
+
 /**
 **  Mix music to stereo 32 bit.
 **
 **  @param buffer  Buffer for mixed samples.
 **  @param size    Number of samples that fits into buffer.
-**
-**  @todo this functions can be called from inside the SDL audio callback,
-**  which is bad, the buffer should be precalculated.
 */
 static void MixMusicToStereo32(int *buffer, int size)
 {
+	//Wyrmgus start
+	/*
 	if (MusicPlaying) {
 		Assert(MusicChannel.Sample);
 
@@ -204,6 +431,40 @@ static void MixMusicToStereo32(int *buffer, int size)
 			}
 		}
 	}
+	*/
+	//the music is decoded and converted by the music decoder thread, so here it only has to be taken from the ring buffer
+	//until the decoder takes the last music sample set, what is in the ring buffer belongs to a previous one
+	if (MusicPlaying && MusicDecoder.DecodedGeneration.load(std::memory_order_acquire) == MusicDecoder.Generation.load(std::memory_order_relaxed)) {
+		//check whether the decoder finished before looking at how much it wrote, so that nothing it wrote before finishing is missed
+		const bool finished = MusicDecoder.Finished;
+		unsigned int read_pos = MusicDecoder.ReadPos.load(std::memory_order_relaxed);
+		const unsigned int start_pos = MusicDecoder.StartPos.load(std::memory_order_relaxed);
+		if ((int) (start_pos - read_pos) > 0) { //skip what was decoded of previous music samples
+			read_pos = start_pos;
+		}
+		const unsigned int available = MusicDecoder.WritePos.load(std::memory_order_acquire) - read_pos;
+		const int count = std::min<unsigned int>(size, available) & ~1;
+		
+		// FIXME: why taking out '/ 2' leads to distortion
+		const int gain = std::min(MusicVolume * 65536 / MaxVolume / 2, SHRT_MAX);
+		const int start = read_pos & (MUSIC_RING_SIZE - 1);
+		const int first = std::min(count, MUSIC_RING_SIZE - start);
+		MixStereo16ToStereo32(MusicDecoder.Ring + start, buffer, first, gain, gain);
+		MixStereo16ToStereo32(MusicDecoder.Ring, buffer + first, count - first, gain, gain);
+		
+		MusicDecoder.ReadPos.store(read_pos + count, std::memory_order_release);
+		SDL_CondSignal(MusicDecoder.Cond);
+
+		//the decoder already freed the finished sample, so only the end of the music has to be signalled
+		if (finished && available - count < 2) { // End reached
+			MusicPlaying = false;
+
+			if (MusicChannel.FinishedCallback) {
+				MusicChannel.FinishedCallback();
+			}
+		}
+	}
+	//Wyrmgus end
 }
 
 /**
@@ -227,8 +488,12 @@ static int MixSampleToStereo32(CSample *sample, int index, unsigned char volume,
 							   char stereo, int *buffer, int size)
 {
 	static int buf[SOUND_BUFFER_SIZE / 2];
-	unsigned char left;
-	unsigned char right;
+	//Wyrmgus start
+//	unsigned char left;
+//	unsigned char right;
+	int left;
+	int right;
+	//Wyrmgus end
 
 	int div = 176400 / (sample->Frequency * (sample->SampleSize / 8) * sample->Channels);
 	int local_volume = (int)volume * EffectsVolume / MaxVolume;
@@ -243,6 +508,19 @@ static int MixSampleToStereo32(CSample *sample, int index, unsigned char volume,
 
 	Assert(!(index & 1));
 
+	//Wyrmgus start
+	// FIXME: why taking out '/ 2' leads to distortion
+	const int left_gain = std::min(local_volume * left * 65536 / 128 / MaxVolume / 2, SHRT_MAX);
+	const int right_gain = std::min(local_volume * right * 65536 / 128 / MaxVolume / 2, SHRT_MAX);
+	
+	//samples converted when loaded can be mixed directly
+	if (SampleIsInOutputFormat(*sample)) {
+		size = std::min((sample->Len - index) / (int) sizeof(short), size) & ~1;
+		MixStereo16ToStereo32((const short *)(sample->Buffer + index), buffer, size, left_gain, right_gain);
+		return size * sizeof(short);
+	}
+	//Wyrmgus end
+
 	size = std::min((sample->Len - index) * div / 2, size);
 
 	size = ConvertToStereo32((char *)(sample->Buffer + index), (char *)buf, sample->Frequency,
@@ -250,11 +528,16 @@ static int MixSampleToStereo32(CSample *sample, int index, unsigned char volume,
 							 size * 2 / div);
 
 	size /= 2;
+	//Wyrmgus start
+	/*
 	for (int i = 0; i < size; i += 2) {
 		// FIXME: why taking out '/ 2' leads to distortion
 		buffer[i] += ((short *)buf)[i] * local_volume * left / 128 / MaxVolume / 2;
 		buffer[i + 1] += ((short *)buf)[i + 1] * local_volume * right / 128 / MaxVolume / 2;
 	}
+	*/
+	MixStereo16ToStereo32((const short *)buf, buffer, size, left_gain, right_gain);
+	//Wyrmgus end
 
 	return 2 * size / div;
 }
@@ -302,6 +585,8 @@ static int MixChannelsToStereo32(int *buffer, int size)
 */
 static void ClipMixToStereo16(const int *mix, int size, short *output)
 {
+	//Wyrmgus start
+	/*
 	const int *end = mix + size;
 
 	while (mix < end) {
@@ -309,6 +594,24 @@ static void ClipMixToStereo16(const int *mix, int size, short *output)
 		clamp(&s, SHRT_MIN, SHRT_MAX);
 		*output++ = s;
 	}
+	*/
+	int i = 0;
+	
+#ifdef __SSE2__
+	//pack with signed saturation eight samples at a time
+	for (; i + 8 <= size; i += 8) {
+		const __m128i low = _mm_loadu_si128((const __m128i *)(mix + i));
+		const __m128i high = _mm_loadu_si128((const __m128i *)(mix + i + 4));
+		_mm_storeu_si128((__m128i *)(output + i), _mm_packs_epi32(low, high));
+	}
+#endif
+	
+	for (; i < size; ++i) {
+		int s = mix[i];
+		clamp(&s, SHRT_MIN, SHRT_MAX);
+		output[i] = s;
+	}
+	//Wyrmgus end
 }
 
 /**
@@ -663,6 +966,11 @@ CSample *LoadSample(const std::string &name)
 	if (sample == NULL) {
 		fprintf(stderr, "Can't load the sound '%s'\n", name.c_str());
 	}
+	//Wyrmgus start
+	else {
+		ConvertSampleToOutputFormat(*sample);
+	}
+	//Wyrmgus end
 	return sample;
 }
 
@@ -759,8 +1067,14 @@ int PlayMusic(CSample *sample)
 {
 	if (sample) {
 		StopMusic();
-		MusicChannel.Sample = sample;
+		//Wyrmgus start
+//		MusicChannel.Sample = sample;
+//		MusicPlaying = true;
+		SDL_LockMutex(Audio.Lock);
+		SetMusicSample(sample);
 		MusicPlaying = true;
+		SDL_UnlockMutex(Audio.Lock);
+		//Wyrmgus end
 		return 0;
 	} else {
 		DebugPrint("Could not play sample\n");
@@ -786,8 +1100,14 @@ int PlayMusic(const std::string &file)
 
 	if (sample) {
 		StopMusic();
-		MusicChannel.Sample = sample;
+		//Wyrmgus start
+//		MusicChannel.Sample = sample;
+//		MusicPlaying = true;
+		SDL_LockMutex(Audio.Lock);
+		SetMusicSample(sample);
 		MusicPlaying = true;
+		SDL_UnlockMutex(Audio.Lock);
+		//Wyrmgus end
 		return 0;
 	} else {
 		DebugPrint("Could not play %s\n" _C_ file.c_str());
@@ -933,12 +1253,18 @@ void StopMusic()
 
 	if (MusicPlaying) {
 		MusicPlaying = false;
-		if (MusicChannel.Sample) {
-			SDL_LockMutex(Audio.Lock);
-			delete MusicChannel.Sample;
-			MusicChannel.Sample = NULL;
-			SDL_UnlockMutex(Audio.Lock);
-		}
+		//Wyrmgus start
+//		if (MusicChannel.Sample) {
+//			SDL_LockMutex(Audio.Lock);
+//			delete MusicChannel.Sample;
+//			MusicChannel.Sample = NULL;
+//			SDL_UnlockMutex(Audio.Lock);
+//		}
+		//the music sample belongs to the music decoder thread, so whether there is one isn't checked here
+		SDL_LockMutex(Audio.Lock);
+		SetMusicSample(NULL);
+		SDL_UnlockMutex(Audio.Lock);
+		//Wyrmgus end
 	}
 }
 
@@ -1109,6 +1435,21 @@ int InitSound()
 
 	// Create thread to fill sdl audio buffer
 	Audio.Thread = SDL_CreateThread(FillThread, NULL);
+	
+	//Wyrmgus start
+	// Create thread to decode music ahead of the mixer
+	MusicDecoder.Ring = new short[MUSIC_RING_SIZE];
+	MusicDecoder.ReadPos = 0;
+	MusicDecoder.WritePos = 0;
+	MusicDecoder.StartPos = 0;
+	MusicDecoder.DecodedGeneration = 0;
+	MusicDecoder.Generation = 0;
+	MusicDecoder.PendingChange = NULL;
+	MusicDecoder.Finished = false;
+	MusicDecoder.Lock = SDL_CreateMutex();
+	MusicDecoder.Cond = SDL_CreateCond();
+	MusicDecoder.Thread = SDL_CreateThread(MusicDecoderThread, NULL);
+	//Wyrmgus end
 	return 0;
 }
 
@@ -1127,9 +1468,26 @@ void QuitSound()
 
 	Audio.Running = false;
 	SDL_WaitThread(Audio.Thread, NULL);
+	//Wyrmgus start
+	SDL_CondSignal(MusicDecoder.Cond);
+	SDL_WaitThread(MusicDecoder.Thread, NULL);
+	//Wyrmgus end
 
 	SDL_DestroyCond(Audio.Cond);
 	SDL_DestroyMutex(Audio.Lock);
+	//Wyrmgus start
+	SDL_DestroyCond(MusicDecoder.Cond);
+	SDL_DestroyMutex(MusicDecoder.Lock);
+	delete[] MusicDecoder.Ring;
+	MusicDecoder.Ring = NULL;
+	MusicSampleChange *change = MusicDecoder.PendingChange.exchange(NULL);
+	if (change != NULL) {
+		delete change->Sample;
+		delete change;
+	}
+	delete MusicChannel.Sample;
+	MusicChannel.Sample = NULL;
+	//Wyrmgus end
 
 	// Mustn't call SDL_CloseAudio here, it'll be called again from SDL_Quit
 	SoundInitialized = false;
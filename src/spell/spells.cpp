@@ -115,7 +115,10 @@ static bool PassCondition(const CUnit &caster, const SpellType &spell, const CUn
 		return false;
 	}
 	// check countdown timer
-	if (caster.SpellCoolDownTimers[spell.Slot]) { // Check caster mana.
+	//Wyrmgus start
+//	if (caster.SpellCoolDownTimers[spell.Slot]) { // Check caster mana.
+	if (caster.GetSpellCoolDownTimer(spell.Slot)) {
+	//Wyrmgus end
 		return false;
 	}
 	// Check caster's resources
@@ -600,7 +603,10 @@ int AutoCastSpell(CUnit &caster, const SpellType &spell)
 	if (!SpellIsAvailable(caster, spell.Slot)
 	//Wyrmgus end
 		|| caster.Variable[MANA_INDEX].Value < spell.ManaCost
-		|| caster.SpellCoolDownTimers[spell.Slot]) {
+		//Wyrmgus start
+//		|| caster.SpellCoolDownTimers[spell.Slot]) {
+		|| caster.GetSpellCoolDownTimer(spell.Slot)) {
+		//Wyrmgus end
 		return 0;
 	}
 	Target *target = SelectTargetUnitsOfAutoCast(caster, spell);
@@ -706,7 +712,10 @@ int SpellCast(CUnit &caster, const SpellType &spell, CUnit *target, const Vec2i
 			caster.Variable[MANA_INDEX].Value -= spell.ManaCost;
 		}
 		caster.Player->SubCosts(spell.Costs);
-		caster.SpellCoolDownTimers[spell.Slot] = spell.CoolDown;
+		//Wyrmgus start
+//		caster.SpellCoolDownTimers[spell.Slot] = spell.CoolDown;
+		caster.SetSpellCoolDownTimer(spell.Slot, spell.CoolDown);
+		//Wyrmgus end
 		//
 		// Spells like blizzard are casted again.
 		// This is sort of confusing, we do the test again, to
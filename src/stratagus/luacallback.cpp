@@ -42,7 +42,10 @@
 **  @param f  Listener function
 */
 LuaCallback::LuaCallback(lua_State *l, lua_Object f) :
-	luastate(l), arguments(0), rescount(0)
+	//Wyrmgus start
+//	luastate(l), arguments(0), rescount(0)
+	luastate(l), tracebackref(LUA_NOREF), arguments(0), rescount(0)
+	//Wyrmgus end
 {
 	if (!lua_isfunction(l, f)) {
 		LuaError(l, "Argument isn't a function");
@@ -59,7 +62,15 @@ LuaCallback::LuaCallback(lua_State *l, lua_Object f) :
 void LuaCallback::pushPreamble()
 {
 	base = lua_gettop(luastate);
-	lua_getglobal(luastate, "_TRACEBACK");
+	//Wyrmgus start
+//	lua_getglobal(luastate, "_TRACEBACK");
+	//look up the traceback handler only once, instead of doing a global table lookup on every call
+	if (tracebackref == LUA_NOREF) {
+		lua_getglobal(luastate, "_TRACEBACK");
+		tracebackref = luaL_ref(luastate, LUA_REGISTRYINDEX);
+	}
+	lua_rawgeti(luastate, LUA_REGISTRYINDEX, tracebackref);
+	//Wyrmgus end
 	lua_rawgeti(luastate, LUA_REGISTRYINDEX, luaref);
 	arguments = 0;
 }
@@ -169,6 +180,9 @@ LuaCallback::~LuaCallback()
 		fprintf(stderr, "There are still some results that weren't popped from stack\n");
 	}
 	luaL_unref(luastate, LUA_REGISTRYINDEX, luaref);
+	//Wyrmgus start
+	luaL_unref(luastate, LUA_REGISTRYINDEX, tracebackref);
+	//Wyrmgus end
 }
 
 //@}
@@ -55,6 +55,7 @@
 #include "network.h"
 #include "particle.h"
 //Wyrmgus start
+#include "pathfinder.h"
 #include "quest.h"
 //Wyrmgus end
 #include "replay.h"
@@ -209,6 +210,10 @@ void DrawMapArea()
 */
 void UpdateDisplay()
 {
+	//Wyrmgus start
+	++DisplayFrameCounter; //advanced once per frame however many viewports there are
+	//Wyrmgus end
+	
 	if (GameRunning || Editor.Running == EditorEditing) {
 		// to prevent empty spaces in the UI
 #if defined(USE_OPENGL) || defined(USE_GLES)
@@ -233,6 +238,10 @@ void UpdateDisplay()
 			UiToggleBigMap();
 		}
 
+		//Wyrmgus start
+		CRenderStageTimer render_stage_timer(RenderStagePanels);
+		//Wyrmgus end
+		
 		if (!BigMapMode) {
 			for (size_t i = 0; i < UI.Fillers.size(); ++i) {
 				UI.Fillers[i].G->DrawSubClip(0, 0,
@@ -300,6 +309,57 @@ void UpdateDisplay()
 	Invalidate();
 }
 
+//Wyrmgus start
+/**
+**  Draw frames with the selected viewport centered on given map positions, and print how long each stage of drawing took.
+**
+**  The minimap is updated as often as it would be at the normal game speed. The game does not advance while the frames are drawn.
+**
+**  @param frames     How many frames to draw.
+**  @param positions  Map tile positions on which the selected viewport is centered, one for each frame in turn; if empty, the viewport is not moved.
+*/
+void BenchmarkRendering(int frames, const std::vector<Vec2i> &positions)
+{
+	if (!GameRunning || !UI.SelectedViewport) {
+		fprintf(stderr, "The rendering benchmark can only be run during a game\n");
+		return;
+	}
+	
+	CViewport &vp = *UI.SelectedViewport;
+	const Vec2i old_map_pos = vp.MapPos;
+	const PixelDiff old_offset = vp.Offset;
+	
+	memset(RenderStageTimes, 0, sizeof(RenderStageTimes));
+	RenderStageTiming = true;
+	const unsigned long start_ticks = GetTicks();
+	
+	for (int i = 0; i < frames; ++i) {
+		if (!positions.empty()) {
+			vp.Center(Map.TilePosToMapPixelPos_Center(positions[i % positions.size()]));
+		}
+		if (i % FRAMES_PER_SECOND == 0) {
+			UI.Minimap.Update();
+		}
+		UpdateDisplay();
+		RealizeVideoMemory();
+	}
+	
+	const unsigned long ticks = GetTicks() - start_ticks;
+	RenderStageTiming = false;
+	vp.Set(old_map_pos, old_offset);
+	
+	static const char *render_stage_names[MaxRenderStages] = {"Terrain", "Units", "Missiles", "Fog of war", "Minimap", "UI panels"};
+	
+	unsigned long long stage_time = 0;
+	fprintf(stdout, "Rendering benchmark: %d frames in %lu ms, %.3f ms per frame\n", frames, ticks, frames ? (double) ticks / frames : 0.0);
+	for (int i = 0; i < MaxRenderStages; ++i) {
+		fprintf(stdout, "  %s: %.3f ms per frame\n", render_stage_names[i], frames ? RenderStageTimes[i] / 1000.0 / frames : 0.0);
+		stage_time += RenderStageTimes[i];
+	}
+	fprintf(stdout, "  Other: %.3f ms per frame\n", frames ? std::max(0.0, ticks - stage_time / 1000.0) / frames : 0.0);
+}
+//Wyrmgus end
+
 static void InitGameCallbacks()
 {
 	GameCallbacks.ButtonPressed = HandleButtonDown;
@@ -335,6 +395,9 @@ static void GameLogicLoop()
 		NetworkCommands(); // Get network commands
 		TriggersEachCycle();// handle triggers
 		UnitActions();      // handle units
+		//Wyrmgus start
+		CompletePathRequests(); // solve the path requests made by the units, for them to use in the next cycle
+		//Wyrmgus end
 		MissileActions();   // handle missiles
 		PlayersEachCycle(); // handle players
 		UpdateTimer();      // update game timer
@@ -349,12 +412,14 @@ static void GameLogicLoop()
 						if (mf.AnimationFrame >= mf.Terrain->SolidAnimationFrames) {
 							mf.AnimationFrame = 0;
 						}
+						MarkTerrainCacheDirty(Vec2i(i % Map.Info.MapWidths[z], i / Map.Info.MapWidths[z]), z);
 					}
 					if (mf.OverlayTerrain && mf.OverlayTerrain->SolidAnimationFrames > 0) {
 						mf.OverlayAnimationFrame += 1;
 						if (mf.OverlayAnimationFrame >= mf.OverlayTerrain->SolidAnimationFrames) {
 							mf.OverlayAnimationFrame = 0;
 						}
+						MarkTerrainCacheDirty(Vec2i(i % Map.Info.MapWidths[z], i / Map.Info.MapWidths[z]), z);
 					}
 				}
 			}
@@ -465,6 +530,17 @@ static void GameLogicLoop()
 							|| ((Map.TimeOfDay[z] == FirstWatchTimeOfDay || Map.TimeOfDay[z] == DawnTimeOfDay) && unit->Variable[NIGHTSIGHTRANGEBONUS_INDEX].Value != 0) // if has night sight bonus and is entering or exiting night
 						)
 					) {
+						// only (un)mark the ring of tiles which enters or leaves the unit's sight
+						if (unit->InsideCount == 0 && CanUpdateUnitSightDifference(*unit)) {
+							const int old_sight_range = unit->CurrentSightRange;
+							UpdateUnitSightRange(*unit);
+							if (unit->CurrentSightRange > old_sight_range) {
+								MapMarkUnitSightDifference(*unit, unit->CurrentSightRange, unit->tilePos, old_sight_range);
+							} else if (unit->CurrentSightRange < old_sight_range) {
+								MapUnmarkUnitSightDifference(*unit, old_sight_range, unit->tilePos, unit->CurrentSightRange);
+							}
+							continue;
+						}
 						MapUnmarkUnitSight(*unit);
 						UpdateUnitSightRange(*unit);
 						MapMarkUnitSight(*unit);
@@ -368,6 +368,10 @@ std::map<std::string, int> DynastyStringToIndex;
 std::map<std::string, CLanguage *> LanguageIdentToPointer;
 
 bool LanguageCacheOutdated = false;
+
+static bool VisionMasksUpdating = false;				/// whether the vision masks are being recalculated
+static unsigned int MutualSharedVisionMasks[PlayerMax];	/// for each player, the players with which it mutually shares vision
+static unsigned int RevealedPlayersMask = 0;		/// the revealed players
 //Wyrmgus end
 
 /*----------------------------------------------------------------------------
@@ -1578,6 +1582,7 @@ void CPlayer::Init(/* PlayerTypes */ int type)
 	this->UnitTypesUnderConstructionCount.clear();
 	this->UnitTypesAiActiveCount.clear();
 	this->Heroes.clear();
+	InvalidatePlayerDependencies(*this);
 	this->Deities.clear();
 	this->UnitsByType.clear();
 	this->AiActiveUnitsByType.clear();
@@ -1605,6 +1610,7 @@ void CPlayer::Init(/* PlayerTypes */ int type)
 	}
 	//Wyrmgus start
 	this->Revealed = false;
+	PlayerVisionChanged();
 	//Wyrmgus end
 	++NumPlayers;
 }
@@ -1635,6 +1641,7 @@ void CPlayer::SetCivilization(int civilization)
 		this->SetFaction(NULL);
 	} else {
 		this->Faction = -1;
+		InvalidatePlayerDependencies(*this);
 	}
 
 	this->Race = civilization;
@@ -1706,6 +1713,7 @@ void CPlayer::SetFaction(CFaction *faction)
 	}
 	
 	this->Faction = faction_id;
+	InvalidatePlayerDependencies(*this);
 
 	if (this->Index == ThisPlayer->Index) {
 		UI.Load();
@@ -2441,8 +2449,11 @@ void CPlayer::GetWorkerLandmasses(std::vector<int>& worker_landmasses, const CUn
 std::vector<CUpgrade *> CPlayer::GetResearchableUpgrades()
 {
 	std::vector<CUpgrade *> researchable_upgrades;
-	for (std::map<const CUnitType *, int>::iterator iterator = this->UnitTypesAiActiveCount.begin(); iterator != this->UnitTypesAiActiveCount.end(); ++iterator) {
-		const CUnitType *type = iterator->first;
+	for (size_t slot = 0; slot < this->UnitTypesAiActiveCount.size(); ++slot) {
+		if (this->UnitTypesAiActiveCount[slot] <= 0) {
+			continue;
+		}
+		const CUnitType *type = UnitTypes[slot];
 		if (type->Slot < ((int) AiHelpers.ResearchedUpgrades.size())) {
 			for (size_t i = 0; i < AiHelpers.ResearchedUpgrades[type->Slot].size(); ++i) {
 				CUpgrade *upgrade = AiHelpers.ResearchedUpgrades[type->Slot][i];
@@ -2500,6 +2511,7 @@ void CPlayer::Clear()
 	this->UnitTypesUnderConstructionCount.clear();
 	this->UnitTypesAiActiveCount.clear();
 	//Wyrmgus start
+	InvalidatePlayerDependencies(*this);
 	this->Heroes.clear();
 	this->Deities.clear();
 	this->UnitsByType.clear();
@@ -2517,6 +2529,7 @@ void CPlayer::Clear()
 	AiEnabled = false;
 	//Wyrmgus start
 	Revealed = false;
+	PlayerVisionChanged();
 	//Wyrmgus end
 	Ai = 0;
 	this->Units.resize(0);
@@ -3775,19 +3788,29 @@ int CPlayer::GetUpgradeCostsMask(const CUpgrade *upgrade) const
 
 //Wyrmgus end
 
+/**
+**  Get the element for a unit type in a vector indexed by unit type slot, growing the vector if it doesn't reach the slot yet
+*/
+template <typename T>
+static T &GetUnitTypeElement(std::vector<T> &type_vector, const CUnitType *type)
+{
+	if (type->Slot >= (int) type_vector.size()) {
+		type_vector.resize(type->Slot + 1);
+	}
+	
+	return type_vector[type->Slot];
+}
+
 void CPlayer::SetUnitTypeCount(const CUnitType *type, int quantity)
 {
 	if (!type) {
 		return;
 	}
 	
-	if (quantity <= 0) {
-		if (this->UnitTypesCount.find(type) != this->UnitTypesCount.end()) {
-			this->UnitTypesCount.erase(type);
-		}
-	} else {
-		this->UnitTypesCount[type] = quantity;
-	}
+	int &count = GetUnitTypeElement(this->UnitTypesCount, type);
+	const int old_count = count;
+	count = std::max(0, quantity);
+	UnitTypeCountChanged(*this, *type, old_count, count);
 }
 
 void CPlayer::ChangeUnitTypeCount(const CUnitType *type, int quantity)
@@ -3797,8 +3820,8 @@ void CPlayer::ChangeUnitTypeCount(const CUnitType *type, int quantity)
 
 int CPlayer::GetUnitTypeCount(const CUnitType *type) const
 {
-	if (type && this->UnitTypesCount.find(type) != this->UnitTypesCount.end()) {
-		return this->UnitTypesCount.find(type)->second;
+	if (type && type->Slot < (int) this->UnitTypesCount.size()) {
+		return this->UnitTypesCount[type->Slot];
 	} else {
 		return 0;
 	}
@@ -3810,13 +3833,7 @@ void CPlayer::SetUnitTypeUnderConstructionCount(const CUnitType *type, int quant
 		return;
 	}
 	
-	if (quantity <= 0) {
-		if (this->UnitTypesUnderConstructionCount.find(type) != this->UnitTypesUnderConstructionCount.end()) {
-			this->UnitTypesUnderConstructionCount.erase(type);
-		}
-	} else {
-		this->UnitTypesUnderConstructionCount[type] = quantity;
-	}
+	GetUnitTypeElement(this->UnitTypesUnderConstructionCount, type) = std::max(0, quantity);
 }
 
 void CPlayer::ChangeUnitTypeUnderConstructionCount(const CUnitType *type, int quantity)
@@ -3826,8 +3843,8 @@ void CPlayer::ChangeUnitTypeUnderConstructionCount(const CUnitType *type, int qu
 
 int CPlayer::GetUnitTypeUnderConstructionCount(const CUnitType *type) const
 {
-	if (type && this->UnitTypesUnderConstructionCount.find(type) != this->UnitTypesUnderConstructionCount.end()) {
-		return this->UnitTypesUnderConstructionCount.find(type)->second;
+	if (type && type->Slot < (int) this->UnitTypesUnderConstructionCount.size()) {
+		return this->UnitTypesUnderConstructionCount[type->Slot];
 	} else {
 		return 0;
 	}
@@ -3839,13 +3856,7 @@ void CPlayer::SetUnitTypeAiActiveCount(const CUnitType *type, int quantity)
 		return;
 	}
 	
-	if (quantity <= 0) {
-		if (this->UnitTypesAiActiveCount.find(type) != this->UnitTypesAiActiveCount.end()) {
-			this->UnitTypesAiActiveCount.erase(type);
-		}
-	} else {
-		this->UnitTypesAiActiveCount[type] = quantity;
-	}
+	GetUnitTypeElement(this->UnitTypesAiActiveCount, type) = std::max(0, quantity);
 }
 
 void CPlayer::ChangeUnitTypeAiActiveCount(const CUnitType *type, int quantity)
@@ -3855,8 +3866,8 @@ void CPlayer::ChangeUnitTypeAiActiveCount(const CUnitType *type, int quantity)
 
 int CPlayer::GetUnitTypeAiActiveCount(const CUnitType *type) const
 {
-	if (type && this->UnitTypesAiActiveCount.find(type) != this->UnitTypesAiActiveCount.end()) {
-		return this->UnitTypesAiActiveCount.find(type)->second;
+	if (type && type->Slot < (int) this->UnitTypesAiActiveCount.size()) {
+		return this->UnitTypesAiActiveCount[type->Slot];
 	} else {
 		return 0;
 	}
@@ -3867,11 +3878,11 @@ void CPlayer::IncreaseCountsForUnit(CUnit *unit, bool type_change)
 	const CUnitType *type = unit->Type;
 
 	this->ChangeUnitTypeCount(type, 1);
-	this->UnitsByType[type].push_back(unit);
+	GetUnitTypeElement(this->UnitsByType, type).push_back(unit);
 	
 	if (unit->Active) {
 		this->ChangeUnitTypeAiActiveCount(type, 1);
-		this->AiActiveUnitsByType[type].push_back(unit);
+		GetUnitTypeElement(this->AiActiveUnitsByType, type).push_back(unit);
 	}
 
 	if (type->BoolFlag[TOWNHALL_INDEX].value) {
@@ -3899,20 +3910,14 @@ void CPlayer::DecreaseCountsForUnit(CUnit *unit, bool type_change)
 
 	this->ChangeUnitTypeCount(type, -1);
 	
-	this->UnitsByType[type].erase(std::remove(this->UnitsByType[type].begin(), this->UnitsByType[type].end(), unit), this->UnitsByType[type].end());
-			
-	if (this->UnitsByType[type].empty()) {
-		this->UnitsByType.erase(type);
-	}
+	std::vector<CUnit *> &type_units = GetUnitTypeElement(this->UnitsByType, type);
+	type_units.erase(std::remove(type_units.begin(), type_units.end(), unit), type_units.end());
 	
 	if (unit->Active) {
 		this->ChangeUnitTypeAiActiveCount(type, -1);
 		
-		this->AiActiveUnitsByType[type].erase(std::remove(this->AiActiveUnitsByType[type].begin(), this->AiActiveUnitsByType[type].end(), unit), this->AiActiveUnitsByType[type].end());
-		
-		if (this->AiActiveUnitsByType[type].empty()) {
-			this->AiActiveUnitsByType.erase(type);
-		}
+		std::vector<CUnit *> &ai_active_type_units = GetUnitTypeElement(this->AiActiveUnitsByType, type);
+		ai_active_type_units.erase(std::remove(ai_active_type_units.begin(), ai_active_type_units.end(), unit), ai_active_type_units.end());
 	}
 	
 	if (type->BoolFlag[TOWNHALL_INDEX].value) {
@@ -3983,6 +3988,7 @@ void PlayersEachCycle()
 		//Wyrmgus start
 		if (p.LostTownHallTimer && !p.Revealed && p.LostTownHallTimer < ((int) GameCycle) && ThisPlayer->HasContactWith(p)) {
 			p.Revealed = true;
+			PlayerVisionChanged();
 			for (int j = 0; j < NumPlayers; ++j) {
 				if (player != j && Players[j].Type != PlayerNobody) {
 					Players[j].Notify(_("%s's units have been revealed!"), p.Name.c_str());
@@ -4281,6 +4287,8 @@ void CPlayer::SetDiplomacyNeutralWith(const CPlayer &player)
 	this->Allied &= ~(1 << player.Index);
 	
 	//Wyrmgus start
+	WakeUpSleepingUnits();
+	
 	if (GameCycle > 0 && player.Index == ThisPlayer->Index) {
 		ThisPlayer->Notify(_("%s changed their diplomatic stance with us to Neutral"), _(this->Name.c_str()));
 	}
@@ -4293,6 +4301,8 @@ void CPlayer::SetDiplomacyAlliedWith(const CPlayer &player)
 	this->Allied |= 1 << player.Index;
 	
 	//Wyrmgus start
+	WakeUpSleepingUnits();
+	
 	if (GameCycle > 0 && player.Index == ThisPlayer->Index) {
 		ThisPlayer->Notify(_("%s changed their diplomatic stance with us to Ally"), _(this->Name.c_str()));
 	}
@@ -4308,6 +4318,8 @@ void CPlayer::SetDiplomacyEnemyWith(CPlayer &player)
 	this->Allied &= ~(1 << player.Index);
 	
 	//Wyrmgus start
+	WakeUpSleepingUnits();
+	
 	if (GameCycle > 0 && player.Index == ThisPlayer->Index) {
 		ThisPlayer->Notify(_("%s changed their diplomatic stance with us to Enemy"), _(this->Name.c_str()));
 	}
@@ -4327,6 +4339,8 @@ void CPlayer::SetDiplomacyCrazyWith(const CPlayer &player)
 	this->Allied |= 1 << player.Index;
 	
 	//Wyrmgus start
+	WakeUpSleepingUnits();
+	
 	if (GameCycle > 0 && player.Index == ThisPlayer->Index) {
 		ThisPlayer->Notify(_("%s changed their diplomatic stance with us to Crazy"), _(this->Name.c_str()));
 	}
@@ -4338,6 +4352,9 @@ void CPlayer::ShareVisionWith(const CPlayer &player)
 	this->SharedVision |= (1 << player.Index);
 	
 	//Wyrmgus start
+	PlayerVisionChanged();
+	WakeUpSleepingUnits();
+	
 	if (GameCycle > 0 && player.Index == ThisPlayer->Index) {
 		ThisPlayer->Notify(_("%s is now sharing vision with us"), _(this->Name.c_str()));
 	}
@@ -4349,6 +4366,9 @@ void CPlayer::UnshareVisionWith(const CPlayer &player)
 	this->SharedVision &= ~(1 << player.Index);
 	
 	//Wyrmgus start
+	PlayerVisionChanged();
+	WakeUpSleepingUnits();
+	
 	if (GameCycle > 0 && player.Index == ThisPlayer->Index) {
 		ThisPlayer->Notify(_("%s is no longer sharing vision with us"), _(this->Name.c_str()));
 	}
@@ -4477,6 +4497,53 @@ bool CPlayer::IsBothSharedVision(const CUnit &unit) const
 	return IsBothSharedVision(*unit.Player);
 }
 
+//Wyrmgus start
+/**
+**  Recalculate the vision masks, after the shared vision or revealed state of a player has changed
+**
+**  The masks are rebuilt here on the game logic thread rather than when they
+**  are read, as the path request threads read them through the team
+**  visibility of the tiles, and must all see the same masks.
+*/
+void PlayerVisionChanged()
+{
+	VisionMasksUpdating = true;
+	unsigned int revealed_players_mask = 0;
+	for (int i = 0; i < PlayerMax; ++i) {
+		unsigned int mutual_shared_vision_mask = 0;
+		for (int j = 0; j < PlayerMax; ++j) {
+			if (Players[i].IsBothSharedVision(Players[j])) {
+				mutual_shared_vision_mask |= (1 << j);
+			}
+		}
+		MutualSharedVisionMasks[i] = mutual_shared_vision_mask;
+		if (Players[i].Revealed) {
+			revealed_players_mask |= (1 << i);
+		}
+	}
+	RevealedPlayersMask = revealed_players_mask;
+	VisionMasksUpdating = false;
+}
+
+/**
+**  Get the players with which the player mutually shares vision, as a bit field
+*/
+unsigned int GetMutualSharedVisionMask(const CPlayer &player)
+{
+	Assert(!VisionMasksUpdating);
+	return MutualSharedVisionMasks[player.Index];
+}
+
+/**
+**  Get the players which have been revealed, as a bit field
+*/
+unsigned int GetRevealedPlayersMask()
+{
+	Assert(!VisionMasksUpdating);
+	return RevealedPlayersMask;
+}
+//Wyrmgus end
+
 /**
 **  Check if the player is teamed
 */
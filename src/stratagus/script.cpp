@@ -708,8 +708,20 @@ static int ParseLuaFunction(lua_State *l, const char *tablename, int *counter)
 **
 **  @return  lua function result.
 */
+//Wyrmgus start
+#ifdef DEBUG
+static unsigned long LuaDescCalls = 0;	/// number of calls to lua functions of number and string descriptions, to know whether evaluating a description had side effects
+static bool EvalDescsByTree = false;	/// whether to evaluate descriptions by walking their tree instead of running their compiled form, to cross-check the latter
+#endif
+//Wyrmgus end
+
 static int CallLuaNumberFunction(unsigned int handler)
 {
+	//Wyrmgus start
+#ifdef DEBUG
+	++LuaDescCalls;
+#endif
+	//Wyrmgus end
 	const int narg = lua_gettop(Lua);
 
 	lua_getglobal(Lua, "_numberfunction_");
@@ -732,6 +744,11 @@ static int CallLuaNumberFunction(unsigned int handler)
 */
 static std::string CallLuaStringFunction(unsigned int handler)
 {
+	//Wyrmgus start
+#ifdef DEBUG
+	++LuaDescCalls;
+#endif
+	//Wyrmgus end
 	const int narg = lua_gettop(Lua);
 	lua_getglobal(Lua, "_stringfunction_");
 	lua_rawgeti(Lua, -1, handler);
@@ -1176,7 +1193,10 @@ CUnit *EvalUnit(const UnitDesc *unitdesc)
 **
 **  @todo Manage better the error (div/0, unit==NULL, ...).
 */
-int EvalNumber(const NumberDesc *number)
+//Wyrmgus start
+//int EvalNumber(const NumberDesc *number)
+static int EvalNumberNode(const NumberDesc *number)
+//Wyrmgus end
 {
 	CUnit *unit;
 	CUnitType **type;
@@ -1311,7 +1331,10 @@ int EvalNumber(const NumberDesc *number)
 **
 **  @todo Manage better the error.
 */
-std::string EvalString(const StringDesc *s)
+//Wyrmgus start
+//std::string EvalString(const StringDesc *s)
+static std::string EvalStringNode(const StringDesc *s)
+//Wyrmgus end
 {
 	std::string res;    // Result string.
 	std::string tmp1;   // Temporary string.
@@ -1762,6 +1785,741 @@ std::string EvalString(const StringDesc *s)
 }
 
 
+//Wyrmgus start
+/*............................................................................
+..  Compiled descriptions
+............................................................................*/
+
+#define NUMBER_PROGRAM_STACK_SIZE 32	/// maximum stack depth of a compiled number description
+#define STRING_PROGRAM_STACK_SIZE 16	/// maximum stack depth of a compiled string description
+
+/// Operations of a compiled number description
+enum ENumberOp {
+	NumberOp_Const,				/// push a constant
+	NumberOp_Lua,				/// push the result of a lua function
+	NumberOp_Add,				/// a + b
+	NumberOp_Sub,				/// a - b
+	NumberOp_Mul,				/// a * b
+	NumberOp_Div,				/// a / b
+	NumberOp_Min,				/// Min(a, b)
+	NumberOp_Max,				/// Max(a, b)
+	NumberOp_Gt,				/// a > b
+	NumberOp_GtEq,				/// a >= b
+	NumberOp_Lt,				/// a < b
+	NumberOp_LtEq,				/// a <= b
+	NumberOp_Eq,				/// a == b
+	NumberOp_NEq,				/// a != b
+	NumberOp_Rand,				/// replace a by Rand(a)
+	NumberOp_UnitStat,			/// push a property of a unit
+	NumberOp_TypeStat,			/// push a property of a unit type
+	NumberOp_TypeTrainQuantity,	/// push a unit type's trained quantity
+	NumberOp_VideoTextLength,	/// push VideoTextLength(font, string)
+	NumberOp_StringFind,		/// push strchr(string, char) - s
+	NumberOp_PlayerData,		/// replace a player number by the player's data
+	NumberOp_JumpIfZero,		/// pop a, and jump if it is zero
+	NumberOp_Jump				/// jump
+};
+
+/// An instruction of a compiled number description
+class CNumberInstruction
+{
+public:
+	CNumberInstruction(ENumberOp op, int value = 0, const NumberDesc *node = NULL) :
+		Op(op), Value(value), Component(VariableValue), Loc(0), Node(node)
+	{
+	}
+
+	ENumberOp Op;				/// operation
+	int Value;					/// constant, lua function index, variable index or jump target
+	EnumVariable Component;		/// variable component
+	int Loc;					/// location of the variable
+	const NumberDesc *Node;		/// description node holding the operands which aren't compiled into the instruction
+};
+
+/// A number description compiled into a linear instruction array, evaluated on a stack
+class CNumberProgram
+{
+public:
+	CNumberProgram() : Compiled(false)
+	{
+	}
+
+	std::vector<CNumberInstruction> Instructions;
+	bool Compiled;		/// false if the description is too deep to be compiled, and must be evaluated by walking its tree
+};
+
+/// Operations of a compiled string description
+enum EStringOp {
+	StringOp_Const,			/// push a constant
+	StringOp_Node,			/// push the result of evaluating a description node by walking its tree
+	StringOp_Number,		/// push a number converted into a string
+	StringOp_Append,		/// pop b, and append it to a
+	StringOp_InverseVideo,	/// replace a by "~<a~>"
+	StringOp_JumpIfZero,	/// evaluate a number, and jump if it is zero
+	StringOp_Jump			/// jump
+};
+
+/// An instruction of a compiled string description
+class CStringInstruction
+{
+public:
+	CStringInstruction(EStringOp op, int target = 0, const StringDesc *node = NULL) :
+		Op(op), Target(target), Node(node)
+	{
+	}
+
+	EStringOp Op;				/// operation
+	int Target;					/// jump target
+	std::string Text;			/// constant
+	const StringDesc *Node;		/// description node holding the operands which aren't compiled into the instruction
+};
+
+/// A string description compiled into a linear instruction array, evaluated on a stack
+class CStringProgram
+{
+public:
+	CStringProgram() : Compiled(false)
+	{
+	}
+
+	std::vector<CStringInstruction> Instructions;
+	bool Compiled;		/// false if the description is too deep to be compiled, and must be evaluated by walking its tree
+};
+
+static const CNumberProgram &GetNumberProgram(const NumberDesc *number);
+
+/**
+**  Check whether a number description always evaluates to the same value, without side effects.
+**
+**  @param number  the number description.
+**  @param value   set to the value of the description if it is constant.
+**
+**  @return        true if the number description is constant.
+*/
+static bool IsConstantNumberDesc(const NumberDesc *number, int &value)
+{
+	const CNumberProgram &program = GetNumberProgram(number);
+	
+	if (program.Compiled && program.Instructions.size() == 1 && program.Instructions[0].Op == NumberOp_Const) {
+		value = program.Instructions[0].Value;
+		return true;
+	}
+	
+	return false;
+}
+
+/**
+**  Fold a binary operation on two constants.
+**
+**  @param op  the operation.
+**  @param a   the left operand.
+**  @param b   the right operand.
+**
+**  @return    the result of the operation.
+*/
+static int FoldNumberOp(ENumberOp op, int a, int b)
+{
+	switch (op) {
+		case NumberOp_Add :
+			return a + b;
+		case NumberOp_Sub :
+			return a - b;
+		case NumberOp_Mul :
+			return a * b;
+		case NumberOp_Div :
+			return b ? a / b : 0;
+		case NumberOp_Min :
+			return std::min(a, b);
+		case NumberOp_Max :
+			return std::max(a, b);
+		case NumberOp_Gt :
+			return a > b ? 1 : 0;
+		case NumberOp_GtEq :
+			return a >= b ? 1 : 0;
+		case NumberOp_Lt :
+			return a < b ? 1 : 0;
+		case NumberOp_LtEq :
+			return a <= b ? 1 : 0;
+		case NumberOp_Eq :
+			return a == b ? 1 : 0;
+		case NumberOp_NEq :
+			return a != b ? 1 : 0;
+		default :
+			return 0;
+	}
+}
+
+/**
+**  Compile a number description node, appending instructions which push its value on the stack.
+**
+**  @param number  the number description node.
+**  @param code    the instructions to append to.
+**  @param depth   the stack depth before the node's value is pushed.
+**
+**  @return        false if the stack would become too deep.
+*/
+static bool CompileNumberDesc(const NumberDesc *number, std::vector<CNumberInstruction> &code, int depth)
+{
+	if (depth >= NUMBER_PROGRAM_STACK_SIZE) {
+		return false;
+	}
+	
+	ENumberOp op = NumberOp_Const;
+	switch (number->e) {
+		case ENumber_Lua :
+			code.push_back(CNumberInstruction(NumberOp_Lua, number->D.Index));
+			return true;
+		case ENumber_Dir :
+			code.push_back(CNumberInstruction(NumberOp_Const, number->D.Val));
+			return true;
+		case ENumber_Add :
+			op = NumberOp_Add;
+			break;
+		case ENumber_Sub :
+			op = NumberOp_Sub;
+			break;
+		case ENumber_Mul :
+			op = NumberOp_Mul;
+			break;
+		case ENumber_Div :
+			op = NumberOp_Div;
+			break;
+		case ENumber_Min :
+			op = NumberOp_Min;
+			break;
+		case ENumber_Max :
+			op = NumberOp_Max;
+			break;
+		case ENumber_Gt :
+			op = NumberOp_Gt;
+			break;
+		case ENumber_GtEq :
+			op = NumberOp_GtEq;
+			break;
+		case ENumber_Lt :
+			op = NumberOp_Lt;
+			break;
+		case ENumber_LtEq :
+			op = NumberOp_LtEq;
+			break;
+		case ENumber_Eq :
+			op = NumberOp_Eq;
+			break;
+		case ENumber_NEq :
+			op = NumberOp_NEq;
+			break;
+		case ENumber_Rand :
+			if (!CompileNumberDesc(number->D.N, code, depth)) {
+				return false;
+			}
+			code.push_back(CNumberInstruction(NumberOp_Rand));
+			return true;
+		case ENumber_UnitStat : {
+			CNumberInstruction instruction(NumberOp_UnitStat, number->D.UnitStat.Index, number);
+			instruction.Component = number->D.UnitStat.Component;
+			instruction.Loc = number->D.UnitStat.Loc;
+			code.push_back(instruction);
+			return true;
+		}
+		case ENumber_TypeStat : {
+			CNumberInstruction instruction(NumberOp_TypeStat, number->D.TypeStat.Index, number);
+			instruction.Component = number->D.TypeStat.Component;
+			instruction.Loc = number->D.TypeStat.Loc;
+			code.push_back(instruction);
+			return true;
+		}
+		case ENumber_TypeTrainQuantity :
+			code.push_back(CNumberInstruction(NumberOp_TypeTrainQuantity, 0, number));
+			return true;
+		case ENumber_VideoTextLength :
+			code.push_back(CNumberInstruction(NumberOp_VideoTextLength, 0, number));
+			return true;
+		case ENumber_StringFind :
+			code.push_back(CNumberInstruction(NumberOp_StringFind, 0, number));
+			return true;
+		case ENumber_NumIf : {
+			int cond;
+			if (IsConstantNumberDesc(number->D.NumIf.Cond, cond)) {
+				if (cond) {
+					return CompileNumberDesc(number->D.NumIf.BTrue, code, depth);
+				} else if (number->D.NumIf.BFalse) {
+					return CompileNumberDesc(number->D.NumIf.BFalse, code, depth);
+				}
+				code.push_back(CNumberInstruction(NumberOp_Const, 0));
+				return true;
+			}
+			
+			if (!CompileNumberDesc(number->D.NumIf.Cond, code, depth)) {
+				return false;
+			}
+			const size_t jump_to_false = code.size();
+			code.push_back(CNumberInstruction(NumberOp_JumpIfZero));
+			if (!CompileNumberDesc(number->D.NumIf.BTrue, code, depth)) {
+				return false;
+			}
+			const size_t jump_to_end = code.size();
+			code.push_back(CNumberInstruction(NumberOp_Jump));
+			code[jump_to_false].Value = code.size();
+			if (number->D.NumIf.BFalse) {
+				if (!CompileNumberDesc(number->D.NumIf.BFalse, code, depth)) {
+					return false;
+				}
+			} else {
+				code.push_back(CNumberInstruction(NumberOp_Const, 0));
+			}
+			code[jump_to_end].Value = code.size();
+			return true;
+		}
+		case ENumber_PlayerData :
+			if (!CompileNumberDesc(number->D.PlayerData.Player, code, depth)) {
+				return false;
+			}
+			code.push_back(CNumberInstruction(NumberOp_PlayerData, 0, number));
+			return true;
+		default :
+			return false;
+	}
+	
+	//binary operation
+	const size_t left_start = code.size();
+	if (!CompileNumberDesc(number->D.binOp.Left, code, depth)) {
+		return false;
+	}
+	const size_t right_start = code.size();
+	if (!CompileNumberDesc(number->D.binOp.Right, code, depth + 1)) {
+		return false;
+	}
+	
+	if (right_start == left_start + 1 && code.size() == right_start + 1 && code[left_start].Op == NumberOp_Const && code[right_start].Op == NumberOp_Const) {
+		code[left_start].Value = FoldNumberOp(op, code[left_start].Value, code[right_start].Value);
+		code.pop_back();
+	} else {
+		code.push_back(CNumberInstruction(op));
+	}
+	return true;
+}
+
+/**
+**  Get the compiled form of a number description, compiling it if it hasn't been yet.
+**
+**  @param number  the number description.
+**
+**  @return        the compiled number description.
+*/
+static const CNumberProgram &GetNumberProgram(const NumberDesc *number)
+{
+	if (!number->Program) {
+		number->Program = new CNumberProgram;
+		number->Program->Compiled = CompileNumberDesc(number, number->Program->Instructions, 0);
+		if (!number->Program->Compiled) {
+			number->Program->Instructions.clear();
+		}
+	}
+	
+	return *number->Program;
+}
+
+/**
+**  Evaluate a compiled number description.
+**
+**  @param program  the compiled number description.
+**
+**  @return         the result number.
+*/
+static int RunNumberProgram(const CNumberProgram &program)
+{
+	int stack[NUMBER_PROGRAM_STACK_SIZE];
+	int top = -1;
+	std::string s;
+	
+	const int size = program.Instructions.size();
+	for (int pc = 0; pc < size; ++pc) {
+		const CNumberInstruction &instruction = program.Instructions[pc];
+		switch (instruction.Op) {
+			case NumberOp_Const :
+				stack[++top] = instruction.Value;
+				break;
+			case NumberOp_Lua :
+				stack[++top] = CallLuaNumberFunction(instruction.Value);
+				break;
+			case NumberOp_Add :
+				--top;
+				stack[top] += stack[top + 1];
+				break;
+			case NumberOp_Sub :
+				--top;
+				stack[top] -= stack[top + 1];
+				break;
+			case NumberOp_Mul :
+				--top;
+				stack[top] *= stack[top + 1];
+				break;
+			case NumberOp_Div :
+			case NumberOp_Min :
+			case NumberOp_Max :
+			case NumberOp_Gt :
+			case NumberOp_GtEq :
+			case NumberOp_Lt :
+			case NumberOp_LtEq :
+			case NumberOp_Eq :
+			case NumberOp_NEq :
+				--top;
+				stack[top] = FoldNumberOp(instruction.Op, stack[top], stack[top + 1]);
+				break;
+			case NumberOp_Rand :
+				stack[top] = SyncRand() % stack[top];
+				break;
+			case NumberOp_UnitStat : {
+				const CUnit *unit = EvalUnit(instruction.Node->D.UnitStat.Unit);
+				stack[++top] = unit != NULL ? GetComponent(*unit, instruction.Value, instruction.Component, instruction.Loc).i : 0;
+				break;
+			}
+			case NumberOp_TypeStat : {
+				CUnitType **type = instruction.Node->D.TypeStat.Type;
+				stack[++top] = type != NULL ? GetComponent(**type, instruction.Value, instruction.Component, instruction.Loc).i : 0;
+				break;
+			}
+			case NumberOp_TypeTrainQuantity : {
+				CUnitType **type = instruction.Node->D.Type;
+				stack[++top] = type != NULL ? (**type).TrainQuantity : 0;
+				break;
+			}
+			case NumberOp_VideoTextLength :
+				if (instruction.Node->D.VideoTextLength.String != NULL
+					&& !(s = EvalString(instruction.Node->D.VideoTextLength.String)).empty()) {
+					stack[++top] = instruction.Node->D.VideoTextLength.Font->Width(s);
+				} else {
+					stack[++top] = 0;
+				}
+				break;
+			case NumberOp_StringFind :
+				if (instruction.Node->D.StringFind.String != NULL
+					&& !(s = EvalString(instruction.Node->D.StringFind.String)).empty()) {
+					size_t pos = s.find(instruction.Node->D.StringFind.C);
+					stack[++top] = pos != std::string::npos ? (int)pos : -1;
+				} else {
+					stack[++top] = 0;
+				}
+				break;
+			case NumberOp_PlayerData : {
+				std::string data = EvalString(instruction.Node->D.PlayerData.DataType);
+				std::string res;
+				if (instruction.Node->D.PlayerData.ResType != NULL) {
+					res = EvalString(instruction.Node->D.PlayerData.ResType);
+				}
+				stack[top] = GetPlayerData(stack[top], data.c_str(), res.c_str());
+				break;
+			}
+			case NumberOp_JumpIfZero :
+				if (!stack[top--]) {
+					pc = instruction.Value - 1;
+				}
+				break;
+			case NumberOp_Jump :
+				pc = instruction.Value - 1;
+				break;
+		}
+	}
+	
+	return stack[0];
+}
+
+/**
+**  Compile a string description node, appending instructions which push its value on the stack.
+**
+**  @param s      the string description node.
+**  @param code   the instructions to append to.
+**  @param depth  the stack depth before the node's value is pushed.
+**
+**  @return       false if the stack would become too deep.
+*/
+static bool CompileStringDesc(const StringDesc *s, std::vector<CStringInstruction> &code, int depth)
+{
+	if (depth >= STRING_PROGRAM_STACK_SIZE) {
+		return false;
+	}
+	
+	switch (s->e) {
+		case EString_Dir : {
+			CStringInstruction instruction(StringOp_Const);
+			instruction.Text = s->D.Val;
+			code.push_back(instruction);
+			return true;
+		}
+		case EString_Concat : {
+			const size_t start = code.size();
+			if (!CompileStringDesc(s->D.Concat.Strings[0], code, depth)) {
+				return false;
+			}
+			for (int i = 1; i < s->D.Concat.n; ++i) {
+				const size_t operand_start = code.size();
+				if (!CompileStringDesc(s->D.Concat.Strings[i], code, depth + 1)) {
+					return false;
+				}
+				if (operand_start == start + 1 && code.size() == operand_start + 1 && code[start].Op == StringOp_Const && code[operand_start].Op == StringOp_Const) {
+					code[start].Text += code[operand_start].Text;
+					code.pop_back();
+				} else {
+					code.push_back(CStringInstruction(StringOp_Append));
+				}
+			}
+			return true;
+		}
+		case EString_String : {
+			int value;
+			if (IsConstantNumberDesc(s->D.Number, value)) {
+				char buffer[16];
+				sprintf(buffer, "%d", value);
+				CStringInstruction instruction(StringOp_Const);
+				instruction.Text = buffer;
+				code.push_back(instruction);
+			} else {
+				code.push_back(CStringInstruction(StringOp_Number, 0, s));
+			}
+			return true;
+		}
+		case EString_InverseVideo : {
+			const size_t start = code.size();
+			if (!CompileStringDesc(s->D.String, code, depth)) {
+				return false;
+			}
+			if (code.size() == start + 1 && code[start].Op == StringOp_Const) {
+				code[start].Text = std::string("~<") + code[start].Text + "~>";
+			} else {
+				code.push_back(CStringInstruction(StringOp_InverseVideo));
+			}
+			return true;
+		}
+		case EString_If : {
+			int cond;
+			if (IsConstantNumberDesc(s->D.If.Cond, cond)) {
+				if (cond) {
+					return CompileStringDesc(s->D.If.BTrue, code, depth);
+				} else if (s->D.If.BFalse) {
+					return CompileStringDesc(s->D.If.BFalse, code, depth);
+				}
+				code.push_back(CStringInstruction(StringOp_Const));
+				return true;
+			}
+			
+			const size_t jump_to_false = code.size();
+			code.push_back(CStringInstruction(StringOp_JumpIfZero, 0, s));
+			if (!CompileStringDesc(s->D.If.BTrue, code, depth)) {
+				return false;
+			}
+			const size_t jump_to_end = code.size();
+			code.push_back(CStringInstruction(StringOp_Jump));
+			code[jump_to_false].Target = code.size();
+			if (s->D.If.BFalse) {
+				if (!CompileStringDesc(s->D.If.BFalse, code, depth)) {
+					return false;
+				}
+			} else {
+				code.push_back(CStringInstruction(StringOp_Const));
+			}
+			code[jump_to_end].Target = code.size();
+			return true;
+		}
+		default : //other descriptions are leaves which depend on the game state, evaluate them by their tree
+			code.push_back(CStringInstruction(StringOp_Node, 0, s));
+			return true;
+	}
+}
+
+/**
+**  Get the compiled form of a string description, compiling it if it hasn't been yet.
+**
+**  @param s  the string description.
+**
+**  @return   the compiled string description.
+*/
+static const CStringProgram &GetStringProgram(const StringDesc *s)
+{
+	if (!s->Program) {
+		s->Program = new CStringProgram;
+		s->Program->Compiled = CompileStringDesc(s, s->Program->Instructions, 0);
+		if (!s->Program->Compiled) {
+			s->Program->Instructions.clear();
+		}
+	}
+	
+	return *s->Program;
+}
+
+/**
+**  Evaluate a compiled string description.
+**
+**  @param program  the compiled string description.
+**
+**  @return         the result string.
+*/
+static std::string RunStringProgram(const CStringProgram &program)
+{
+	std::string stack[STRING_PROGRAM_STACK_SIZE];
+	int top = -1;
+	
+	const int size = program.Instructions.size();
+	for (int pc = 0; pc < size; ++pc) {
+		const CStringInstruction &instruction = program.Instructions[pc];
+		switch (instruction.Op) {
+			case StringOp_Const :
+				stack[++top] = instruction.Text;
+				break;
+			case StringOp_Node :
+				stack[++top] = EvalStringNode(instruction.Node);
+				break;
+			case StringOp_Number : {
+				char buffer[16]; // Should be enough ?
+				sprintf(buffer, "%d", EvalNumber(instruction.Node->D.Number));
+				stack[++top] = buffer;
+				break;
+			}
+			case StringOp_Append :
+				--top;
+				stack[top] += stack[top + 1];
+				stack[top + 1].clear();
+				break;
+			case StringOp_InverseVideo :
+				stack[top] = std::string("~<") + stack[top] + "~>";
+				break;
+			case StringOp_JumpIfZero :
+				if (!EvalNumber(instruction.Node->D.If.Cond)) {
+					pc = instruction.Target - 1;
+				}
+				break;
+			case StringOp_Jump :
+				pc = instruction.Target - 1;
+				break;
+		}
+	}
+	
+	std::string res;
+	res.swap(stack[0]);
+	return res;
+}
+
+#ifdef DEBUG
+/**
+**  Evaluate a compiled number description, and check that the result is the same as that of walking its tree.
+**
+**  Descriptions which call lua functions aren't run twice, as the functions may have side effects;
+**  random numbers are checked by restoring the sync random seed before running the compiled form.
+**
+**  @param number   the number description.
+**  @param program  its compiled form.
+**
+**  @return         the result number.
+*/
+static int CheckNumberProgram(const NumberDesc *number, const CNumberProgram &program)
+{
+	const unsigned long lua_calls = LuaDescCalls;
+	const unsigned seed = SyncRandSeed;
+	
+	EvalDescsByTree = true;
+	const int tree_result = EvalNumberNode(number);
+	EvalDescsByTree = false;
+	
+	if (LuaDescCalls != lua_calls) {
+		return tree_result;
+	}
+	
+	const unsigned tree_seed = SyncRandSeed;
+	SyncRandSeed = seed;
+	const int result = RunNumberProgram(program);
+	Assert(result == tree_result);
+	Assert(SyncRandSeed == tree_seed);
+	return result;
+}
+
+/**
+**  Evaluate a compiled string description, and check that the result is the same as that of walking its tree.
+**
+**  @param s        the string description.
+**  @param program  its compiled form.
+**
+**  @return         the result string.
+*/
+static std::string CheckStringProgram(const StringDesc *s, const CStringProgram &program)
+{
+	const unsigned long lua_calls = LuaDescCalls;
+	const unsigned seed = SyncRandSeed;
+	
+	EvalDescsByTree = true;
+	const std::string tree_result = EvalStringNode(s);
+	EvalDescsByTree = false;
+	
+	if (LuaDescCalls != lua_calls) {
+		return tree_result;
+	}
+	
+	const unsigned tree_seed = SyncRandSeed;
+	SyncRandSeed = seed;
+	const std::string result = RunStringProgram(program);
+	Assert(result == tree_result);
+	Assert(SyncRandSeed == tree_seed);
+	return result;
+}
+#endif
+
+/**
+**  compute the number expression
+**
+**  @param number  struct with definition of the calculation.
+**
+**  @return        the result number.
+*/
+int EvalNumber(const NumberDesc *number)
+{
+	Assert(number);
+	
+#ifdef DEBUG
+	if (EvalDescsByTree) {
+		return EvalNumberNode(number);
+	}
+#endif
+	
+	const CNumberProgram &program = GetNumberProgram(number);
+	if (program.Compiled) {
+#ifdef DEBUG
+		return CheckNumberProgram(number, program);
+#else
+		return RunNumberProgram(program);
+#endif
+	} else {
+		return EvalNumberNode(number);
+	}
+}
+
+/**
+**  compute the string expression
+**
+**  @param s  struct with definition of the calculation.
+**
+**  @return   the result string.
+*/
+std::string EvalString(const StringDesc *s)
+{
+	Assert(s);
+	
+#ifdef DEBUG
+	if (EvalDescsByTree) {
+		return EvalStringNode(s);
+	}
+#endif
+	
+	const CStringProgram &program = GetStringProgram(s);
+	if (program.Compiled) {
+#ifdef DEBUG
+		return CheckStringProgram(s, program);
+#else
+		return RunStringProgram(program);
+#endif
+	} else {
+		return EvalStringNode(s);
+	}
+}
+//Wyrmgus end
+
 /**
 **  Free the unit expression content. (not the pointer itself).
 **
@@ -1786,6 +2544,10 @@ void FreeNumberDesc(NumberDesc *number)
 	if (number == 0) {
 		return;
 	}
+	//Wyrmgus start
+	delete number->Program;
+	number->Program = NULL;
+	//Wyrmgus end
 	switch (number->e) {
 		case ENumber_Lua :     // a lua function.
 		// FIXME: when lua table should be freed ?
@@ -1863,6 +2625,10 @@ void FreeStringDesc(StringDesc *s)
 	if (s == 0) {
 		return;
 	}
+	//Wyrmgus start
+	delete s->Program;
+	s->Program = NULL;
+	//Wyrmgus end
 	switch (s->e) {
 		case EString_Lua :     // a lua function.
 			// FIXME: when lua table should be freed ?
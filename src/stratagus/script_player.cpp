@@ -44,6 +44,7 @@
 //Wyrmgus end
 #include "commands.h"
 //Wyrmgus start
+#include "depend.h"
 #include "editor.h"
 #include "font.h"
 #include "grand_strategy.h"
@@ -151,6 +152,7 @@ void CPlayer::Load(lua_State *l)
 		//Wyrmgus start
 		} else if (!strcmp(value, "faction")) {
 			this->Faction = LuaToNumber(l, j + 1);
+			InvalidatePlayerDependencies(*this);
 		} else if (!strcmp(value, "dynasty")) {
 			this->Dynasty = PlayerRaces.GetDynasty(LuaToString(l, j + 1));
 		} else if (!strcmp(value, "color")) {
@@ -189,6 +191,9 @@ void CPlayer::Load(lua_State *l)
 					this->SharedVision |= (1 << i);
 				}
 			}
+			//Wyrmgus start
+			PlayerVisionChanged();
+			//Wyrmgus end
 		} else if (!strcmp(value, "start")) {
 			CclGetPos(l, &this->StartPos.x, &this->StartPos.y, j + 1);
 		//Wyrmgus start
@@ -290,6 +295,7 @@ void CPlayer::Load(lua_State *l)
 		//Wyrmgus start
 		} else if (!strcmp(value, "revealed")) {
 			this->Revealed = true;
+			PlayerVisionChanged();
 			--j;
 		//Wyrmgus end
 		} else if (!strcmp(value, "supply")) {
@@ -466,6 +466,7 @@ static void Usage()
 		"\t-F\t\tFull screen video mode\n"
 		"\t-G \"options\"\tGame options (passed to game scripts)\n"
 		"\t-h\t\tHelp shows this page\n"
+		"\t-H\t\tHeadless mode: draw to an offscreen surface without opening a window\n"
 		"\t-i\t\tEnables unit info dumping into log (for debugging)\n"
 		"\t-I addr\t\tNetwork address to use\n"
 		"\t-l\t\tDisable command log\n"
@@ -533,7 +534,10 @@ static void RedirectOutput()
 void ParseCommandLine(int argc, char **argv, Parameters &parameters)
 {
 	for (;;) {
-		switch (getopt(argc, argv, "ac:d:D:eE:FG:hiI:lN:oOP:ps:S:u:v:Wx:Z?-")) {
+		//Wyrmgus start
+//		switch (getopt(argc, argv, "ac:d:D:eE:FG:hiI:lN:oOP:ps:S:u:v:Wx:Z?-")) {
+		switch (getopt(argc, argv, "ac:d:D:eE:FG:hHiI:lN:oOP:ps:S:u:v:Wx:Z?-")) {
+		//Wyrmgus end
 			case 'a':
 				EnableAssert = true;
 				continue;
@@ -568,6 +572,15 @@ void ParseCommandLine(int argc, char **argv, Parameters &parameters)
 			case 'G':
 				parameters.luaScriptArguments = optarg;
 				continue;
+			//Wyrmgus start
+			case 'H':
+				VideoHeadless = 1;
+#if defined(USE_OPENGL) || defined(USE_GLES)
+				ForceUseOpenGL = 1;
+				UseOpenGL = 0;
+#endif
+				continue;
+			//Wyrmgus end
 			case 'i':
 				EnableUnitDebug = true;
 				continue;
@@ -1231,11 +1231,18 @@ void CButtonPanel::Draw()
 			if (!IsButtonAllowed(*Selected[j], buttons[i])) {
 				gray = true;
 				break;
+			//Wyrmgus start
+//			} else if (buttons[i].Action == ButtonSpellCast
+//					   && (*Selected[j]).SpellCoolDownTimers[SpellTypeTable[buttons[i].Value]->Slot]) {
 			} else if (buttons[i].Action == ButtonSpellCast
-					   && (*Selected[j]).SpellCoolDownTimers[SpellTypeTable[buttons[i].Value]->Slot]) {
+					   && (*Selected[j]).GetSpellCoolDownTimer(SpellTypeTable[buttons[i].Value]->Slot)) {
+			//Wyrmgus end
 				Assert(SpellTypeTable[buttons[i].Value]->CoolDown > 0);
 				cooldownSpell = true;
-				maxCooldown = std::max(maxCooldown, (*Selected[j]).SpellCoolDownTimers[SpellTypeTable[buttons[i].Value]->Slot]);
+				//Wyrmgus start
+//				maxCooldown = std::max(maxCooldown, (*Selected[j]).SpellCoolDownTimers[SpellTypeTable[buttons[i].Value]->Slot]);
+				maxCooldown = std::max(maxCooldown, (*Selected[j]).GetSpellCoolDownTimer(SpellTypeTable[buttons[i].Value]->Slot));
+				//Wyrmgus end
 			}
 		}
 		//
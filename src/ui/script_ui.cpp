@@ -1311,6 +1311,38 @@ static int CclGetIcons(lua_State *l)
 	}
 	return 1;
 }
+
+/**
+**  Draw frames and print how long each stage of drawing took.
+**
+**  @param l  Lua state.
+*/
+static int CclBenchmarkRendering(lua_State *l)
+{
+	const int args = lua_gettop(l);
+	if (args < 1 || args > 2) {
+		LuaError(l, "incorrect argument");
+	}
+	const int frames = LuaToNumber(l, 1);
+	
+	std::vector<Vec2i> positions;
+	if (args == 2) {
+		if (!lua_istable(l, 2)) {
+			LuaError(l, "incorrect argument");
+		}
+		const int subargs = lua_rawlen(l, 2);
+		for (int i = 0; i < subargs; ++i) {
+			lua_rawgeti(l, 2, i + 1);
+			Vec2i pos;
+			CclGetPos(l, &pos.x, &pos.y);
+			lua_pop(l, 1);
+			positions.push_back(pos);
+		}
+	}
+	
+	BenchmarkRendering(frames, positions);
+	return 0;
+}
 //Wyrmgus end
 
 /**
@@ -1323,6 +1355,7 @@ void UserInterfaceCclRegister()
 	//Wyrmgus start
 	lua_register(Lua, "AddObjective", CclAddObjective);
 	lua_register(Lua, "ClearObjectives", CclClearObjectives);
+	lua_register(Lua, "BenchmarkRendering", CclBenchmarkRendering);
 	//Wyrmgus end
 
 	lua_register(Lua, "SetKeyScrollSpeed", CclSetKeyScrollSpeed);
@@ -57,6 +57,27 @@ static DependRule *DependHash[101];
 //Wyrmgus start
 /// All predependencies hash (predependencies are checked to see whether a button should be displayed at all)
 static DependRule *PredependHash[101];
+
+#define DEPEND_CACHE_FLAGS 8	/// quantity of combinations of the ignore units, predependency and neutral use flags of a dependency check
+
+/// A cached result of a dependency check
+class CDependCacheEntry
+{
+public:
+	CDependCacheEntry() : Version(0), Valid(false), Result(false)
+	{
+	}
+
+	unsigned int Version;	/// dependency version of the player when the result was cached
+	bool Valid;				/// whether a result has been cached
+	bool Result;			/// the cached result
+};
+
+static unsigned int DependVersions[PlayerMax];	/// version of each player's dependency inputs, increased whenever one of them changes
+static std::vector<CDependCacheEntry> DependCache[PlayerMax][2];	/// cached dependency results of each player for unit types and upgrades, indexed by target slot and check flags
+static std::vector<int> DependUnitTypeThresholds;	/// the highest unit count which dependency rules tell apart for each unit type, indexed by unit type slot
+
+static bool CheckDependByTargetCached(const CPlayer &player, DependRule &rule, bool ignore_units, bool is_predependency, bool is_neutral_use);
 //Wyrmgus end
 
 /*----------------------------------------------------------------------------
@@ -196,6 +217,19 @@ static void AddDependency(const std::string &target, const std::string &required
 		}
 		node->Rule = temp;
 	}
+	
+	//Wyrmgus start
+	if (temp->Type == DependRuleUnitType && temp->Kind.UnitType) {
+		const int slot = temp->Kind.UnitType->Slot;
+		if (slot >= (int) DependUnitTypeThresholds.size()) {
+			DependUnitTypeThresholds.resize(slot + 1, 0);
+		}
+		//a count of zero means that no unit of the type may exist, so the rule tells apart zero and one units
+		DependUnitTypeThresholds[slot] = std::max(DependUnitTypeThresholds[slot], std::max(count, 1));
+	}
+	
+	InvalidateDependencies();
+	//Wyrmgus end
 
 #ifdef neverDEBUG
 	fprintf(stdout, "New rules are :");
@@ -469,6 +503,8 @@ bool CheckDependByIdent(const CPlayer &player, const std::string &target, bool i
 	//
 	//  first have to check, if target is allowed itself
 	//
+	//Wyrmgus start
+	/*
 	if (!strncmp(target.c_str(), "unit-", 5)) {
 		// target string refers to unit-XXX
 		rule.Kind.UnitType = UnitTypeByIdent(target);
@@ -485,6 +521,42 @@ bool CheckDependByIdent(const CPlayer &player, const std::string &target, bool i
 		//Wyrmgus end
 			return false;
 		}
+	*/
+	if (!strncmp(target.c_str(), "unit-", 5)) {
+		// target string refers to unit-XXX
+		rule.Kind.UnitType = UnitTypeByIdent(target);
+		rule.Type = DependRuleUnitType;
+	} else if (!strncmp(target.c_str(), "upgrade-", 8)) {
+		// target string refers to upgrade-XXX
+		rule.Kind.Upgrade = CUpgrade::Get(target);
+		rule.Type = DependRuleUpgrade;
+	} else {
+		DebugPrint("target '%s' should be unit-type or upgrade\n" _C_ target.c_str());
+		return false;
+	}
+	
+	return CheckDependByTargetCached(player, rule, ignore_units, is_predependency, is_neutral_use);
+}
+
+/**
+**  Check if the target of a rule is available, without going through the cache.
+**
+**  @param player  For this player available.
+**  @param rule    Rule with the unit type or upgrade to check.
+**
+**  @return        True if available, false otherwise.
+*/
+static bool CheckDependByTarget(const CPlayer &player, DependRule &rule, bool ignore_units, bool is_predependency, bool is_neutral_use)
+{
+	if (rule.Type == DependRuleUnitType) {
+		if (UnitIdAllowed(player, rule.Kind.UnitType->Slot) == 0) {
+			return false;
+		}
+	} else {
+		if (UpgradeIdAllowed(player, rule.Kind.Upgrade->ID) != 'A' && !((is_predependency || is_neutral_use) && UpgradeIdAllowed(player, rule.Kind.Upgrade->ID) == 'R')) {
+			return false;
+		}
+	//Wyrmgus end
 		//Wyrmgus start
 		if (player.Faction != -1 && PlayerRaces.Factions[player.Faction]->Type == FactionTypeHolyOrder) { // if the player is a holy order, and the upgrade is incompatible with its deity, don't allow it
 			if (PlayerRaces.Factions[player.Faction]->HolyOrderDeity) {
@@ -504,10 +576,14 @@ bool CheckDependByIdent(const CPlayer &player, const std::string &target, bool i
 			}
 		}
 		//Wyrmgus end
+		//Wyrmgus start
+		/*
 		rule.Type = DependRuleUpgrade;
 	} else {
 		DebugPrint("target '%s' should be unit-type or upgrade\n" _C_ target.c_str());
 		return false;
+		*/
+		//Wyrmgus end
 	}
 	//Wyrmgus start
 //	return CheckDependByRule(player, rule);
@@ -515,6 +591,82 @@ bool CheckDependByIdent(const CPlayer &player, const std::string &target, bool i
 	//Wyrmgus end
 }
 
+//Wyrmgus start
+/**
+**  Check if the target of a rule is available, using the player's cached result if its dependency inputs haven't changed since it was obtained.
+**
+**  @param player  For this player available.
+**  @param rule    Rule with the unit type or upgrade to check.
+**
+**  @return        True if available, false otherwise.
+*/
+static bool CheckDependByTargetCached(const CPlayer &player, DependRule &rule, bool ignore_units, bool is_predependency, bool is_neutral_use)
+{
+	if (rule.Type == DependRuleUnitType) {
+		is_neutral_use = false; //only makes a difference for upgrades
+	}
+	
+	const int slot = rule.Type == DependRuleUnitType ? rule.Kind.UnitType->Slot : rule.Kind.Upgrade->ID;
+	const size_t index = slot * DEPEND_CACHE_FLAGS + (ignore_units ? 1 : 0) + (is_predependency ? 2 : 0) + (is_neutral_use ? 4 : 0);
+	std::vector<CDependCacheEntry> &cache = DependCache[player.Index][rule.Type == DependRuleUnitType ? 0 : 1];
+	
+	if (index < cache.size() && cache[index].Valid && cache[index].Version == DependVersions[player.Index]) {
+		return cache[index].Result;
+	}
+	
+	const bool result = CheckDependByTarget(player, rule, ignore_units, is_predependency, is_neutral_use);
+	
+	if (index >= cache.size()) {
+		cache.resize((slot + 1) * DEPEND_CACHE_FLAGS);
+	}
+	cache[index].Version = DependVersions[player.Index];
+	cache[index].Valid = true;
+	cache[index].Result = result;
+	
+	return result;
+}
+
+/**
+**  Invalidate the cached dependency results of a player, after one of the inputs of its dependency checks changed.
+**
+**  @param player  The player.
+*/
+void InvalidatePlayerDependencies(const CPlayer &player)
+{
+	++DependVersions[player.Index];
+}
+
+/**
+**  Invalidate the cached dependency results of all players.
+*/
+void InvalidateDependencies()
+{
+	for (int i = 0; i < PlayerMax; ++i) {
+		++DependVersions[i];
+	}
+}
+
+/**
+**  Invalidate the cached dependency results of a player if a change in its count of units of a type can change a dependency check.
+**
+**  @param player     The player.
+**  @param type       The unit type.
+**  @param old_count  The player's previous count of units of the type.
+**  @param new_count  The player's new count of units of the type.
+*/
+void UnitTypeCountChanged(const CPlayer &player, const CUnitType &type, int old_count, int new_count)
+{
+	if (type.Slot >= (int) DependUnitTypeThresholds.size()) {
+		return;
+	}
+	
+	const int threshold = DependUnitTypeThresholds[type.Slot];
+	if (std::min(old_count, threshold) != std::min(new_count, threshold)) {
+		InvalidatePlayerDependencies(player);
+	}
+}
+//Wyrmgus end
+
 //Wyrmgus start
 /**
 **  Check if this upgrade or unit is available for a particular unit.
@@ -565,16 +717,20 @@ bool CheckDependByIdent(const CUnit &unit, const std::string &target, bool ignor
 bool CheckDependByType(const CPlayer &player, const CUnitType &type, bool ignore_units, bool is_predependency)
 //Wyrmgus end
 {
+	//Wyrmgus start
+	/*
 	if (UnitIdAllowed(player, type.Slot) == 0) {
 		return false;
 	}
+	*/
+	//Wyrmgus end
 	DependRule rule;
 
 	rule.Kind.UnitType = &type;
 	rule.Type = DependRuleUnitType;
 	//Wyrmgus start
 //	return CheckDependByRule(player, rule);
-	return CheckDependByRule(player, rule, ignore_units, is_predependency);
+	return CheckDependByTargetCached(player, rule, ignore_units, is_predependency, false);
 	//Wyrmgus end
 }
 
@@ -666,6 +822,13 @@ void CleanDependencies()
 		}
 		PredependHash[u] = NULL;
 	}
+	
+	DependUnitTypeThresholds.clear();
+	for (int i = 0; i < PlayerMax; ++i) {
+		DependCache[i][0].clear();
+		DependCache[i][1].clear();
+	}
+	InvalidateDependencies();
 	//Wyrmgus end
 }
 
@@ -260,6 +260,31 @@ void PathFinderOutput::Load(lua_State *l)
 	}
 }
 
+//Wyrmgus start
+void PathFinderData::LoadRequest(lua_State *l)
+{
+	if (!lua_istable(l, -1)) {
+		LuaError(l, "incorrect argument in PathFinderData::LoadRequest");
+	}
+	const int args = 1 + lua_rawlen(l, -1);
+	for (int i = 1; i < args; ++i) {
+		const char *tag = LuaToString(l, -1, i);
+		++i;
+		if (!strcmp(tag, "completed")) {
+			this->RequestState = PathRequestCompleted;
+			this->RequestResult = LuaToNumber(l, -1, i);
+		} else if (!strcmp(tag, "after-blocked")) {
+			this->RequestAfterBlocked = true;
+			--i;
+		} else if (!strcmp(tag, "retries")) {
+			this->RequestRetries = LuaToNumber(l, -1, i);
+		} else {
+			LuaError(l, "PathFinderData::LoadRequest: Unsupported tag: %s" _C_ tag);
+		}
+	}
+}
+//Wyrmgus end
+
 /**
 **  Parse orders.
 **
@@ -585,6 +610,15 @@ static int CclUnit(lua_State *l)
 			lua_pushvalue(l, -1);
 			unit->pathFinderData->output.Load(l);
 			lua_pop(l, 1);
+		//Wyrmgus start
+		} else if (!strcmp(value, "pathfinder-request")) {
+			lua_rawgeti(l, 2, j + 1);
+			lua_pushvalue(l, -1);
+			unit->pathFinderData->LoadRequest(l);
+			lua_pop(l, 1);
+		} else if (!strcmp(value, "sleep-cycle")) {
+			unit->SleepCycle = LuaToNumber(l, 2, j + 1);
+		//Wyrmgus end
 		} else if (!strcmp(value, "wait")) {
 			unit->Wait = LuaToNumber(l, 2, j + 1);
 		} else if (!strcmp(value, "anim-data")) {
@@ -691,11 +725,18 @@ static int CclUnit(lua_State *l)
 				LuaError(l, "incorrect argument");
 			}
 			if (!unit->SpellCoolDownTimers) {
-				unit->SpellCoolDownTimers = new int[SpellTypeTable.size()];
-				memset(unit->SpellCoolDownTimers, 0, SpellTypeTable.size() * sizeof(int));
+				//Wyrmgus start
+//				unit->SpellCoolDownTimers = new int[SpellTypeTable.size()];
+//				memset(unit->SpellCoolDownTimers, 0, SpellTypeTable.size() * sizeof(int));
+				unit->SpellCoolDownTimers = new unsigned long[SpellTypeTable.size()];
+				memset(unit->SpellCoolDownTimers, 0, SpellTypeTable.size() * sizeof(unsigned long));
+				//Wyrmgus end
 			}
 			for (size_t k = 0; k < SpellTypeTable.size(); ++k) {
-				unit->SpellCoolDownTimers[k] = LuaToNumber(l, -1, k + 1);
+				//Wyrmgus start
+//				unit->SpellCoolDownTimers[k] = LuaToNumber(l, -1, k + 1);
+				unit->SetSpellCoolDownTimer(k, LuaToNumber(l, -1, k + 1));
+				//Wyrmgus end
 			}
 			lua_pop(l, 1);
 		//Wyrmgus start
@@ -2182,6 +2223,19 @@ static int CclUnitIsAt(lua_State *l)
 	}
 	return 1;
 }
+
+/**
+**  Print the allocation statistics of the order pools
+**
+**  @param l  Lua state.
+*/
+static int CclPrintOrderPoolStatistics(lua_State *l)
+{
+	LuaCheckArgs(l, 0);
+	
+	PrintOrderPoolStatistics();
+	return 0;
+}
 //Wyrmgus end
 
 /**
@@ -2235,6 +2289,7 @@ void UnitCclRegister()
 	
 	//Wyrmgus start
 	lua_register(Lua, "UnitIsAt", CclUnitIsAt);
+	lua_register(Lua, "PrintOrderPoolStatistics", CclPrintOrderPoolStatistics);
 	//Wyrmgus end
 }
 
@@ -1545,6 +1545,12 @@ static int CclDefineUnitType(lua_State *l)
 			type->OnEachCycle = new LuaCallback(l, -1);
 		} else if (!strcmp(value, "OnEachSecond")) {
 			type->OnEachSecond = new LuaCallback(l, -1);
+		//Wyrmgus start
+		} else if (!strcmp(value, "BatchOnEachCycle")) {
+			type->BatchOnEachCycle = LuaToBoolean(l, -1);
+		} else if (!strcmp(value, "BatchOnEachSecond")) {
+			type->BatchOnEachSecond = LuaToBoolean(l, -1);
+		//Wyrmgus end
 		} else if (!strcmp(value, "OnInit")) {
 			type->OnInit = new LuaCallback(l, -1);
 		} else if (!strcmp(value, "Type")) {
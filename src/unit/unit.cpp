@@ -495,6 +495,9 @@ void CUnit::Init()
 	Direction = 0;
 	DamagedType = ANIMATIONS_DEATHTYPES;
 	Attacked = 0;
+	//Wyrmgus start
+	SleepCycle = 0;
+	//Wyrmgus end
 	Burning = 0;
 	Destroyed = 0;
 	Removed = 0;
@@ -517,6 +520,9 @@ void CUnit::Init()
 	Moving = 0;
 	ReCast = 0;
 	CacheLock = 0;
+	//Wyrmgus start
+	SelectGeneration = 0;
+	//Wyrmgus end
 	Summoned = 0;
 	Waiting = 0;
 	MineLow = 0;
@@ -2559,8 +2565,12 @@ void CUnit::Init(const CUnitType &type)
 	//to avoid crashes with spell items for units who cannot ordinarily cast spells
 	//Wyrmgus end
 		AutoCastSpell = new char[SpellTypeTable.size()];
-		SpellCoolDownTimers = new int[SpellTypeTable.size()];
-		memset(SpellCoolDownTimers, 0, SpellTypeTable.size() * sizeof(int));
+		//Wyrmgus start
+//		SpellCoolDownTimers = new int[SpellTypeTable.size()];
+//		memset(SpellCoolDownTimers, 0, SpellTypeTable.size() * sizeof(int));
+		SpellCoolDownTimers = new unsigned long[SpellTypeTable.size()];
+		memset(SpellCoolDownTimers, 0, SpellTypeTable.size() * sizeof(unsigned long));
+		//Wyrmgus end
 		if (Type->AutoCastActive) {
 			memcpy(AutoCastSpell, Type->AutoCastActive, SpellTypeTable.size());
 		} else {
@@ -2977,6 +2987,117 @@ void MapUnmarkUnitSight(CUnit &unit)
 	//Wyrmgus end
 }
 
+//Wyrmgus start
+/**
+**  (Un)Mark on vision table the Sight of the unit (and units inside for
+**  transporter (recursively)) which is not within its sight from another
+**  position or with another range.
+**
+**  @param unit            Unit to (un)mark.
+**  @param pos             coord of first container of unit.
+**  @param width           Width of the first container of unit.
+**  @param height          Height of the first container of unit.
+**  @param range           Sight range to (un)mark, or -1 for the unit's current one.
+**  @param excluded_pos    coord of first container of unit for the sight which is not (un)marked.
+**  @param excluded_range  Sight range which is not (un)marked, or -1 for the unit's current one.
+**  @param f               Function to (un)mark for normal vision.
+**  @param f2              Function to (un)mark for cloaking vision.
+**  @param f3              Function to (un)mark for ethereal vision.
+*/
+static void MapMarkUnitSightDifferenceRec(const CUnit &unit, const Vec2i &pos, int width, int height, int range, const Vec2i &excluded_pos, int excluded_range,
+								MapMarkerFunc *f, MapMarkerFunc *f2, MapMarkerFunc *f3)
+{
+	const int current_range = unit.Container && unit.Container->CurrentSightRange >= unit.CurrentSightRange ? unit.Container->CurrentSightRange : unit.CurrentSightRange;
+	if (range == -1) {
+		range = current_range;
+	}
+	if (excluded_range == -1) {
+		excluded_range = current_range;
+	}
+
+	MapSightDifference(*unit.Player, pos, width, height, range, excluded_pos, excluded_range, f, unit.MapLayer);
+
+	if (unit.Type && unit.Type->BoolFlag[DETECTCLOAK_INDEX].value && f2) {
+		MapSightDifference(*unit.Player, pos, width, height, range, excluded_pos, excluded_range, f2, unit.MapLayer);
+	}
+	
+	if (unit.Variable[ETHEREALVISION_INDEX].Value && f3) {
+		MapSightDifference(*unit.Player, pos, width, height, range, excluded_pos, excluded_range, f3, unit.MapLayer);
+	}
+
+	CUnit *unit_inside = unit.UnitInside;
+	for (int i = unit.InsideCount; i--; unit_inside = unit_inside->NextContained) {
+		MapMarkUnitSightDifferenceRec(*unit_inside, pos, width, height, -1, excluded_pos, -1, f, f2, f3);
+	}
+}
+
+/**
+**  Check whether the sight of the unit can be updated by only (un)marking
+**  the tiles which enter or leave it, instead of unmarking and marking
+**  again its whole sight.
+**
+**  Units whose sight is blocked by obstacles, and units with radar, radar
+**  jamming or ownership influence, which are (un)marked together with the
+**  sight, are excluded.
+**
+**  @param unit  Unit whose sight is to be updated.
+*/
+bool CanUpdateUnitSightDifference(const CUnit &unit)
+{
+	if (unit.Container || Map.IsLayerUnderground(unit.MapLayer)) {
+		return false;
+	}
+	
+	if (!unit.IsUnusable() && (unit.Stats->Variables[RADAR_INDEX].Value || unit.Stats->Variables[RADARJAMMER_INDEX].Value)) {
+		return false;
+	}
+	
+	if (unit.Variable[OWNERSHIPINFLUENCERANGE_INDEX].Value) {
+		return false;
+	}
+	
+	return true;
+}
+
+/**
+**  Mark on vision table the Sight of the unit (and units inside for
+**  transporter) which is not within its sight from another position or
+**  with another range.
+**
+**  @param unit            unit to mark its vision.
+**  @param range           sight range to mark, or -1 for the unit's current one.
+**  @param excluded_pos    position from which the sight is not marked.
+**  @param excluded_range  sight range which is not marked, or -1 for the unit's current one.
+**  @see CanUpdateUnitSightDifference.
+*/
+void MapMarkUnitSightDifference(CUnit &unit, int range, const Vec2i &excluded_pos, int excluded_range)
+{
+	Assert(CanUpdateUnitSightDifference(unit));
+
+	MapMarkUnitSightDifferenceRec(unit, unit.tilePos, unit.Type->TileWidth, unit.Type->TileHeight, range, excluded_pos, excluded_range,
+						MapMarkTileSight, MapMarkTileDetectCloak, MapMarkTileDetectEthereal);
+}
+
+/**
+**  Unmark on vision table the Sight of the unit (and units inside for
+**  transporter) which is not within its sight from another position or
+**  with another range.
+**
+**  @param unit            unit to unmark its vision.
+**  @param range           sight range to unmark, or -1 for the unit's current one.
+**  @param excluded_pos    position from which the sight is not unmarked.
+**  @param excluded_range  sight range which is not unmarked, or -1 for the unit's current one.
+**  @see CanUpdateUnitSightDifference.
+*/
+void MapUnmarkUnitSightDifference(CUnit &unit, int range, const Vec2i &excluded_pos, int excluded_range)
+{
+	Assert(CanUpdateUnitSightDifference(unit));
+
+	MapMarkUnitSightDifferenceRec(unit, unit.tilePos, unit.Type->TileWidth, unit.Type->TileHeight, range, excluded_pos, excluded_range,
+						MapUnmarkTileSight, MapUnmarkTileDetectCloak, MapUnmarkTileDetectEthereal);
+}
+//Wyrmgus end
+
 /**
 **  Update the Unit Current sight range to good value and transported units inside.
 **
@@ -3070,6 +3191,17 @@ void MarkUnitFieldFlags(const CUnit &unit)
 		index += Map.Info.MapWidths[unit.MapLayer];
 		//Wyrmgus end
 	} while (--h);
+	
+	//Wyrmgus start
+	if (flags & ~(MapFieldLandUnit | MapFieldAirUnit | MapFieldSeaUnit)) {
+		for (int x = 0; x < unit.Type->TileWidth; ++x) {
+			for (int y = 0; y < unit.Type->TileHeight; ++y) {
+				HierarchicalPathfinderTileChanged(unit.tilePos + Vec2i(x, y), unit.MapLayer);
+				MapSightTileChanged(unit.tilePos + Vec2i(x, y), unit.MapLayer);
+			}
+		}
+	}
+	//Wyrmgus end
 }
 
 class _UnmarkUnitFieldFlags
@@ -3124,6 +3256,17 @@ void UnmarkUnitFieldFlags(const CUnit &unit)
 		index += Map.Info.MapWidths[unit.MapLayer];
 		//Wyrmgus end
 	} while (--h);
+	
+	//Wyrmgus start
+	if (unit.Type->FieldFlags & ~(MapFieldLandUnit | MapFieldAirUnit | MapFieldSeaUnit)) {
+		for (int x = 0; x < unit.Type->TileWidth; ++x) {
+			for (int y = 0; y < unit.Type->TileHeight; ++y) {
+				HierarchicalPathfinderTileChanged(unit.tilePos + Vec2i(x, y), unit.MapLayer);
+				MapSightTileChanged(unit.tilePos + Vec2i(x, y), unit.MapLayer);
+			}
+		}
+	}
+	//Wyrmgus end
 }
 
 /**
@@ -3432,7 +3575,17 @@ static void UnitInXY(CUnit &unit, const Vec2i &pos, int z)
 void CUnit::MoveToXY(const Vec2i &pos, int z)
 //Wyrmgus end
 {
-	MapUnmarkUnitSight(*this);
+	//Wyrmgus start
+//	MapUnmarkUnitSight(*this);
+	// if the unit moves to an adjacent tile, only update its sight on the tiles which leave or enter it
+	const Vec2i old_pos = this->tilePos;
+	const bool sight_difference = z == this->MapLayer && abs(pos.x - old_pos.x) <= 1 && abs(pos.y - old_pos.y) <= 1 && CanUpdateUnitSightDifference(*this);
+	if (sight_difference) {
+		MapUnmarkUnitSightDifference(*this, -1, pos, -1);
+	} else {
+		MapUnmarkUnitSight(*this);
+	}
+	//Wyrmgus end
 	Map.Remove(*this);
 	UnmarkUnitFieldFlags(*this);
 
@@ -3450,7 +3603,14 @@ void CUnit::MoveToXY(const Vec2i &pos, int z)
 	MarkUnitFieldFlags(*this);
 	//  Recalculate the seen count.
 	UnitCountSeen(*this);
-	MapMarkUnitSight(*this);
+	//Wyrmgus start
+//	MapMarkUnitSight(*this);
+	if (sight_difference) {
+		MapMarkUnitSightDifference(*this, -1, old_pos, -1);
+	} else {
+		MapMarkUnitSight(*this);
+	}
+	//Wyrmgus end
 	
 	//Wyrmgus start
 	// if there is a trap in the new tile, trigger it
@@ -4038,6 +4198,7 @@ void UpdateForNewUnit(const CUnit &unit, int upgrade)
 	if (player.LostTownHallTimer != 0 && type.BoolFlag[TOWNHALL_INDEX].value && ThisPlayer->HasContactWith(player)) {
 		player.LostTownHallTimer = 0;
 		player.Revealed = false;
+		PlayerVisionChanged();
 		for (int j = 0; j < NumPlayers; ++j) {
 			if (player.Index != j && Players[j].Type != PlayerNobody) {
 				Players[j].Notify(_("%s has rebuilt a town hall, and will no longer be revealed!"), player.Name.c_str());
@@ -4183,6 +4344,9 @@ void CorrectWallNeighBours(CUnit &unit)
 */
 void UnitGoesUnderFog(CUnit &unit, const CPlayer &player)
 {
+	//Wyrmgus start
+	UI.Minimap.UpdateUnitDot(unit);
+	//Wyrmgus end
 	if (unit.Type->BoolFlag[VISIBLEUNDERFOG_INDEX].value) {
 		if (player.Type == PlayerPerson && !unit.Destroyed) {
 			unit.RefsIncrease();
@@ -4224,6 +4388,9 @@ void UnitGoesUnderFog(CUnit &unit, const CPlayer &player)
 */
 void UnitGoesOutOfFog(CUnit &unit, const CPlayer &player)
 {
+	//Wyrmgus start
+	UI.Minimap.UpdateUnitDot(unit);
+	//Wyrmgus end
 	if (!unit.Type->BoolFlag[VISIBLEUNDERFOG_INDEX].value) {
 		return;
 	}
@@ -4276,12 +4443,15 @@ void UnitCountSeen(CUnit &unit)
 				int x = width;
 				do {
 					if (unit.Type->BoolFlag[PERMANENTCLOAK_INDEX].value && unit.Player != &Players[p]) {
-						if (mf->playerInfo.VisCloak[p]) {
+						//Wyrmgus start
+//						if (mf->playerInfo.VisCloak[p]) {
+						if (mf->playerInfo.GetVisCloak(p)) {
+						//Wyrmgus end
 							newv++;
 						}
 					//Wyrmgus start
 					} else if (unit.Type->BoolFlag[ETHEREAL_INDEX].value && unit.Player != &Players[p]) {
-						if (mf->playerInfo.VisEthereal[p]) {
+						if (mf->playerInfo.GetVisEthereal(p)) {
 							newv++;
 						}
 					//Wyrmgus end
@@ -4509,6 +4679,10 @@ void CUnit::ChangeOwner(CPlayer &newplayer, bool show_change)
 	MapUnmarkUnitSight(*this);
 	newplayer.AddUnit(*this);
 	Stats = &Type->Stats[newplayer.Index];
+	//Wyrmgus start
+	Map.MarkUnitBucketsChanged(*this); // sleeping units nearby may now consider the unit an enemy or an ally
+	UI.Minimap.UpdateUnitDot(*this);
+	//Wyrmgus end
 
 	//  Must change food/gold and other.
 	//Wyrmgus start
@@ -5537,8 +5711,9 @@ void CUnit::ChangeUnitStock(CUnitType *unit_type, int quantity)
 
 int CUnit::GetUnitStockReplenishmentTimer(CUnitType *unit_type) const
 {
-	if (this->UnitStockReplenishmentTimers.find(unit_type) != this->UnitStockReplenishmentTimers.end()) {
-		return this->UnitStockReplenishmentTimers.find(unit_type)->second;
+	std::map<CUnitType *, unsigned long>::const_iterator find_iterator = this->UnitStockReplenishmentTimers.find(unit_type);
+	if (find_iterator != this->UnitStockReplenishmentTimers.end() && find_iterator->second > GameCycle) {
+		return find_iterator->second - GameCycle;
 	} else {
 		return 0;
 	}
@@ -5555,7 +5730,7 @@ void CUnit::SetUnitStockReplenishmentTimer(CUnitType *unit_type, int quantity)
 			this->UnitStockReplenishmentTimers.erase(unit_type);
 		}
 	} else {
-		this->UnitStockReplenishmentTimers[unit_type] = quantity;
+		this->UnitStockReplenishmentTimers[unit_type] = GameCycle + quantity;
 	}
 }
 
@@ -5564,6 +5739,30 @@ void CUnit::ChangeUnitStockReplenishmentTimer(CUnitType *unit_type, int quantity
 	this->SetUnitStockReplenishmentTimer(unit_type, this->GetUnitStockReplenishmentTimer(unit_type) + quantity);
 }
 
+/**
+**  Get the cycles left before a spell can be cast again
+**
+**  The cooldown is stored as the game cycle at which it is over, so that it
+**  doesn't need to be counted down each cycle.
+*/
+int CUnit::GetSpellCoolDownTimer(int spell_slot) const
+{
+	if (!this->SpellCoolDownTimers || this->SpellCoolDownTimers[spell_slot] <= GameCycle) {
+		return 0;
+	}
+	
+	return this->SpellCoolDownTimers[spell_slot] - GameCycle;
+}
+
+void CUnit::SetSpellCoolDownTimer(int spell_slot, int cool_down)
+{
+	if (!this->SpellCoolDownTimers) {
+		return;
+	}
+	
+	this->SpellCoolDownTimers[spell_slot] = cool_down > 0 ? GameCycle + cool_down : 0;
+}
+
 int CUnit::GetResourceStep(const int resource) const
 {
 	if (!this->Type->ResInfo[resource]) {
@@ -6588,6 +6787,9 @@ static void HitUnit_LastAttack(const CUnit *attacker, CUnit &target)
 	const unsigned long lastattack = target.Attacked;
 
 	target.Attacked = GameCycle ? GameCycle : 1;
+	//Wyrmgus start
+	UI.Minimap.UpdateUnitDot(target); // the dot of the unit blinks
+	//Wyrmgus end
 	if (target.Type->BoolFlag[WALL_INDEX].value || (lastattack && GameCycle <= lastattack + 2 * CYCLES_PER_SECOND)) {
 		return;
 	}
@@ -6758,6 +6960,10 @@ static void HitUnit_ApplyDamage(CUnit *attacker, CUnit &target, int damage)
 		target.Variable[HP_INDEX].Value -= damage - shieldDamage;
 	}
 	
+	//Wyrmgus start
+	Map.MarkUnitBucketsChanged(target); // wake up sleeping units nearby, e.g. workers which can repair the target
+	//Wyrmgus end
+	
 	//Wyrmgus start
 	//distribute experience between nearby units belonging to the same player
 
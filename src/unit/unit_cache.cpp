@@ -43,6 +43,131 @@
 #include "unit.h"
 #include "unittype.h"
 #include "map.h"
+//Wyrmgus start
+#include "ui.h"
+//Wyrmgus end
+
+//Wyrmgus start
+/**
+**  Insert a unit into the buckets of the unit bucket grid which it overlaps.
+**
+**  Range queries go through the buckets instead of through the cache of
+**  every tile, so that their cost depends on the number of units nearby
+**  rather than on the size of the area.
+*/
+static void InsertUnitInBuckets(CUnit &unit)
+{
+	const int z = unit.MapLayer;
+	if ((int) Map.UnitBuckets.size() <= z) {
+		Map.UnitBuckets.resize(z + 1);
+		Map.UnitBucketCycles.resize(z + 1);
+	}
+	if (Map.UnitBuckets[z].empty()) {
+		const int buckets_per_row = (Map.Info.MapWidths[z] + UNIT_BUCKET_SIZE - 1) / UNIT_BUCKET_SIZE;
+		const int buckets_per_column = (Map.Info.MapHeights[z] + UNIT_BUCKET_SIZE - 1) / UNIT_BUCKET_SIZE;
+		Map.UnitBuckets[z].resize(buckets_per_row * buckets_per_column);
+		Map.UnitBucketCycles[z].resize(buckets_per_row * buckets_per_column, 0);
+	}
+
+	const int buckets_per_row = (Map.Info.MapWidths[z] + UNIT_BUCKET_SIZE - 1) / UNIT_BUCKET_SIZE;
+	const Vec2i end_pos(std::min(unit.tilePos.x + unit.Type->TileWidth, (int) Map.Info.MapWidths[z]) - 1, std::min(unit.tilePos.y + unit.Type->TileHeight, (int) Map.Info.MapHeights[z]) - 1);
+	for (int y = unit.tilePos.y / UNIT_BUCKET_SIZE; y <= end_pos.y / UNIT_BUCKET_SIZE; ++y) {
+		for (int x = unit.tilePos.x / UNIT_BUCKET_SIZE; x <= end_pos.x / UNIT_BUCKET_SIZE; ++x) {
+			Map.UnitBucket(Vec2i(x * UNIT_BUCKET_SIZE, y * UNIT_BUCKET_SIZE), z).Insert(&unit);
+			Map.UnitBucketCycles[z][y * buckets_per_row + x] = GameCycle;
+		}
+	}
+}
+
+/**
+**  Remove a unit from the buckets of the unit bucket grid which it overlaps.
+*/
+static void RemoveUnitFromBuckets(CUnit &unit)
+{
+	const int z = unit.MapLayer;
+	if ((int) Map.UnitBuckets.size() <= z || Map.UnitBuckets[z].empty()) {
+		return;
+	}
+
+	const int buckets_per_row = (Map.Info.MapWidths[z] + UNIT_BUCKET_SIZE - 1) / UNIT_BUCKET_SIZE;
+	const Vec2i end_pos(std::min(unit.tilePos.x + unit.Type->TileWidth, (int) Map.Info.MapWidths[z]) - 1, std::min(unit.tilePos.y + unit.Type->TileHeight, (int) Map.Info.MapHeights[z]) - 1);
+	for (int y = unit.tilePos.y / UNIT_BUCKET_SIZE; y <= end_pos.y / UNIT_BUCKET_SIZE; ++y) {
+		for (int x = unit.tilePos.x / UNIT_BUCKET_SIZE; x <= end_pos.x / UNIT_BUCKET_SIZE; ++x) {
+			Map.UnitBucket(Vec2i(x * UNIT_BUCKET_SIZE, y * UNIT_BUCKET_SIZE), z).Remove(&unit);
+			Map.UnitBucketCycles[z][y * buckets_per_row + x] = GameCycle;
+		}
+	}
+}
+
+/**
+**  Mark the bucket of the unit bucket grid containing a tile as changed in the current game cycle.
+**
+**  Used for changes which do not move units between buckets, such as a tile
+**  being revealed or a unit being damaged, so that sleeping units watching
+**  the area wake up and react to them.
+**
+**  @param pos  Tile which changed.
+**  @param z    Map layer of the tile.
+*/
+void CMap::MarkUnitBucketChanged(const Vec2i &pos, int z)
+{
+	if ((int) this->UnitBucketCycles.size() <= z || this->UnitBucketCycles[z].empty()) {
+		return;
+	}
+
+	const int buckets_per_row = (this->Info.MapWidths[z] + UNIT_BUCKET_SIZE - 1) / UNIT_BUCKET_SIZE;
+	this->UnitBucketCycles[z][(pos.y / UNIT_BUCKET_SIZE) * buckets_per_row + pos.x / UNIT_BUCKET_SIZE] = GameCycle;
+}
+
+/**
+**  Mark the buckets of the unit bucket grid which a unit overlaps as changed in the current game cycle.
+**
+**  @param unit  Unit which changed without moving, e.g. by being damaged or changing owner.
+*/
+void CMap::MarkUnitBucketsChanged(const CUnit &unit)
+{
+	if (unit.Removed) {
+		return;
+	}
+
+	const int z = unit.MapLayer;
+	const Vec2i end_pos(std::min(unit.tilePos.x + unit.Type->TileWidth, (int) this->Info.MapWidths[z]) - 1, std::min(unit.tilePos.y + unit.Type->TileHeight, (int) this->Info.MapHeights[z]) - 1);
+	for (int y = unit.tilePos.y / UNIT_BUCKET_SIZE; y <= end_pos.y / UNIT_BUCKET_SIZE; ++y) {
+		for (int x = unit.tilePos.x / UNIT_BUCKET_SIZE; x <= end_pos.x / UNIT_BUCKET_SIZE; ++x) {
+			this->MarkUnitBucketChanged(Vec2i(x * UNIT_BUCKET_SIZE, y * UNIT_BUCKET_SIZE), z);
+		}
+	}
+}
+
+/**
+**  Get whether any unit entered or left the buckets overlapping an area since a given game cycle.
+**
+**  @param min_pos  Top left tile of the area.
+**  @param max_pos  Bottom right tile of the area.
+**  @param z        Map layer of the area.
+**  @param cycle    Game cycle since which to look for changes, inclusive.
+*/
+bool CMap::HasUnitBucketChangedSince(const Vec2i &min_pos, const Vec2i &max_pos, int z, unsigned long cycle) const
+{
+	if ((int) this->UnitBucketCycles.size() <= z || this->UnitBucketCycles[z].empty()) {
+		return false;
+	}
+
+	const int buckets_per_row = (this->Info.MapWidths[z] + UNIT_BUCKET_SIZE - 1) / UNIT_BUCKET_SIZE;
+	const int min_x = std::max<int>(min_pos.x, 0) / UNIT_BUCKET_SIZE;
+	const int min_y = std::max<int>(min_pos.y, 0) / UNIT_BUCKET_SIZE;
+	const int max_x = std::min<int>(max_pos.x, this->Info.MapWidths[z] - 1) / UNIT_BUCKET_SIZE;
+	const int max_y = std::min<int>(max_pos.y, this->Info.MapHeights[z] - 1) / UNIT_BUCKET_SIZE;
+	for (int y = min_y; y <= max_y; ++y) {
+		for (int x = min_x; x <= max_x; ++x) {
+			if (this->UnitBucketCycles[z][y * buckets_per_row + x] >= cycle) {
+				return true;
+			}
+		}
+	}
+	return false;
+}
+//Wyrmgus end
 
 /**
 **  Insert new unit into cache.
@@ -57,6 +182,11 @@ void CMap::Insert(CUnit &unit)
 	const int h = unit.Type->TileHeight;
 	int j, i = h;
 
+	//Wyrmgus start
+	InsertUnitInBuckets(unit);
+	UI.Minimap.UpdateUnitDot(unit);
+	//Wyrmgus end
+
 	do {
 		//Wyrmgus start
 //		CMapField *mf = Field(index);
@@ -91,6 +221,11 @@ void CMap::Remove(CUnit &unit)
 	const int h = unit.Type->TileHeight;
 	int j, i = h;
 
+	//Wyrmgus start
+	RemoveUnitFromBuckets(unit);
+	UI.Minimap.UpdateUnitDot(unit);
+	//Wyrmgus end
+
 	do {
 		//Wyrmgus start
 //		CMapField *mf = Field(index);
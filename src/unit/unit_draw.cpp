@@ -1120,6 +1120,10 @@ static void DrawConstruction(const int player, const CConstructionFrame *cframe,
 */
 void CUnit::Draw(const CViewport &vp) const
 {
+	//Wyrmgus start
+	CRenderStageTimer render_stage_timer(RenderStageUnits);
+	//Wyrmgus end
+
 	int frame;
 	int state;
 	int constructed;
@@ -1463,6 +1467,10 @@ static inline bool DrawLevelCompare(const CUnit *c1, const CUnit *c2)
 */
 int FindAndSortUnits(const CViewport &vp, std::vector<CUnit *> &table)
 {
+	//Wyrmgus start
+	CRenderStageTimer render_stage_timer(RenderStageUnits);
+	//Wyrmgus end
+
 	//  Select all units touching the viewpoint.
 	const Vec2i offset(1, 1);
 	const Vec2i vpSize(vp.MapWidth, vp.MapHeight);
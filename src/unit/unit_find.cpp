@@ -54,6 +54,10 @@
   -- Finding units
   ----------------------------------------------------------------------------*/
 
+//Wyrmgus start
+unsigned int UnitSelectGeneration = 0;
+//Wyrmgus end
+
 //Wyrmgus start
 //void Select(const Vec2i &ltPos, const Vec2i &rbPos, std::vector<CUnit *> &units)
 void Select(const Vec2i &ltPos, const Vec2i &rbPos, std::vector<CUnit *> &units, int z, bool circle)
@@ -860,18 +864,13 @@ void FindUnitsByType(const CUnitType &type, std::vector<CUnit *> &units, bool ev
 */
 void FindPlayerUnitsByType(const CPlayer &player, const CUnitType &type, std::vector<CUnit *> &table, bool ai_active)
 {
-	std::vector<CUnit *> type_units;
-
-	if (ai_active) {
-		if (player.AiActiveUnitsByType.find(&type) != player.AiActiveUnitsByType.end()) {
-			type_units = player.AiActiveUnitsByType.find(&type)->second;;
-		}
-	} else {
-		if (player.UnitsByType.find(&type) != player.UnitsByType.end()) {
-			type_units = player.UnitsByType.find(&type)->second;;
-		}
+	const std::vector<std::vector<CUnit *>> &units_by_type = ai_active ? player.AiActiveUnitsByType : player.UnitsByType;
+	if (type.Slot >= (int) units_by_type.size()) {
+		return;
 	}
 	
+	const std::vector<CUnit *> &type_units = units_by_type[type.Slot];
+	
 	for (size_t i = 0; i < type_units.size(); ++i) {
 		CUnit *unit = type_units[i];
 
@@ -35,6 +35,11 @@
 
 #include "stratagus.h"
 
+//Wyrmgus start
+#include <new>
+#include <set>
+//Wyrmgus end
+
 //Wyrmgus start
 #include "character.h"
 //Wyrmgus end
@@ -67,16 +72,75 @@ void CUnitManager::Init()
 	//Assert(units.empty());
 	units.clear();
 	// Release memory of units in release list.
+	//Wyrmgus start
+	/*
 	while (!releasedUnits.empty()) {
 		CUnit *unit = releasedUnits.front();
 		releasedUnits.pop_front();
 		delete unit;
 	}
+	*/
+	FreeArena();
+	//Wyrmgus end
 
 	// Initialize the free unit slots
 	unitSlots.clear();
 }
 
+//Wyrmgus start
+/**
+**  Construct the unit of a new slot in the unit arena
+**
+**  Units are placed in chunks in slot order, so that their memory is contiguous and a slot's unit never moves.
+**
+**  @return  New unit
+*/
+CUnit *CUnitManager::NewSlotUnit()
+{
+	const size_t slot = unitSlots.size();
+	const size_t chunk_index = slot / UNIT_ARENA_CHUNK_SIZE;
+	
+	if (chunk_index >= arenaChunks.size()) {
+		arenaChunks.push_back(static_cast<char *>(::operator new(sizeof(CUnit) * UNIT_ARENA_CHUNK_SIZE)));
+	}
+	
+	CUnit *unit = new (arenaChunks[chunk_index] + (slot % UNIT_ARENA_CHUNK_SIZE) * sizeof(CUnit)) CUnit;
+	unit->UnitManagerData.slot = slot;
+	unitSlots.push_back(unit);
+	return unit;
+}
+
+/**
+**  Destroy the released units and free the unit arena
+**
+**  A chunk holding a unit which is still referenced is kept, so that the unit stays valid.
+*/
+void CUnitManager::FreeArena()
+{
+	std::set<CUnit *> released_units(releasedUnits.begin(), releasedUnits.end());
+	releasedUnits.clear();
+	
+	for (size_t i = 0; i < arenaChunks.size(); ++i) {
+		bool chunk_in_use = false;
+		
+		for (size_t slot = i * UNIT_ARENA_CHUNK_SIZE; slot < std::min(unitSlots.size(), (i + 1) * UNIT_ARENA_CHUNK_SIZE); ++slot) {
+			CUnit *unit = unitSlots[slot];
+			if (released_units.find(unit) != released_units.end()) {
+				unit->~CUnit();
+			} else {
+				chunk_in_use = true;
+			}
+		}
+		
+		if (!chunk_in_use) {
+			::operator delete(arenaChunks[i]);
+		}
+	}
+	
+	arenaChunks.clear();
+}
+//Wyrmgus end
+
 /**
 **  Allocate a new unit
 **
@@ -94,11 +158,14 @@ CUnit *CUnitManager::AllocUnit()
 		unit->UnitManagerData.unitSlot = -1;
 		return unit;
 	} else {
-		CUnit *unit = new CUnit;
+		//Wyrmgus start
+//		CUnit *unit = new CUnit;
 
-		unit->UnitManagerData.slot = unitSlots.size();
-		unitSlots.push_back(unit);
-		return unit;
+//		unit->UnitManagerData.slot = unitSlots.size();
+//		unitSlots.push_back(unit);
+//		return unit;
+		return NewSlotUnit();
+		//Wyrmgus end
 	}
 }
 
@@ -211,9 +278,12 @@ void CUnitManager::Load(lua_State *l)
 		LuaError(l, "incorrect argument");
 	}
 	for (unsigned int i = 0; i < unitCount; i++) {
-		CUnit *unit = new CUnit;
-		unitSlots.push_back(unit);
-		unit->UnitManagerData.slot = i;
+		//Wyrmgus start
+//		CUnit *unit = new CUnit;
+//		unitSlots.push_back(unit);
+//		unit->UnitManagerData.slot = i;
+		NewSlotUnit();
+		//Wyrmgus end
 	}
 	const unsigned int args = lua_rawlen(l, 2);
 	for (unsigned int i = 0; i < args; i++) {
@@ -117,6 +117,26 @@ void PathFinderOutput::Save(CFile &file) const
 	file.printf("},\n  ");
 }
 
+//Wyrmgus start
+void PathFinderData::SaveRequest(CFile &file) const
+{
+	// requests are never pending between game cycles, so only the result of a completed one may need to be kept
+	if (this->RequestState != PathRequestCompleted && this->RequestRetries == 0) {
+		return;
+	}
+
+	file.printf("\"pathfinder-request\", {");
+	if (this->RequestState == PathRequestCompleted) {
+		file.printf("\"completed\", %d, ", this->RequestResult);
+	}
+	if (this->RequestAfterBlocked) {
+		file.printf("\"after-blocked\", ");
+	}
+	file.printf("\"retries\", %d", this->RequestRetries);
+	file.printf("},\n  ");
+}
+//Wyrmgus end
+
 
 /**
 **  Save the state of a unit to file.
@@ -323,6 +343,12 @@ void SaveUnit(const CUnit &unit, CFile &file)
 
 	unit.pathFinderData->input.Save(file);
 	unit.pathFinderData->output.Save(file);
+	//Wyrmgus start
+	unit.pathFinderData->SaveRequest(file);
+	if (unit.SleepCycle) {
+		file.printf("\"sleep-cycle\", %lu, ", unit.SleepCycle);
+	}
+	//Wyrmgus end
 
 	file.printf("\"wait\", %d, ", unit.Wait);
 	CAnimations::SaveUnitAnim(file, unit);
@@ -410,7 +436,10 @@ void SaveUnit(const CUnit &unit, CFile &file)
 			if (i) {
 				file.printf(" ,");
 			}
-			file.printf("%d", unit.SpellCoolDownTimers[i]);
+			//Wyrmgus start
+//			file.printf("%d", unit.SpellCoolDownTimers[i]);
+			file.printf("%d", unit.GetSpellCoolDownTimer(i));
+			//Wyrmgus end
 		}
 		file.printf("}");
 	}
@@ -565,7 +565,11 @@ CUnitType::CUnitType() :
 	Class(-1), Civilization(-1), Faction(-1), Species(NULL), TerrainType(NULL),
 	//Wyrmgus end
 	Animations(NULL), StillFrame(0),
-	DeathExplosion(NULL), OnHit(NULL), OnEachCycle(NULL), OnEachSecond(NULL), OnInit(NULL),
+	//Wyrmgus start
+//	DeathExplosion(NULL), OnHit(NULL), OnEachCycle(NULL), OnEachSecond(NULL), OnInit(NULL),
+	DeathExplosion(NULL), OnHit(NULL), OnEachCycle(NULL), OnEachSecond(NULL),
+	BatchOnEachCycle(false), BatchOnEachSecond(false), OnInit(NULL),
+	//Wyrmgus end
 	TeleportCost(0), TeleportEffectIn(NULL), TeleportEffectOut(NULL),
 	CorpseType(NULL), Construction(NULL), RepairHP(0), TileWidth(0), TileHeight(0),
 	BoxWidth(0), BoxHeight(0), BoxOffsetX(0), BoxOffsetY(0), NumDirections(0),
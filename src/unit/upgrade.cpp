@@ -1214,6 +1214,22 @@ static int CclGetUpgradeData(lua_State *l)
 
 	return 0;
 }
+
+/**
+**  Time finding the units affected by the modifiers of the players' acquired upgrades, and print the results.
+**
+**  @param l  Lua state.
+*/
+static int CclBenchmarkUpgradeModifierUnitSearch(lua_State *l)
+{
+	const int args = lua_gettop(l);
+	if (args > 1) {
+		LuaError(l, "incorrect argument");
+	}
+	const int repeat = args == 1 ? LuaToNumber(l, 1) : 1;
+	BenchmarkUpgradeModifierUnitSearch(repeat);
+	return 0;
+}
 //Wyrmgus end
 
 /**
@@ -1236,6 +1252,7 @@ void UpgradesCclRegister()
 	lua_register(Lua, "GetRunicSuffixes", CclGetRunicSuffixes);
 	lua_register(Lua, "GetLiteraryWorks", CclGetLiteraryWorks);
 	lua_register(Lua, "GetUpgradeData", CclGetUpgradeData);
+	lua_register(Lua, "BenchmarkUpgradeModifierUnitSearch", CclBenchmarkUpgradeModifierUnitSearch);
 	//Wyrmgus end
 }
 
@@ -1388,6 +1405,56 @@ static void ConvertUnitTypeTo(CPlayer &player, const CUnitType &src, CUnitType &
 	}
 }
 
+//Wyrmgus start
+/**
+**  Find the living units of a player for each unit type to which an upgrade modifier applies.
+**
+**  This is done in a single pass through the player's units, instead of searching all units for each unit type.
+**
+**  @param player  Player whose units are to be found.
+**  @param um      Upgrade modifier which determines the unit types.
+**  @param units   Set to the units found, indexed by unit type slot.
+*/
+static void FindPlayerUnitsForUpgradeModifier(const CPlayer &player, const CUpgradeModifier *um, std::vector<std::vector<CUnit *>> &units)
+{
+	units.clear();
+	units.resize(UnitTypes.size());
+	
+	for (std::vector<CUnit *>::const_iterator it = player.UnitBegin(); it != player.UnitEnd(); ++it) {
+		CUnit &unit = **it;
+		
+		if (unit.Type && um->ApplyTo[unit.Type->Slot] == 'X' && unit.IsAlive()) {
+			units[unit.Type->Slot].push_back(&unit);
+		}
+	}
+}
+
+/**
+**  Check whether any player has a usable unit of a given type.
+**
+**  @param type  Unit type to check.
+**
+**  @return      True if a usable unit of the type exists.
+*/
+static bool UsableUnitOfTypeExists(const CUnitType &type)
+{
+	for (int p = 0; p < PlayerMax; ++p) {
+		if (type.Slot >= (int) Players[p].UnitsByType.size()) {
+			continue;
+		}
+		
+		const std::vector<CUnit *> &type_units = Players[p].UnitsByType[type.Slot];
+		for (size_t i = 0; i < type_units.size(); ++i) {
+			if (!type_units[i]->IsUnusable()) {
+				return true;
+			}
+		}
+	}
+	
+	return false;
+}
+//Wyrmgus end
+
 /**
 **  Apply the modifiers of an upgrade.
 **
@@ -1427,16 +1494,29 @@ static void ApplyUpgradeModifier(CPlayer &player, const CUpgradeModifier *um)
 		// FIXME: check if modify is allowed
 
 		if (player.Allow.Upgrades[z] != 'R') {
+			//Wyrmgus start
+			//go through AllowUpgradeId, so that the player's cached dependency results are invalidated after the change
+//			if (um->ChangeUpgrades[z] == 'A') {
+//				player.Allow.Upgrades[z] = 'A';
+//			}
+//			if (um->ChangeUpgrades[z] == 'F') {
+//				player.Allow.Upgrades[z] = 'F';
+//			}
+//			// we can even have upgrade acquired w/o costs
+//			if (um->ChangeUpgrades[z] == 'R') {
+//				player.Allow.Upgrades[z] = 'R';
+//			}
 			if (um->ChangeUpgrades[z] == 'A') {
-				player.Allow.Upgrades[z] = 'A';
+				AllowUpgradeId(player, z, 'A');
 			}
 			if (um->ChangeUpgrades[z] == 'F') {
-				player.Allow.Upgrades[z] = 'F';
+				AllowUpgradeId(player, z, 'F');
 			}
 			// we can even have upgrade acquired w/o costs
 			if (um->ChangeUpgrades[z] == 'R') {
-				player.Allow.Upgrades[z] = 'R';
+				AllowUpgradeId(player, z, 'R');
 			}
+			//Wyrmgus end
 		}
 	}
 	
@@ -1448,6 +1528,12 @@ static void ApplyUpgradeModifier(CPlayer &player, const CUpgradeModifier *um)
 	}
 	//Wyrmgus end
 
+	//Wyrmgus start
+	//find the player's units of all the unit types affected by the modifier at once
+	std::vector<std::vector<CUnit *>> units_by_type;
+	FindPlayerUnitsForUpgradeModifier(player, um, units_by_type);
+	//Wyrmgus end
+
 	for (size_t z = 0; z < UnitTypes.size(); ++z) {
 		CUnitStats &stat = UnitTypes[z]->Stats[pn];
 		// add/remove allowed units
@@ -1460,7 +1546,12 @@ static void ApplyUpgradeModifier(CPlayer &player, const CUpgradeModifier *um)
 
 		// FIXME: check if modify is allowed
 
-		player.Allow.Units[z] += um->ChangeUnits[z];
+		//Wyrmgus start
+//		player.Allow.Units[z] += um->ChangeUnits[z];
+		if (um->ChangeUnits[z] != 0) {
+			AllowUnitId(player, z, player.Allow.Units[z] + um->ChangeUnits[z]);
+		}
+		//Wyrmgus end
 
 		Assert(um->ApplyTo[z] == '?' || um->ApplyTo[z] == 'X');
 
@@ -1469,12 +1560,20 @@ static void ApplyUpgradeModifier(CPlayer &player, const CUpgradeModifier *um)
 
 			// if a unit type's supply is changed, we need to update the player's supply accordingly
 			if (um->Modifier.Variables[SUPPLY_INDEX].Value) {
+				//Wyrmgus start
+				/*
 				std::vector<CUnit *> unitupgrade;
 
 				FindUnitsByType(*UnitTypes[z], unitupgrade);
 				for (size_t j = 0; j != unitupgrade.size(); ++j) {
 					CUnit &unit = *unitupgrade[j];
 					if (unit.Player->Index == pn && unit.IsAlive()) {
+				*/
+				const std::vector<CUnit *> &unitupgrade = units_by_type[z];
+				for (size_t j = 0; j != unitupgrade.size(); ++j) {
+					CUnit &unit = *unitupgrade[j];
+					if (!unit.IsUnusable()) {
+				//Wyrmgus end
 						unit.Player->Supply += um->Modifier.Variables[SUPPLY_INDEX].Value;
 					}
 				}
@@ -1482,12 +1581,20 @@ static void ApplyUpgradeModifier(CPlayer &player, const CUpgradeModifier *um)
 			
 			// if a unit type's demand is changed, we need to update the player's demand accordingly
 			if (um->Modifier.Variables[DEMAND_INDEX].Value) {
+				//Wyrmgus start
+				/*
 				std::vector<CUnit *> unitupgrade;
 
 				FindUnitsByType(*UnitTypes[z], unitupgrade);
 				for (size_t j = 0; j != unitupgrade.size(); ++j) {
 					CUnit &unit = *unitupgrade[j];
 					if (unit.Player->Index == pn && unit.IsAlive()) {
+				*/
+				const std::vector<CUnit *> &unitupgrade = units_by_type[z];
+				for (size_t j = 0; j != unitupgrade.size(); ++j) {
+					CUnit &unit = *unitupgrade[j];
+					if (!unit.IsUnusable()) {
+				//Wyrmgus end
 						unit.Player->Demand += um->Modifier.Variables[DEMAND_INDEX].Value;
 					}
 				}
@@ -1504,9 +1611,12 @@ static void ApplyUpgradeModifier(CPlayer &player, const CUpgradeModifier *um)
 						stat.ImproveIncomes[j] += um->Modifier.ImproveIncomes[j];
 					}
 					//update player's income
-					std::vector<CUnit *> unitupgrade;
-					FindUnitsByType(*UnitTypes[z], unitupgrade);
-					if (unitupgrade.size() > 0) {
+					//Wyrmgus start
+//					std::vector<CUnit *> unitupgrade;
+//					FindUnitsByType(*UnitTypes[z], unitupgrade);
+//					if (unitupgrade.size() > 0) {
+					if (UsableUnitOfTypeExists(*UnitTypes[z])) {
+					//Wyrmgus end
 						player.Incomes[j] = std::max(player.Incomes[j], stat.ImproveIncomes[j]);
 					}
 				}
@@ -1554,19 +1664,14 @@ static void ApplyUpgradeModifier(CPlayer &player, const CUpgradeModifier *um)
 			}
 			
 			if (um->Modifier.Variables[TRADECOST_INDEX].Value) {
-				std::vector<CUnit *> unitupgrade;
-
-				FindUnitsByType(*UnitTypes[z], unitupgrade);
-				if (unitupgrade.size() > 0) {
+				if (UsableUnitOfTypeExists(*UnitTypes[z])) {
 					player.TradeCost = std::min(player.TradeCost, stat.Variables[TRADECOST_INDEX].Value);
 				}
 			}
 
 			// And now modify ingame units
 			//Wyrmgus start
-			std::vector<CUnit *> unitupgrade;
-
-			FindUnitsByType(*UnitTypes[z], unitupgrade, true);
+			const std::vector<CUnit *> &unitupgrade = units_by_type[z];
 			//Wyrmgus end
 			
 			if (varModified) {
@@ -1698,6 +1803,9 @@ static void ApplyUpgradeModifier(CPlayer &player, const CUpgradeModifier *um)
 			
 			if (um->ConvertTo) {
 				ConvertUnitTypeTo(player, *UnitTypes[z], *um->ConvertTo);
+				//Wyrmgus start
+				FindPlayerUnitsForUpgradeModifier(player, um, units_by_type); //units may have been converted to a type which is yet to be handled
+				//Wyrmgus end
 			}
 		}
 	}
@@ -1728,19 +1836,38 @@ static void RemoveUpgradeModifier(CPlayer &player, const CUpgradeModifier *um)
 		// FIXME: check if modify is allowed
 
 		if (player.Allow.Upgrades[z] != 'R') {
+			//Wyrmgus start
+			//go through AllowUpgradeId, so that the player's cached dependency results are invalidated after the change
+//			if (um->ChangeUpgrades[z] == 'A') {
+//				player.Allow.Upgrades[z] = 'F';
+//			}
+//			if (um->ChangeUpgrades[z] == 'F') {
+//				player.Allow.Upgrades[z] = 'A';
+//			}
+//			// we can even have upgrade acquired w/o costs
+//			if (um->ChangeUpgrades[z] == 'R') {
+//				player.Allow.Upgrades[z] = 'A';
+//			}
 			if (um->ChangeUpgrades[z] == 'A') {
-				player.Allow.Upgrades[z] = 'F';
+				AllowUpgradeId(player, z, 'F');
 			}
 			if (um->ChangeUpgrades[z] == 'F') {
-				player.Allow.Upgrades[z] = 'A';
+				AllowUpgradeId(player, z, 'A');
 			}
 			// we can even have upgrade acquired w/o costs
 			if (um->ChangeUpgrades[z] == 'R') {
-				player.Allow.Upgrades[z] = 'A';
+				AllowUpgradeId(player, z, 'A');
 			}
+			//Wyrmgus end
 		}
 	}
 
+	//Wyrmgus start
+	//find the player's units of all the unit types affected by the modifier at once
+	std::vector<std::vector<CUnit *>> units_by_type;
+	FindPlayerUnitsForUpgradeModifier(player, um, units_by_type);
+	//Wyrmgus end
+
 	for (size_t z = 0; z < UnitTypes.size(); ++z) {
 		CUnitStats &stat = UnitTypes[z]->Stats[pn];
 		// add/remove allowed units
@@ -1753,7 +1880,12 @@ static void RemoveUpgradeModifier(CPlayer &player, const CUpgradeModifier *um)
 		
 		// FIXME: check if modify is allowed
 
-		player.Allow.Units[z] -= um->ChangeUnits[z];
+		//Wyrmgus start
+//		player.Allow.Units[z] -= um->ChangeUnits[z];
+		if (um->ChangeUnits[z] != 0) {
+			AllowUnitId(player, z, player.Allow.Units[z] - um->ChangeUnits[z]);
+		}
+		//Wyrmgus end
 
 		Assert(um->ApplyTo[z] == '?' || um->ApplyTo[z] == 'X');
 
@@ -1761,12 +1893,20 @@ static void RemoveUpgradeModifier(CPlayer &player, const CUpgradeModifier *um)
 		if (um->ApplyTo[z] == 'X') {
 			// if a unit type's supply is changed, we need to update the player's supply accordingly
 			if (um->Modifier.Variables[SUPPLY_INDEX].Value) {
+				//Wyrmgus start
+				/*
 				std::vector<CUnit *> unitupgrade;
 
 				FindUnitsByType(*UnitTypes[z], unitupgrade);
 				for (size_t j = 0; j != unitupgrade.size(); ++j) {
 					CUnit &unit = *unitupgrade[j];
 					if (unit.Player->Index == pn && unit.IsAlive()) {
+				*/
+				const std::vector<CUnit *> &unitupgrade = units_by_type[z];
+				for (size_t j = 0; j != unitupgrade.size(); ++j) {
+					CUnit &unit = *unitupgrade[j];
+					if (!unit.IsUnusable()) {
+				//Wyrmgus end
 						unit.Player->Supply -= um->Modifier.Variables[SUPPLY_INDEX].Value;
 					}
 				}
@@ -1774,12 +1914,20 @@ static void RemoveUpgradeModifier(CPlayer &player, const CUpgradeModifier *um)
 			
 			// if a unit type's demand is changed, we need to update the player's demand accordingly
 			if (um->Modifier.Variables[DEMAND_INDEX].Value) {
+				//Wyrmgus start
+				/*
 				std::vector<CUnit *> unitupgrade;
 
 				FindUnitsByType(*UnitTypes[z], unitupgrade);
 				for (size_t j = 0; j != unitupgrade.size(); ++j) {
 					CUnit &unit = *unitupgrade[j];
 					if (unit.Player->Index == pn && unit.IsAlive()) {
+				*/
+				const std::vector<CUnit *> &unitupgrade = units_by_type[z];
+				for (size_t j = 0; j != unitupgrade.size(); ++j) {
+					CUnit &unit = *unitupgrade[j];
+					if (!unit.IsUnusable()) {
+				//Wyrmgus end
 						unit.Player->Demand -= um->Modifier.Variables[DEMAND_INDEX].Value;
 					}
 				}
@@ -1859,9 +2007,7 @@ static void RemoveUpgradeModifier(CPlayer &player, const CUpgradeModifier *um)
 			}
 
 			//Wyrmgus start
-			std::vector<CUnit *> unitupgrade;
-
-			FindUnitsByType(*UnitTypes[z], unitupgrade, true);
+			const std::vector<CUnit *> &unitupgrade = units_by_type[z];
 			//Wyrmgus end
 			
 			// And now modify ingame units
@@ -1993,6 +2139,9 @@ static void RemoveUpgradeModifier(CPlayer &player, const CUpgradeModifier *um)
 			
 			if (um->ConvertTo) {
 				ConvertUnitTypeTo(player, *um->ConvertTo, *UnitTypes[z]);
+				//Wyrmgus start
+				FindPlayerUnitsForUpgradeModifier(player, um, units_by_type); //units may have been converted to a type which is yet to be handled
+				//Wyrmgus end
 			}
 		}
 	}
@@ -2346,6 +2495,71 @@ void ApplyUpgrades()
 }
 
 //Wyrmgus start
+/**
+**  Time finding the units affected by the modifiers of the players' acquired upgrades, and print the results.
+**
+**  The search is timed both by searching all units for each affected unit type, and by a single pass through each player's units. No modifier is applied.
+**
+**  @param repeat  How many times to repeat the searches.
+*/
+void BenchmarkUpgradeModifierUnitSearch(int repeat)
+{
+	unsigned long modifiers = 0;
+	unsigned long per_type_units = 0;
+	unsigned long per_player_units = 0;
+	
+	const unsigned long per_type_start_ticks = GetTicks();
+	for (int i = 0; i < repeat; ++i) {
+		for (int p = 0; p < PlayerMax; ++p) {
+			for (size_t j = 0; j < AllUpgrades.size(); ++j) {
+				if (Players[p].Allow.Upgrades[j] != 'R') {
+					continue;
+				}
+				for (size_t z = 0; z < AllUpgrades[j]->UpgradeModifiers.size(); ++z) {
+					const CUpgradeModifier *um = AllUpgrades[j]->UpgradeModifiers[z];
+					for (size_t k = 0; k < UnitTypes.size(); ++k) {
+						if (um->ApplyTo[k] != 'X') {
+							continue;
+						}
+						std::vector<CUnit *> unitupgrade;
+						FindUnitsByType(*UnitTypes[k], unitupgrade, true);
+						for (size_t u = 0; u < unitupgrade.size(); ++u) {
+							if (unitupgrade[u]->Player->Index == p) {
+								++per_type_units;
+							}
+						}
+					}
+					++modifiers;
+				}
+			}
+		}
+	}
+	const unsigned long per_type_ticks = GetTicks() - per_type_start_ticks;
+	
+	const unsigned long per_player_start_ticks = GetTicks();
+	std::vector<std::vector<CUnit *>> units_by_type;
+	for (int i = 0; i < repeat; ++i) {
+		for (int p = 0; p < PlayerMax; ++p) {
+			for (size_t j = 0; j < AllUpgrades.size(); ++j) {
+				if (Players[p].Allow.Upgrades[j] != 'R') {
+					continue;
+				}
+				for (size_t z = 0; z < AllUpgrades[j]->UpgradeModifiers.size(); ++z) {
+					FindPlayerUnitsForUpgradeModifier(Players[p], AllUpgrades[j]->UpgradeModifiers[z], units_by_type);
+					for (size_t k = 0; k < units_by_type.size(); ++k) {
+						per_player_units += units_by_type[k].size();
+					}
+				}
+			}
+		}
+	}
+	const unsigned long per_player_ticks = GetTicks() - per_player_start_ticks;
+	
+	fprintf(stdout, "Upgrade modifier unit search benchmark: %lu modifiers\n", modifiers);
+	fprintf(stdout, "  Searching all units for each unit type: %lu units found in %lu ms\n", per_type_units, per_type_ticks);
+	fprintf(stdout, "  Single pass through each player's units: %lu units found in %lu ms\n", per_player_units, per_player_ticks);
+}
+
 /**
 **  Handle that an ability was acquired.
 **
@@ -2560,6 +2774,9 @@ void AllowUnitId(CPlayer &player, int id, int units)
 //Wyrmgus end
 {
 	player.Allow.Units[id] = units;
+	//Wyrmgus start
+	InvalidatePlayerDependencies(player);
+	//Wyrmgus end
 }
 
 /**
@@ -2573,6 +2790,9 @@ void AllowUpgradeId(CPlayer &player, int id, char af)
 {
 	Assert(af == 'A' || af == 'F' || af == 'R');
 	player.Allow.Upgrades[id] = af;
+	//Wyrmgus start
+	InvalidatePlayerDependencies(player);
+	//Wyrmgus end
 }
 
 /**
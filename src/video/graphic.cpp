@@ -39,6 +39,7 @@
 #include <string>
 #include <map>
 #include <list>
+#include <unordered_map>
 
 //Wyrmgus start
 #include "grand_strategy.h"
@@ -65,10 +66,166 @@ static int HashCount;
 static std::map<std::string, CGraphic *> GraphicHash;
 static std::list<CGraphic *> Graphics;
 
+//Wyrmgus start
+/**
+**  A player color or time of day variant of a graphic, held in the sprite variant cache
+*/
+class CSpriteVariant
+{
+public:
+	CSpriteVariant() : Surface(NULL),
+#if defined(USE_OPENGL) || defined(USE_GLES)
+		Textures(NULL), NumTextures(0),
+#endif
+		Bytes(0), LastUsedFrame(0)
+	{
+	}
+	
+	SDL_Surface **Surface;			/// the slot of the graphic holding the variant's surface
+#if defined(USE_OPENGL) || defined(USE_GLES)
+	GLuint **Textures;				/// the slot of the graphic holding the variant's textures
+	int NumTextures;				/// the number of textures of the variant
+#endif
+	size_t Bytes;					/// the memory held by the variant
+	unsigned long LastUsedFrame;	/// the display update in which the variant was last used
+};
+
+static std::list<CSpriteVariant> SpriteVariants;										/// the cached sprite variants, the most recently used first
+static std::unordered_map<void *, std::list<CSpriteVariant>::iterator> SpriteVariantsBySlot;	/// the cached sprite variants, keyed by the slot holding them
+static size_t SpriteVariantCacheBudget = 128 * 1024 * 1024;							/// the memory the cached sprite variants may hold
+static size_t SpriteVariantCacheBytes = 0;											/// the memory the cached sprite variants hold
+static unsigned long SpriteVariantCacheHits = 0;
+static unsigned long SpriteVariantCacheMisses = 0;
+static unsigned long SpriteVariantCacheEvictions = 0;
+
+static void RemoveGraphicSpriteVariants(CGraphic &graphic);
+//Wyrmgus end
+
 /*----------------------------------------------------------------------------
 --  Functions
 ----------------------------------------------------------------------------*/
 
+//Wyrmgus start
+/**
+**  Get the slot holding a graphic's surface for a time of day
+**
+**  @return  NULL if the graphic's base surface is used for the time of day.
+*/
+static SDL_Surface **GetTimeOfDaySurfaceSlot(CGraphic &graphic, int time_of_day, bool flipped)
+{
+	switch (time_of_day) {
+		case DawnTimeOfDay:
+			return flipped ? &graphic.DawnSurfaceFlip : &graphic.DawnSurface;
+		case DuskTimeOfDay:
+			return flipped ? &graphic.DuskSurfaceFlip : &graphic.DuskSurface;
+		case FirstWatchTimeOfDay:
+		case MidnightTimeOfDay:
+		case SecondWatchTimeOfDay:
+			return flipped ? &graphic.NightSurfaceFlip : &graphic.NightSurface;
+		default:
+			return NULL;
+	}
+}
+
+/**
+**  Get the slot holding a player color graphic's surface for a player color and time of day
+*/
+static SDL_Surface **GetPlayerColorSurfaceSlot(CPlayerColorGraphic &graphic, int player_color, bool flipped, int time_of_day)
+{
+	switch (time_of_day) {
+		case DawnTimeOfDay:
+			return flipped ? &graphic.PlayerColorSurfacesDawnFlip[player_color] : &graphic.PlayerColorSurfacesDawn[player_color];
+		case DuskTimeOfDay:
+			return flipped ? &graphic.PlayerColorSurfacesDuskFlip[player_color] : &graphic.PlayerColorSurfacesDusk[player_color];
+		case FirstWatchTimeOfDay:
+		case MidnightTimeOfDay:
+		case SecondWatchTimeOfDay:
+			return flipped ? &graphic.PlayerColorSurfacesNightFlip[player_color] : &graphic.PlayerColorSurfacesNight[player_color];
+		default:
+			return flipped ? &graphic.PlayerColorSurfacesFlip[player_color] : &graphic.PlayerColorSurfaces[player_color];
+	}
+}
+
+/**
+**  Get the color modifier applied to graphics for a time of day
+*/
+static void GetTimeOfDayColorModifier(int time_of_day, int &red, int &green, int &blue)
+{
+	switch (time_of_day) {
+		case DawnTimeOfDay:
+			red = -20;
+			green = -20;
+			blue = 0;
+			break;
+		case DuskTimeOfDay:
+			red = 0;
+			green = -20;
+			blue = -20;
+			break;
+		case FirstWatchTimeOfDay:
+		case MidnightTimeOfDay:
+		case SecondWatchTimeOfDay:
+			red = -45;
+			green = -35;
+			blue = -10;
+			break;
+		default:
+			red = 0;
+			green = 0;
+			blue = 0;
+			break;
+	}
+}
+
+/**
+**  Fill a lookup table with the clamped values of a color channel after adding a modifier to it
+*/
+static void MakeColorModifierTable(int modifier, Uint8 table[256])
+{
+	for (int i = 0; i < 256; ++i) {
+		table[i] = std::max<int>(0, std::min<int>(255, i + modifier));
+	}
+}
+
+/**
+**  Add a color modifier to the pixels of a surface, through a lookup table per color channel
+*/
+static void ApplyColorModifierLUT(SDL_Surface *surface, int red, int green, int blue)
+{
+	Uint8 red_table[256];
+	Uint8 green_table[256];
+	Uint8 blue_table[256];
+	MakeColorModifierTable(red, red_table);
+	MakeColorModifierTable(green, green_table);
+	MakeColorModifierTable(blue, blue_table);
+
+	SDL_LockSurface(surface);
+	if (surface->format->BytesPerPixel == 1) {
+		SDL_Color colors[256];
+		const SDL_Palette &pal = *surface->format->palette;
+		for (int i = 0; i < 256; ++i) {
+			colors[i].r = red_table[pal.colors[i].r];
+			colors[i].g = green_table[pal.colors[i].g];
+			colors[i].b = blue_table[pal.colors[i].b];
+		}
+		SDL_SetColors(surface, &colors[0], 0, 256);
+	} else if (surface->format->BytesPerPixel == 4) {
+		const SDL_PixelFormat &f = *surface->format;
+		for (int y = 0; y < surface->h; ++y) {
+			Uint32 *pixels = (Uint32 *)((Uint8 *)surface->pixels + y * surface->pitch);
+			for (int x = 0; x < surface->w; ++x) {
+				const Uint32 c = pixels[x];
+				pixels[x] = (red_table[(c & f.Rmask) >> f.Rshift] << f.Rshift)
+					| (green_table[(c & f.Gmask) >> f.Gshift] << f.Gshift)
+					| (blue_table[(c & f.Bmask) >> f.Bshift] << f.Bshift)
+					| (c & f.Amask);
+			}
+		}
+	}
+	SDL_UnlockSurface(surface);
+}
+//Wyrmgus end
+
 /**
 **  Video draw the graphic clipped.
 **
@@ -181,10 +338,13 @@ void CPlayerColorGraphic::DrawPlayerColorSub(int player, int gx, int gy, int w,
 {
 #if defined(USE_OPENGL) || defined(USE_GLES)
 	if (UseOpenGL) {
-		if (!PlayerColorTextures[player]) {
-			MakePlayerColorTexture(this, player, NoTimeOfDay);
-		}
-		DrawTexture(this, PlayerColorTextures[player], gx, gy, gx + w, gy + h, x, y, 0);
+		//Wyrmgus start
+//		if (!PlayerColorTextures[player]) {
+//			MakePlayerColorTexture(this, player, NoTimeOfDay);
+//		}
+//		DrawTexture(this, PlayerColorTextures[player], gx, gy, gx + w, gy + h, x, y, 0);
+		DrawTexture(this, GetPlayerColorTextures(player, NoTimeOfDay), gx, gy, gx + w, gy + h, x, y, 0);
+		//Wyrmgus end
 	} else
 #endif
 	{
@@ -195,10 +355,7 @@ void CPlayerColorGraphic::DrawPlayerColorSub(int player, int gx, int gy, int w,
 		SDL_Rect drect = {Sint16(x), Sint16(y), 0, 0};
 		//Wyrmgus start
 //		SDL_BlitSurface(Surface, &srect, TheScreen, &drect);
-		if (!PlayerColorSurfaces[player]) {
-			MakePlayerColorSurface(player, true, NoTimeOfDay);
-		}
-		SDL_BlitSurface(PlayerColorSurfaces[player], &srect, TheScreen, &drect);
+		SDL_BlitSurface(GetPlayerColorSurface(player, false, NoTimeOfDay), &srect, TheScreen, &drect);
 		//Wyrmgus end
 	}
 }
@@ -375,24 +532,7 @@ void CGraphic::DrawFrameClip(unsigned frame, int x, int y, bool ignore_time_of_d
 	if (UseOpenGL) {
 		//Wyrmgus start
 //		DoDrawFrameClip(Textures, frame, x, y);
-		if (ignore_time_of_day || !Map.TimeOfDay[CurrentMapLayer] || Map.TimeOfDay[CurrentMapLayer] == MorningTimeOfDay || Map.TimeOfDay[CurrentMapLayer] == MiddayTimeOfDay || Map.TimeOfDay[CurrentMapLayer] == AfternoonTimeOfDay) {
-			DoDrawFrameClip(Textures, frame, x, y, show_percent);
-		} else if (Map.TimeOfDay[CurrentMapLayer] == DawnTimeOfDay) {
-			if (!TexturesDawn) {
-				MakeTexture(this, Map.TimeOfDay[CurrentMapLayer]);
-			}
-			DoDrawFrameClip(TexturesDawn, frame, x, y, show_percent);
-		} else if (Map.TimeOfDay[CurrentMapLayer] == DuskTimeOfDay) {
-			if (!TexturesDusk) {
-				MakeTexture(this, Map.TimeOfDay[CurrentMapLayer]);
-			}
-			DoDrawFrameClip(TexturesDusk, frame, x, y, show_percent);
-		} else if (Map.TimeOfDay[CurrentMapLayer] == FirstWatchTimeOfDay || Map.TimeOfDay[CurrentMapLayer] == MidnightTimeOfDay || Map.TimeOfDay[CurrentMapLayer] == SecondWatchTimeOfDay) {
-			if (!TexturesNight) {
-				MakeTexture(this, Map.TimeOfDay[CurrentMapLayer]);
-			}
-			DoDrawFrameClip(TexturesNight, frame, x, y, show_percent);
-		}
+		DoDrawFrameClip(GetTextures(ignore_time_of_day ? NoTimeOfDay : Map.TimeOfDay[CurrentMapLayer]), frame, x, y, show_percent);
 		//Wyrmgus end
 	} else
 #endif
@@ -464,64 +604,14 @@ void CPlayerColorGraphic::MakePlayerColorSurface(int player_color, bool flipped,
 		return;
 	}
 #endif
-	SDL_Surface *surface = NULL;
-	if (time_of_day == 1) {
-		if (flipped) {
-			surface = PlayerColorSurfacesDawnFlip[player_color];
-		} else {
-			surface = PlayerColorSurfacesDawn[player_color];
-		}
-	} else if (time_of_day == 5) {
-		if (flipped) {
-			surface = PlayerColorSurfacesDuskFlip[player_color];
-		} else {
-			surface = PlayerColorSurfacesDusk[player_color];
-		}
-	} else if (time_of_day == 6 || time_of_day == 7 || time_of_day == 8) {
-		if (flipped) {
-			surface = PlayerColorSurfacesNightFlip[player_color];
-		} else {
-			surface = PlayerColorSurfacesNight[player_color];
-		}
-	} else {
-		if (flipped) {
-			surface = PlayerColorSurfacesFlip[player_color];
-		} else {
-			surface = PlayerColorSurfaces[player_color];
-		}
-	}
-
-	if (surface) {
+	SDL_Surface **surface_slot = GetPlayerColorSurfaceSlot(*this, player_color, flipped, time_of_day);
+	if (*surface_slot) {
 		return;
 	}
 	
 	SDL_Surface *base_surface = flipped ? SurfaceFlip : Surface;
 	
-	if (time_of_day == 1) {
-		if (flipped) {
-			surface = PlayerColorSurfacesDawnFlip[player_color] = SDL_ConvertSurface(base_surface, base_surface->format, SDL_SWSURFACE);
-		} else {
-			surface = PlayerColorSurfacesDawn[player_color] = SDL_ConvertSurface(base_surface, base_surface->format, SDL_SWSURFACE);
-		}
-	} else if (time_of_day == 5) {
-		if (flipped) {
-			surface = PlayerColorSurfacesDuskFlip[player_color] = SDL_ConvertSurface(base_surface, base_surface->format, SDL_SWSURFACE);
-		} else {
-			surface = PlayerColorSurfacesDusk[player_color] = SDL_ConvertSurface(base_surface, base_surface->format, SDL_SWSURFACE);
-		}
-	} else if (time_of_day == 6 || time_of_day == 7 || time_of_day == 8) {
-		if (flipped) {
-			surface = PlayerColorSurfacesNightFlip[player_color] = SDL_ConvertSurface(base_surface, base_surface->format, SDL_SWSURFACE);
-		} else {
-			surface = PlayerColorSurfacesNight[player_color] = SDL_ConvertSurface(base_surface, base_surface->format, SDL_SWSURFACE);
-		}
-	} else {
-		if (flipped) {
-			surface = PlayerColorSurfacesFlip[player_color] = SDL_ConvertSurface(base_surface, base_surface->format, SDL_SWSURFACE);
-		} else {
-			surface = PlayerColorSurfaces[player_color] = SDL_ConvertSurface(base_surface, base_surface->format, SDL_SWSURFACE);
-		}
-	}
+	SDL_Surface *surface = *surface_slot = SDL_ConvertSurface(base_surface, base_surface->format, SDL_SWSURFACE);
 
 	if (base_surface->flags & SDL_SRCCOLORKEY) {
 		SDL_SetColorKey(surface, SDL_SRCCOLORKEY | SDL_RLEACCEL, base_surface->format->colorkey);
@@ -537,45 +627,20 @@ void CPlayerColorGraphic::MakePlayerColorSurface(int player_color, bool flipped,
 	int time_of_day_blue = 0;
 	
 	if (!this->Grayscale) { // don't alter the colors of grayscale graphics
-		if (time_of_day == 1) { // dawn
-			time_of_day_red = -20;
-			time_of_day_green = -20;
-			time_of_day_blue = 0;
-		} else if (time_of_day == 2) { // morning
-			time_of_day_red = 0;
-			time_of_day_green = 0;
-			time_of_day_blue = 0;
-		} else if (time_of_day == 3) { // midday
-			time_of_day_red = 0;
-			time_of_day_green = 0;
-			time_of_day_blue = 0;
-		} else if (time_of_day == 4) { // afternoon
-			time_of_day_red = 0;
-			time_of_day_green = 0;
-			time_of_day_blue = 0;
-		} else if (time_of_day == 5) { // dusk
-			time_of_day_red = 0;
-			time_of_day_green = -20;
-			time_of_day_blue = -20;
-		} else if (time_of_day == 6) { // first watch
-			time_of_day_red = -45;
-			time_of_day_green = -35;
-			time_of_day_blue = -10;
-		} else if (time_of_day == 7) { // midnight
-			time_of_day_red = -45;
-			time_of_day_green = -35;
-			time_of_day_blue = -10;
-		} else if (time_of_day == 8) { // second watch
-			time_of_day_red = -45;
-			time_of_day_green = -35;
-			time_of_day_blue = -10;
-		}
+		GetTimeOfDayColorModifier(time_of_day, time_of_day_red, time_of_day_green, time_of_day_blue);
 	}
 	
 	SDL_LockSurface(surface);
 	
 	switch (surface->format->BytesPerPixel) {
 		case 1: {
+			Uint8 red_table[256];
+			Uint8 green_table[256];
+			Uint8 blue_table[256];
+			MakeColorModifierTable(time_of_day_red, red_table);
+			MakeColorModifierTable(time_of_day_green, green_table);
+			MakeColorModifierTable(time_of_day_blue, blue_table);
+			
 			SDL_Color colors[256];
 			SDL_Palette &pal = *surface->format->palette;
 			for (int i = 0; i < 256; ++i) {
@@ -608,14 +673,17 @@ void CPlayerColorGraphic::MakePlayerColorSurface(int player_color, bool flipped,
 					}
 				}
 				
-				colors[i].r = std::max<int>(0,std::min<int>(255,int(red) + time_of_day_red));
-				colors[i].g = std::max<int>(0,std::min<int>(255,int(green) + time_of_day_green));
-				colors[i].b = std::max<int>(0,std::min<int>(255,int(blue) + time_of_day_blue));;
+				colors[i].r = red_table[red];
+				colors[i].g = green_table[green];
+				colors[i].b = blue_table[blue];
 			}
 			SDL_SetColors(surface, &colors[0], 0, 256);
 			break;
 		}
 		case 4: {
+			if (time_of_day_red != 0 || time_of_day_green != 0 || time_of_day_blue != 0) {
+				ApplyColorModifierLUT(surface, time_of_day_red, time_of_day_green, time_of_day_blue);
+			}
 			break;
 		}
 	}
@@ -656,27 +724,7 @@ void CPlayerColorGraphic::DrawPlayerColorFrameClip(int player, unsigned frame,
 		}
 		DoDrawFrameClip(PlayerColorTextures[player], frame, x, y);
 		*/
-		if (ignore_time_of_day || !Map.TimeOfDay[CurrentMapLayer] || Map.TimeOfDay[CurrentMapLayer] == MorningTimeOfDay || Map.TimeOfDay[CurrentMapLayer] == MiddayTimeOfDay || Map.TimeOfDay[CurrentMapLayer] == AfternoonTimeOfDay) {
-			if (!PlayerColorTextures[player]) {
-				MakePlayerColorTexture(this, player, NoTimeOfDay);
-			}
-			DoDrawFrameClip(PlayerColorTextures[player], frame, x, y, show_percent);
-		} else if (Map.TimeOfDay[CurrentMapLayer] == DawnTimeOfDay) {
-			if (!PlayerColorTexturesDawn[player]) {
-				MakePlayerColorTexture(this, player, Map.TimeOfDay[CurrentMapLayer]);
-			}
-			DoDrawFrameClip(PlayerColorTexturesDawn[player], frame, x, y, show_percent);
-		} else if (Map.TimeOfDay[CurrentMapLayer] == DuskTimeOfDay) {
-			if (!PlayerColorTexturesDusk[player]) {
-				MakePlayerColorTexture(this, player, Map.TimeOfDay[CurrentMapLayer]);
-			}
-			DoDrawFrameClip(PlayerColorTexturesDusk[player], frame, x, y, show_percent);
-		} else if (Map.TimeOfDay[CurrentMapLayer] == FirstWatchTimeOfDay || Map.TimeOfDay[CurrentMapLayer] == MidnightTimeOfDay || Map.TimeOfDay[CurrentMapLayer] == SecondWatchTimeOfDay) {
-			if (!PlayerColorTexturesNight[player]) {
-				MakePlayerColorTexture(this, player, Map.TimeOfDay[CurrentMapLayer]);
-			}
-			DoDrawFrameClip(PlayerColorTexturesNight[player], frame, x, y, show_percent);
-		}
+		DoDrawFrameClip(GetPlayerColorTextures(player, ignore_time_of_day ? NoTimeOfDay : Map.TimeOfDay[CurrentMapLayer]), frame, x, y, show_percent);
 		//Wyrmgus end
 	} else
 #endif
@@ -684,28 +732,7 @@ void CPlayerColorGraphic::DrawPlayerColorFrameClip(int player, unsigned frame,
 		//Wyrmgus start
 //		GraphicPlayerPixels(Players[player], *this);
 
-		SDL_Surface *surface = NULL;
-		if (ignore_time_of_day || !Map.TimeOfDay[CurrentMapLayer] || Map.TimeOfDay[CurrentMapLayer] == MorningTimeOfDay || Map.TimeOfDay[CurrentMapLayer] == MiddayTimeOfDay || Map.TimeOfDay[CurrentMapLayer] == AfternoonTimeOfDay) {
-			if (!PlayerColorSurfaces[player]) {
-				MakePlayerColorSurface(player, false, NoTimeOfDay);
-			}
-			surface = PlayerColorSurfaces[player];
-		} else if (Map.TimeOfDay[CurrentMapLayer] == DawnTimeOfDay) {
-			if (!PlayerColorSurfacesDawn[player]) {
-				MakePlayerColorSurface(player, false, Map.TimeOfDay[CurrentMapLayer]);
-			}
-			surface = PlayerColorSurfacesDawn[player];
-		} else if (Map.TimeOfDay[CurrentMapLayer] == DuskTimeOfDay) {
-			if (!PlayerColorSurfacesDusk[player]) {
-				MakePlayerColorSurface(player, false, Map.TimeOfDay[CurrentMapLayer]);
-			}
-			surface = PlayerColorSurfacesDusk[player];
-		} else if (Map.TimeOfDay[CurrentMapLayer] == FirstWatchTimeOfDay || Map.TimeOfDay[CurrentMapLayer] == MidnightTimeOfDay || Map.TimeOfDay[CurrentMapLayer] == SecondWatchTimeOfDay) {
-			if (!PlayerColorSurfacesNight[player]) {
-				MakePlayerColorSurface(player, false, Map.TimeOfDay[CurrentMapLayer]);
-			}
-			surface = PlayerColorSurfacesNight[player];
-		}
+		SDL_Surface *surface = GetPlayerColorSurface(player, false, ignore_time_of_day ? NoTimeOfDay : Map.TimeOfDay[CurrentMapLayer]);
 		
 //		DrawFrameClip(frame, x, y);
 		DrawFrameClip(frame, x, y, true, surface);
@@ -730,37 +757,13 @@ void CPlayerColorGraphic::DrawPlayerColorFrameClipTrans(int player, unsigned fra
 			MakePlayerColorTexture(this, player);
 		}
 		*/
-		if (ignore_time_of_day || !Map.TimeOfDay[CurrentMapLayer] || Map.TimeOfDay[CurrentMapLayer] == MorningTimeOfDay || Map.TimeOfDay[CurrentMapLayer] == MiddayTimeOfDay || Map.TimeOfDay[CurrentMapLayer] == AfternoonTimeOfDay) {
-			if (!PlayerColorTextures[player]) {
-				MakePlayerColorTexture(this, player, NoTimeOfDay);
-			}
-		} else if (Map.TimeOfDay[CurrentMapLayer] == DawnTimeOfDay) {
-			if (!PlayerColorTexturesDawn[player]) {
-				MakePlayerColorTexture(this, player, Map.TimeOfDay[CurrentMapLayer]);
-			}
-		} else if (Map.TimeOfDay[CurrentMapLayer] == DuskTimeOfDay) {
-			if (!PlayerColorTexturesDusk[player]) {
-				MakePlayerColorTexture(this, player, Map.TimeOfDay[CurrentMapLayer]);
-			}
-		} else if (Map.TimeOfDay[CurrentMapLayer] == FirstWatchTimeOfDay || Map.TimeOfDay[CurrentMapLayer] == MidnightTimeOfDay || Map.TimeOfDay[CurrentMapLayer] == SecondWatchTimeOfDay) {
-			if (!PlayerColorTexturesNight[player]) {
-				MakePlayerColorTexture(this, player, Map.TimeOfDay[CurrentMapLayer]);
-			}
-		}
+		GLuint *textures = GetPlayerColorTextures(player, ignore_time_of_day ? NoTimeOfDay : Map.TimeOfDay[CurrentMapLayer]);
 		//Wyrmgus end
 		glTexEnvf(GL_TEXTURE_ENV, GL_TEXTURE_ENV_MODE, GL_MODULATE);
 		glColor4ub(255, 255, 255, alpha);
 		//Wyrmgus start
 //		DoDrawFrameClip(PlayerColorTextures[player], frame, x, y);
-		if (ignore_time_of_day || !Map.TimeOfDay[CurrentMapLayer] || Map.TimeOfDay[CurrentMapLayer] == MorningTimeOfDay || Map.TimeOfDay[CurrentMapLayer] == MiddayTimeOfDay || Map.TimeOfDay[CurrentMapLayer] == AfternoonTimeOfDay) {
-			DoDrawFrameClip(PlayerColorTextures[player], frame, x, y, show_percent);
-		} else if (Map.TimeOfDay[CurrentMapLayer] == DawnTimeOfDay) {
-			DoDrawFrameClip(PlayerColorTexturesDawn[player], frame, x, y, show_percent);
-		} else if (Map.TimeOfDay[CurrentMapLayer] == DuskTimeOfDay) {
-			DoDrawFrameClip(PlayerColorTexturesDusk[player], frame, x, y, show_percent);
-		} else if (Map.TimeOfDay[CurrentMapLayer] == FirstWatchTimeOfDay || Map.TimeOfDay[CurrentMapLayer] == MidnightTimeOfDay || Map.TimeOfDay[CurrentMapLayer] == SecondWatchTimeOfDay) {
-			DoDrawFrameClip(PlayerColorTexturesNight[player], frame, x, y, show_percent);
-		}
+		DoDrawFrameClip(textures, frame, x, y, show_percent);
 		//Wyrmgus end
 		glTexEnvf(GL_TEXTURE_ENV, GL_TEXTURE_ENV_MODE, GL_REPLACE);
 	} else
@@ -769,28 +772,7 @@ void CPlayerColorGraphic::DrawPlayerColorFrameClipTrans(int player, unsigned fra
 		//Wyrmgus start
 //		GraphicPlayerPixels(Players[player], *this);
 
-		SDL_Surface *surface = NULL;
-		if (ignore_time_of_day || !Map.TimeOfDay[CurrentMapLayer] || Map.TimeOfDay[CurrentMapLayer] == MorningTimeOfDay || Map.TimeOfDay[CurrentMapLayer] == MiddayTimeOfDay || Map.TimeOfDay[CurrentMapLayer] == AfternoonTimeOfDay) {
-			if (!PlayerColorSurfaces[player]) {
-				MakePlayerColorSurface(player, false, NoTimeOfDay);
-			}
-			surface = PlayerColorSurfaces[player];
-		} else if (Map.TimeOfDay[CurrentMapLayer] == DawnTimeOfDay) {
-			if (!PlayerColorSurfacesDawn[player]) {
-				MakePlayerColorSurface(player, false, Map.TimeOfDay[CurrentMapLayer]);
-			}
-			surface = PlayerColorSurfacesDawn[player];
-		} else if (Map.TimeOfDay[CurrentMapLayer] == DuskTimeOfDay) {
-			if (!PlayerColorSurfacesDusk[player]) {
-				MakePlayerColorSurface(player, false, Map.TimeOfDay[CurrentMapLayer]);
-			}
-			surface = PlayerColorSurfacesDusk[player];
-		} else if (Map.TimeOfDay[CurrentMapLayer] == FirstWatchTimeOfDay || Map.TimeOfDay[CurrentMapLayer] == MidnightTimeOfDay || Map.TimeOfDay[CurrentMapLayer] == SecondWatchTimeOfDay) {
-			if (!PlayerColorSurfacesNight[player]) {
-				MakePlayerColorSurface(player, false, Map.TimeOfDay[CurrentMapLayer]);
-			}
-			surface = PlayerColorSurfacesNight[player];
-		}
+		SDL_Surface *surface = GetPlayerColorSurface(player, false, ignore_time_of_day ? NoTimeOfDay : Map.TimeOfDay[CurrentMapLayer]);
 		
 //		DrawFrameClipTrans(frame, x, y, alpha);
 		DrawFrameClipTrans(frame, x, y, alpha, true, surface);
@@ -819,37 +801,13 @@ void CPlayerColorGraphic::DrawPlayerColorFrameClipTransX(int player, unsigned fr
 			MakePlayerColorTexture(this, player);
 		}
 		*/
-		if (ignore_time_of_day || !Map.TimeOfDay[CurrentMapLayer] || Map.TimeOfDay[CurrentMapLayer] == MorningTimeOfDay || Map.TimeOfDay[CurrentMapLayer] == MiddayTimeOfDay || Map.TimeOfDay[CurrentMapLayer] == AfternoonTimeOfDay) {
-			if (!PlayerColorTextures[player]) {
-				MakePlayerColorTexture(this, player, NoTimeOfDay);
-			}
-		} else if (Map.TimeOfDay[CurrentMapLayer] == DawnTimeOfDay) {
-			if (!PlayerColorTexturesDawn[player]) {
-				MakePlayerColorTexture(this, player, Map.TimeOfDay[CurrentMapLayer]);
-			}
-		} else if (Map.TimeOfDay[CurrentMapLayer] == DuskTimeOfDay) {
-			if (!PlayerColorTexturesDusk[player]) {
-				MakePlayerColorTexture(this, player, Map.TimeOfDay[CurrentMapLayer]);
-			}
-		} else if (Map.TimeOfDay[CurrentMapLayer] == FirstWatchTimeOfDay || Map.TimeOfDay[CurrentMapLayer] == MidnightTimeOfDay || Map.TimeOfDay[CurrentMapLayer] == SecondWatchTimeOfDay) {
-			if (!PlayerColorTexturesNight[player]) {
-				MakePlayerColorTexture(this, player, Map.TimeOfDay[CurrentMapLayer]);
-			}
-		}
+		GLuint *textures = GetPlayerColorTextures(player, ignore_time_of_day ? NoTimeOfDay : Map.TimeOfDay[CurrentMapLayer]);
 		//Wyrmgus end
 		glTexEnvf(GL_TEXTURE_ENV, GL_TEXTURE_ENV_MODE, GL_MODULATE);
 		glColor4ub(255, 255, 255, alpha);
 		//Wyrmgus start
 //		DoDrawFrameClipX(PlayerColorTextures[player], frame, x, y);
-		if (ignore_time_of_day || !Map.TimeOfDay[CurrentMapLayer] || Map.TimeOfDay[CurrentMapLayer] == MorningTimeOfDay || Map.TimeOfDay[CurrentMapLayer] == MiddayTimeOfDay || Map.TimeOfDay[CurrentMapLayer] == AfternoonTimeOfDay) {
-			DoDrawFrameClipX(PlayerColorTextures[player], frame, x, y);
-		} else if (Map.TimeOfDay[CurrentMapLayer] == DawnTimeOfDay) {
-			DoDrawFrameClipX(PlayerColorTexturesDawn[player], frame, x, y);
-		} else if (Map.TimeOfDay[CurrentMapLayer] == DuskTimeOfDay) {
-			DoDrawFrameClipX(PlayerColorTexturesDusk[player], frame, x, y);
-		} else if (Map.TimeOfDay[CurrentMapLayer] == FirstWatchTimeOfDay || Map.TimeOfDay[CurrentMapLayer] == MidnightTimeOfDay || Map.TimeOfDay[CurrentMapLayer] == SecondWatchTimeOfDay) {
-			DoDrawFrameClipX(PlayerColorTexturesNight[player], frame, x, y);
-		}
+		DoDrawFrameClipX(textures, frame, x, y);
 		//Wyrmgus end
 		glTexEnvf(GL_TEXTURE_ENV, GL_TEXTURE_ENV_MODE, GL_REPLACE);
 	} else
@@ -858,28 +816,7 @@ void CPlayerColorGraphic::DrawPlayerColorFrameClipTransX(int player, unsigned fr
 		//Wyrmgus start
 //		GraphicPlayerPixels(Players[player], *this);
 
-		SDL_Surface *surface = NULL;
-		if (ignore_time_of_day || !Map.TimeOfDay[CurrentMapLayer] || Map.TimeOfDay[CurrentMapLayer] == MorningTimeOfDay || Map.TimeOfDay[CurrentMapLayer] == MiddayTimeOfDay || Map.TimeOfDay[CurrentMapLayer] == AfternoonTimeOfDay) {
-			if (!PlayerColorSurfacesFlip[player]) {
-				MakePlayerColorSurface(player, true, NoTimeOfDay);
-			}
-			surface = PlayerColorSurfacesFlip[player];
-		} else if (Map.TimeOfDay[CurrentMapLayer] == DawnTimeOfDay) {
-			if (!PlayerColorSurfacesDawnFlip[player]) {
-				MakePlayerColorSurface(player, true, Map.TimeOfDay[CurrentMapLayer]);
-			}
-			surface = PlayerColorSurfacesDawnFlip[player];
-		} else if (Map.TimeOfDay[CurrentMapLayer] == DuskTimeOfDay) {
-			if (!PlayerColorSurfacesDuskFlip[player]) {
-				MakePlayerColorSurface(player, true, Map.TimeOfDay[CurrentMapLayer]);
-			}
-			surface = PlayerColorSurfacesDuskFlip[player];
-		} else if (Map.TimeOfDay[CurrentMapLayer] == FirstWatchTimeOfDay || Map.TimeOfDay[CurrentMapLayer] == MidnightTimeOfDay || Map.TimeOfDay[CurrentMapLayer] == SecondWatchTimeOfDay) {
-			if (!PlayerColorSurfacesNightFlip[player]) {
-				MakePlayerColorSurface(player, true, Map.TimeOfDay[CurrentMapLayer]);
-			}
-			surface = PlayerColorSurfacesNightFlip[player];
-		}
+		SDL_Surface *surface = GetPlayerColorSurface(player, true, ignore_time_of_day ? NoTimeOfDay : Map.TimeOfDay[CurrentMapLayer]);
 		
 //		DrawFrameClipTransX(frame, x, y, alpha);
 		DrawFrameClipTransX(frame, x, y, alpha, true, surface);
@@ -954,24 +891,7 @@ void CGraphic::DrawFrameClipX(unsigned frame, int x, int y, bool ignore_time_of_
 	if (UseOpenGL) {
 		//Wyrmgus start
 		//DoDrawFrameClipX(Textures, frame, x, y);
-		if (ignore_time_of_day || !Map.TimeOfDay[CurrentMapLayer] || Map.TimeOfDay[CurrentMapLayer] == MorningTimeOfDay || Map.TimeOfDay[CurrentMapLayer] == MiddayTimeOfDay || Map.TimeOfDay[CurrentMapLayer] == AfternoonTimeOfDay) {
-			DoDrawFrameClipX(Textures, frame, x, y);
-		} else if (Map.TimeOfDay[CurrentMapLayer] == DawnTimeOfDay) {
-			if (!TexturesDawn) {
-				MakeTexture(this, Map.TimeOfDay[CurrentMapLayer]);
-			}
-			DoDrawFrameClipX(TexturesDawn, frame, x, y);
-		} else if (Map.TimeOfDay[CurrentMapLayer] == DuskTimeOfDay) {
-			if (!TexturesDusk) {
-				MakeTexture(this, Map.TimeOfDay[CurrentMapLayer]);
-			}
-			DoDrawFrameClipX(TexturesDusk, frame, x, y);
-		} else if (Map.TimeOfDay[CurrentMapLayer] == FirstWatchTimeOfDay || Map.TimeOfDay[CurrentMapLayer] == MidnightTimeOfDay || Map.TimeOfDay[CurrentMapLayer] == SecondWatchTimeOfDay) {
-			if (!TexturesNight) {
-				MakeTexture(this, Map.TimeOfDay[CurrentMapLayer]);
-			}
-			DoDrawFrameClipX(TexturesNight, frame, x, y);
-		}
+		DoDrawFrameClipX(GetTextures(ignore_time_of_day ? NoTimeOfDay : Map.TimeOfDay[CurrentMapLayer]), frame, x, y);
 		//Wyrmgus end
 	} else
 #endif
@@ -1108,27 +1028,7 @@ void CPlayerColorGraphic::DrawPlayerColorFrameClipX(int player, unsigned frame,
 		}
 		DoDrawFrameClipX(PlayerColorTextures[player], frame, x, y);
 		*/
-		if (ignore_time_of_day || !Map.TimeOfDay[CurrentMapLayer] || Map.TimeOfDay[CurrentMapLayer] == MorningTimeOfDay || Map.TimeOfDay[CurrentMapLayer] == MiddayTimeOfDay || Map.TimeOfDay[CurrentMapLayer] == AfternoonTimeOfDay) {
-			if (!PlayerColorTextures[player]) {
-				MakePlayerColorTexture(this, player, NoTimeOfDay);
-			}
-			DoDrawFrameClipX(PlayerColorTextures[player], frame, x, y);
-		} else if (Map.TimeOfDay[CurrentMapLayer] == DawnTimeOfDay) {
-			if (!PlayerColorTexturesDawn[player]) {
-				MakePlayerColorTexture(this, player, Map.TimeOfDay[CurrentMapLayer]);
-			}
-			DoDrawFrameClipX(PlayerColorTexturesDawn[player], frame, x, y);
-		} else if (Map.TimeOfDay[CurrentMapLayer] == DuskTimeOfDay) {
-			if (!PlayerColorTexturesDusk[player]) {
-				MakePlayerColorTexture(this, player, Map.TimeOfDay[CurrentMapLayer]);
-			}
-			DoDrawFrameClipX(PlayerColorTexturesDusk[player], frame, x, y);
-		} else if (Map.TimeOfDay[CurrentMapLayer] == FirstWatchTimeOfDay || Map.TimeOfDay[CurrentMapLayer] == MidnightTimeOfDay || Map.TimeOfDay[CurrentMapLayer] == SecondWatchTimeOfDay) {
-			if (!PlayerColorTexturesNight[player]) {
-				MakePlayerColorTexture(this, player, Map.TimeOfDay[CurrentMapLayer]);
-			}
-			DoDrawFrameClipX(PlayerColorTexturesNight[player], frame, x, y);
-		}
+		DoDrawFrameClipX(GetPlayerColorTextures(player, ignore_time_of_day ? NoTimeOfDay : Map.TimeOfDay[CurrentMapLayer]), frame, x, y);
 		//Wyrmgus end
 	} else
 #endif
@@ -1136,28 +1036,7 @@ void CPlayerColorGraphic::DrawPlayerColorFrameClipX(int player, unsigned frame,
 		//Wyrmgus start
 //		GraphicPlayerPixels(Players[player], *this);
 
-		SDL_Surface *surface = NULL;
-		if (ignore_time_of_day || !Map.TimeOfDay[CurrentMapLayer] || Map.TimeOfDay[CurrentMapLayer] == MorningTimeOfDay || Map.TimeOfDay[CurrentMapLayer] == MiddayTimeOfDay || Map.TimeOfDay[CurrentMapLayer] == AfternoonTimeOfDay) {
-			if (!PlayerColorSurfacesFlip[player]) {
-				MakePlayerColorSurface(player, true, NoTimeOfDay);
-			}
-			surface = PlayerColorSurfacesFlip[player];
-		} else if (Map.TimeOfDay[CurrentMapLayer] == DawnTimeOfDay) {
-			if (!PlayerColorSurfacesDawnFlip[player]) {
-				MakePlayerColorSurface(player, true, Map.TimeOfDay[CurrentMapLayer]);
-			}
-			surface = PlayerColorSurfacesDawnFlip[player];
-		} else if (Map.TimeOfDay[CurrentMapLayer] == DuskTimeOfDay) {
-			if (!PlayerColorSurfacesDuskFlip[player]) {
-				MakePlayerColorSurface(player, true, Map.TimeOfDay[CurrentMapLayer]);
-			}
-			surface = PlayerColorSurfacesDuskFlip[player];
-		} else if (Map.TimeOfDay[CurrentMapLayer] == FirstWatchTimeOfDay || Map.TimeOfDay[CurrentMapLayer] == MidnightTimeOfDay || Map.TimeOfDay[CurrentMapLayer] == SecondWatchTimeOfDay) {
-			if (!PlayerColorSurfacesNightFlip[player]) {
-				MakePlayerColorSurface(player, true, Map.TimeOfDay[CurrentMapLayer]);
-			}
-			surface = PlayerColorSurfacesNightFlip[player];
-		}
+		SDL_Surface *surface = GetPlayerColorSurface(player, true, ignore_time_of_day ? NoTimeOfDay : Map.TimeOfDay[CurrentMapLayer]);
 		
 //		DrawFrameClipX(frame, x, y);
 		DrawFrameClipX(frame, x, y, true, surface);
@@ -1638,6 +1517,9 @@ void CGraphic::Free(CGraphic *g)
 
 	--g->Refs;
 	if (!g->Refs) {
+		//Wyrmgus start
+		RemoveGraphicSpriteVariants(*g);
+		//Wyrmgus end
 #if defined(USE_OPENGL) || defined(USE_GLES)
 		// No more uses of this graphic
 		if (UseOpenGL) {
@@ -2117,40 +1999,15 @@ void MakeTextures2(CGraphic *g, GLuint texture, CUnitColors *colors,
 	int time_of_day_blue = 0;
 	
 	if (!g->Grayscale) { // don't alter the colors of grayscale graphics
-		if (time_of_day == 1) { // dawn
-			time_of_day_red = -20;
-			time_of_day_green = -20;
-			time_of_day_blue = 0;
-		} else if (time_of_day == 2) { // morning
-			time_of_day_red = 0;
-			time_of_day_green = 0;
-			time_of_day_blue = 0;
-		} else if (time_of_day == 3) { // midday
-			time_of_day_red = 0;
-			time_of_day_green = 0;
-			time_of_day_blue = 0;
-		} else if (time_of_day == 4) { // afternoon
-			time_of_day_red = 0;
-			time_of_day_green = 0;
-			time_of_day_blue = 0;
-		} else if (time_of_day == 5) { // dusk
-			time_of_day_red = 0;
-			time_of_day_green = -20;
-			time_of_day_blue = -20;
-		} else if (time_of_day == 6) { // first watch
-			time_of_day_red = -45;
-			time_of_day_green = -35;
-			time_of_day_blue = -10;
-		} else if (time_of_day == 7) { // midnight
-			time_of_day_red = -45;
-			time_of_day_green = -35;
-			time_of_day_blue = -10;
-		} else if (time_of_day == 8) { // second watch
-			time_of_day_red = -45;
-			time_of_day_green = -35;
-			time_of_day_blue = -10;
-		}
+		GetTimeOfDayColorModifier(time_of_day, time_of_day_red, time_of_day_green, time_of_day_blue);
 	}
+	
+	Uint8 red_table[256];
+	Uint8 green_table[256];
+	Uint8 blue_table[256];
+	MakeColorModifierTable(time_of_day_red, red_table);
+	MakeColorModifierTable(time_of_day_green, green_table);
+	MakeColorModifierTable(time_of_day_blue, blue_table);
 	//Wyrmgus end
 
 	for (int i = 0; i < maxh; ++i) {
@@ -2196,9 +2053,9 @@ void MakeTextures2(CGraphic *g, GLuint texture, CUnitColors *colors,
 						}
 					}
 				
-					tp[0] = std::max<int>(0,std::min<int>(255,int(red) + time_of_day_red));
-					tp[1] = std::max<int>(0,std::min<int>(255,int(green) + time_of_day_green));
-					tp[2] = std::max<int>(0,std::min<int>(255,int(blue) + time_of_day_blue));;
+					tp[0] = red_table[red];
+					tp[1] = green_table[green];
+					tp[2] = blue_table[blue];
 					//Wyrmgus end
 					tp[3] = alpha;
 				}
@@ -2243,9 +2100,9 @@ void MakeTextures2(CGraphic *g, GLuint texture, CUnitColors *colors,
 							 ((colors->Colors[0].G * b / 255) << f->Gshift) |
 							 ((colors->Colors[0].B * b / 255) << f->Bshift);
 						*/
-						pc = ((std::max<int>(0,std::min<int>(255, (*tp) + time_of_day_red))) << f->Rshift) |
-							 ((std::max<int>(0,std::min<int>(255, *(tp + 1) + time_of_day_green))) << f->Gshift) |
-							 ((std::max<int>(0,std::min<int>(255, *(tp + 2) + time_of_day_blue))) << f->Bshift);
+						pc = (red_table[*tp] << f->Rshift) |
+							 (green_table[*(tp + 1)] << f->Gshift) |
+							 (blue_table[*(tp + 2)] << f->Bshift);
 						//Wyrmgus end
 						if (bpp == 4) {
 							pc |= (c & f->Amask);
@@ -2621,129 +2478,311 @@ void CGraphic::SetOriginalSize()
 }
 
 //Wyrmgus start
+/**
+**  Free a sprite variant's surface or textures, emptying the slot holding it
+*/
+static void FreeSpriteVariant(CSpriteVariant &variant)
+{
+	if (variant.Surface) {
+		FreeSurface(variant.Surface);
+	}
+#if defined(USE_OPENGL) || defined(USE_GLES)
+	if (variant.Textures && *variant.Textures) {
+		glDeleteTextures(variant.NumTextures, *variant.Textures);
+		delete[] *variant.Textures;
+		*variant.Textures = NULL;
+	}
+#endif
+}
+
+/**
+**  Free the least recently used sprite variants until the cache fits its budget
+**
+**  Variants which have been used in the current display update are never
+**  freed, as they may still be drawn from.
+*/
+static void EvictSpriteVariants()
+{
+	while (SpriteVariantCacheBytes > SpriteVariantCacheBudget && !SpriteVariants.empty()) {
+		CSpriteVariant &variant = SpriteVariants.back();
+		if (variant.LastUsedFrame == DisplayFrameCounter) {
+			break;
+		}
+		
+		FreeSpriteVariant(variant);
+		SpriteVariantCacheBytes -= variant.Bytes;
+#if defined(USE_OPENGL) || defined(USE_GLES)
+		SpriteVariantsBySlot.erase(variant.Surface ? (void *) variant.Surface : (void *) variant.Textures);
+#else
+		SpriteVariantsBySlot.erase((void *) variant.Surface);
+#endif
+		SpriteVariants.pop_back();
+		++SpriteVariantCacheEvictions;
+	}
+}
+
+/**
+**  Mark a cached sprite variant as the most recently used one
+**
+**  @param slot  The slot holding the variant.
+**
+**  @return  True if the variant is in the cache.
+*/
+static bool UseSpriteVariant(void *slot)
+{
+	std::unordered_map<void *, std::list<CSpriteVariant>::iterator>::iterator find_iterator = SpriteVariantsBySlot.find(slot);
+	if (find_iterator == SpriteVariantsBySlot.end()) {
+		return false;
+	}
+	
+	// the variants are only ordered by the display update in which they were last used, so a variant drawn many times in an update is only moved once
+	if (find_iterator->second->LastUsedFrame != DisplayFrameCounter) {
+		SpriteVariants.splice(SpriteVariants.begin(), SpriteVariants, find_iterator->second);
+		find_iterator->second->LastUsedFrame = DisplayFrameCounter;
+	}
+	++SpriteVariantCacheHits;
+	return true;
+}
+
+/**
+**  Add a sprite variant which has just been made to the cache
+*/
+static void AddSpriteVariant(const CSpriteVariant &variant, void *slot)
+{
+	SpriteVariants.push_front(variant);
+	SpriteVariants.front().LastUsedFrame = DisplayFrameCounter;
+	SpriteVariantsBySlot[slot] = SpriteVariants.begin();
+	SpriteVariantCacheBytes += variant.Bytes;
+	++SpriteVariantCacheMisses;
+	
+	EvictSpriteVariants();
+}
+
+static void AddSpriteVariant(SDL_Surface **slot)
+{
+	CSpriteVariant variant;
+	variant.Surface = slot;
+	variant.Bytes = (*slot)->h * (*slot)->pitch;
+	if ((*slot)->format->palette) {
+		variant.Bytes += (*slot)->format->palette->ncolors * sizeof(SDL_Color);
+	}
+	AddSpriteVariant(variant, slot);
+}
+
+#if defined(USE_OPENGL) || defined(USE_GLES)
+static void AddSpriteVariant(GLuint **slot, const CGraphic &graphic)
+{
+	CSpriteVariant variant;
+	variant.Textures = slot;
+	variant.NumTextures = graphic.NumTextures;
+	for (int y = 0; y < graphic.GraphicHeight; y += GLMaxTextureSize) {
+		for (int x = 0; x < graphic.GraphicWidth; x += GLMaxTextureSize) {
+			variant.Bytes += PowerOf2(std::min<int>(GLMaxTextureSize, graphic.GraphicWidth - x)) * PowerOf2(std::min<int>(GLMaxTextureSize, graphic.GraphicHeight - y)) * 4;
+		}
+	}
+	AddSpriteVariant(variant, slot);
+}
+#endif
+
+/**
+**  Remove a sprite variant from the cache, without freeing it
+*/
+static void RemoveSpriteVariant(void *slot)
+{
+	std::unordered_map<void *, std::list<CSpriteVariant>::iterator>::iterator find_iterator = SpriteVariantsBySlot.find(slot);
+	if (find_iterator == SpriteVariantsBySlot.end()) {
+		return;
+	}
+	
+	SpriteVariantCacheBytes -= find_iterator->second->Bytes;
+	SpriteVariants.erase(find_iterator->second);
+	SpriteVariantsBySlot.erase(find_iterator);
+}
+
+/**
+**  Remove all variants of a graphic from the sprite variant cache, for when the graphic is freed
+*/
+static void RemoveGraphicSpriteVariants(CGraphic &graphic)
+{
+	if (SpriteVariants.empty()) {
+		return;
+	}
+	
+	RemoveSpriteVariant(&graphic.DawnSurface);
+	RemoveSpriteVariant(&graphic.DawnSurfaceFlip);
+	RemoveSpriteVariant(&graphic.DuskSurface);
+	RemoveSpriteVariant(&graphic.DuskSurfaceFlip);
+	RemoveSpriteVariant(&graphic.NightSurface);
+	RemoveSpriteVariant(&graphic.NightSurfaceFlip);
+#if defined(USE_OPENGL) || defined(USE_GLES)
+	RemoveSpriteVariant(&graphic.TexturesDawn);
+	RemoveSpriteVariant(&graphic.TexturesDusk);
+	RemoveSpriteVariant(&graphic.TexturesNight);
+#endif
+
+	CPlayerColorGraphic *cg = dynamic_cast<CPlayerColorGraphic *>(&graphic);
+	if (cg) {
+		for (int i = 0; i < PlayerColorMax; ++i) {
+			RemoveSpriteVariant(&cg->PlayerColorSurfaces[i]);
+			RemoveSpriteVariant(&cg->PlayerColorSurfacesFlip[i]);
+			RemoveSpriteVariant(&cg->PlayerColorSurfacesDawn[i]);
+			RemoveSpriteVariant(&cg->PlayerColorSurfacesDawnFlip[i]);
+			RemoveSpriteVariant(&cg->PlayerColorSurfacesDusk[i]);
+			RemoveSpriteVariant(&cg->PlayerColorSurfacesDuskFlip[i]);
+			RemoveSpriteVariant(&cg->PlayerColorSurfacesNight[i]);
+			RemoveSpriteVariant(&cg->PlayerColorSurfacesNightFlip[i]);
+#if defined(USE_OPENGL) || defined(USE_GLES)
+			RemoveSpriteVariant(&cg->PlayerColorTextures[i]);
+			RemoveSpriteVariant(&cg->PlayerColorTexturesDawn[i]);
+			RemoveSpriteVariant(&cg->PlayerColorTexturesDusk[i]);
+			RemoveSpriteVariant(&cg->PlayerColorTexturesNight[i]);
+#endif
+		}
+	}
+}
+
+/**
+**  Set the memory budget of the sprite variant cache
+**
+**  @param megabytes  The memory the cached sprite variants may hold, in megabytes.
+*/
+void SetSpriteVariantCacheBudget(int megabytes)
+{
+	SpriteVariantCacheBudget = (size_t) std::max(0, megabytes) * 1024 * 1024;
+	EvictSpriteVariants();
+}
+
+/**
+**  Print the hit rate and memory use of the sprite variant cache
+*/
+void PrintSpriteVariantCacheStatistics()
+{
+	const unsigned long lookups = SpriteVariantCacheHits + SpriteVariantCacheMisses;
+	fprintf(stdout, "Sprite variant cache: %lu variants holding %lu KB of a %lu KB budget, %lu hits and %lu misses (%.1f%% hit rate), %lu evictions.\n", (unsigned long) SpriteVariants.size(), (unsigned long) (SpriteVariantCacheBytes / 1024), (unsigned long) (SpriteVariantCacheBudget / 1024), SpriteVariantCacheHits, SpriteVariantCacheMisses, lookups ? SpriteVariantCacheHits * 100.0 / lookups : 0.0, SpriteVariantCacheEvictions);
+}
+
 /**
 **  Set a graphic's time of day
 **
 **  @param time  New time of day of graphic.
+**
+**  @return  The surface of the graphic for the time of day, made and cached if needed.
 */
 SDL_Surface *CGraphic::SetTimeOfDay(int time, bool flipped)
 {
 	Assert(Surface);
 
-	if (this->Grayscale || !time) {
-		if (flipped && SurfaceFlip) {
-			return SurfaceFlip;
-		} else {
-			return Surface;
-		}
-	} else if (time == DawnTimeOfDay) {
-		if (flipped) {
-			if (DawnSurfaceFlip) {
-				return DawnSurfaceFlip;
-			}
-		} else {
-			if (DawnSurface) {
-				return DawnSurface;
-			}
-		}
-	} else if (time == DuskTimeOfDay) {
-		if (flipped) {
-			if (DuskSurfaceFlip) {
-				return DuskSurfaceFlip;
-			}
-		} else {
-			if (DuskSurface) {
-				return DuskSurface;
-			}
-		}
-	} else if (time == FirstWatchTimeOfDay || time == MidnightTimeOfDay || time == SecondWatchTimeOfDay) {
-		if (flipped) {
-			if (NightSurfaceFlip) {
-				return NightSurfaceFlip;
-			}
-		} else {
-			if (NightSurface) {
-				return NightSurface;
-			}
-		}
-	} else {
-		if (flipped) {
-			return SurfaceFlip;
-		} else {
-			return Surface;
-		}
+	SDL_Surface *base_surface = (flipped && SurfaceFlip) ? SurfaceFlip : Surface;
+	SDL_Surface **surface_slot = this->Grayscale ? NULL : GetTimeOfDaySurfaceSlot(*this, time, flipped);
+	if (!surface_slot) {
+		return base_surface;
 	}
+	
+	if (UseSpriteVariant(surface_slot)) {
+		return *surface_slot;
+	}
+	
+	if (!*surface_slot) {
+		SDL_Surface *surface = *surface_slot = SDL_ConvertSurface(base_surface, base_surface->format, SDL_SWSURFACE);
+		
+		int time_of_day_red;
+		int time_of_day_green;
+		int time_of_day_blue;
+		GetTimeOfDayColorModifier(time, time_of_day_red, time_of_day_green, time_of_day_blue);
+		ApplyColorModifierLUT(surface, time_of_day_red, time_of_day_green, time_of_day_blue);
+	}
+	
+	AddSpriteVariant(surface_slot);
+	return *surface_slot;
+}
 
-	SDL_Surface *surface = NULL;
-	SDL_Surface *base_surface = flipped ? SurfaceFlip : Surface;
-	int time_of_day_red = 0;
-	int time_of_day_green = 0;
-	int time_of_day_blue = 0;
+/**
+**  Get the surface of a player color graphic for a player color and time of day, making and caching it if needed
+*/
+SDL_Surface *CPlayerColorGraphic::GetPlayerColorSurface(int player_color, bool flipped, int time_of_day)
+{
+	SDL_Surface **surface_slot = GetPlayerColorSurfaceSlot(*this, player_color, flipped, time_of_day);
+	if (UseSpriteVariant(surface_slot)) {
+		return *surface_slot;
+	}
+	
+	if (!*surface_slot) {
+		MakePlayerColorSurface(player_color, flipped, time_of_day);
+	}
+	if (*surface_slot) {
+		AddSpriteVariant(surface_slot);
+	}
+	return *surface_slot;
+}
 
-	if (time == DawnTimeOfDay) {
-		if (flipped) {
-			surface = DawnSurfaceFlip = SDL_ConvertSurface(base_surface, base_surface->format, SDL_SWSURFACE);
-		} else {
-			surface = DawnSurface = SDL_ConvertSurface(base_surface, base_surface->format, SDL_SWSURFACE);
-		}
-		time_of_day_red = -20;
-		time_of_day_green = -20;
-		time_of_day_blue = 0;
-	} else if (time == DuskTimeOfDay) {
-		if (flipped) {
-			surface = DuskSurfaceFlip = SDL_ConvertSurface(base_surface, base_surface->format, SDL_SWSURFACE);
-		} else {
-			surface = DuskSurface = SDL_ConvertSurface(base_surface, base_surface->format, SDL_SWSURFACE);
-		}
-		time_of_day_red = 0;
-		time_of_day_green = -20;
-		time_of_day_blue = -20;
-	} else if (time == FirstWatchTimeOfDay || time == MidnightTimeOfDay || time == SecondWatchTimeOfDay) {
-		if (flipped) {
-			surface = NightSurfaceFlip = SDL_ConvertSurface(base_surface, base_surface->format, SDL_SWSURFACE);
-		} else {
-			surface = NightSurface = SDL_ConvertSurface(base_surface, base_surface->format, SDL_SWSURFACE);
-		}
-		time_of_day_red = -45;
-		time_of_day_green = -35;
-		time_of_day_blue = -10;
+#if defined(USE_OPENGL) || defined(USE_GLES)
+/**
+**  Get the textures of a graphic for a time of day, making and caching them if needed
+*/
+GLuint *CGraphic::GetTextures(int time_of_day)
+{
+	GLuint **textures_slot;
+	switch (this->Grayscale ? NoTimeOfDay : time_of_day) {
+		case DawnTimeOfDay:
+			textures_slot = &TexturesDawn;
+			break;
+		case DuskTimeOfDay:
+			textures_slot = &TexturesDusk;
+			break;
+		case FirstWatchTimeOfDay:
+		case MidnightTimeOfDay:
+		case SecondWatchTimeOfDay:
+			textures_slot = &TexturesNight;
+			break;
+		default:
+			return Textures;
 	}
 	
-	if (time_of_day_red != 0 || time_of_day_green != 0 || time_of_day_blue != 0) {
-		const int bpp = surface->format->BytesPerPixel;
-		if (bpp == 1) {
-			SDL_LockSurface(surface);
-			SDL_Color colors[256];
-			SDL_Palette &pal = *surface->format->palette;
-			for (int i = 0; i < 256; ++i) {
-				colors[i].r = std::max<int>(0,std::min<int>(255,int(pal.colors[i].r) + time_of_day_red));
-				colors[i].g = std::max<int>(0,std::min<int>(255,int(pal.colors[i].g) + time_of_day_green));
-				colors[i].b = std::max<int>(0,std::min<int>(255,int(pal.colors[i].b) + time_of_day_blue));
-			}
-			SDL_SetColors(surface, &colors[0], 0, 256);
-			if (SurfaceFlip) {
-				SDL_SetColors(SurfaceFlip, &colors[0], 0, 256);
-			}
-			SDL_UnlockSurface(surface);
-		} else if (bpp == 4) {
-			for (int y = 0; y < surface->h; ++y) {
-				for (int x = 0; x < surface->w; ++x) {
-					Uint32 c;
-					SDL_PixelFormat *f = surface->format;
-					c = *(Uint32 *)&((Uint8 *)surface->pixels)[x * bpp + y * surface->pitch];
-					Uint8 red = (std::max<int>(0,std::min<int>(255, ((c & f->Rmask) >> f->Rshift) + time_of_day_red)));
-					Uint8 green = (std::max<int>(0,std::min<int>(255, ((c & f->Gmask) >> f->Gshift) + time_of_day_green)));
-					Uint8 blue = (std::max<int>(0,std::min<int>(255, ((c & f->Bmask) >> f->Bshift) + time_of_day_blue)));
-					Uint8 alpha = ((c & f->Amask) >> f->Ashift);
-					c = Video.MapRGBA(f, red, green, blue, alpha);
-					*(Uint32 *)&((Uint8 *)surface->pixels)[(x + y * surface->w) * bpp] = c;
-				}
-			}
-		}
+	if (UseSpriteVariant(textures_slot)) {
+		return *textures_slot;
 	}
 	
-	return surface;
+	if (!*textures_slot) {
+		MakeTexture(this, time_of_day);
+	}
+	AddSpriteVariant(textures_slot, *this);
+	return *textures_slot;
 }
+
+/**
+**  Get the textures of a player color graphic for a player color and time of day, making and caching them if needed
+*/
+GLuint *CPlayerColorGraphic::GetPlayerColorTextures(int player_color, int time_of_day)
+{
+	GLuint **textures_slot;
+	switch (time_of_day) {
+		case DawnTimeOfDay:
+			textures_slot = &PlayerColorTexturesDawn[player_color];
+			break;
+		case DuskTimeOfDay:
+			textures_slot = &PlayerColorTexturesDusk[player_color];
+			break;
+		case FirstWatchTimeOfDay:
+		case MidnightTimeOfDay:
+		case SecondWatchTimeOfDay:
+			textures_slot = &PlayerColorTexturesNight[player_color];
+			break;
+		default:
+			textures_slot = &PlayerColorTextures[player_color];
+			break;
+	}
+	
+	if (UseSpriteVariant(textures_slot)) {
+		return *textures_slot;
+	}
+	
+	if (!*textures_slot) {
+		MakePlayerColorTexture(this, player_color, time_of_day);
+	}
+	AddSpriteVariant(textures_slot, *this);
+	return *textures_slot;
+}
+#endif
 //Wyrmgus end
 
 /**
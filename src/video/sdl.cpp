@@ -474,6 +474,10 @@ void InitVideoSdl()
 		SDL_putenv(strdup("SDL_MOUSE_RELATIVE=0"));
 //Wyrmgus start
 //#endif
+		if (VideoHeadless) {
+			// Draw to a surface in memory, without opening a window
+			SDL_putenv(strdup("SDL_VIDEODRIVER=dummy"));
+		}
 //Wyrmgus end
 		int res = SDL_Init(
 #ifdef DEBUG
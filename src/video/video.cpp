@@ -83,6 +83,9 @@
 #include "stratagus.h"
 
 #include <vector>
+//Wyrmgus start
+#include <chrono>
+//Wyrmgus end
 
 #include "video.h"
 #include "intern_video.h"
@@ -178,10 +181,20 @@ bool GLShaderPipelineSupported = false;
 #endif
 
 char VideoForceFullScreen;           /// fullscreen set from commandline
+//Wyrmgus start
+char VideoHeadless;                  /// draw offscreen without a window, set from commandline
+
+bool RenderStageTiming = false;                          /// whether the stages of drawing are being timed
+unsigned long long RenderStageTimes[MaxRenderStages];    /// microseconds spent in each stage of drawing
+static CRenderStageTimer *CurrentRenderStageTimer = NULL; /// innermost timer which exists
+//Wyrmgus end
 
 double NextFrameTicks;               /// Ticks of begin of the next frame
 unsigned long FrameCounter;          /// Current frame number
 unsigned long SlowFrameCounter;      /// Profile, frames out of sync
+//Wyrmgus start
+unsigned long DisplayFrameCounter;   /// Display updates, including those of the rendering benchmark
+//Wyrmgus end
 
 int ClipX1;                          /// current clipping top left
 int ClipY1;                          /// current clipping top left
@@ -253,6 +266,42 @@ void PopClipping()
 	Clips.pop_back();
 }
 
+//Wyrmgus start
+/**
+**  Get the time for render stage timing, in microseconds.
+*/
+static unsigned long long GetRenderStageTime()
+{
+	return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+CRenderStageTimer::CRenderStageTimer(RenderStages stage) : Stage(MaxRenderStages), StartTime(0), NestedTime(0), Parent(NULL)
+{
+	if (!RenderStageTiming) {
+		return;
+	}
+	
+	this->Stage = stage;
+	this->Parent = CurrentRenderStageTimer;
+	CurrentRenderStageTimer = this;
+	this->StartTime = GetRenderStageTime();
+}
+
+CRenderStageTimer::~CRenderStageTimer()
+{
+	if (this->Stage == MaxRenderStages) {
+		return;
+	}
+	
+	const unsigned long long elapsed_time = GetRenderStageTime() - this->StartTime;
+	RenderStageTimes[this->Stage] += elapsed_time - std::min(this->NestedTime, elapsed_time);
+	if (this->Parent) {
+		this->Parent->NestedTime += elapsed_time;
+	}
+	CurrentRenderStageTimer = this->Parent;
+}
+//Wyrmgus end
+
 /*----------------------------------------------------------------------------
 --  Functions
 ----------------------------------------------------------------------------*/
@@ -361,9 +410,39 @@ static int CclSetVideoSyncSpeed(lua_State *l)
 	return 0;
 }
 
+//Wyrmgus start
+/**
+**  Set the memory budget of the sprite variant cache
+**
+**  @param l  Lua state.
+*/
+static int CclSetSpriteVariantCacheBudget(lua_State *l)
+{
+	LuaCheckArgs(l, 1);
+	SetSpriteVariantCacheBudget(LuaToNumber(l, 1));
+	return 0;
+}
+
+/**
+**  Print the statistics of the sprite variant cache
+**
+**  @param l  Lua state.
+*/
+static int CclPrintSpriteVariantCacheStatistics(lua_State *l)
+{
+	LuaCheckArgs(l, 0);
+	PrintSpriteVariantCacheStatistics();
+	return 0;
+}
+//Wyrmgus end
+
 void VideoCclRegister()
 {
 	lua_register(Lua, "SetVideoSyncSpeed", CclSetVideoSyncSpeed);
+	//Wyrmgus start
+	lua_register(Lua, "SetSpriteVariantCacheBudget", CclSetSpriteVariantCacheBudget);
+	lua_register(Lua, "PrintSpriteVariantCacheStatistics", CclPrintSpriteVariantCacheStatistics);
+	//Wyrmgus end
 }
 
 #if 1 // color cycling